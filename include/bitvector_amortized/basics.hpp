@@ -20,10 +20,15 @@ namespace amo {
 
     using uint = uint32_t;
 
+    // single word, the loops over several words use the kernels of simd.hpp
     inline uint popcount (uint64_t y) { 
+#if defined(__POPCNT__)
+        return __builtin_popcountll(y);
+#else
         y -= ((y >> 1) & 0x5555555555555555ull);
         y = (y & 0x3333333333333333ull) + (y >> 2 & 0x3333333333333333ull);
         return ((y + (y >> 4)) & 0xf0f0f0f0f0f0f0full) * 0x101010101010101ull >> 56;
+#endif
     }
 
     inline void myfread(void* ptr, size_t size, size_t nmemb, std::istream& in) {
@@ -0,0 +1,38 @@
+#ifndef BITVECTOR_AMORTIZED_CONCURRENT
+#define BITVECTOR_AMORTIZED_CONCURRENT
+
+#include "bitvector_amortized/basics.hpp"
+#include <functional>
+
+namespace amo {
+
+    // Concurrent read mode. When enabled, the queries (access, rank, select,
+    // next, read) of a HybridBV can run from many threads at the same time.
+    // They do not flatten the nodes in place: the flattened copy is built on
+    // the side and published atomically, and the old subtree is freed with
+    // epoch-based reclamation. Updates (insert, remove, set, load, serialize)
+    // must still run alone, without readers.
+    // Not thread-safe, call it before using the bitvectors
+    void setConcurrentReads(bool enabled);
+    bool concurrentReads();
+
+    // Pins the current epoch while alive, so that the nodes retired meanwhile
+    // are not freed. Does nothing if the concurrent mode is disabled
+    class EpochGuard {
+        public:
+            EpochGuard();
+            ~EpochGuard();
+            EpochGuard(const EpochGuard&) = delete;
+            EpochGuard& operator=(const EpochGuard&) = delete;
+        private:
+            bool pinned;
+    };
+
+    // Frees (calls) deleter once no pinned reader can be using the object
+    void retire(std::function<void()> deleter);
+
+    // Frees the retired objects that are safe to free
+    void reclaim();
+}
+
+#endif // BITVECTOR_AMORTIZED_CONCURRENT
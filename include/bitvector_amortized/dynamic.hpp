@@ -2,6 +2,7 @@
 #define BITVECTOR_AMORTIZED_DYNAMIC
 
 #include "bitvector_amortized/basics.hpp"
+#include <atomic>
 
 namespace amo {
     class HybridBV;
@@ -12,9 +13,13 @@ namespace amo {
             uint64_t size;          // the size of the bitvector
             uint64_t ones;          // the number of ones
             uint64_t leaves;        // the number of leaves
-            uint64_t accesses;      // since last update
+            std::atomic<uint64_t> accesses; // since last update, relaxed
             HybridBV* left;         // Pointer to the left child (subtree)
             HybridBV* right;        // Pointer to the right child (subtree)
+            // flattened copy published by a concurrent reader, it replaces
+            // the children (which are then retired) until the next update
+            std::atomic<HybridBV*> flat{nullptr};
+            std::atomic<bool> flattening{false}; // a reader is building flat
 
             // Default constructor
             DynamicBV();
@@ -40,6 +45,12 @@ namespace amo {
             // tells if it transferred something
             int transferRight();
 
+            // counts a query that goes through the node. Lost increments
+            // between concurrent readers only delay the flattening
+            void countAccess() {
+                accesses.store(accesses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
             // return the number of leaves
             uint64_t getLeaves() const;
             // Returns the size of the bitvector in words of w bits
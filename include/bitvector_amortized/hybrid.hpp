@@ -2,6 +2,7 @@
 #define BITVECTOR_AMORTIZED_HYBRID
 
 #include "bitvector_amortized/basics.hpp"
+#include <atomic>
 #include <variant>
 
 namespace amo {
@@ -12,6 +13,8 @@ namespace amo {
     class HybridBV {
         public:
             std::variant<StaticBV*, LeafBV*, DynamicBV*> bv;
+            // some node below was flattened by a concurrent reader (root only)
+            std::atomic<bool> pending{false};
 
             // Empty constructor
             HybridBV();
@@ -54,6 +57,10 @@ namespace amo {
             int hybridRemove_(uint64_t i);
             void recompute(uint64_t i, int64_t delta);
             bool mustFlatten(uint64_t n);
+            HybridBV* amortize(DynamicBV* dyn, int64_t* delta, uint64_t n);
+            HybridBV* flattenAside();
+            void settle();
+            void fold();
             uint access_(uint64_t i, int64_t* delta, uint64_t n);
             uint hybridAccess_(uint64_t i);
             void read(uint64_t i, uint64_t l, uint64_t* D, uint64_t j, uint* recomp, uint64_t n); // external read
@@ -86,6 +93,8 @@ namespace amo {
         private:
             // Helper method for destructor and assignment operators
             void deleteBV();
+            // the node that holds the bits, following a published flattening
+            const HybridBV& resolved() const;
         };
 }
 
@@ -0,0 +1,37 @@
+#ifndef BITVECTOR_AMORTIZED_SIMD
+#define BITVECTOR_AMORTIZED_SIMD
+
+#include "bitvector_amortized/basics.hpp"
+
+namespace amo {
+
+    // Bit kernels of the innermost loops (rank, select, preprocessing),
+    // chosen once at runtime according to the CPU features
+    struct Kernels {
+        const char* name;
+        // number of 1s in data[0..n-1]
+        uint64_t (*popcountWords)(const uint64_t* data, uint64_t n);
+        // number of 1s of each block of K words of data[0..n-1] (the last one may be partial)
+        void (*popcountBlocks)(const uint64_t* data, uint64_t n, uint16_t* counts);
+        // position of the j-th 1 of word, j is one-based and assumed right
+        uint (*selectWord)(uint64_t word, uint j);
+    };
+
+    // Returns the kernels in use (the best ones the CPU supports)
+    const Kernels& kernels();
+
+    // Forces the kernels "default", "popcnt", "avx2" or "avx512", for testing
+    // and benchmarking. Returns false if the CPU does not support them.
+    // Not thread-safe, call it before using the bitvectors
+    bool setKernels(const char* name);
+
+    inline uint64_t popcountWords(const uint64_t* data, uint64_t n) {
+        return kernels().popcountWords(data, n);
+    }
+
+    inline uint selectWord(uint64_t word, uint j) {
+        return kernels().selectWord(word, j);
+    }
+}
+
+#endif // BITVECTOR_AMORTIZED_SIMD
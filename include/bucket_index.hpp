@@ -0,0 +1,113 @@
+/*
+ * bucket_index.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUCKET_INDEX_HPP
+#define BUCKET_INDEX_HPP
+
+#include "pfc.hpp"
+
+namespace ring
+{
+
+  /**
+   * @brief Index of the PFCs of a dictionary by their first words (the headers).
+   * The headers are stored one after the other in a single string and searched
+   * with a binary search, so finding the PFC of a string does not follow the
+   * pointers of the tree nor decode the first words of its nodes.
+   *
+   * It is a snapshot of the PFCs: the dictionaries clear it when they are updated
+   * and search their trees until it is built again.
+   */
+  class bucket_index
+  {
+  public:
+    /**
+     * @brief Builds the index
+     *
+     * @param pfcs The PFCs of the dictionary in the order of their words
+     */
+    void build(const std::vector<PFC *> &pfcs)
+    {
+      clear();
+      m_offsets.reserve(pfcs.size() + 1);
+      for (PFC *pfc : pfcs)
+      {
+        // The empty PFCs left by the eliminations have no header
+        if (pfc->size() == 0)
+          continue;
+        m_offsets.push_back(m_headers.size());
+        m_headers += pfc->first_word();
+        m_pfcs.push_back(pfc);
+      }
+      m_offsets.push_back(m_headers.size());
+      m_headers.shrink_to_fit();
+      m_valid = !m_pfcs.empty();
+    }
+
+    void clear()
+    {
+      m_valid = false;
+      m_headers.clear();
+      m_offsets.clear();
+      m_pfcs.clear();
+    }
+
+    bool valid() const
+    {
+      return m_valid;
+    }
+
+    /**
+     * @brief The PFC where s is (or would be): the last one whose first word
+     * is not greater than s, or the first one
+     *
+     * @param s The string being searched
+     * @param n The length of s
+     * @return PFC* The PFC
+     */
+    PFC *find(const char *s, uint64_t n) const
+    {
+      uint64_t lo = 1, hi = m_pfcs.size();
+      // First header greater than s, the headers [0, lo) are not
+      while (lo < hi)
+      {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const char *header = m_headers.data() + m_offsets[mid];
+        if (compare_bytes(header, m_offsets[mid + 1] - m_offsets[mid], s, n) <= 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      return m_pfcs[lo - 1];
+    }
+
+    size_t bit_size() const
+    {
+      return 8 * (sizeof(*this) + m_headers.capacity() + m_offsets.capacity() * sizeof(uint64_t) + m_pfcs.capacity() * sizeof(PFC *));
+    }
+
+  private:
+    std::string m_headers;           // The first words of the PFCs, one after the other
+    std::vector<uint64_t> m_offsets; // Start of each header, and the end of the last one
+    std::vector<PFC *> m_pfcs;
+    bool m_valid = false;
+  };
+}
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * bucket_map.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUCKET_MAP_HPP
+#define BUCKET_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ring
+{
+  class PFC;
+
+  /**
+   * @brief Maps every ID of a dictionary to its PFC (bucket).
+   * The PFCs are numbered and each ID stores the number of its PFC plus one
+   * (0 for the free IDs) in a packed array, with the bits needed by the number
+   * of PFCs. The array is widened when the PFCs no longer fit, and the numbers
+   * of the PFCs that are left without IDs are reused.
+   */
+  class bucket_map
+  {
+  public:
+    //! Number of IDs, including the free ones
+    uint64_t size() const
+    {
+      return m_size;
+    }
+
+    /**
+     * @brief Replaces the map with n free IDs
+     *
+     * @param n      The number of IDs
+     * @param n_pfcs The number of PFCs expected, to avoid widening the array
+     */
+    void assign(uint64_t n, uint64_t n_pfcs = 0)
+    {
+      m_size = n;
+      m_width = bits(n_pfcs + 1);
+      m_bits.assign(words(n, m_width), 0);
+      m_pfcs.clear();
+      m_counts.clear();
+      m_numbers.clear();
+      m_free_numbers.clear();
+    }
+
+    //! Adds the next ID, with the given PFC
+    void push_back(PFC *pfc)
+    {
+      m_size++;
+      m_bits.resize(words(m_size, m_width), 0);
+      set_pfc(m_size, pfc);
+    }
+
+    //! The PFC of an ID, nullptr if the ID is free or is not in the map
+    PFC *get_pfc(uint64_t id) const
+    {
+      if (id == 0 || id > m_size)
+        return nullptr;
+      uint64_t v = read(id - 1);
+      return v ? m_pfcs[v - 1] : nullptr;
+    }
+
+    bool has_pfc(uint64_t id) const
+    {
+      return get_pfc(id) != nullptr;
+    }
+
+    /**
+     * @brief Sets the PFC of an ID
+     *
+     * @param id  The ID, up to size()
+     * @param pfc The PFC, nullptr to free the ID
+     */
+    void set_pfc(uint64_t id, PFC *pfc)
+    {
+      uint64_t old = read(id - 1);
+      if (old && m_pfcs[old - 1] == pfc)
+        return;
+      uint64_t v = pfc ? number(pfc) + 1 : 0;
+      if (old && --m_counts[old - 1] == 0)
+        release(old - 1);
+      if (v >> m_width)
+        widen(bits(v));
+      write(id - 1, v);
+    }
+
+    size_t bit_size() const
+    {
+      return 8 * (sizeof(*this) + m_bits.capacity() * sizeof(uint64_t) + m_pfcs.capacity() * sizeof(PFC *) + m_counts.capacity() * sizeof(uint64_t) + m_free_numbers.capacity() * sizeof(uint64_t) + m_numbers.size() * (sizeof(PFC *) + 2 * sizeof(uint64_t)));
+    }
+
+  private:
+    uint64_t m_size = 0;
+    uint64_t m_width = 1;                          // Bits of each ID
+    std::vector<uint64_t> m_bits;                  // The numbers of the PFCs of the IDs, plus one
+    std::vector<PFC *> m_pfcs;                     // The PFC with each number
+    std::vector<uint64_t> m_counts;                // The number of IDs of each PFC
+    std::unordered_map<PFC *, uint64_t> m_numbers; // The number of each PFC
+    std::vector<uint64_t> m_free_numbers;          // Numbers without PFC
+
+    static uint64_t bits(uint64_t v)
+    {
+      return v ? 64 - __builtin_clzll(v) : 1;
+    }
+
+    // One more word so that the reads of the last value do not check the bounds
+    static uint64_t words(uint64_t n, uint64_t width)
+    {
+      return (n * width + 63) / 64 + 1;
+    }
+
+    uint64_t read(uint64_t i) const
+    {
+      uint64_t pos = i * m_width, word = pos >> 6, offset = pos & 63;
+      uint64_t v = m_bits[word] >> offset;
+      if (offset + m_width > 64)
+        v |= m_bits[word + 1] << (64 - offset);
+      return m_width == 64 ? v : v & ((1ULL << m_width) - 1);
+    }
+
+    void write(uint64_t i, uint64_t v)
+    {
+      uint64_t pos = i * m_width, word = pos >> 6, offset = pos & 63;
+      uint64_t mask = m_width == 64 ? ~0ULL : (1ULL << m_width) - 1;
+      m_bits[word] = (m_bits[word] & ~(mask << offset)) | (v << offset);
+      if (offset + m_width > 64)
+      {
+        uint64_t high = 64 - offset;
+        m_bits[word + 1] = (m_bits[word + 1] & ~(mask >> high)) | (v >> high);
+      }
+    }
+
+    //! The number of a PFC that gets one more ID, a new one if it had none
+    uint64_t number(PFC *pfc)
+    {
+      auto it = m_numbers.find(pfc);
+      if (it != m_numbers.end())
+      {
+        m_counts[it->second]++;
+        return it->second;
+      }
+      uint64_t n;
+      if (m_free_numbers.empty())
+      {
+        n = m_pfcs.size();
+        m_pfcs.push_back(pfc);
+        m_counts.push_back(1);
+      }
+      else
+      {
+        n = m_free_numbers.back();
+        m_free_numbers.pop_back();
+        m_pfcs[n] = pfc;
+        m_counts[n] = 1;
+      }
+      m_numbers.emplace(pfc, n);
+      return n;
+    }
+
+    //! Frees the number of a PFC without IDs
+    void release(uint64_t n)
+    {
+      m_numbers.erase(m_pfcs[n]);
+      m_pfcs[n] = nullptr;
+      m_free_numbers.push_back(n);
+    }
+
+    //! Copies the array to one with the given bits for each ID
+    void widen(uint64_t width)
+    {
+      std::vector<uint64_t> old_bits(words(m_size, width), 0);
+      uint64_t old_width = width;
+      std::swap(old_bits, m_bits);
+      std::swap(old_width, m_width);
+      for (uint64_t i = 0; i < m_size; i++)
+      {
+        uint64_t pos = i * old_width, word = pos >> 6, offset = pos & 63;
+        uint64_t v = old_bits[word] >> offset;
+        if (offset + old_width > 64)
+          v |= old_bits[word + 1] << (64 - offset);
+        write(i, v & ((1ULL << old_width) - 1));
+      }
+    }
+  };
+}
+
+#endif
@@ -22,6 +22,7 @@
 #define BWT_T
 
 #include "configuration.hpp"
+#include "range_values.hpp"
 
 using namespace std;
 
@@ -68,7 +69,13 @@ namespace ring {
 
         bwt(const int_vector<> &L, const vector<uint64_t> &C, uint64_t sigma = 0) {
             //Building the wavelet matrix
-            construct_im(m_L, L);
+            //Same as construct_im, but the name of the temporary file depends on the object,
+            //so several bwts can be built concurrently
+            std::string tmp_file = ram_file_name(util::to_string(util::pid()) + "_bwt_"
+                                                 + util::to_string((uint64_t) this));
+            store_to_file(L, tmp_file);
+            construct(m_L, tmp_file, 0);
+            ram_fs::remove(tmp_file);
             //Building C and its rank and select structures
             m_C = c_type(C[C.size() - 1] + 1 + C.size(), 0);
             for (uint64_t i = 0; i < C.size(); i++) {
@@ -227,6 +234,32 @@ namespace ring {
             return m_L.all_values_in_range(pos_min, pos_max);
         }
 
+        /**
+         * Distinct values of L[pos_min, pos_max] with their number of occurrences,
+         * computed in a single traversal of the wavelet matrix.
+         *
+         * @param pos_min   First position of the range
+         * @param pos_max   Last position of the range
+         * @param res       Buffer that receives the values in increasing order
+         */
+        void values_in_range(uint64_t pos_min, uint64_t pos_max, range_values &res) {
+            res.clear();
+            if (pos_min > pos_max) return;
+            // interval_symbols writes one entry per distinct value, at most sigma of them
+            res.reserve(std::min<uint64_t>(m_L.sigma, pos_max - pos_min + 1));
+            size_type k = 0;
+            m_L.interval_symbols(pos_min, pos_max + 1, k, res.values, res.ranks, res.counts);
+            for (size_type i = 0; i < k; ++i) {
+                res.counts[i] -= res.ranks[i];
+            }
+            // ranges of two positions are reported in the order of L
+            if (k == 2 && res.values[0] > res.values[1]) {
+                std::swap(res.values[0], res.values[1]);
+                std::swap(res.counts[0], res.counts[1]);
+            }
+            res.n = k;
+        }
+
         // backward search for pattern of length 1
         pair<uint64_t, uint64_t> backward_search_1_interval(uint64_t P) const {
             return {get_C(P), get_C(P + 1) - 1};
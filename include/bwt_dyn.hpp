@@ -22,6 +22,8 @@
 
 #include <dynamic/dynamic.hpp>
 #include "configuration.hpp"
+#include "range_values.hpp"
+#include "fenwick_tree.hpp"
 #include "bitvector_amortized/hybrid.hpp"
 
 using namespace std;
@@ -45,12 +47,33 @@ namespace ring
   private:
     bwt_type m_L;
     c_type m_C;
+    // Number of zeros of m_C before each one, and after the last one. It answers
+    // get_C without the descents of m_C, and it is updated with it
+    fenwick_tree m_C_sums;
     uint32_t m_sigma;
 
     void copy(const bwt_dyn &o)
     {
       m_L = o.m_L;
       m_C = o.m_C;
+      m_C_sums = o.m_C_sums;
+    }
+
+    // Builds m_C_sums from m_C, one select per symbol
+    void build_C_sums()
+    {
+      uint64_t n = m_C.size();
+      uint64_t ones = m_C.rank(n);
+      vector<uint64_t> counts(ones + 1);
+      uint64_t last = 0; // position after the previous one
+      for (uint64_t k = 0; k < ones; k++)
+      {
+        uint64_t pos = m_C.select1(k);
+        counts[k] = pos - last;
+        last = pos + 1;
+      }
+      counts[ones] = n - last;
+      m_C_sums.build(counts);
     }
 
   public:
@@ -74,6 +97,10 @@ namespace ring
       {
         m_C.set(C[i] + i);
       }
+      vector<uint64_t> counts(C.size() + 1, 0);
+      for (uint64_t i = 0; i < C.size(); i++)
+        counts[i] = C[i] - (i > 0 ? C[i - 1] : 0);
+      m_C_sums.build(counts);
     }
 
 
@@ -95,6 +122,7 @@ namespace ring
           m_C.insert0(i);
         }
       }
+      build_C_sums();
     }
 
     //! Copy constructor
@@ -126,6 +154,7 @@ namespace ring
       {
         m_L = move(o.m_L);
         m_C = move(o.m_C);
+        m_C_sums = move(o.m_C_sums);
       }
       return *this;
     }
@@ -134,6 +163,7 @@ namespace ring
     {
       swap(m_L, o.m_L);
       swap(m_C, o.m_C);
+      m_C_sums.swap(o.m_C_sums);
     }
 
     // //! Serializes the data structure into the given ostream
@@ -157,6 +187,7 @@ namespace ring
     {
       m_L.load(in);
       m_C.load(in);
+      build_C_sums();
     }
 
     uint64_t triple_amount()
@@ -170,7 +201,7 @@ namespace ring
 
     uint64_t bit_size()
     {
-      return m_L.bit_size() + m_C.bit_size();
+      return m_L.bit_size() + m_C.bit_size() + m_C_sums.bit_size();
     }
 
      uint64_t alphabet_size() {
@@ -206,7 +237,7 @@ namespace ring
     //  Get the value of v in C
     inline size_type get_C(const uint64_t v)
     {
-      return m_C.select1(v) - v;
+      return m_C_sums.prefix(v + 1);
     }
 
 
@@ -230,7 +261,7 @@ namespace ring
 
     inline uint64_t bsearch_C(uint64_t value)
     {
-      return m_C.rank(m_C.select0(value));
+      return m_C_sums.upper(value);
     }
 
     // Creo que no se usa
@@ -271,6 +302,31 @@ namespace ring
       return m_L.all_values_in_range(pos_min, pos_max);
     }
 
+    /**
+     * Distinct values of L[pos_min, pos_max] with their number of occurrences.
+     * The dynamic wavelet matrix only reports the values, so the counts take
+     * two ranks per value and are only computed if res.with_counts is set.
+     *
+     * @param pos_min   First position of the range
+     * @param pos_max   Last position of the range
+     * @param res       Buffer that receives the values in increasing order
+     */
+    void values_in_range(uint64_t pos_min, uint64_t pos_max, range_values &res)
+    {
+      res.clear();
+      if (pos_min > pos_max)
+        return;
+      vector<uint64_t> values = m_L.all_values_in_range(pos_min, pos_max);
+      res.reserve(values.size());
+      for (uint64_t v : values)
+      {
+        uint64_t count = 0;
+        if (res.with_counts)
+          count = m_L.rank(pos_max + 1, v) - m_L.rank(pos_min, v);
+        res.push_back(v, count);
+      }
+    }
+
     // backward search for pattern of length 1
     pair<uint64_t, uint64_t> backward_search_1_interval(uint64_t P)
     {
@@ -309,19 +365,50 @@ namespace ring
     }
 
     uint64_t select_C(uint64_t s) {
-      return m_C.select1(s);
+      return get_C(s) + s;
     }
 
     void insert_C(uint64_t s, bool b) {
+      uint64_t r = m_C.rank(s);
       m_C.insert(s, b);
+      if (b)
+        build_C_sums(); // a new symbol in the middle shifts the counts
+      else
+        m_C_sums.add(r, 1);
     }
 
     void remove_C(uint64_t i) {
+      bool b = m_C.at(i);
+      uint64_t r = b ? 0 : m_C.rank(i);
       m_C.remove(i);
+      if (b)
+        build_C_sums();
+      else
+        m_C_sums.add(r, -1);
     }
 
     void push_back_C(bool b) {
       m_C.insert(m_C.size(), b);
+      if (b)
+        m_C_sums.push_back(0);
+      else
+        m_C_sums.add(m_C_sums.size() - 1, 1);
+    }
+
+    //! Adds k occurrences of v to C, zeros at the end of its block
+    void increment_C(uint64_t v, uint64_t k = 1) {
+      uint64_t pos = select_C(v + 1);
+      for (uint64_t i = 0; i < k; i++)
+        m_C.insert(pos, 0);
+      m_C_sums.add(v + 1, k);
+    }
+
+    //! Removes k occurrences of v from C, the zeros at the end of its block
+    void decrement_C(uint64_t v, uint64_t k = 1) {
+      uint64_t pos = select_C(v + 1) - 1;
+      for (uint64_t i = 0; i < k; i++)
+        m_C.remove(pos - i);
+      m_C_sums.add(v + 1, -(int64_t)k);
     }
 
     void insert_WT(uint64_t i, uint64_t v) {
@@ -0,0 +1,302 @@
+/*
+ * bwt_mapped.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BWT_MAPPED_T
+#define BWT_MAPPED_T
+
+#include "configuration.hpp"
+#include "mapped_wm.hpp"
+#include "range_values.hpp"
+#include "mapped_file.hpp"
+
+using namespace std;
+
+
+namespace ring {
+
+    /**
+     * BWT with the same operations as bwt_plain, stored as a single block of words
+     * (the wavelet matrix of L followed by C). When it is loaded from a
+     * mapped_streambuf the block is used in place, so the queries run directly
+     * on the mapped file; otherwise the block is read into memory.
+     */
+    class bwt_mapped {
+
+    public:
+        typedef uint64_t value_type;
+        typedef uint64_t size_type;
+        typedef mapped_wm bwt_type;
+        typedef mapped_bv c_type;
+
+    private:
+        std::vector<uint64_t> m_data; //Empty when the block is mapped
+        const uint64_t *m_ptr = nullptr;
+        uint64_t m_words = 0;
+        bwt_type m_L;
+        c_type m_C;
+
+        void init_views() {
+            if (m_words == 0) {
+                m_L = bwt_type();
+                m_C = c_type();
+                return;
+            }
+            m_L = bwt_type(m_ptr);
+            m_C = c_type(m_ptr + m_L.words());
+        }
+
+        void copy(const bwt_mapped &o) {
+            m_data = o.m_data;
+            m_ptr = m_data.empty() ? o.m_ptr : m_data.data();
+            m_words = o.m_words;
+            init_views();
+        }
+
+        //The block is aligned to 8 bytes with respect to the beginning of the file
+        static uint64_t padding(int64_t pos) {
+            return (pos < 0) ? 0 : (8 - pos % 8) % 8;
+        }
+
+    public:
+
+
+        bwt_mapped() = default;
+
+        bwt_mapped(const int_vector<> &L, const vector<uint64_t> &C, uint64_t sigma = 0) {
+            bwt_type::build(L, m_data);
+            //Building C
+            uint64_t n_C = C[C.size() - 1] + 1 + C.size();
+            std::vector<uint64_t> bits((n_C + 63) / 64, 0);
+            for (uint64_t i = 0; i < C.size(); i++) {
+                bits[(C[i] + i) / 64] |= 1ULL << ((C[i] + i) % 64);
+            }
+            c_type::build(bits, n_C, m_data);
+            m_data.shrink_to_fit();
+            m_ptr = m_data.data();
+            m_words = m_data.size();
+            init_views();
+        }
+
+
+        //! Copy constructor
+        bwt_mapped(const bwt_mapped &o) {
+            copy(o);
+        }
+
+        //! Move constructor
+        bwt_mapped(bwt_mapped &&o) {
+            *this = std::move(o);
+        }
+
+        //! Copy Operator=
+        bwt_mapped &operator=(const bwt_mapped &o) {
+            if (this != &o) {
+                copy(o);
+            }
+            return *this;
+        }
+
+        //! Move Operator=
+        bwt_mapped &operator=(bwt_mapped &&o) {
+            if (this != &o) {
+                bool owned = !o.m_data.empty();
+                m_data = std::move(o.m_data);
+                m_ptr = owned ? m_data.data() : o.m_ptr;
+                m_words = o.m_words;
+                init_views();
+                o.m_ptr = nullptr;
+                o.m_words = 0;
+                o.init_views();
+            }
+            return *this;
+        }
+
+        //! True if the data is used from a mapped file
+        inline bool is_mapped() const {
+            return m_data.empty() && m_words > 0;
+        }
+
+        void print_tree()
+        {
+            std::cout << m_L.levels() << std::endl;
+            for (uint64_t l = 0; l < m_L.levels(); l++) {
+                for (uint64_t i = 0; i < m_L.size(); i++) {
+                    std::cout << m_L.level(l)[i] << " ";
+                }
+                std::cout << std::endl;
+            }
+        }
+
+        void print_C()
+        {
+            std::cout << "C bitvector" << std::endl;
+            for (uint64_t i = 0; i < m_C.size(); i++) {
+                std::cout << m_C[i] << " ";
+            }
+            std::cout << std::endl;
+        }
+
+        void statistics() {
+            cout << "Not implemented" << endl;
+        }
+
+        uint64_t bit_size() {
+            return (m_words + 1) * 64;
+        }
+
+        void swap(bwt_mapped &o) {
+            bwt_mapped aux(std::move(o));
+            o = std::move(*this);
+            *this = std::move(aux);
+        }
+
+
+        //! Serializes the data structure into the given ostream
+        size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const {
+            sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+            size_type written_bytes = 0;
+            written_bytes += sdsl::write_member(m_words, out, child, "words");
+            uint64_t pad = padding(out.tellp());
+            const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            out.write(zeros, pad);
+            out.write((const char *) m_ptr, m_words * sizeof(uint64_t));
+            written_bytes += pad + m_words * sizeof(uint64_t);
+            sdsl::structure_tree::add_size(child, written_bytes);
+            return written_bytes;
+        }
+
+        void load(std::istream &in) {
+            m_data.clear();
+            sdsl::read_member(m_words, in);
+            in.ignore(padding(in.tellg()));
+            auto *buf = dynamic_cast<mapped_streambuf *>(in.rdbuf());
+            if (buf != nullptr && buf->remaining() >= m_words * sizeof(uint64_t)) {
+                m_ptr = (const uint64_t *) buf->current();
+                buf->advance(m_words * sizeof(uint64_t));
+            } else {
+                m_data.resize(m_words);
+                in.read((char *) m_data.data(), m_words * sizeof(uint64_t));
+                m_ptr = m_data.data();
+            }
+            init_views();
+        }
+
+        //Operations
+        inline size_type get_C(const uint64_t v) const {
+            return m_C.select1(v + 1) - v;
+        }
+
+        inline uint64_t LF(uint64_t i) {
+            uint64_t s = m_L[i];
+            return get_C(s) + m_L.rank(i, s) - 1;
+        }
+
+        uint64_t nElems(uint64_t val) {
+            return get_C(val + 1) - get_C(val);
+        }
+
+        pair<uint64_t, uint64_t>
+        backward_step(uint64_t left_end, uint64_t right_end, uint64_t value) {
+            return {m_L.rank(left_end, value), m_L.rank(right_end + 1, value) - 1};
+        }
+
+        inline uint64_t bsearch_C(uint64_t value) {
+            return m_C.rank1(m_C.select0(value + 1));
+        }
+
+
+        inline uint64_t ranky(uint64_t pos, uint64_t val) {
+            return m_L.rank(pos, val);
+        }
+
+        inline uint64_t rank(uint64_t pos, uint64_t val) {
+            return m_L.rank(get_C(pos), val);
+        }
+
+        inline uint64_t select(uint64_t _rank, uint64_t val) {
+            return m_L.select(_rank, val);
+        }
+
+        inline std::pair<uint64_t, uint64_t> select_next(uint64_t pos, uint64_t val, uint64_t n_elems) {
+            return m_L.select_next(get_C(pos), val, n_elems);
+        }
+
+        inline uint64_t min_in_range(uint64_t l, uint64_t r) {
+            return m_L.range_minimum_query(l, r);
+        }
+
+        inline uint64_t range_next_value(uint64_t x, uint64_t l, uint64_t r) {
+            return m_L.range_next_value(x, l, r);
+        }
+
+        std::vector<uint64_t>
+        values_in_range(uint64_t pos_min, uint64_t pos_max) {
+            return m_L.all_values_in_range(pos_min, pos_max);
+        }
+
+        /**
+         * Distinct values of L[pos_min, pos_max] with their number of occurrences,
+         * computed in a single traversal of the wavelet matrix.
+         *
+         * @param pos_min   First position of the range
+         * @param pos_max   Last position of the range
+         * @param res       Buffer that receives the values in increasing order
+         */
+        void values_in_range(uint64_t pos_min, uint64_t pos_max, range_values &res) {
+            m_L.all_values_in_range(pos_min, pos_max, res);
+        }
+
+        // backward search for pattern of length 1
+        pair<uint64_t, uint64_t> backward_search_1_interval(uint64_t P) const {
+            return {get_C(P), get_C(P + 1) - 1};
+        }
+
+        // backward search for pattern of length 1
+        pair<uint64_t, uint64_t> backward_search_1_rank(uint64_t P, uint64_t S) const {
+            return {m_L.rank(get_C(P), S), m_L.rank(get_C(P + 1), S)};
+        }
+
+        // backward search for pattern PQ of length 2
+        // returns an empty interval if search is unsuccessful
+        pair<uint64_t, uint64_t>
+        backward_search_2_interval(uint64_t P, pair<uint64_t, uint64_t> &I) const {
+            return {get_C(P) + I.first, get_C(P) + I.second - 1};
+        }
+
+        pair<uint64_t, uint64_t>
+        backward_search_2_rank(uint64_t P, uint64_t S, pair<uint64_t, uint64_t> &I) const {
+            uint64_t c = get_C(P);
+            return {m_L.rank(c + I.first, S), m_L.rank(c + I.second, S)};
+        }
+
+        inline std::pair<uint64_t, uint64_t> inverse_select(uint64_t pos)
+        {
+            return m_L.inverse_select(pos);
+        }
+
+        inline uint64_t operator[](uint64_t i)
+        {
+            return m_L[i];
+        }
+
+    };
+}
+
+#endif
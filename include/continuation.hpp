@@ -0,0 +1,119 @@
+/*
+ * continuation.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_CONTINUATION_HPP
+#define RING_CONTINUATION_HPP
+
+#include <triple_pattern.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ring {
+
+    /**
+     * State of a paginated join (see ltj_algorithm::cursor), enough to resume it
+     * in a later call. It does not keep the intervals of the iterators: they are
+     * restored by leaping to the bindings of the last reported result, which takes
+     * one seek per variable. So it stays valid after updates of the ring: the join
+     * goes on with the results that come after those bindings in the GAO order.
+     */
+    struct continuation {
+        typedef uint64_t size_type;
+
+        uint64_t query = 0;           // fingerprint of the triple patterns
+        std::vector<uint8_t> gao;     // order of the variables
+        std::vector<uint64_t> values; // bindings of the last reported result, by position in the gao
+        size_type n_results = 0;      // results reported before, the offset of the next one
+        bool finished = false;        // there are no more results
+
+        //! Fingerprint of a query, to check that a continuation belongs to it
+        static uint64_t fingerprint(const std::vector<triple_pattern> &query) {
+            uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+            auto add = [&h](const term_pattern &term) {
+                h = (h ^ term.is_variable) * 0x100000001b3ULL;
+                h = (h ^ term.value) * 0x100000001b3ULL;
+            };
+            for (const triple_pattern &t : query) {
+                add(t.term_s);
+                add(t.term_p);
+                add(t.term_o);
+            }
+            return h;
+        }
+
+        //! Compact form of the continuation, integers are written with 7 bits per byte
+        std::string encode() const {
+            std::string s;
+            put(s, query);
+            put(s, n_results);
+            put(s, finished);
+            put(s, gao.size());
+            for (uint8_t x : gao) put(s, x);
+            put(s, values.size());
+            for (uint64_t v : values) put(s, v);
+            return s;
+        }
+
+        /**
+         * @param s     A string given by encode
+         * @return      False if s is not a valid continuation
+         */
+        bool decode(const std::string &s) {
+            size_type pos = 0, n_gao, n_values, fin, x;
+            if (!get(s, pos, query) || !get(s, pos, n_results) || !get(s, pos, fin) || fin > 1
+                || !get(s, pos, n_gao) || n_gao > 256) {
+                return false;
+            }
+            finished = fin;
+            gao.resize(n_gao);
+            for (size_type i = 0; i < n_gao; ++i) {
+                if (!get(s, pos, x) || x > 255) return false;
+                gao[i] = x;
+            }
+            if (!get(s, pos, n_values) || (n_values != 0 && n_values != n_gao)) return false;
+            values.resize(n_values);
+            for (size_type i = 0; i < n_values; ++i) {
+                if (!get(s, pos, values[i])) return false;
+            }
+            return pos == s.size();
+        }
+
+    private:
+        static void put(std::string &s, uint64_t x) {
+            while (x >= 0x80) {
+                s.push_back((char) (x | 0x80));
+                x >>= 7;
+            }
+            s.push_back((char) x);
+        }
+
+        static bool get(const std::string &s, size_type &pos, uint64_t &x) {
+            x = 0;
+            for (size_type shift = 0; pos < s.size() && shift < 64; shift += 7) {
+                uint8_t b = s[pos++];
+                x |= (uint64_t) (b & 0x7f) << shift;
+                if (!(b & 0x80)) return true;
+            }
+            return false;
+        }
+    };
+}
+
+#endif //RING_CONTINUATION_HPP
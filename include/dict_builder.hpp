@@ -0,0 +1,333 @@
+/*
+ * dict_builder.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_DICT_BUILDER_HPP
+#define RING_DICT_BUILDER_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "configuration.hpp"
+#include "parallel.hpp"
+
+namespace ring
+{
+
+    /**
+     * Parallel construction of the dictionaries of a file of triples (one triple of
+     * terms per line) and of the triples of IDs. It makes two passes over the file,
+     * each one a pipeline: a thread reads the next chunk of lines while the current
+     * one is split among the threads.
+     *  1. The terms of each thread are sorted and deduplicated in runs, which are
+     *     merged in parallel at the end. The dictionaries are built from the sorted
+     *     terms with the bulk constructor of the map, if it has one.
+     *  2. The threads look up the IDs of the terms of their lines in the dictionaries.
+     */
+    namespace dict_builder
+    {
+        typedef std::vector<std::string> run_type; // sorted and without repetitions
+
+        //! Reads a file in chunks of whole lines
+        class chunk_reader
+        {
+            std::ifstream m_in;
+            std::string m_rest; // start of the line cut by the last chunk
+            uint64_t m_chunk_size;
+
+        public:
+            chunk_reader(const std::string &file, const uint64_t chunk_size = 1ULL << 26)
+                : m_in(file, std::ios::binary), m_chunk_size(chunk_size)
+            {
+                if (!m_in)
+                    throw std::runtime_error("Cannot open " + file);
+            }
+
+            /**
+             * @param buffer    Replaced by the next lines, the last one may have no newline
+             * @return          False at the end of the file
+             */
+            bool next(std::string &buffer)
+            {
+                buffer.swap(m_rest);
+                m_rest.clear();
+                uint64_t nl = std::string::npos;
+                while (m_in && nl == std::string::npos)
+                {
+                    uint64_t old = buffer.size();
+                    buffer.resize(old + m_chunk_size);
+                    m_in.read(&buffer[old], m_chunk_size);
+                    buffer.resize(old + m_in.gcount());
+                    nl = buffer.rfind('\n');
+                }
+                if (m_in && nl != std::string::npos)
+                {
+                    m_rest.assign(buffer, nl + 1, std::string::npos);
+                    buffer.resize(nl + 1);
+                }
+                return !buffer.empty();
+            }
+        };
+
+        /**
+         * Splits a line into the terms of a triple as the regex (?:\".*\"|[^[:space:]])+
+         * did: a term ends at a space, except between a quote and the last quote of the line.
+         *
+         * @return  False if the line has less than three terms
+         */
+        inline bool tokenize(const char *begin, const char *end, std::string_view (&terms)[3])
+        {
+            const char *last_quote = nullptr;
+            bool searched = false;
+            const char *p = begin;
+            for (int i = 0; i < 3; i++)
+            {
+                while (p < end && std::isspace((unsigned char)*p))
+                    p++;
+                if (p == end)
+                    return false;
+                const char *start = p;
+                while (p < end && !std::isspace((unsigned char)*p))
+                {
+                    if (*p == '"')
+                    {
+                        if (!searched)
+                        {
+                            for (const char *q = end; q > p && !last_quote; q--)
+                                if (q[-1] == '"')
+                                    last_quote = q - 1;
+                            searched = true;
+                        }
+                        if (last_quote > p)
+                        {
+                            p = last_quote;
+                        }
+                    }
+                    p++;
+                }
+                terms[i] = std::string_view(start, p - start);
+            }
+            return true;
+        }
+
+        /**
+         * Runs f(t, line_begin, line_end) on the lines of the chunk, the thread t gets
+         * the t-th part of the chunk cut at the newlines.
+         */
+        template <class function_t>
+        void for_each_line(const std::string &chunk, const uint64_t n_threads, function_t f)
+        {
+            const char *data = chunk.data();
+            const uint64_t n = chunk.size();
+            std::vector<uint64_t> cuts(n_threads + 1, n);
+            cuts[0] = 0;
+            for (uint64_t t = 1; t < n_threads; t++)
+            {
+                const void *nl = std::memchr(data + n * t / n_threads, '\n', n - n * t / n_threads);
+                cuts[t] = nl ? (const char *)nl - data + 1 : n;
+                cuts[t] = std::max(cuts[t], cuts[t - 1]);
+            }
+            parallel::parallel_for(n_threads, n_threads, [&](uint64_t t, uint64_t, uint64_t)
+            {
+                const char *p = data + cuts[t], *e = data + cuts[t + 1];
+                while (p < e)
+                {
+                    const char *nl = (const char *)std::memchr(p, '\n', e - p);
+                    const char *line_end = nl ? nl : e;
+                    f(t, p, line_end);
+                    p = line_end + 1;
+                }
+            });
+        }
+
+        //! Reads the file in chunks, processing each one while the next is read
+        template <class function_t>
+        void for_each_chunk(const std::string &dataset, function_t f)
+        {
+            chunk_reader reader(dataset);
+            std::string current, next;
+            bool has_current = reader.next(current);
+            while (has_current)
+            {
+                std::future<bool> has_next = std::async(std::launch::async, [&]()
+                                                        { return reader.next(next); });
+                f(current);
+                has_current = has_next.get();
+                current.swap(next);
+            }
+        }
+
+        inline run_type merge(run_type &a, run_type &b)
+        {
+            run_type r;
+            r.reserve(a.size() + b.size());
+            std::set_union(std::make_move_iterator(a.begin()), std::make_move_iterator(a.end()),
+                           std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()),
+                           std::back_inserter(r));
+            run_type().swap(a);
+            run_type().swap(b);
+            return r;
+        }
+
+        /**
+         * Adds a run to the runs of a thread. The last two runs are merged while the
+         * older one is not twice as large, so there are O(log n) runs and each term
+         * is merged O(log n) times.
+         */
+        inline void add_run(std::vector<run_type> &runs, run_type &&run)
+        {
+            std::sort(run.begin(), run.end());
+            run.erase(std::unique(run.begin(), run.end()), run.end());
+            runs.push_back(std::move(run));
+            while (runs.size() >= 2 && runs[runs.size() - 2].size() <= 2 * runs.back().size())
+            {
+                run_type r = merge(runs[runs.size() - 2], runs.back());
+                runs.pop_back();
+                runs.back() = std::move(r);
+            }
+        }
+
+        //! Merges the runs of all the threads, the pairs of each round in parallel
+        inline run_type merge_all(std::vector<run_type> &runs, const uint64_t n_threads)
+        {
+            while (runs.size() > 1)
+            {
+                uint64_t n_pairs = runs.size() / 2;
+                std::vector<run_type> merged(n_pairs);
+                parallel::parallel_for(n_pairs, std::min(n_threads, n_pairs), [&](uint64_t, uint64_t b, uint64_t e)
+                {
+                    for (uint64_t i = b; i < e; i++)
+                        merged[i] = merge(runs[2 * i], runs[2 * i + 1]);
+                });
+                if (runs.size() % 2)
+                    merged.push_back(std::move(runs.back()));
+                runs.swap(merged);
+            }
+            return runs.empty() ? run_type() : std::move(runs[0]);
+        }
+
+        //! Builds a map with the sorted terms, each one gets its position + 1 as ID
+        template <class map_t>
+        std::unique_ptr<map_t> make_map(const run_type &terms)
+        {
+            if constexpr (std::is_constructible<map_t, const run_type &>::value)
+            {
+                return std::unique_ptr<map_t>(new map_t(terms));
+            }
+            else
+            {
+                std::unique_ptr<map_t> map(new map_t());
+                for (const std::string &term : terms)
+                    map->insert(term);
+                return map;
+            }
+        }
+
+        /**
+         * @param dataset   File with a triple of terms per line
+         * @param so_map    Built with the subjects and objects
+         * @param p_map     Built with the predicates
+         * @param D         The triples of IDs are appended, in the order of the file
+         * @param n_threads Number of threads
+         */
+        template <class map_t>
+        void build(const std::string &dataset, std::unique_ptr<map_t> &so_map, std::unique_ptr<map_t> &p_map,
+                   std::vector<spo_triple> &D, uint64_t n_threads)
+        {
+            n_threads = std::max<uint64_t>(n_threads, 1);
+
+            // 1. Distinct terms
+            std::vector<std::vector<run_type>> so_runs(n_threads), p_runs(n_threads);
+            std::vector<run_type> so_terms(n_threads), p_terms(n_threads);
+            for_each_chunk(dataset, [&](const std::string &chunk)
+            {
+                for_each_line(chunk, n_threads, [&](uint64_t t, const char *b, const char *e)
+                {
+                    std::string_view terms[3];
+                    if (!tokenize(b, e, terms))
+                        return;
+                    so_terms[t].emplace_back(terms[0]);
+                    p_terms[t].emplace_back(terms[1]);
+                    so_terms[t].emplace_back(terms[2]);
+                });
+                parallel::parallel_for(n_threads, n_threads, [&](uint64_t t, uint64_t, uint64_t)
+                {
+                    add_run(so_runs[t], std::move(so_terms[t]));
+                    add_run(p_runs[t], std::move(p_terms[t]));
+                    so_terms[t].clear();
+                    p_terms[t].clear();
+                });
+            });
+
+            std::vector<run_type> all_so, all_p;
+            for (uint64_t t = 0; t < n_threads; t++)
+            {
+                std::move(so_runs[t].begin(), so_runs[t].end(), std::back_inserter(all_so));
+                std::move(p_runs[t].begin(), p_runs[t].end(), std::back_inserter(all_p));
+            }
+            {
+                std::future<run_type> p_sorted = std::async(std::launch::async, [&]()
+                                                            { return merge_all(all_p, 1); });
+                run_type so_sorted = merge_all(all_so, n_threads);
+                run_type p_sorted_terms = p_sorted.get();
+                std::future<std::unique_ptr<map_t>> p_built = std::async(std::launch::async, [&]()
+                                                                         { return make_map<map_t>(p_sorted_terms); });
+                so_map = make_map<map_t>(so_sorted);
+                p_map = p_built.get();
+            }
+
+            // 2. IDs of the triples
+            std::vector<std::vector<spo_triple>> triples(n_threads);
+            std::vector<char> missing(n_threads, false);
+            for_each_chunk(dataset, [&](const std::string &chunk)
+            {
+                for_each_line(chunk, n_threads, [&](uint64_t t, const char *b, const char *e)
+                {
+                    std::string_view terms[3];
+                    if (!tokenize(b, e, terms))
+                        return;
+                    std::pair<bool, uint64_t> s = so_map->locate(std::string(terms[0]));
+                    std::pair<bool, uint64_t> p = p_map->locate(std::string(terms[1]));
+                    std::pair<bool, uint64_t> o = so_map->locate(std::string(terms[2]));
+                    if (!s.first || !p.first || !o.first)
+                        missing[t] = true;
+                    else
+                        triples[t].emplace_back(s.second, p.second, o.second);
+                });
+                if (std::find(missing.begin(), missing.end(), true) != missing.end())
+                    throw std::runtime_error("The file changed while building its dictionaries");
+                for (uint64_t t = 0; t < n_threads; t++)
+                {
+                    D.insert(D.end(), triples[t].begin(), triples[t].end());
+                    triples[t].clear();
+                }
+            });
+        }
+    }
+}
+
+#endif // RING_DICT_BUILDER_HPP
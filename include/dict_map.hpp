@@ -20,7 +20,11 @@
 #ifndef DICT_MAP_HPP
 #define DICT_MAP_HPP
 
+#include <atomic>
+#include <mutex>
 #include "pfc.hpp"
+#include "bucket_index.hpp"
+#include "hash_index.hpp"
 
 namespace ring
 {
@@ -30,7 +34,7 @@ namespace ring
    * It uses a binary tree with Plain Front Coding as the leaves.
    * It also has an array mapping every ID with its corresponding PFC
    *
-   * @tparam MINSIZE The minimum words a PFC can have before being fused with its sibling
+   * @tparam MINSIZE The minimum words a PFC can have before being fused with an adjacent one
    * @tparam MAXSIZE The maximum words a PFC can have before splitting
    */
   template <uint64_t MINSIZE, uint64_t MAXSIZE>
@@ -45,7 +49,45 @@ namespace ring
     dict_map(std::string val)
     {
       root = new node(val, 1);
-      id_map.push_back(EmptyOrPFC(root->get_pfc()));
+      id_map.push_back(root->get_pfc());
+    }
+
+    /**
+     * @brief Builds the dictionary from the given values in a single pass
+     * (see bulk_load_pfcs). The i-th value gets the ID i + 1 and the tree is balanced.
+     *
+     * @param values The values, sorted and without repetitions
+     */
+    explicit dict_map(const std::vector<std::string> &values)
+    {
+      std::vector<PFC *> pfcs = bulk_load_pfcs(values, MAXSIZE, id_map);
+      root = pfcs.empty() ? new node() : node::build(pfcs, 0, pfcs.size());
+      index_buckets();
+    }
+
+    /**
+     * @brief Builds the dictionary with the given PFCs, which are owned by it from now on.
+     * The IDs up to n_ids that are in none of them are free.
+     *
+     * @param pfcs  The non-empty PFCs in the order of their words
+     * @param n_ids The number of IDs
+     */
+    dict_map(const std::vector<PFC *> &pfcs, uint64_t n_ids)
+    {
+      id_map.assign(n_ids, pfcs.size());
+      for (PFC *pfc : pfcs)
+      {
+        for (uint64_t id : pfc->all_ids())
+          id_map.set_pfc(id, pfc);
+      }
+      // The lowest free ID on top
+      for (uint64_t id = n_ids; id >= 1; id--)
+      {
+        if (!id_map.has_pfc(id))
+          free_ids.push_back(id);
+      }
+      root = pfcs.empty() ? new node() : node::build(pfcs, 0, pfcs.size());
+      index_buckets();
     }
 
     // Move constructor
@@ -74,21 +116,17 @@ namespace ring
       out.write((char *)&map_size, sizeof(map_size));
       w_bytes += sizeof(map_size);
       w_bytes += root->serialize(out);
+      uint64_t free_ids_size = free_ids.size(), first_empty = free_ids.empty() ? 0 : free_ids.back();
       out.write((char *)&free_ids_size, sizeof(uint64_t));
       w_bytes += sizeof(uint64_t);
       out.write((char *)&first_empty, sizeof(uint64_t));
       w_bytes += sizeof(uint64_t);
 
-      if (free_ids_size > 0)
+      // The rest of the free IDs, in the order they are reused
+      for (uint64_t i = free_ids_size; i-- > 1;)
       {
-        // For every empty slot write the next empty
-        for (uint64_t i = 0; i < free_ids_size - 1; i++)
-        {
-          uint64_t next = id_map[first_empty - 1].get_next_empty();
-          out.write((char *)&next, sizeof(uint64_t));
-          first_empty = id_map[first_empty - 1].get_next_empty();
-          w_bytes += sizeof(uint64_t);
-        }
+        out.write((char *)&free_ids[i - 1], sizeof(uint64_t));
+        w_bytes += sizeof(uint64_t);
       }
 
       return w_bytes;
@@ -103,18 +141,14 @@ namespace ring
 
       written_bytes += sdsl::write_member(map_size, out, child, "map_size");
       written_bytes += root->serialize(out);
+      uint64_t free_ids_size = free_ids.size(), first_empty = free_ids.empty() ? 0 : free_ids.back();
       written_bytes += sdsl::write_member(free_ids_size, out, child, "free_ids_size");
       written_bytes += sdsl::write_member(first_empty, out, child, "first_empty");
-      if (free_ids_size > 0)
+      // The rest of the free IDs, in the order they are reused
+      for (uint64_t i = free_ids_size; i-- > 1;)
       {
-        // For every empty slot write the next empty
-        for (uint64_t i = 0; i < free_ids_size - 1; i++)
-        {
-          uint64_t next = id_map[first_empty - 1].get_next_empty();
-          out.write((char *)&next, sizeof(uint64_t));
-          first_empty = id_map[first_empty - 1].get_next_empty();
-          written_bytes += sizeof(uint64_t);
-        }
+        out.write((char *)&free_ids[i - 1], sizeof(uint64_t));
+        written_bytes += sizeof(uint64_t);
       }
       sdsl::structure_tree::add_size(child, written_bytes);
 
@@ -131,22 +165,24 @@ namespace ring
       size_t map_size;
 
       sdsl::read_member(map_size, in);
-      id_map = std::vector<EmptyOrPFC>(map_size);
+      clear_index();
+      id_map.assign(map_size, map_size / MINSIZE + 1);
+      root->free_mem();
+      delete root;
       root = new node();
       root->load(in, id_map);
+      uint64_t free_ids_size, first_empty;
       sdsl::read_member(free_ids_size, in);
       sdsl::read_member(first_empty, in);
-      uint64_t tmp = 0;
-      last_empty = first_empty;
+      // Read in the order they are reused, so the stack is filled from the bottom
+      free_ids.resize(free_ids_size);
       if (free_ids_size > 0)
       {
-        for (uint64_t i = 0; i < free_ids_size - 1; i++)
-        {
-          in.read((char *)&tmp, sizeof(uint64_t));
-          id_map[last_empty - 1].set_next_empty(tmp);
-          last_empty = tmp;
-        }
+        free_ids[free_ids_size - 1] = first_empty;
+        for (uint64_t i = free_ids_size - 1; i-- > 0;)
+          in.read((char *)&free_ids[i], sizeof(uint64_t));
       }
+      index_buckets();
     }
 
     /**
@@ -159,27 +195,22 @@ namespace ring
      */
     uint64_t insert(const std::string &val)
     {
+      clear_index();
       uint64_t id;
-      if (free_ids_size == 0)
+      if (free_ids.empty())
       {
         id = id_map.size() + 1;
-        id_map.push_back(EmptyOrPFC(root->insert(val, id, id_map)));
+        id_map.push_back(root->insert(val, id, id_map));
       }
       else
       {
-        id = first_empty;
-        // Last element on "Symbolic queue"
-        if (free_ids_size == 1)
-        {
-          last_empty = 0;
-          first_empty = 0;
-        } else {
-          first_empty = id_map[id - 1].get_next_empty();
-        }
-        id_map[id - 1].set_pfc(root->insert(val, id, id_map));
-        free_ids_size--;
+        id = free_ids.back();
+        free_ids.pop_back();
+        id_map.set_pfc(id, root->insert(val, id, id_map));
       }
 
+      if (hashes.enabled())
+        hashes.insert(fingerprint(val.data(), val.size()), id);
       return id;
     }
 
@@ -193,36 +224,34 @@ namespace ring
     {
       uint64_t id, found_id;
       std::tuple<uint64_t, PFC *> res;
-      if (free_ids_size == 0)
+      if (free_ids.empty())
       {
         id = id_map.size() + 1;
         res = root->get_or_insert(val, id, id_map);
         found_id = std::get<0>(res);
         if (found_id == id)
         {
-          id_map.push_back(EmptyOrPFC(std::get<1>(res)));
+          id_map.push_back(std::get<1>(res));
         }
       }
       else
       {
-        id = first_empty;
+        id = free_ids.back();
         res = root->get_or_insert(val, id, id_map);
         found_id = std::get<0>(res);
         if (found_id == id)
         {
-          // Last element on "Symbolic queue"
-          if (free_ids_size == 1)
-          {
-            last_empty = 0;
-            first_empty = 0;
-          } else {
-            first_empty = id_map[id - 1].get_next_empty();
-          }
-          id_map[id - 1].set_pfc(std::get<1>(res));
-          free_ids_size--;
+          free_ids.pop_back();
+          id_map.set_pfc(id, std::get<1>(res));
         }
       }
 
+      if (found_id == id)
+      {
+        clear_index();
+        if (hashes.enabled())
+          hashes.insert(fingerprint(val.data(), val.size()), id);
+      }
       return found_id;
     }
 
@@ -240,19 +269,12 @@ namespace ring
      */
     uint64_t eliminate(const std::string &val)
     {
+      clear_index();
       uint64_t elim_id = std::get<0>(root->eliminate(val, id_map));
-      // First in "Symbolic queue"
-      if (free_ids_size == 0)
-      {
-        first_empty = elim_id;
-        id_map[elim_id - 1].set_pfc(nullptr);
-      }
-      else
-      {
-        id_map[last_empty - 1].set_next_empty(elim_id);
-      }
-      last_empty = elim_id;
-      free_ids_size++;
+      if (hashes.enabled())
+        hashes.erase(fingerprint(val.data(), val.size()), elim_id);
+      id_map.set_pfc(elim_id, nullptr);
+      free_ids.push_back(elim_id);
       return elim_id;
     }
 
@@ -263,32 +285,90 @@ namespace ring
      */
     void eliminate(const uint64_t id)
     {
-      id_map[id - 1].get_pfc()->elim(id);
-      id_map[id - 1].set_pfc(nullptr);
-      // First in "Symbolic queue"
-      if (free_ids_size == 0)
+      clear_index();
+      if (hashes.enabled())
       {
-        first_empty = id;
+        std::string val = id_map.get_pfc(id)->extract(id);
+        hashes.erase(fingerprint(val.data(), val.size()), id);
       }
-      else
-      {
-        id_map[last_empty - 1].set_next_empty(id);
-      }
-      last_empty = id;
-      free_ids_size++;
+      id_map.get_pfc(id)->elim(id);
+      id_map.set_pfc(id, nullptr);
+      free_ids.push_back(id);
     }
 
     /**
-     * @brief Search a value in the binary tree of the structure and get its ID
+     * @brief Search a value in the structure and get its ID, using the index of
+     * the PFCs if it is built and the binary tree otherwise. After about as many
+     * searches in the tree as PFCs since an update, the index is built again.
+     * It can be called concurrently, but not during an update.
      *
      * @param val value being searched
      * @return std::pair<bool, uint64_t> True if the string exits and the ID of the string otherwise false and 0
      */
     std::pair<bool, uint64_t> locate(const std::string &val) const
     {
+      if (hashes.enabled())
+      {
+        uint64_t id = hashes.find(fingerprint(val.data(), val.size()), [&](uint64_t id)
+                                  { PFC *pfc = id_map.get_pfc(id);
+                                    return pfc && pfc->matches(id, val.data(), val.size()); });
+        return {id != 0, id};
+      }
+      if (!indexed.load(std::memory_order_acquire) && ++tree_locates > id_map.size() / MAXSIZE)
+        index_buckets();
+      // The readers only use the index once it is published
+      if (indexed.load(std::memory_order_acquire))
+        return headers.find(val.data(), val.size())->locate_if_exists(val.data(), val.size());
       return root->search(val);
     }
 
+    /**
+     * @brief Builds the index of the first words of the PFCs used by locate.
+     * The updates clear it, it is built again after a batch of them or by locate,
+     * once even if many readers ask for it at the same time.
+     */
+    void index_buckets() const
+    {
+      std::lock_guard<std::mutex> lock(index_mutex);
+      if (indexed.load(std::memory_order_relaxed))
+        return;
+      headers.build(get_pfcs());
+      tree_locates = 0;
+      indexed.store(headers.valid(), std::memory_order_release);
+    }
+
+    /**
+     * @brief Builds the hash index of the words, used by locate instead of the
+     * PFCs index and the tree. Once built, the updates keep it consistent.
+     */
+    void build_hash_index()
+    {
+      std::vector<PFC *> pfcs = get_pfcs();
+      uint64_t n = 0;
+      for (PFC *pfc : pfcs)
+        n += pfc->size();
+      hashes.reset(n);
+      for (PFC *pfc : pfcs)
+        pfc->for_each([&](uint64_t id, const std::string &word)
+                      { hashes.insert(fingerprint(word.data(), word.size()), id); });
+    }
+
+    bool has_hash_index() const
+    {
+      return hashes.enabled();
+    }
+
+    //! Serializes the hash index, it is stored apart from the dictionary
+    uint64_t serialize_hash_index(std::ostream &out) const
+    {
+      return hashes.serialize(out);
+    }
+
+    void load_hash_index(std::istream &in)
+    {
+      hashes.load(in);
+    }
+
     /**
      * @brief Search for an ID in the structure and get its corresponding value
      *
@@ -298,18 +378,32 @@ namespace ring
     std::string extract(uint64_t id)
     {
       assert(id > 0 && id - 1 < id_map.size());
-      return id_map[id - 1].get_pfc()->extract(id);
+      return id_map.get_pfc(id)->extract(id);
     }
 
-    size_t size()
+    /**
+     * @brief Search for many IDs in the structure and get their values,
+     * decoding each PFC once (see ::ring::extract_batch)
+     *
+     * @param ids    The IDs being searched
+     * @param n      The number of IDs
+     * @param arena  Holds the values, which are valid until it is reset
+     * @param values The i-th value is the one associated to ids[i]
+     */
+    void extract_batch(const uint64_t *ids, uint64_t n, query_arena &arena, std::vector<std::string_view> &values) const
+    {
+      ::ring::extract_batch(id_map, ids, n, arena, values);
+    }
+
+    size_t size() const
     {
       return id_map.size();
     }
 
     size_t bit_size() const
     {
-      size_t id_size = 8 * sizeof(id_map) + 8 * id_map.size() * sizeof(EmptyOrPFC);
-      return 8 * sizeof(root) + id_size + root->bit_size();
+      size_t id_size = id_map.bit_size() + 8 * (sizeof(free_ids) + free_ids.capacity() * sizeof(uint64_t));
+      return 8 * sizeof(root) + id_size + root->bit_size() + headers.bit_size() + hashes.bit_size();
     }
 
     std::string root_value()
@@ -322,23 +416,43 @@ namespace ring
       return root->get_pfc();
     }
 
+    //! The PFCs of the leaves, in the order of their words
+    std::vector<PFC *> get_pfcs() const
+    {
+      std::vector<PFC *> pfcs;
+      root->collect_pfcs(pfcs);
+      return pfcs;
+    }
+
     int get_height() const {
       return root ? root->get_height() : 0;
-  }
+    }
 
   private:
     class node;
     node *root = NULL;
-    std::vector<EmptyOrPFC> id_map;
-    // Values used to represent the Queue of free IDs
-    uint64_t first_empty = 0, last_empty = 0, free_ids_size = 0;
+    bucket_map id_map;
+    mutable bucket_index headers;                // Index of the PFCs for locate, empty after an update
+    mutable std::atomic<bool> indexed{false};    // Whether headers is built and can be read
+    mutable std::atomic<uint64_t> tree_locates{0}; // Searches in the tree since the index was emptied
+    mutable std::mutex index_mutex;              // Taken to build headers
+    hash_index hashes;    // Optional, from the words to their IDs
+    std::vector<uint64_t> free_ids; // Stack of the free IDs, the next one to reuse on top
+
+    //! Empties the index of the PFCs before an update
+    void clear_index()
+    {
+      indexed.store(false, std::memory_order_relaxed);
+      headers.clear();
+      tree_locates = 0;
+    }
   };
 
   /**
    * @brief Class representing the node of the binary tree
    * in the dictionary mapping.
    *
-   * @tparam MINSIZE The minimum words a PFC can have before being fused with its sibling
+   * @tparam MINSIZE The minimum words a PFC can have before being fused with an adjacent one
    * @tparam MAXSIZE The maximum words a PFC can have before splitting
    */
   template <uint64_t MINSIZE, uint64_t MAXSIZE>
@@ -364,6 +478,26 @@ namespace ring
       pfc = p;
     }
 
+    /**
+     * @brief Builds a balanced tree with the given PFCs as leaves
+     *
+     * @param pfcs The PFCs in the order of their words
+     * @param begin First PFC of the subtree
+     * @param end Position past the last PFC of the subtree
+     * @return node* The root of the subtree
+     */
+    static node *build(const std::vector<PFC *> &pfcs, uint64_t begin, uint64_t end)
+    {
+      if (end - begin == 1)
+        return new node(pfcs[begin]);
+      uint64_t middle = begin + (end - begin) / 2;
+      node *n = new node(pfcs[middle]);
+      n->_is_leaf = false;
+      n->left = build(pfcs, begin, middle);
+      n->right = build(pfcs, middle, end);
+      return n;
+    }
+
     void free_mem()
     {
       if (_is_leaf)
@@ -379,6 +513,20 @@ namespace ring
       }
     }
 
+    //! Appends the PFCs of the leaves of the subtree, from left to right
+    void collect_pfcs(std::vector<PFC *> &pfcs) const
+    {
+      if (_is_leaf)
+      {
+        pfcs.push_back(pfc);
+      }
+      else
+      {
+        left->collect_pfcs(pfcs);
+        right->collect_pfcs(pfcs);
+      }
+    }
+
     bool is_leaf() { return _is_leaf; }
 
     PFC *get_pfc()
@@ -440,19 +588,20 @@ namespace ring
      * @param id_map Reference to the vector that maps every ID to its corresponding PFC
      * @return PFC* The pointer to the leftmost leaf in the node subtree
      */
-    PFC *load(std::istream &in, std::vector<EmptyOrPFC> &id_map)
+    PFC *load(std::istream &in, bucket_map &id_map)
     {
       size_t string_size;
       in.read((char *)&_is_leaf, sizeof(_is_leaf));
 
       if (_is_leaf)
       {
-        pfc = new PFC();
         pfc->load(in, id_map);
         return pfc;
       }
       else
       {
+        // The PFC of an internal node is the first one of its right subtree
+        delete pfc;
         left = new node();
         PFC *left_pfc = left->load(in, id_map);
         right = new node();
@@ -468,7 +617,7 @@ namespace ring
      * @param val value being inserted
      * @param id ID assigned to that value
      */
-    PFC *insert(const std::string &val, const uint64_t &id, std::vector<EmptyOrPFC> &id_map)
+    PFC *insert(const std::string &val, const uint64_t &id, bucket_map &id_map)
     {
       if (is_leaf())
       {
@@ -487,12 +636,12 @@ namespace ring
           // Update ID mapping
           for (uint64_t id : pfc->all_ids())
           {
-            if (id_map[id - 1].has_pfc()) {
-              id_map[id - 1].set_pfc(pfc);
+            if (id_map.has_pfc(id)) {
+              id_map.set_pfc(id, pfc);
             }
           }
 
-          if (val.compare(pfc->first_word()) >= 0)
+          if (pfc->compare_to_first_word(val.data(), val.size()) >= 0)
             return right->get_pfc();
           else
             return left->get_pfc();
@@ -502,7 +651,7 @@ namespace ring
       else
       {
         // Go to correct children
-        if (val.compare(pfc->first_word()) > 0)
+        if (pfc->compare_to_first_word(val.data(), val.size()) > 0)
         {
           return right->insert(val, id, id_map);
         }
@@ -520,7 +669,7 @@ namespace ring
      * @param id  ID assigned to the value if its inserted
      * @return std::tuple<uint64_t, PFC *> a pair containing the ID of the value and the PFC it was found/inserted
      */
-    std::tuple<uint64_t, PFC *> get_or_insert(const std::string &val, const uint64_t &id, std::vector<EmptyOrPFC> &id_map)
+    std::tuple<uint64_t, PFC *> get_or_insert(const std::string &val, const uint64_t &id, bucket_map &id_map)
     {
       if (is_leaf())
       {
@@ -539,12 +688,12 @@ namespace ring
           // Update ID mapping
           for (uint64_t id : pfc->all_ids())
           {
-            if (id_map[id - 1].has_pfc()) {
-              id_map[id - 1].set_pfc(pfc);
+            if (id_map.has_pfc(id)) {
+              id_map.set_pfc(id, pfc);
             }
           }
 
-          if (val.compare(pfc->first_word()) >= 0)
+          if (pfc->compare_to_first_word(val.data(), val.size()) >= 0)
             return {new_id, right->get_pfc()};
           else
             return {new_id, left->get_pfc()};
@@ -554,7 +703,7 @@ namespace ring
       else
       {
         // Go to correct children
-        int r = val.compare(pfc->first_word());
+        int r = pfc->compare_to_first_word(val.data(), val.size());
         if (r == 0)
         {
           uint64_t new_id = pfc->get_or_insert(val, id);
@@ -578,7 +727,7 @@ namespace ring
      * @return std::tuple<uint64_t, uint64_t> a pair containing
      * the ID of the deleted value and the resulting size of the PFC it was stored in
      */
-    std::tuple<uint64_t, uint64_t> eliminate(const std::string &val, std::vector<EmptyOrPFC> &id_map)
+    std::tuple<uint64_t, uint64_t> eliminate(const std::string &val, bucket_map &id_map)
     {
       if (is_leaf())
       {
@@ -587,7 +736,7 @@ namespace ring
       }
       else
       {
-        int r = val.compare(pfc->first_word());
+        int r = pfc->compare_to_first_word(val.data(), val.size());
         std::tuple<uint64_t, uint64_t> res;
         uint64_t child_size = MAXSIZE;
         // Go to correct children
@@ -610,42 +759,39 @@ namespace ring
 
         if (child_size < MINSIZE)
         {
-          // Update ID mapping
-          for (uint64_t id : right->pfc->all_ids())
+          if (r < 0)
           {
-            if (id_map[id - 1].has_pfc()) {
-              id_map[id - 1].set_pfc(left->pfc);
+            // The left leaf takes the words of the next one, the leftmost leaf of the right subtree
+            node *next = right->leftmost();
+            fuse(left->pfc, next->pfc, id_map);
+            if (right->_is_leaf)
+            {
+              delete right;
+              _is_leaf = true;
+              pfc = left->pfc;
+              delete left;
+              left = right = NULL;
+              split_full(id_map);
             }
-          }
-
-          std::string right_string = right->pfc->pfc_string();
-
-          left->pfc->fuse(right_string, right->pfc->size());
-          right->free_mem();
-          delete right;
-          _is_leaf = true;
-          pfc = left->pfc;
-          left->pfc = nullptr;
-          delete left;
-
-          if (pfc->size() > MAXSIZE)
-          {
-            // Split PFC
-            std::tuple<std::string, uint64_t> split_res = pfc->split();
-            PFC *new_pfc = new PFC(std::get<0>(split_res), std::get<1>(split_res));
-            _is_leaf = false;
-            right = new node(new_pfc);
-            left = new node(pfc);
-            pfc = new_pfc;
-
-            // Update ID mapping
-            for (uint64_t id : pfc->all_ids())
+            else
             {
-              if (id_map[id - 1].has_pfc()) {
-                id_map[id - 1].set_pfc(pfc);
-              }
+              right->remove_leftmost();
+              pfc = right->leftmost()->pfc;
+              left->split_full(id_map);
             }
           }
+          else
+          {
+            // The previous leaf, the rightmost one of the left subtree, takes the words
+            // of the right leaf, and the left subtree takes the place of this node
+            node *prev = left->rightmost();
+            fuse(prev->pfc, right->pfc, id_map);
+            delete right;
+            replace_by(left);
+            if (_is_leaf)
+              prev = this;
+            prev->split_full(id_map);
+          }
         }
 
         return {std::get<0>(res), MAXSIZE};
@@ -666,7 +812,7 @@ namespace ring
       }
       else
       {
-        int r = val.compare(pfc->first_word());
+        int r = pfc->compare_to_first_word(val.data(), val.size());
         if (r == 0)
         {
           return pfc->locate_if_exists(val);
@@ -694,6 +840,82 @@ namespace ring
     node *left = NULL;
     node *right = NULL;
     PFC *pfc = NULL;
+
+    node *leftmost()
+    {
+      node *n = this;
+      while (!n->_is_leaf)
+        n = n->left;
+      return n;
+    }
+
+    node *rightmost()
+    {
+      node *n = this;
+      while (!n->_is_leaf)
+        n = n->right;
+      return n;
+    }
+
+    //! Takes the place of the child, which is deleted but not its subtree
+    void replace_by(node *child)
+    {
+      _is_leaf = child->_is_leaf;
+      left = child->left;
+      right = child->right;
+      pfc = child->pfc;
+      delete child;
+    }
+
+    //! Removes the leftmost leaf of an internal node, whose PFC was fused into the previous one
+    void remove_leftmost()
+    {
+      if (left->_is_leaf)
+      {
+        delete left;
+        replace_by(right);
+      }
+      else
+      {
+        left->remove_leftmost();
+      }
+    }
+
+    //! Splits the PFC of a leaf with more than MAXSIZE words into two leaves
+    void split_full(bucket_map &id_map)
+    {
+      if (pfc->size() <= MAXSIZE)
+        return;
+      std::tuple<std::string, uint64_t> res = pfc->split();
+      PFC *new_pfc = new PFC(std::get<0>(res), std::get<1>(res));
+      _is_leaf = false;
+      right = new node(new_pfc);
+      left = new node(pfc);
+      pfc = new_pfc;
+
+      // Update ID mapping
+      for (uint64_t id : pfc->all_ids())
+      {
+        if (id_map.has_pfc(id)) {
+          id_map.set_pfc(id, pfc);
+        }
+      }
+    }
+
+    //! Appends the words of next, the PFC that follows prev, to prev and deletes next
+    static void fuse(PFC *prev, PFC *next, bucket_map &id_map)
+    {
+      // Update ID mapping
+      for (uint64_t id : next->all_ids())
+      {
+        if (id_map.has_pfc(id)) {
+          id_map.set_pfc(id, prev);
+        }
+      }
+      std::string next_string = next->pfc_string();
+      prev->fuse(next_string, next->size());
+      delete next;
+    }
   };
 
   typedef dict_map<32, 128> basic_map;
@@ -0,0 +1,423 @@
+/*
+ * dict_mapped.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DICT_MAPPED_HPP
+#define DICT_MAPPED_HPP
+
+#include <memory>
+#include "dict_map.hpp"
+#include "dict_map_avl.hpp"
+#include "hash_index.hpp"
+#include "mapped_file.hpp"
+
+namespace ring
+{
+
+  /**
+   * @brief Read-only layout of a dictionary, stored as a single block of words:
+   *  - n_ids, n_buckets, text_bytes, header_bytes
+   *  - The bucket of each ID (32 bits each, none for the free IDs)
+   *  - The number of words of each bucket
+   *  - The offsets of the buckets in the text, and of their first words in the headers
+   *  - The text, the bytes of the PFCs one after the other
+   *  - The headers, the first words of the PFCs one after the other
+   * When it is loaded from a mapped_streambuf the block is used in place, so
+   * loading it does not build any tree nor per-ID objects (see bwt_mapped).
+   *
+   * The first update builds the mutable dictionary from the buckets, which is
+   * used from then on.
+   *
+   * @tparam map_t The mutable dictionary (dict_map or dict_map_avl)
+   */
+  template <class map_t>
+  class dict_mapped
+  {
+  public:
+    dict_mapped() = default;
+
+    /**
+     * @brief Builds the dictionary from the given values (see the bulk constructor of map_t)
+     *
+     * @param values The values, sorted and without repetitions
+     */
+    explicit dict_mapped(const std::vector<std::string> &values)
+    {
+      map_t map(values);
+      flatten(map, m_data);
+      m_ptr = m_data.data();
+      m_words = m_data.size();
+      init_views();
+    }
+
+    dict_mapped(const dict_mapped &) = delete;
+    dict_mapped &operator=(const dict_mapped &) = delete;
+
+    // The views point to the heap buffer of m_data or to the mapping, a move keeps both
+    dict_mapped(dict_mapped &&) = default;
+    dict_mapped &operator=(dict_mapped &&) = default;
+
+    //! True if the block is used from a mapped file
+    bool is_mapped() const
+    {
+      return m_data.empty() && m_words > 0;
+    }
+
+    //! True once the mutable dictionary has been built
+    bool is_mutable() const
+    {
+      return m_map != nullptr;
+    }
+
+    /**
+     * @brief The mutable dictionary, built from the buckets the first time
+     *
+     * @return map_t& The dictionary that handles every operation from now on
+     */
+    map_t &mutable_map()
+    {
+      if (!m_map)
+      {
+        std::vector<PFC *> pfcs(m_n_buckets);
+        for (uint64_t b = 0; b < m_n_buckets; b++)
+          pfcs[b] = new PFC(std::string(bucket(b)), m_sizes[b]);
+        m_map.reset(new map_t(pfcs, m_n_ids));
+        if (m_hashes.enabled())
+        {
+          m_map->build_hash_index();
+          m_hashes.clear();
+        }
+      }
+      return *m_map;
+    }
+
+    //! Serializes the data structure into the given ostream
+    uint64_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "") const
+    {
+      sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, "dict_mapped");
+      std::vector<uint64_t> data;
+      const uint64_t *ptr = m_ptr;
+      uint64_t n_words = m_words;
+      if (m_map)
+      {
+        flatten(*m_map, data);
+        ptr = data.data();
+        n_words = data.size();
+      }
+      uint64_t written_bytes = sdsl::write_member(n_words, out, child, "words");
+      uint64_t pad = padding(out.tellp());
+      const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+      out.write(zeros, pad);
+      out.write((const char *)ptr, n_words * sizeof(uint64_t));
+      written_bytes += pad + n_words * sizeof(uint64_t);
+      sdsl::structure_tree::add_size(child, written_bytes);
+      return written_bytes;
+    }
+
+    /**
+     * @brief Loads the dictionary, in place if the stream is a mapped_streambuf
+     *
+     * @param in The in stream where the bytes are coming from
+     */
+    void load(std::istream &in)
+    {
+      m_map.reset();
+      m_data.clear();
+      sdsl::read_member(m_words, in);
+      in.ignore(padding(in.tellg()));
+      auto *buf = dynamic_cast<mapped_streambuf *>(in.rdbuf());
+      if (buf != nullptr && buf->remaining() >= m_words * sizeof(uint64_t))
+      {
+        m_ptr = (const uint64_t *)buf->current();
+        buf->advance(m_words * sizeof(uint64_t));
+      }
+      else
+      {
+        m_data.resize(m_words);
+        in.read((char *)m_data.data(), m_words * sizeof(uint64_t));
+        m_ptr = m_data.data();
+      }
+      init_views();
+    }
+
+    /**
+     * @brief Search a value in the structure and get its ID
+     *
+     * @param val value being searched
+     * @return std::pair<bool, uint64_t> True if the string exits and the ID of the string otherwise false and 0
+     */
+    std::pair<bool, uint64_t> locate(const std::string &val) const
+    {
+      if (m_map)
+        return m_map->locate(val);
+      if (m_hashes.enabled())
+      {
+        uint64_t id = m_hashes.find(fingerprint(val.data(), val.size()), [&](uint64_t id)
+                                    {
+                                      std::string_view b = bucket_of(id);
+                                      return !b.empty() && PFC::matches_in(b.data(), b.size(), id, val.data(), val.size()); });
+        return {id != 0, id};
+      }
+      if (m_n_buckets == 0)
+        return {false, 0};
+      // Last bucket whose first word is not greater than val
+      uint64_t lo = 1, hi = m_n_buckets;
+      while (lo < hi)
+      {
+        uint64_t mid = lo + (hi - lo) / 2;
+        const char *header = m_headers + m_header_offsets[mid];
+        if (compare_bytes(header, m_header_offsets[mid + 1] - m_header_offsets[mid], val.data(), val.size()) <= 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      std::string_view b = bucket(lo - 1);
+      return PFC::locate_in(b.data(), b.size(), val.data(), val.size());
+    }
+
+    /**
+     * @brief Search for an ID in the structure and get its corresponding value
+     *
+     * @param id the ID being searched
+     * @return std::string value associated to the ID
+     */
+    std::string extract(uint64_t id) const
+    {
+      if (m_map)
+        return m_map->extract(id);
+      std::string value;
+      std::string_view b = bucket_of(id);
+      if (PFC::extract_in(b.data(), b.size(), &id, 1, [&](uint64_t, const std::string &word)
+                          { value = word; }) == 0)
+        throw std::invalid_argument("ID is not asociated to any string in Plain Front Coding");
+      return value;
+    }
+
+    //! Extracts the values of many IDs decoding each bucket once (see ::ring::extract_batch)
+    void extract_batch(const uint64_t *ids, uint64_t n, query_arena &arena, std::vector<std::string_view> &values) const
+    {
+      if (m_map)
+        return m_map->extract_batch(ids, n, arena, values);
+      ::ring::extract_batch([&](uint64_t id)
+                            { return bucket_of(id); },
+                            ids, n, arena, values);
+    }
+
+    uint64_t insert(const std::string &val)
+    {
+      return mutable_map().insert(val);
+    }
+
+    uint64_t get_or_insert(const std::string &val)
+    {
+      // Values already in the dictionary do not need the mutable one
+      if (!m_map)
+      {
+        std::pair<bool, uint64_t> res = locate(val);
+        if (res.first)
+          return res.second;
+      }
+      return mutable_map().get_or_insert(val);
+    }
+
+    spo_triple get_or_insert_triple(const std::string &s, const std::string &p, const std::string &o)
+    {
+      return {this->get_or_insert(s), this->get_or_insert(p), this->get_or_insert(o)};
+    }
+
+    uint64_t eliminate(const std::string &val)
+    {
+      return mutable_map().eliminate(val);
+    }
+
+    void eliminate(const uint64_t id)
+    {
+      mutable_map().eliminate(id);
+    }
+
+    //! Builds the hash index of the words used by locate (see hash_index)
+    void build_hash_index()
+    {
+      if (m_map)
+        return m_map->build_hash_index();
+      m_hashes.reset(m_n_ids);
+      for (uint64_t b = 0; b < m_n_buckets; b++)
+      {
+        std::string_view text = bucket(b);
+        PFC::for_each_in(text.data(), text.size(), [&](uint64_t id, const std::string &word)
+                         { m_hashes.insert(fingerprint(word.data(), word.size()), id); });
+      }
+    }
+
+    bool has_hash_index() const
+    {
+      return m_map ? m_map->has_hash_index() : m_hashes.enabled();
+    }
+
+    uint64_t serialize_hash_index(std::ostream &out) const
+    {
+      return m_map ? m_map->serialize_hash_index(out) : m_hashes.serialize(out);
+    }
+
+    void load_hash_index(std::istream &in)
+    {
+      if (m_map)
+        return m_map->load_hash_index(in);
+      m_hashes.load(in);
+    }
+
+    size_t size() const
+    {
+      return m_map ? m_map->size() : m_n_ids;
+    }
+
+    size_t bit_size() const
+    {
+      if (m_map)
+        return m_map->bit_size();
+      return 8 * sizeof(*this) + 64 * m_words + m_hashes.bit_size();
+    }
+
+  private:
+    static constexpr uint32_t no_bucket = UINT32_MAX;
+
+    std::vector<uint64_t> m_data; // Empty when the block is mapped
+    const uint64_t *m_ptr = nullptr;
+    uint64_t m_words = 0;
+
+    // Views of the block
+    uint64_t m_n_ids = 0, m_n_buckets = 0;
+    const uint32_t *m_bucket_of = nullptr;
+    const uint64_t *m_sizes = nullptr;
+    const uint64_t *m_offsets = nullptr;
+    const uint64_t *m_header_offsets = nullptr;
+    const char *m_text = nullptr;
+    const char *m_headers = nullptr;
+
+    hash_index m_hashes;          // Optional, until the mutable dictionary is built
+    std::unique_ptr<map_t> m_map; // Built by the first update
+
+    static uint64_t words(uint64_t bytes)
+    {
+      return (bytes + 7) / 8;
+    }
+
+    // The block is aligned to 8 bytes with respect to the beginning of the file
+    static uint64_t padding(int64_t pos)
+    {
+      return (pos < 0) ? 0 : (8 - pos % 8) % 8;
+    }
+
+    void init_views()
+    {
+      if (m_words == 0)
+      {
+        m_n_ids = m_n_buckets = 0;
+        return;
+      }
+      const uint64_t *p = m_ptr;
+      m_n_ids = p[0];
+      m_n_buckets = p[1];
+      uint64_t text_bytes = p[2];
+      p += 4;
+      m_bucket_of = (const uint32_t *)p;
+      p += words(m_n_ids * sizeof(uint32_t));
+      m_sizes = p;
+      p += m_n_buckets;
+      m_offsets = p;
+      p += m_n_buckets + 1;
+      m_header_offsets = p;
+      p += m_n_buckets + 1;
+      m_text = (const char *)p;
+      p += words(text_bytes);
+      m_headers = (const char *)p;
+    }
+
+    std::string_view bucket(uint64_t b) const
+    {
+      return std::string_view(m_text + m_offsets[b], m_offsets[b + 1] - m_offsets[b]);
+    }
+
+    //! The bytes of the bucket of an ID, none if it is free
+    std::string_view bucket_of(uint64_t id) const
+    {
+      if (id == 0 || id > m_n_ids || m_bucket_of[id - 1] == no_bucket)
+        return std::string_view();
+      return bucket(m_bucket_of[id - 1]);
+    }
+
+    //! Writes the block of a mutable dictionary
+    static void flatten(const map_t &map, std::vector<uint64_t> &data)
+    {
+      std::vector<PFC *> pfcs;
+      for (PFC *pfc : map.get_pfcs())
+      {
+        if (pfc->size() > 0)
+          pfcs.push_back(pfc);
+      }
+      const uint64_t n_ids = map.size(), n_buckets = pfcs.size();
+      if (n_buckets >= no_bucket)
+        throw std::invalid_argument("Too many buckets for the mapped dictionary");
+      uint64_t text_bytes = 0, header_bytes = 0;
+      std::vector<std::string> headers(n_buckets);
+      for (uint64_t b = 0; b < n_buckets; b++)
+      {
+        text_bytes += pfcs[b]->bytes().size();
+        headers[b] = pfcs[b]->first_word();
+        header_bytes += headers[b].size();
+      }
+
+      data.assign(4 + words(n_ids * sizeof(uint32_t)) + n_buckets + 2 * (n_buckets + 1) + words(text_bytes) + words(header_bytes), 0);
+      data[0] = n_ids;
+      data[1] = n_buckets;
+      data[2] = text_bytes;
+      data[3] = header_bytes;
+      uint64_t *p = data.data() + 4;
+      uint32_t *bucket_of = (uint32_t *)p;
+      std::fill(bucket_of, bucket_of + n_ids, no_bucket);
+      p += words(n_ids * sizeof(uint32_t));
+      uint64_t *sizes = p;
+      p += n_buckets;
+      uint64_t *offsets = p;
+      p += n_buckets + 1;
+      uint64_t *header_offsets = p;
+      p += n_buckets + 1;
+      char *text = (char *)p;
+      p += words(text_bytes);
+      char *header_text = (char *)p;
+
+      offsets[0] = header_offsets[0] = 0;
+      for (uint64_t b = 0; b < n_buckets; b++)
+      {
+        std::string_view bytes = pfcs[b]->bytes();
+        sizes[b] = pfcs[b]->size();
+        std::memcpy(text + offsets[b], bytes.data(), bytes.size());
+        offsets[b + 1] = offsets[b] + bytes.size();
+        std::memcpy(header_text + header_offsets[b], headers[b].data(), headers[b].size());
+        header_offsets[b + 1] = header_offsets[b] + headers[b].size();
+        for (uint64_t id : pfcs[b]->all_ids())
+          bucket_of[id - 1] = b;
+      }
+    }
+  };
+
+  typedef dict_mapped<basic_map> basic_map_mapped;
+  typedef dict_mapped<basic_map_avl> basic_map_avl_mapped;
+}
+
+#endif
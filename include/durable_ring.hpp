@@ -0,0 +1,504 @@
+/*
+ * durable_ring.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_DURABLE_RING_HPP
+#define RING_DURABLE_RING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "versioned_ring.hpp"
+#include "update_log.hpp"
+
+namespace ring {
+
+    /**
+     * A dynamic ring and its dictionaries stored in a directory, so that they
+     * survive a restart (or a crash) without saving the whole index after each
+     * update.
+     *
+     * Every update is applied, then appended to an update_log and committed
+     * (synced) before returning, so an update that fails is never logged.
+     * Concurrent writers share the syncs (group commit). The state is
+     * checkpointed from time to time into "<dir>/checkpoint-<lsn>" with the
+     * usual serialize of the ring and the dictionaries, and then the log up to
+     * that lsn is dropped. A checkpoint that fails in the background thread is
+     * reported to the next update, which throws it without being applied. Opening the directory loads the last checkpoint and
+     * replays the rest of the log. A record that still fails there (logged by
+     * an older version before it failed) is skipped and reported, as it was
+     * not applied either when it was logged.
+     *
+     * The queries use snapshots as in versioned_ring. They may see an update
+     * before its commit has returned.
+     */
+    template <class ring_t, class map_t>
+    class durable_ring
+    {
+    public:
+        typedef ring_t ring_type;
+        typedef map_t map_type;
+        typedef typename versioned_ring<ring_t>::snapshot_type snapshot_type;
+
+    private:
+        std::string m_dir;
+        map_type m_so_mapping;
+        map_type m_p_mapping;
+        std::unique_ptr<versioned_ring<ring_type>> m_ring;
+        update_log m_log;
+        std::atomic<uint64_t> m_checkpoint_lsn{0};
+        std::mutex m_mutex;            // serializes the updates
+        std::mutex m_checkpoint_mutex; // one checkpoint at a time
+
+        std::thread m_checkpointer;
+        std::mutex m_checkpointer_mutex;
+        std::condition_variable m_checkpointer_cv;
+        bool m_stop = false;
+        std::exception_ptr m_checkpoint_error;          // of the background checkpoints, for the next update
+        std::atomic<uint64_t> m_checkpoint_records{0}; // 0 if only by time
+        uint64_t m_skipped_records = 0;    // records that failed in the replay
+
+        static std::string checkpoint_name(uint64_t lsn)
+        {
+            return "checkpoint-" + std::to_string(lsn);
+        }
+
+        static void sync_file(const std::string &file)
+        {
+            int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        static void write_file(const std::string &file, const std::string &data)
+        {
+            std::ofstream out(file, std::ios::binary | std::ios::trunc);
+            out.write(data.data(), data.size());
+            out.close();
+            if (!out)
+                throw std::runtime_error("durable_ring: cannot write " + file);
+            sync_file(file);
+        }
+
+        void apply(ring_type &r, const update_log::record &rec)
+        {
+            std::vector<spo_triple> triples;
+            switch (rec.kind)
+            {
+            case update_log::insert_triples:
+                triples = rec.triples;
+                r.insert_batch(triples);
+                break;
+            case update_log::remove_triples:
+                triples = rec.triples;
+                r.remove_batch(triples);
+                break;
+            case update_log::remove_node:
+                r.remove_node(rec.value);
+                break;
+            case update_log::so_insert:
+                m_so_mapping.get_or_insert(rec.str);
+                break;
+            case update_log::so_eliminate:
+                m_so_mapping.eliminate(rec.str);
+                break;
+            case update_log::p_insert:
+                m_p_mapping.get_or_insert(rec.str);
+                break;
+            case update_log::p_eliminate:
+                m_p_mapping.eliminate(rec.str);
+                break;
+            }
+        }
+
+        void wake_checkpointer()
+        {
+            uint64_t records = m_checkpoint_records.load();
+            if (records && m_log.last_lsn() - m_checkpoint_lsn.load() >= records)
+                m_checkpointer_cv.notify_one();
+        }
+
+        //! Throws the error of the last background checkpoint, once
+        void throw_checkpoint_error()
+        {
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> lock(m_checkpointer_mutex);
+                std::swap(error, m_checkpoint_error);
+            }
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        uint64_t get_or_insert(map_type &mapping, update_log::kind_type kind, const std::string &val)
+        {
+            throw_checkpoint_error();
+            uint64_t lsn;
+            uint64_t id;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto found = mapping.locate(val);
+                if (found.first)
+                    return found.second;
+                id = mapping.get_or_insert(val);
+                lsn = m_log.append_string(kind, val);
+            }
+            m_log.commit(lsn);
+            wake_checkpointer();
+            return id;
+        }
+
+        uint64_t eliminate(map_type &mapping, update_log::kind_type kind, const std::string &val)
+        {
+            throw_checkpoint_error();
+            uint64_t lsn;
+            uint64_t id;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!mapping.locate(val).first)
+                    return 0;
+                id = mapping.eliminate(val);
+                lsn = m_log.append_string(kind, val);
+            }
+            m_log.commit(lsn);
+            wake_checkpointer();
+            return id;
+        }
+
+        std::pair<bool, uint64_t> locate(map_type &mapping, const std::string &val)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return mapping.locate(val);
+        }
+
+        //! Removes the checkpoints other than the one of lsn, left by a crash
+        static void remove_stale_checkpoints(const std::string &dir, uint64_t lsn)
+        {
+            std::string current = checkpoint_name(lsn);
+            std::vector<std::filesystem::path> stale;
+            for (auto &e : std::filesystem::directory_iterator(dir))
+            {
+                std::string name = e.path().filename().string();
+                if ((name.compare(0, 11, "checkpoint-") == 0 && name != current) || name == "CHECKPOINT.tmp")
+                    stale.push_back(e.path());
+            }
+            for (auto &p : stale)
+                std::filesystem::remove_all(p);
+            if (!stale.empty())
+                update_log::sync_dir(dir);
+        }
+
+    public:
+        /**
+         * Opens the ring stored in dir, or an empty one if there is nothing.
+         *
+         * @param dir   Directory of the checkpoints and of the log
+         */
+        explicit durable_ring(const std::string &dir) : m_dir(dir)
+        {
+            std::filesystem::create_directories(dir);
+            ring_type r;
+            std::ifstream last(dir + "/CHECKPOINT");
+            uint64_t lsn;
+            if (last >> lsn)
+            {
+                m_checkpoint_lsn = lsn;
+                std::string ckpt = dir + "/" + checkpoint_name(lsn);
+                sdsl::load_from_file(r, ckpt + "/ring");
+                std::ifstream stats_in(ckpt + "/ring.stats", std::ios::binary);
+                if (stats_in)
+                    r.stats().load(stats_in);
+                std::ifstream so_in(ckpt + "/so.mapping", std::ios::binary);
+                m_so_mapping.load(so_in);
+                std::ifstream p_in(ckpt + "/p.mapping", std::ios::binary);
+                m_p_mapping.load(p_in);
+            }
+            remove_stale_checkpoints(dir, m_checkpoint_lsn);
+            m_log.open(dir, m_checkpoint_lsn, [&](const update_log::record &rec) {
+                try
+                {
+                    apply(r, rec);
+                }
+                catch (const std::exception &e)
+                {
+                    ++m_skipped_records;
+                    std::cerr << "durable_ring: skipped record " << rec.lsn << ": " << e.what() << std::endl;
+                }
+            });
+            m_ring.reset(new versioned_ring<ring_type>(std::move(r)));
+        }
+
+        ~durable_ring()
+        {
+            stop_checkpoints();
+        }
+
+        durable_ring(const durable_ring &) = delete;
+        durable_ring &operator=(const durable_ring &) = delete;
+
+        /**
+         * Makes dir the storage of an existing index and its mappings (as written
+         * by build-index), as its first checkpoint.
+         */
+        static void create(const std::string &dir, const std::string &index, const std::string &so_mapping, const std::string &p_mapping)
+        {
+            std::string ckpt = dir + "/" + checkpoint_name(0);
+            std::filesystem::create_directories(ckpt);
+            auto overwrite = std::filesystem::copy_options::overwrite_existing;
+            std::filesystem::copy_file(index, ckpt + "/ring", overwrite);
+            if (std::filesystem::exists(index + ".stats"))
+            {
+                std::filesystem::copy_file(index + ".stats", ckpt + "/ring.stats", overwrite);
+                sync_file(ckpt + "/ring.stats");
+            }
+            std::filesystem::copy_file(so_mapping, ckpt + "/so.mapping", overwrite);
+            std::filesystem::copy_file(p_mapping, ckpt + "/p.mapping", overwrite);
+            sync_file(ckpt + "/ring");
+            sync_file(ckpt + "/so.mapping");
+            sync_file(ckpt + "/p.mapping");
+            update_log::sync_dir(ckpt);
+            write_file(dir + "/CHECKPOINT.tmp", "0\n");
+            std::filesystem::rename(dir + "/CHECKPOINT.tmp", dir + "/CHECKPOINT");
+            update_log::sync_dir(dir);
+        }
+
+        snapshot_type snapshot() const
+        {
+            return m_ring->snapshot();
+        }
+
+        void insert_batch(const std::vector<spo_triple> &triples)
+        {
+            throw_checkpoint_error();
+            uint64_t lsn;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ring->insert_batch(triples);
+                lsn = m_log.append_insert(triples);
+            }
+            m_log.commit(lsn);
+            wake_checkpointer();
+        }
+
+        void remove_batch(const std::vector<spo_triple> &triples)
+        {
+            throw_checkpoint_error();
+            uint64_t lsn;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ring->remove_batch(triples);
+                lsn = m_log.append_remove(triples);
+            }
+            m_log.commit(lsn);
+            wake_checkpointer();
+        }
+
+        void remove_node(uint64_t v)
+        {
+            throw_checkpoint_error();
+            uint64_t lsn;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ring->remove_node(v);
+                lsn = m_log.append_remove_node(v);
+            }
+            m_log.commit(lsn);
+            wake_checkpointer();
+        }
+
+        uint64_t so_get_or_insert(const std::string &val)
+        {
+            return get_or_insert(m_so_mapping, update_log::so_insert, val);
+        }
+
+        uint64_t p_get_or_insert(const std::string &val)
+        {
+            return get_or_insert(m_p_mapping, update_log::p_insert, val);
+        }
+
+        //! Returns the ID of val, 0 if it was not in the mapping
+        uint64_t so_eliminate(const std::string &val)
+        {
+            return eliminate(m_so_mapping, update_log::so_eliminate, val);
+        }
+
+        uint64_t p_eliminate(const std::string &val)
+        {
+            return eliminate(m_p_mapping, update_log::p_eliminate, val);
+        }
+
+        std::pair<bool, uint64_t> so_locate(const std::string &val)
+        {
+            return locate(m_so_mapping, val);
+        }
+
+        std::pair<bool, uint64_t> p_locate(const std::string &val)
+        {
+            return locate(m_p_mapping, val);
+        }
+
+        /**
+         * Writes a checkpoint of the current state and drops the log it covers.
+         * The updates only wait while the dictionaries are serialized.
+         *
+         * serialize may flatten the amortized bitvectors, which would race with
+         * the queries on the same snapshot, so the ring is written from a
+         * private copy. That is the standby of the versioned ring when it is
+         * free, so the checkpoint only copies the ring when a reader still
+         * holds the standby or an update comes first.
+         */
+        void checkpoint()
+        {
+            std::lock_guard<std::mutex> ckpt_lock(m_checkpoint_mutex);
+            uint64_t lsn;
+            uint64_t version;
+            snapshot_type snap;
+            std::ostringstream so_out, p_out;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                lsn = m_log.last_lsn();
+                if (lsn == m_checkpoint_lsn)
+                    return;
+                snap = m_ring->snapshot();
+                version = m_ring->version();
+                m_so_mapping.serialize(so_out);
+                m_p_mapping.serialize(p_out);
+                m_log.rotate();
+            }
+            snapshot_type copy = m_ring->private_copy(snap);
+            snap.reset();
+            ring_type &r = *copy;
+
+            std::string ckpt = m_dir + "/" + checkpoint_name(lsn);
+            std::string tmp = ckpt + ".tmp";
+            try
+            {
+                std::filesystem::remove_all(tmp);
+                std::filesystem::create_directories(tmp);
+                sdsl::store_to_file(r, tmp + "/ring");
+                sync_file(tmp + "/ring");
+                if (r.stats().enabled())
+                {
+                    std::ostringstream stats_out;
+                    r.stats().serialize(stats_out);
+                    write_file(tmp + "/ring.stats", stats_out.str());
+                }
+                write_file(tmp + "/so.mapping", so_out.str());
+                write_file(tmp + "/p.mapping", p_out.str());
+                update_log::sync_dir(tmp);
+                std::filesystem::remove_all(ckpt);
+                std::filesystem::rename(tmp, ckpt);
+                write_file(m_dir + "/CHECKPOINT.tmp", std::to_string(lsn) + "\n");
+                std::filesystem::rename(m_dir + "/CHECKPOINT.tmp", m_dir + "/CHECKPOINT");
+                update_log::sync_dir(m_dir);
+            }
+            catch (...)
+            {
+                // The previous checkpoint and the log are still complete
+                m_ring->restore_standby(std::move(copy), version);
+                throw;
+            }
+            m_ring->restore_standby(std::move(copy), version);
+
+            uint64_t old_lsn = m_checkpoint_lsn;
+            m_checkpoint_lsn = lsn;
+            m_log.remove_upto(lsn);
+            std::filesystem::remove_all(m_dir + "/" + checkpoint_name(old_lsn));
+        }
+
+        /**
+         * Starts a thread that checkpoints every interval, or as soon as
+         * records updates have been logged since the last checkpoint. If a
+         * checkpoint fails, the next update throws its error, and the thread
+         * tries again at the next interval.
+         *
+         * @param interval  Time between checkpoints
+         * @param records   Number of log records that trigger a checkpoint, 0 to only use the time
+         */
+        void start_checkpoints(std::chrono::milliseconds interval, uint64_t records = 0)
+        {
+            stop_checkpoints();
+            m_stop = false;
+            m_checkpoint_records = records;
+            m_checkpointer = std::thread([this, interval]() {
+                std::unique_lock<std::mutex> lock(m_checkpointer_mutex);
+                while (!m_stop)
+                {
+                    m_checkpointer_cv.wait_for(lock, interval);
+                    if (m_stop)
+                        break;
+                    lock.unlock();
+                    std::exception_ptr error;
+                    try
+                    {
+                        checkpoint();
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                    lock.lock();
+                    if (error)
+                        m_checkpoint_error = error;
+                }
+            });
+        }
+
+        void stop_checkpoints()
+        {
+            if (!m_checkpointer.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(m_checkpointer_mutex);
+                m_stop = true;
+            }
+            m_checkpointer_cv.notify_one();
+            m_checkpointer.join();
+        }
+
+        uint64_t checkpoint_lsn() const
+        {
+            return m_checkpoint_lsn;
+        }
+
+        uint64_t last_lsn()
+        {
+            return m_log.last_lsn();
+        }
+
+        //! Number of log records that failed when replayed at the opening
+        uint64_t skipped_records() const
+        {
+            return m_skipped_records;
+        }
+    };
+
+}
+
+#endif
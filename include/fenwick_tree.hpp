@@ -0,0 +1,117 @@
+/*
+ * fenwick_tree.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_FENWICK_TREE_HPP
+#define RING_FENWICK_TREE_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ring {
+
+    /**
+     * Fenwick tree (binary indexed tree) over a sequence of counts. Prefix sums,
+     * updates and the search of a prefix sum take O(log n) accesses to a plain
+     * array, and appending a count is O(log n) too. The queries do not modify
+     * it, so it can be read by several threads.
+     */
+    class fenwick_tree {
+
+    public:
+        typedef uint64_t size_type;
+        typedef uint64_t value_type;
+
+    private:
+        std::vector<value_type> m_tree; //1-based, m_tree[0] is not used
+        size_type m_top = 0; //Largest power of two <= size
+
+        void update_top(){
+            m_top = 1;
+            while(2 * m_top <= size()) m_top *= 2;
+            if(size() == 0) m_top = 0;
+        }
+
+    public:
+
+        fenwick_tree() : m_tree(1, 0) {}
+
+        //! Builds the tree over the given counts in linear time
+        explicit fenwick_tree(const std::vector<value_type> &counts){
+            build(counts);
+        }
+
+        void build(const std::vector<value_type> &counts){
+            m_tree.assign(counts.size() + 1, 0);
+            for(size_type i = 1; i <= counts.size(); ++i){
+                m_tree[i] += counts[i - 1];
+                size_type parent = i + (i & -i);
+                if(parent <= counts.size()) m_tree[parent] += m_tree[i];
+            }
+            update_top();
+        }
+
+        inline size_type size() const {
+            return m_tree.size() - 1;
+        }
+
+        //! Sum of the first m counts
+        inline value_type prefix(size_type m) const {
+            value_type sum = 0;
+            for(; m > 0; m &= m - 1) sum += m_tree[m];
+            return sum;
+        }
+
+        //! Adds delta to the i-th count (0-based)
+        inline void add(size_type i, const int64_t delta){
+            for(++i; i < m_tree.size(); i += i & -i) m_tree[i] += delta;
+        }
+
+        //! Appends a count
+        void push_back(const value_type c){
+            size_type i = m_tree.size();
+            //m_tree[i] covers the counts (i - lowbit(i), i]
+            m_tree.push_back(c + prefix(i - 1) - prefix(i - (i & -i)));
+            update_top();
+        }
+
+        //! Largest m such that the sum of the first m counts is <= x
+        size_type upper(value_type x) const {
+            size_type pos = 0;
+            for(size_type step = m_top; step > 0; step >>= 1){
+                if(pos + step <= size() && m_tree[pos + step] <= x){
+                    pos += step;
+                    x -= m_tree[pos];
+                }
+            }
+            return pos;
+        }
+
+        size_type bit_size() const {
+            return m_tree.capacity() * 8 * sizeof(value_type);
+        }
+
+        void swap(fenwick_tree &o){
+            std::swap(m_tree, o.m_tree);
+            std::swap(m_top, o.m_top);
+        }
+    };
+}
+
+#endif //RING_FENWICK_TREE_HPP
@@ -26,6 +26,7 @@
 #include <vector>
 #include <utils.hpp>
 #include <unordered_set>
+#include <query_arena.hpp>
 
 namespace ring {
 
@@ -39,37 +40,44 @@ namespace ring {
             typedef cons_t cons_type;
             typedef uint64_t size_type;
             typedef ring_t ring_type;
+            static constexpr size_type max_vars = 256; //var_type has one byte
+            static_assert(sizeof(var_type) == 1, "The tables of the GAO are indexed by var_type");
             typedef struct {
                 var_type name;
                 size_type weight;
                 size_type n_triples;
-                std::unordered_set<var_type> related;
+                uint64_t related[max_vars / 64]; //bitmap of the variables sharing a triple pattern with it
             } info_var_type;
 
-            typedef ltj_iterator<ring_type, var_type, cons_type> ltj_iter_type;
+            typedef typename ltj_iterator_of<ring_type, var_type, cons_type>::type ltj_iter_type;
+            typedef std::vector<ltj_iter_type, arena_allocator<ltj_iter_type>> iterators_type;
+            typedef std::vector<var_type, arena_allocator<var_type>> gao_type;
             typedef std::pair<size_type, var_type> pair_type;
-            typedef std::priority_queue<pair_type, std::vector<pair_type>, greater<pair_type>> min_heap_type;
 
         private:
             const std::vector<triple_pattern>* m_ptr_triple_patterns;
-            const std::vector<ltj_iter_type>* m_ptr_iterators;
+            const iterators_type* m_ptr_iterators;
             ring_type* m_ptr_ring;
+            //The tables live in the object, so computing the GAO does not allocate
+            info_var_type m_var_info[max_vars];
+            size_type m_n_vars = 0;
+            size_type m_position[max_vars]; //position of each variable in m_var_info
+            bool m_seen[max_vars];
+            pair_type m_heap[max_vars]; //min-heap, each variable is pushed at most once
 
 
-            void var_to_vector(const var_type var, const size_type size,
-                               std::unordered_map<var_type, size_type> &hash_table,
-                               std::vector<info_var_type> &vec){
+            void var_to_vector(const var_type var, const size_type size){
 
-                auto it = hash_table.find(var);
-                if(it == hash_table.end()){
-                    info_var_type info;
+                if(!m_seen[var]){
+                    m_seen[var] = true;
+                    info_var_type& info = m_var_info[m_n_vars];
                     info.name = var;
                     info.weight = size;
                     info.n_triples = 1;
-                    vec.emplace_back(info);
-                    hash_table.insert({var, vec.size()-1});
+                    std::fill(info.related, info.related + max_vars / 64, 0);
+                    m_position[var] = m_n_vars++;
                 }else{
-                    info_var_type& info = vec[it->second];
+                    info_var_type& info = m_var_info[m_position[var]];
                     ++info.n_triples;
                     if(info.weight > size){
                         info.weight = size;
@@ -77,28 +85,26 @@ namespace ring {
                 }
             }
 
-            void var_to_related(const var_type var, const var_type rel,
-                                std::unordered_map<var_type, size_type> &hash_table,
-                                std::vector<info_var_type> &vec){
+            void var_to_related(const var_type var, const var_type rel){
 
-                auto pos_var = hash_table[var];
-                vec[pos_var].related.insert(rel);
-                auto pos_rel = hash_table[rel];
-                vec[pos_rel].related.insert(var);
+                info_var_type& info_var = m_var_info[m_position[var]];
+                info_var.related[rel / 64] |= 1ULL << (rel % 64);
+                info_var_type& info_rel = m_var_info[m_position[rel]];
+                info_rel.related[var / 64] |= 1ULL << (var % 64);
             }
 
-            void fill_heap(const var_type var,
-                           std::unordered_map<var_type, size_type> &hash_table,
-                           std::vector<info_var_type> &vec,
-                           std::vector<bool> &checked,
-                           min_heap_type &heap){
+            void fill_heap(const var_type var, bool* checked, size_type &heap_size){
 
-                auto pos_var = hash_table[var];
-                for(const auto &e : vec[pos_var].related){
-                    auto pos_rel = hash_table[e];
-                    if(!checked[pos_rel] && vec[pos_rel].n_triples > 1){
-                        heap.push({vec[pos_rel].weight, e});
-                        checked[pos_rel] = true;
+                const info_var_type& info = m_var_info[m_position[var]];
+                for(size_type w = 0; w < max_vars / 64; ++w){
+                    for(uint64_t bits = info.related[w]; bits; bits &= bits - 1){
+                        var_type e = (var_type) (w * 64 + __builtin_ctzll(bits));
+                        auto pos_rel = m_position[e];
+                        if(!checked[pos_rel] && m_var_info[pos_rel].n_triples > 1){
+                            m_heap[heap_size++] = {m_var_info[pos_rel].weight, e};
+                            std::push_heap(m_heap, m_heap + heap_size, std::greater<pair_type>());
+                            checked[pos_rel] = true;
+                        }
                     }
                 }
             }
@@ -120,60 +126,96 @@ namespace ring {
         public:
 
 
+            /**
+             * @param triple_patterns   Triple patterns of the query
+             * @param iterators         Their iterators, one per triple pattern
+             * @param r                 Ring
+             * @param gao               Result, the variables in the order of the join
+             * @param arena             Arena for the temporary arrays, the heap if it is null
+             */
             gao_size(const std::vector<triple_pattern>* triple_patterns,
-                        const std::vector<ltj_iter_type>* iterators,
+                        const iterators_type* iterators,
                         ring_type* r,
-                        std::vector<var_type> &gao){
+                        gao_type &gao,
+                        query_arena* arena = nullptr){
                 m_ptr_triple_patterns = triple_patterns;
                 m_ptr_iterators = iterators;
                 m_ptr_ring = r;
+                std::fill(m_seen, m_seen + max_vars, false);
 
 
                 //1. Filling var_info with data about each variable
                 //std::cout << "Filling... " << std::flush;
-                std::vector<info_var_type> var_info;
-                std::unordered_map<var_type, size_type> hash_table_position;
+                const stats_catalog &stats = m_ptr_ring->stats();
+                //Constant predicates of the patterns of each subject variable
+                std::vector<std::pair<var_type, uint64_t>, arena_allocator<std::pair<var_type, uint64_t>>>
+                        star_predicates{arena_allocator<std::pair<var_type, uint64_t>>(arena)};
+                if(stats.enabled()) star_predicates.reserve(m_ptr_triple_patterns->size());
                 size_type i = 0;
                 for (const triple_pattern& triple_pattern : *m_ptr_triple_patterns) {
-                    size_type size = util::get_size_interval(m_ptr_iterators->at(i));
+                    size_type size = util::get_size_interval((*m_ptr_iterators)[i]);
+                    //The interval counts triples, the statistics give the distinct values
+                    size_type size_s = size, size_o = size;
+                    if(stats.enabled() && !triple_pattern.p_is_variable()){
+                        auto ps = stats.predicate(triple_pattern.term_p.value);
+                        if(triple_pattern.o_is_variable()) size_s = std::min(size, ps.distinct_s);
+                        if(triple_pattern.s_is_variable()) size_o = std::min(size, ps.distinct_o);
+                        if(triple_pattern.s_is_variable()){
+                            star_predicates.emplace_back((var_type) triple_pattern.term_s.value, triple_pattern.term_p.value);
+                        }
+                    }
                     bool s = false, p = false, o = false;
                     var_type var_s, var_p, var_o;
                     if(triple_pattern.s_is_variable()){
                         s = true;
                         var_s = (var_type) triple_pattern.term_s.value;
-                        var_to_vector(var_s, size,hash_table_position, var_info);
+                        var_to_vector(var_s, size_s);
                     }
                     if(triple_pattern.p_is_variable()){
                         p = true;
                         var_p = (var_type) triple_pattern.term_p.value;
-                        var_to_vector(var_p, size,hash_table_position, var_info);
+                        var_to_vector(var_p, size);
                     }
                     if(triple_pattern.o_is_variable()){
                         o = true;
                         var_o = triple_pattern.term_o.value;
-                        var_to_vector(var_o, size,hash_table_position, var_info);
+                        var_to_vector(var_o, size_o);
                     }
 
                     if(s && p){
-                        var_to_related(var_s, var_p, hash_table_position, var_info);
+                        var_to_related(var_s, var_p);
                     }
                     if(s && o){
-                        var_to_related(var_s, var_o, hash_table_position, var_info);
+                        var_to_related(var_s, var_o);
                     }
                     if(p && o){
-                        var_to_related(var_p, var_o, hash_table_position, var_info);
+                        var_to_related(var_p, var_o);
                     }
                     ++i;
                 }
+                //Subjects of stars: the characteristic sets give the subjects with all their predicates
+                std::sort(star_predicates.begin(), star_predicates.end());
+                star_predicates.erase(std::unique(star_predicates.begin(), star_predicates.end()), star_predicates.end());
+                std::vector<uint64_t, arena_allocator<uint64_t>> predicates{arena_allocator<uint64_t>(arena)};
+                predicates.reserve(star_predicates.size());
+                for(const auto &e : star_predicates) predicates.push_back(e.second);
+                for(size_type first = 0, last; first < star_predicates.size(); first = last){
+                    for(last = first; last < star_predicates.size()
+                                      && star_predicates[last].first == star_predicates[first].first; ++last);
+                    if(last - first < 2) continue;
+                    info_var_type& info = m_var_info[m_position[star_predicates[first].first]];
+                    info.weight = std::min(info.weight, stats.subjects_with(predicates.begin() + first,
+                                                                            predicates.begin() + last));
+                }
                 //std::cout << "Done. " << std::endl;
 
                 //2. Sorting variables according to their weights.
                 //std::cout << "Sorting... " << std::flush;
-                std::sort(var_info.begin(), var_info.end(), compare_var_info());
-                size_type lonely_start = var_info.size();
-                for(i = 0; i < var_info.size(); ++i){
-                    hash_table_position[var_info[i].name] = i;
-                    if(var_info[i].n_triples == 1 && i < lonely_start){
+                std::sort(m_var_info, m_var_info + m_n_vars, compare_var_info());
+                size_type lonely_start = m_n_vars;
+                for(i = 0; i < m_n_vars; ++i){
+                    m_position[m_var_info[i].name] = i;
+                    if(m_var_info[i].n_triples == 1 && i < lonely_start){
                         lonely_start = i;
                     }
                 }
@@ -182,26 +224,28 @@ namespace ring {
                 //3. Choosing the variables
                 i = 0;
                 //std::cout << "Choosing GAO ... " << std::flush;
-                std::vector<bool> checked(var_info.size(), false);
-                gao.reserve(var_info.size());
+                bool checked[max_vars];
+                std::fill(checked, checked + m_n_vars, false);
+                gao.reserve(m_n_vars);
                 while(i < lonely_start){ //Related variables
                     if(!checked[i]){
-                        gao.push_back(var_info[i].name); //Adding var to gao
+                        gao.push_back(m_var_info[i].name); //Adding var to gao
                         checked[i] = true;
-                        min_heap_type heap; //Stores the related variables that are related with the chosen ones
-                        auto var_name = var_info[i].name;
-                        fill_heap(var_name, hash_table_position, var_info, checked,heap);
-                        while(!heap.empty()){
-                            var_name = heap.top().second;
-                            heap.pop();
+                        size_type heap_size = 0; //Stores the related variables that are related with the chosen ones
+                        auto var_name = m_var_info[i].name;
+                        fill_heap(var_name, checked, heap_size);
+                        while(heap_size > 0){
+                            var_name = m_heap[0].second;
+                            std::pop_heap(m_heap, m_heap + heap_size, std::greater<pair_type>());
+                            --heap_size;
                             gao.push_back(var_name);
-                            fill_heap(var_name, hash_table_position, var_info, checked, heap);
+                            fill_heap(var_name, checked, heap_size);
                         }
                     }
                     ++i;
                 }
-                while(i < var_info.size()){ //Lonely variables
-                    gao.push_back(var_info[i].name); //Adding var to gao
+                while(i < m_n_vars){ //Lonely variables
+                    gao.push_back(m_var_info[i].name); //Adding var to gao
                     ++i;
                 }
                 //std::cout << "Done. " << std::endl;
@@ -209,6 +253,214 @@ namespace ring {
 
         };
 
+        /**
+         * Adaptive GAO. The order is not fixed before the join: after each binding the next
+         * variable is the one with the fewest estimated candidates, given the constants already
+         * bound. The estimate of a variable is the smallest interval among its iterators, and
+         * the sizes of the intervals are cached, so after a binding only the iterators of the
+         * bound variable are updated.
+         * As in gao_size, variables related with the bound ones go first and lonely variables
+         * go last. Ties and queries with more than 64 variables follow the static GAO.
+         */
+        template<class ring_t = ring<>, class var_t = uint8_t, class cons_t = uint64_t >
+        class gao_adaptive {
+
+        public:
+            typedef var_t var_type;
+            typedef cons_t cons_type;
+            typedef uint64_t size_type;
+            typedef ring_t ring_type;
+            typedef typename ltj_iterator_of<ring_type, var_type, cons_type>::type ltj_iter_type;
+            typedef std::vector<ltj_iter_type, arena_allocator<ltj_iter_type>> iterators_type;
+            typedef std::vector<var_type, arena_allocator<var_type>> gao_type;
+            typedef std::vector<size_type, arena_allocator<size_type>> sizes_type;
+            static constexpr size_type max_vars = 256; //var_type has one byte
+            static_assert(sizeof(var_type) == 1, "The tables of the GAO are indexed by var_type");
+            typedef struct {
+                var_type name;
+                size_type begin; //its iterators are m_var_iterators[begin, end)
+                size_type end;
+                uint64_t related; //bitmap of the variables sharing a triple pattern with it
+                bool lonely;
+            } info_var_type;
+
+        private:
+            iterators_type* m_ptr_iterators;
+            std::vector<info_var_type, arena_allocator<info_var_type>> m_vars; //sorted as in the static GAO
+            sizes_type m_var_iterators; //positions of the iterators of each variable
+            sizes_type m_sizes; //size of the interval of each iterator
+            //State before binding each depth, m_max_iterators per depth
+            iterators_type m_saved_iterators;
+            sizes_type m_saved_sizes;
+            sizes_type m_n_saved; //number of iterators saved at each depth
+            size_type m_max_iterators = 0;
+            uint64_t m_bound = 0;
+            bool m_static = false;
+
+            inline size_type estimate(const info_var_type &info) const {
+                size_type size = -1ULL;
+                for(size_type k = info.begin; k < info.end; ++k){
+                    if(m_sizes[m_var_iterators[k]] < size) size = m_sizes[m_var_iterators[k]];
+                }
+                return size;
+            }
+
+        public:
+
+            gao_adaptive() = default;
+
+            /**
+             * @param triple_patterns   Triple patterns of the query
+             * @param iterators         Their iterators, one per triple pattern
+             * @param gao               Static GAO of the query, used for breaking ties
+             * @param arena             Arena for the tables, the heap if it is null. It has
+             *                          to outlive the gao_adaptive.
+             */
+            gao_adaptive(const std::vector<triple_pattern>* triple_patterns,
+                         iterators_type* iterators,
+                         const gao_type &gao,
+                         query_arena* arena = nullptr)
+                    : m_vars(arena_allocator<info_var_type>(arena)),
+                      m_var_iterators(arena_allocator<size_type>(arena)),
+                      m_sizes(arena_allocator<size_type>(arena)),
+                      m_saved_iterators(arena_allocator<ltj_iter_type>(arena)),
+                      m_saved_sizes(arena_allocator<size_type>(arena)),
+                      m_n_saved(arena_allocator<size_type>(arena)) {
+                m_ptr_iterators = iterators;
+                m_static = gao.size() > 64;
+
+                size_type position[max_vars];
+                m_vars.resize(gao.size());
+                for(size_type v = 0; v < gao.size(); ++v){
+                    m_vars[v].name = gao[v];
+                    m_vars[v].begin = m_vars[v].end = 0;
+                    m_vars[v].related = 0;
+                    position[gao[v]] = v;
+                }
+                //Counting the iterators of each variable, and then placing them
+                for (const triple_pattern& triple_pattern : *triple_patterns) {
+                    if(triple_pattern.s_is_variable()) ++m_vars[position[triple_pattern.term_s.value]].end;
+                    if(triple_pattern.p_is_variable()) ++m_vars[position[triple_pattern.term_p.value]].end;
+                    if(triple_pattern.o_is_variable()) ++m_vars[position[triple_pattern.term_o.value]].end;
+                }
+                size_type total = 0;
+                for(auto &info : m_vars){
+                    info.lonely = info.end == 1;
+                    if(info.end > m_max_iterators) m_max_iterators = info.end;
+                    info.begin = total;
+                    total += info.end;
+                    info.end = info.begin;
+                }
+                m_var_iterators.resize(total);
+                size_type i = 0;
+                for (const triple_pattern& triple_pattern : *triple_patterns) {
+                    size_type vars[3], n = 0;
+                    if(triple_pattern.s_is_variable()) vars[n++] = position[triple_pattern.term_s.value];
+                    if(triple_pattern.p_is_variable()) vars[n++] = position[triple_pattern.term_p.value];
+                    if(triple_pattern.o_is_variable()) vars[n++] = position[triple_pattern.term_o.value];
+                    for(size_type a = 0; a < n; ++a){
+                        info_var_type &info = m_vars[vars[a]];
+                        m_var_iterators[info.end++] = i;
+                        for(size_type b = 0; b < n; ++b){
+                            if(vars[b] != vars[a] && vars[b] < 64) info.related |= (1ULL << vars[b]);
+                        }
+                    }
+                    ++i;
+                }
+
+                m_sizes.resize(m_ptr_iterators->size());
+                for(i = 0; i < m_sizes.size(); ++i){
+                    m_sizes[i] = util::get_size_interval(m_ptr_iterators->at(i));
+                }
+                m_saved_iterators.resize(m_vars.size() * m_max_iterators);
+                m_saved_sizes.resize(m_vars.size() * m_max_iterators);
+                m_n_saved.resize(m_vars.size());
+            }
+
+            //! Number of variables
+            inline size_type size() const {
+                return m_vars.size();
+            }
+
+            inline const info_var_type &var(const size_type v) const {
+                return m_vars[v];
+            }
+
+            /**
+             * Chooses the variable to bind at the given depth.
+             *
+             * @param depth     Number of bound variables
+             * @return          Position of the variable (in the static GAO)
+             */
+            size_type choose(const size_type depth) const {
+                if(m_static) return depth;
+                size_type best = m_vars.size(), lonely = m_vars.size();
+                size_type best_size = -1ULL;
+                bool best_related = false;
+                for(size_type v = 0; v < m_vars.size(); ++v){
+                    if(m_bound & (1ULL << v)) continue;
+                    const info_var_type &info = m_vars[v];
+                    if(info.lonely){
+                        if(lonely == m_vars.size()) lonely = v;
+                        continue;
+                    }
+                    bool related = (info.related & m_bound) != 0;
+                    if(related < best_related) continue;
+                    size_type size = estimate(info);
+                    if(related > best_related || size < best_size){
+                        best = v;
+                        best_size = size;
+                        best_related = related;
+                    }
+                }
+                return (best < m_vars.size()) ? best : lonely;
+            }
+
+            /**
+             * Goes down in the iterators of a variable, saving their previous state.
+             *
+             * @param v         Position of the variable
+             * @param depth     Number of bound variables
+             * @param c         Constant bound to the variable
+             * @param only_first Only the first iterator (lonely variables in the last level)
+             */
+            void bind(const size_type v, const size_type depth, const cons_type c, const bool only_first = false){
+                const info_var_type &info = m_vars[v];
+                size_type first = depth * m_max_iterators;
+                size_type n = only_first ? 1 : info.end - info.begin;
+                for(size_type k = 0; k < n; ++k){
+                    size_type it = m_var_iterators[info.begin + k];
+                    ltj_iter_type &iter = (*m_ptr_iterators)[it];
+                    m_saved_iterators[first + k] = iter;
+                    m_saved_sizes[first + k] = m_sizes[it];
+                    iter.down(info.name, c);
+                    m_sizes[it] = util::get_size_interval(iter);
+                }
+                m_n_saved[depth] = n;
+                if(v < 64) m_bound |= (1ULL << v);
+            }
+
+            /**
+             * Restores the iterators of a variable to their state before bind. Unlike up,
+             * the intervals are also restored, as the following bindings may follow a
+             * different order.
+             *
+             * @param v         Position of the variable
+             * @param depth     Number of bound variables
+             */
+            void unbind(const size_type v, const size_type depth){
+                const info_var_type &info = m_vars[v];
+                size_type first = depth * m_max_iterators;
+                for(size_type k = 0; k < m_n_saved[depth]; ++k){
+                    size_type it = m_var_iterators[info.begin + k];
+                    (*m_ptr_iterators)[it] = m_saved_iterators[first + k];
+                    m_sizes[it] = m_saved_sizes[first + k];
+                }
+                if(v < 64) m_bound &= ~(1ULL << v);
+            }
+
+        };
+
     }
 }
 
@@ -0,0 +1,297 @@
+/*
+ * hash_index.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_INDEX_HPP
+#define HASH_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "mapped_file.hpp"
+
+namespace ring
+{
+
+  /**
+   * @brief 64-bit fingerprint of s[0, n). It does not depend on the platform,
+   * so the fingerprints can be serialized.
+   */
+  inline uint64_t fingerprint(const char *s, uint64_t n)
+  {
+    const uint64_t k = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = n * k;
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      uint64_t w;
+      std::memcpy(&w, s + i, 8);
+      w *= 0xff51afd7ed558ccdULL;
+      w ^= w >> 32;
+      h = (h ^ w) * k;
+    }
+    if (i < n)
+    {
+      uint64_t w = 0;
+      std::memcpy(&w, s + i, n - i);
+      w *= 0xff51afd7ed558ccdULL;
+      w ^= w >> 32;
+      h = (h ^ w) * k;
+    }
+    // Finalizer of MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /**
+   * @brief Hash table from the fingerprints of the words of a dictionary to their IDs.
+   * It has no words, so the caller verifies the candidate IDs against its PFCs.
+   *
+   * Each slot is a 64-bit word with the upper 32 bits of the fingerprint and the
+   * 32-bit ID (as in the triples of the ring). The home slot of a fingerprint is
+   * taken from those 32 bits, so the table can be grown without the words. It
+   * uses linear probing over any number of slots, and it is built with a load
+   * of 0.8, about 10 bytes per ID.
+   *
+   * The table is a single block of words, so when it is loaded from a
+   * mapped_streambuf it is used in place (see dict_mapped). The first update of
+   * a mapped table copies it to the heap.
+   */
+  class hash_index
+  {
+  public:
+    /**
+     * @brief Gets the ID of a word
+     *
+     * @param fp     The fingerprint of the word
+     * @param verify Called with the candidate IDs, true if the ID is the one of the word
+     * @return uint64_t The ID or 0 if the word is not in the table
+     */
+    template <class verify_t>
+    uint64_t find(uint64_t fp, verify_t verify) const
+    {
+      if (m_capacity == 0)
+        return 0;
+      const uint64_t *s = slots();
+      const uint32_t key = fp >> 32;
+      for (uint64_t i = home(key);; i = next(i))
+      {
+        uint32_t id = s[i];
+        if (id == empty)
+          return 0;
+        if (id != deleted && (uint32_t)(s[i] >> 32) == key && verify(id))
+          return id;
+      }
+    }
+
+    /**
+     * @brief Adds an ID, its word can not be in the table
+     *
+     * @param fp The fingerprint of the word
+     * @param id The ID of the word
+     */
+    void insert(uint64_t fp, uint64_t id)
+    {
+      if (id == empty || id >= deleted)
+        throw std::invalid_argument("ID out of the range of the hash index");
+      if (8 * (m_size + m_deleted + 1) > 7 * m_capacity)
+        rehash(m_size + 1 + (m_size + 1) / 2);
+      own();
+      const uint32_t key = fp >> 32;
+      uint64_t i = home(key);
+      while ((uint32_t)m_data[i] != empty && (uint32_t)m_data[i] != deleted)
+        i = next(i);
+      if ((uint32_t)m_data[i] == deleted)
+        m_deleted--;
+      m_data[i] = ((uint64_t)key << 32) | id;
+      m_size++;
+    }
+
+    /**
+     * @brief Removes an ID
+     *
+     * @param fp The fingerprint of its word
+     * @param id The ID
+     */
+    void erase(uint64_t fp, uint64_t id)
+    {
+      if (m_capacity == 0)
+        return;
+      own();
+      const uint32_t key = fp >> 32;
+      for (uint64_t i = home(key); (uint32_t)m_data[i] != empty; i = next(i))
+      {
+        if (m_data[i] == (((uint64_t)key << 32) | id))
+        {
+          m_data[i] = deleted;
+          m_size--;
+          m_deleted++;
+          return;
+        }
+      }
+    }
+
+    //! Empties the table and reserves space for n IDs
+    void reset(uint64_t n)
+    {
+      clear();
+      rehash(n);
+    }
+
+    void clear()
+    {
+      std::vector<uint64_t>().swap(m_data);
+      m_mapped = nullptr;
+      m_capacity = m_size = m_deleted = 0;
+    }
+
+    uint64_t size() const
+    {
+      return m_size;
+    }
+
+    //! False until the table is reset or loaded
+    bool enabled() const
+    {
+      return m_capacity > 0;
+    }
+
+    //! True if the slots are used from a mapped file
+    bool is_mapped() const
+    {
+      return m_mapped != nullptr;
+    }
+
+    uint64_t serialize(std::ostream &out) const
+    {
+      const uint64_t header[4] = {version, m_capacity, m_size, m_deleted};
+      out.write((const char *)header, sizeof(header));
+      uint64_t pad = padding(out.tellp());
+      const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+      out.write(zeros, pad);
+      out.write((const char *)slots(), m_capacity * sizeof(uint64_t));
+      return sizeof(header) + pad + m_capacity * sizeof(uint64_t);
+    }
+
+    /**
+     * @brief Loads the table, in place if the stream is a mapped_streambuf
+     *
+     * @param in The in stream where the bytes are coming from
+     */
+    void load(std::istream &in)
+    {
+      clear();
+      uint64_t header[4];
+      in.read((char *)header, sizeof(header));
+      if (!in || header[0] != version || header[2] + header[3] > header[1])
+        throw std::runtime_error("Invalid hash index");
+      m_capacity = header[1];
+      m_size = header[2];
+      m_deleted = header[3];
+      in.ignore(padding(in.tellg()));
+      auto *buf = dynamic_cast<mapped_streambuf *>(in.rdbuf());
+      if (buf != nullptr && buf->remaining() >= m_capacity * sizeof(uint64_t))
+      {
+        m_mapped = (const uint64_t *)buf->current();
+        buf->advance(m_capacity * sizeof(uint64_t));
+        return;
+      }
+      m_data.resize(m_capacity);
+      in.read((char *)m_data.data(), m_capacity * sizeof(uint64_t));
+      if (!in)
+        throw std::runtime_error("Invalid hash index");
+    }
+
+    size_t bit_size() const
+    {
+      return 8 * (sizeof(*this) + m_capacity * sizeof(uint64_t));
+    }
+
+  private:
+    static constexpr uint32_t empty = 0;
+    static constexpr uint32_t deleted = UINT32_MAX;
+    static constexpr uint64_t version = 2;
+
+    std::vector<uint64_t> m_data;        // Empty when the slots are mapped
+    const uint64_t *m_mapped = nullptr;  // The mapped slots
+    uint64_t m_capacity = 0, m_size = 0, m_deleted = 0;
+
+    const uint64_t *slots() const
+    {
+      return m_mapped ? m_mapped : m_data.data();
+    }
+
+    uint64_t home(uint32_t key) const
+    {
+      return ((uint64_t)key * m_capacity) >> 32;
+    }
+
+    uint64_t next(uint64_t i) const
+    {
+      return (i + 1 == m_capacity) ? 0 : i + 1;
+    }
+
+    // The slots are aligned to 8 bytes with respect to the beginning of the file
+    static uint64_t padding(int64_t pos)
+    {
+      return (pos < 0) ? 0 : (8 - pos % 8) % 8;
+    }
+
+    //! Copies the mapped slots to the heap before an update
+    void own()
+    {
+      if (m_mapped)
+      {
+        m_data.assign(m_mapped, m_mapped + m_capacity);
+        m_mapped = nullptr;
+      }
+    }
+
+    //! Moves the IDs to a table with room for n of them at a load of 0.8, dropping the deleted ones
+    void rehash(uint64_t n)
+    {
+      uint64_t capacity = std::max<uint64_t>(16, n + n / 4 + 1);
+      std::vector<uint64_t> data(capacity, empty);
+      const uint64_t *s = slots();
+      std::swap(m_capacity, capacity);
+      for (uint64_t j = 0; j < capacity; j++)
+      {
+        uint32_t id = s[j];
+        if (id == empty || id == deleted)
+          continue;
+        uint64_t i = home(s[j] >> 32);
+        while ((uint32_t)data[i] != empty)
+          i = next(i);
+        data[i] = s[j];
+      }
+      m_data.swap(data);
+      m_mapped = nullptr;
+      m_deleted = 0;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * hybrid_ltj_iterator.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_HYBRID_LTJ_ITERATOR_HPP
+#define RING_HYBRID_LTJ_ITERATOR_HPP
+
+#include <triple_pattern.hpp>
+#include <ltj_iterator.hpp>
+#include <range_values.hpp>
+#include <utils.hpp>
+
+namespace ring {
+
+    /**
+     * Iterator of a triple pattern on a hybrid_ring. It runs an ltj_iterator on
+     * each part of the ring (the base, the inserted triples and the deleted ones)
+     * and leap merges them: a value is reported if it has inserted triples, or
+     * triples in the base that are not all deleted. The deleted triples are a
+     * subset of the base, so the last check compares the sizes of the intervals
+     * of the base and of the deleted triples, and it is only needed for the values
+     * that have deleted triples.
+     *
+     * A part that does not have the value bound to a variable is switched off
+     * until the variable is unbound.
+     */
+    template<class ring_t, class var_t, class cons_t>
+    class hybrid_ltj_iterator {
+
+    public:
+        typedef cons_t value_type;
+        typedef var_t var_type;
+        typedef ring_t ring_type;
+        typedef uint64_t size_type;
+        typedef typename ring_type::base_ring_type base_ring_type;
+        typedef typename ring_type::delta_ring_type delta_ring_type;
+        typedef ltj_iterator<base_ring_type, var_type, value_type> base_iter_type;
+        typedef ltj_iterator<delta_ring_type, var_type, value_type> delta_iter_type;
+
+        //! Size of an interval of the merged parts, what util::get_size_interval reads
+        struct interval_size {
+            size_type n = 0;
+            inline size_type size() const { return n; }
+        };
+
+    private:
+        enum part_type {base = 0, inserted = 1, deleted = 2};
+        static constexpr uint16_t absent = 0xffff; //The part is empty for the whole pattern
+
+        const triple_pattern *m_ptr_triple_pattern;
+        base_iter_type m_base;
+        delta_iter_type m_inserted;
+        delta_iter_type m_deleted;
+        uint16_t m_off[3] = {absent, absent, absent}; //0 if the part is on, otherwise 1 + the variable that switched it off
+        value_type m_cur_s = -1;
+        value_type m_cur_p = -1;
+        value_type m_cur_o = -1;
+        interval_size m_i_s;
+        interval_size m_i_p;
+        interval_size m_i_o;
+        bool m_is_empty = false;
+        //Last leap, to know in down which parts have the value without leaping again
+        var_type m_last_var = 0;
+        value_type m_last = 0;
+        bool m_last_in_base = false;
+        bool m_last_in_inserted = false;
+
+        void copy(const hybrid_ltj_iterator &o) {
+            m_ptr_triple_pattern = o.m_ptr_triple_pattern;
+            m_base = o.m_base;
+            m_inserted = o.m_inserted;
+            m_deleted = o.m_deleted;
+            std::copy(o.m_off, o.m_off + 3, m_off);
+            m_cur_s = o.m_cur_s;
+            m_cur_p = o.m_cur_p;
+            m_cur_o = o.m_cur_o;
+            m_i_s = o.m_i_s;
+            m_i_p = o.m_i_p;
+            m_i_o = o.m_i_o;
+            m_is_empty = o.m_is_empty;
+            m_last_var = o.m_last_var;
+            m_last = o.m_last;
+            m_last_in_base = o.m_last_in_base;
+            m_last_in_inserted = o.m_last_in_inserted;
+        }
+
+        inline bool is_variable_subject(var_type var) const {
+            return m_ptr_triple_pattern->term_s.is_variable && var == m_ptr_triple_pattern->term_s.value;
+        }
+
+        inline bool is_variable_predicate(var_type var) const {
+            return m_ptr_triple_pattern->term_p.is_variable && var == m_ptr_triple_pattern->term_p.value;
+        }
+
+        inline bool is_variable_object(var_type var) const {
+            return m_ptr_triple_pattern->term_o.is_variable && var == m_ptr_triple_pattern->term_o.value;
+        }
+
+        inline bool on(const part_type k) const {
+            return m_off[k] == 0;
+        }
+
+        template<class iter_t>
+        static inline value_type leap_part(iter_t &iter, const var_type var, const value_type c) {
+            return c == (value_type) -1 ? iter.leap(var) : iter.leap(var, c);
+        }
+
+        //The triples of the base with var = c are all deleted
+        bool deleted_in_base(const var_type var, const value_type c) {
+            if (!on(deleted) || m_deleted.leap(var, c) != c) return false;
+            if (in_last_level()) return true; //A single triple
+            base_iter_type b(m_base);
+            delta_iter_type d(m_deleted);
+            b.down(var, c);
+            d.down(var, c);
+            return util::get_size_interval(b) == util::get_size_interval(d);
+        }
+
+        //Smallest value >= c of the merged parts, c = -1 for the minimum
+        value_type merged_leap(const var_type var, const value_type c) {
+            value_type i = on(inserted) ? leap_part(m_inserted, var, c) : 0;
+            value_type b = on(base) ? leap_part(m_base, var, c) : 0;
+            while (b != 0 && (i == 0 || b < i) && deleted_in_base(var, b)) {
+                b = m_base.leap(var, b + 1);
+            }
+            m_last_var = var;
+            if (b != 0 && (i == 0 || b < i)) {
+                m_last = b;
+                m_last_in_base = true;
+                m_last_in_inserted = false;
+            } else {
+                m_last = i;
+                m_last_in_base = i != 0 && b == i;
+                m_last_in_inserted = i != 0;
+            }
+            return m_last;
+        }
+
+        void update_sizes() {
+            size_type s = 0, p = 0, o = 0;
+            if (on(base)) {
+                s += m_base.i_s.size();
+                p += m_base.i_p.size();
+                o += m_base.i_o.size();
+            }
+            if (on(inserted)) {
+                s += m_inserted.i_s.size();
+                p += m_inserted.i_p.size();
+                o += m_inserted.i_o.size();
+            }
+            if (on(deleted)) { //Subset of the base
+                s -= std::min(s, (size_type) m_deleted.i_s.size());
+                p -= std::min(p, (size_type) m_deleted.i_p.size());
+                o -= std::min(o, (size_type) m_deleted.i_o.size());
+            }
+            m_i_s.n = s;
+            m_i_p.n = p;
+            m_i_o.n = o;
+        }
+
+    public:
+        const bool &is_empty = m_is_empty;
+        const interval_size &i_s = m_i_s;
+        const interval_size &i_p = m_i_p;
+        const interval_size &i_o = m_i_o;
+        const value_type &cur_s = m_cur_s;
+        const value_type &cur_p = m_cur_p;
+        const value_type &cur_o = m_cur_o;
+
+        hybrid_ltj_iterator() = default;
+
+        hybrid_ltj_iterator(const triple_pattern *triple, ring_type *ring) {
+            m_ptr_triple_pattern = triple;
+            if (ring->base() != nullptr) {
+                m_base = base_iter_type(triple, ring->base());
+                if (!m_base.is_empty) m_off[base] = 0;
+            }
+            if (ring->inserted() != nullptr) {
+                m_inserted = delta_iter_type(triple, ring->inserted());
+                if (!m_inserted.is_empty) m_off[inserted] = 0;
+            }
+            if (ring->deleted() != nullptr) {
+                m_deleted = delta_iter_type(triple, ring->deleted());
+                if (!m_deleted.is_empty) m_off[deleted] = 0;
+            }
+            if (!triple->s_is_variable()) m_cur_s = triple->term_s.value;
+            if (!triple->p_is_variable()) m_cur_p = triple->term_p.value;
+            if (!triple->o_is_variable()) m_cur_o = triple->term_o.value;
+            if (!triple->s_is_variable() && !triple->p_is_variable() && !triple->o_is_variable()) {
+                //The iterator of each part says if it has the triple
+                m_is_empty = !on(inserted) && (!on(base) || on(deleted));
+            } else {
+                update_sizes();
+                m_is_empty = util::get_size_interval(*this) == 0;
+            }
+        }
+
+        //! Copy constructor
+        hybrid_ltj_iterator(const hybrid_ltj_iterator &o) {
+            copy(o);
+        }
+
+        //! Move constructor
+        hybrid_ltj_iterator(hybrid_ltj_iterator &&o) {
+            *this = std::move(o);
+        }
+
+        //! Copy Operator=
+        hybrid_ltj_iterator &operator=(const hybrid_ltj_iterator &o) {
+            if (this != &o) {
+                copy(o);
+            }
+            return *this;
+        }
+
+        //! Move Operator=
+        hybrid_ltj_iterator &operator=(hybrid_ltj_iterator &&o) {
+            if (this != &o) {
+                copy(o);
+            }
+            return *this;
+        }
+
+        void swap(hybrid_ltj_iterator &o) {
+            hybrid_ltj_iterator tmp(o);
+            o = *this;
+            *this = tmp;
+        }
+
+        void down(var_type var, size_type c) { //Go down in the trie
+            bool in_base, in_inserted;
+            if (var == m_last_var && c == m_last) {
+                in_base = m_last_in_base;
+                in_inserted = m_last_in_inserted;
+            } else {
+                in_base = on(base) && m_base.leap(var, c) == c;
+                in_inserted = on(inserted) && m_inserted.leap(var, c) == c;
+            }
+            bool in_deleted = in_base && on(deleted) && m_deleted.leap(var, c) == c;
+            m_last = 0;
+            if (on(base)) {
+                if (in_base) m_base.down(var, c);
+                else m_off[base] = var + 1;
+            }
+            if (on(inserted)) {
+                if (in_inserted) m_inserted.down(var, c);
+                else m_off[inserted] = var + 1;
+            }
+            if (on(deleted)) {
+                if (in_deleted) m_deleted.down(var, c);
+                else m_off[deleted] = var + 1;
+            }
+            if (is_variable_subject(var)) {
+                m_cur_s = c;
+            } else if (is_variable_predicate(var)) {
+                m_cur_p = c;
+            } else if (is_variable_object(var)) {
+                m_cur_o = c;
+            }
+            update_sizes();
+        };
+
+        void up(var_type var) { //Go up in the trie
+            if (on(base)) m_base.up(var);
+            else if (m_off[base] == var + 1) m_off[base] = 0;
+            if (on(inserted)) m_inserted.up(var);
+            else if (m_off[inserted] == var + 1) m_off[inserted] = 0;
+            if (on(deleted)) m_deleted.up(var);
+            else if (m_off[deleted] == var + 1) m_off[deleted] = 0;
+            m_last = 0;
+            if (is_variable_subject(var)) {
+                m_cur_s = -1;
+            } else if (is_variable_predicate(var)) {
+                m_cur_p = -1;
+            } else if (is_variable_object(var)) {
+                m_cur_o = -1;
+            }
+        };
+
+        value_type leap(var_type var) { //Return the minimum in the range
+            return merged_leap(var, -1);
+        }
+
+        value_type leap(var_type var, size_type c) { //Return the next value greater or equal than c in the range
+            return merged_leap(var, c);
+        }
+
+        bool in_last_level() {
+            return (m_cur_o != -1 && m_cur_p != -1) || (m_cur_s != -1 && m_cur_p != -1)
+                   || (m_cur_o != -1 && m_cur_s != -1);
+        }
+
+        std::vector<uint64_t> seek_all(var_type var) {
+            range_values res;
+            res.with_counts = false;
+            seek_all(var, res);
+            return std::vector<uint64_t>(res.begin(), res.end());
+        }
+
+        //Values of the last level, written into res without counts
+        void seek_all(var_type var, range_values &res) {
+            if (!on(inserted) && !on(deleted)) {
+                if (on(base)) m_base.seek_all(var, res);
+                else res.clear();
+                return;
+            }
+            res.clear();
+            for (value_type c = leap(var); c != 0; c = leap(var, c + 1)) {
+                if (res.size() == res.values.size()) res.reserve(2 * res.size() + 16);
+                res.push_back(c, 0);
+            }
+        }
+    };
+
+}
+
+#endif //RING_HYBRID_LTJ_ITERATOR_HPP
@@ -0,0 +1,621 @@
+/*
+ * hybrid_ring.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_HYBRID_RING_HPP
+#define RING_HYBRID_RING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+#include "ring.hpp"
+#include "triple_pattern.hpp"
+#include "ltj_iterator.hpp"
+#include "stats_catalog.hpp"
+#include "hybrid_ltj_iterator.hpp"
+
+namespace ring
+{
+
+    /**
+     * Ring made of an immutable static ring (the base) and two small dynamic rings:
+     * the triples inserted after the base was built, and the triples of the base
+     * that have been removed. The queries run on the three of them at once with
+     * hybrid_ltj_iterator, so they are close to the speed of the static ring
+     * while the changes are small.
+     *
+     * When the changes reach a fraction of the base, a compaction builds a new base
+     * with the current triples in a background thread. The updates go on meanwhile
+     * and are applied again on top of the new base when it is installed, which
+     * happens in the next update (or in finish_compaction).
+     *
+     * The base is shared by the copies of the ring, so copying it (as versioned_ring
+     * does) only copies the changes. A compaction in progress is not copied.
+     * Like the dynamic rings, queries cannot run while the ring is being updated.
+     * The compaction reads the base while the queries run, so the base must allow
+     * concurrent queries, as the static rings do.
+     */
+    template <class base_ring_t = ring<>, class delta_ring_t = ring_dyn>
+    class hybrid_ring
+    {
+    public:
+        typedef uint64_t size_type;
+        typedef uint64_t value_type;
+        typedef base_ring_t base_ring_type;
+        typedef delta_ring_t delta_ring_type;
+
+    private:
+        typedef std::pair<bool, spo_triple> update_type; // true if it is an insertion
+
+        std::shared_ptr<base_ring_type> m_base;     // null if there are no triples
+        std::unique_ptr<delta_ring_type> m_inserted; // not in the base, null if empty
+        std::unique_ptr<delta_ring_type> m_deleted;  // subset of the base, null if empty
+        stats_catalog m_stats;
+        size_type m_epoch = 0;
+        std::vector<size_type> m_predicate_epoch;
+        double m_max_changes = 0.01; // compaction threshold, relative to the base
+        size_type m_threads = 1;     // threads building the new bases
+        std::future<std::shared_ptr<base_ring_type>> m_compaction;
+        std::vector<update_type> m_pending; // updates after the start of the compaction
+
+        // Counts the update, records the predicates it touches and keeps the statistics
+        // up to date, as ring::update_scope does
+        struct update_scope
+        {
+            hybrid_ring &r;
+            stats_catalog::update_type u;
+            bool active;
+
+            update_scope(hybrid_ring &_r, const std::vector<spo_triple> &triples) : r(_r), active(_r.m_stats.enabled())
+            {
+                ++r.m_epoch;
+                for (const spo_triple &t : triples)
+                {
+                    uint64_t p = std::get<1>(t);
+                    if (p >= r.m_predicate_epoch.size())
+                        r.m_predicate_epoch.resize(p + 1, 0);
+                    r.m_predicate_epoch[p] = r.m_epoch;
+                }
+                if (active)
+                    r.m_stats.begin_update(r, triples, u);
+            }
+
+            ~update_scope()
+            {
+                if (active)
+                    r.m_stats.end_update(r, u);
+            }
+        };
+
+        void copy(const hybrid_ring &o)
+        {
+            m_base = o.m_base;
+            m_inserted.reset(o.m_inserted ? new delta_ring_type(*o.m_inserted) : nullptr);
+            m_deleted.reset(o.m_deleted ? new delta_ring_type(*o.m_deleted) : nullptr);
+            m_stats = o.m_stats;
+            m_epoch = o.m_epoch;
+            m_predicate_epoch = o.m_predicate_epoch;
+            m_max_changes = o.m_max_changes;
+            m_threads = o.m_threads;
+            m_pending.clear();
+        }
+
+        static size_type size(const std::unique_ptr<delta_ring_type> &r)
+        {
+            return r ? r->n_triples() : 0;
+        }
+
+        bool base_contains(const spo_triple &t)
+        {
+            if (!m_base)
+                return false;
+            triple_pattern tp;
+            tp.const_s(std::get<0>(t));
+            tp.const_p(std::get<1>(t));
+            tp.const_o(std::get<2>(t));
+            ltj_iterator<base_ring_type, uint8_t, uint64_t> iter(&tp, m_base.get());
+            return !iter.is_empty;
+        }
+
+        static bool delta_contains(std::unique_ptr<delta_ring_type> &r, const spo_triple &t)
+        {
+            return r && r->contains(t);
+        }
+
+        static void delta_insert(std::unique_ptr<delta_ring_type> &r, std::vector<spo_triple> &triples)
+        {
+            if (triples.empty())
+                return;
+            if (r)
+                r->insert_batch(triples);
+            else
+                r.reset(new delta_ring_type(triples));
+        }
+
+        static void delta_remove(std::unique_ptr<delta_ring_type> &r, std::vector<spo_triple> &triples)
+        {
+            if (triples.empty())
+                return;
+            r->remove_batch(triples);
+            if (r->n_triples() == 0)
+                r.reset();
+        }
+
+        // Applies the updates to the parts, without the bookkeeping of the public methods
+        void apply_insert(std::vector<spo_triple> &triples)
+        {
+            std::vector<spo_triple> to_insert, to_undelete;
+            for (const spo_triple &t : triples)
+            {
+                if (base_contains(t))
+                {
+                    if (delta_contains(m_deleted, t))
+                        to_undelete.push_back(t);
+                }
+                else if (!delta_contains(m_inserted, t))
+                {
+                    to_insert.push_back(t);
+                }
+            }
+            delta_remove(m_deleted, to_undelete);
+            delta_insert(m_inserted, to_insert);
+        }
+
+        void apply_remove(std::vector<spo_triple> &triples)
+        {
+            std::vector<spo_triple> to_uninsert, to_delete;
+            for (const spo_triple &t : triples)
+            {
+                if (delta_contains(m_inserted, t))
+                    to_uninsert.push_back(t);
+                else if (base_contains(t) && !delta_contains(m_deleted, t))
+                    to_delete.push_back(t);
+            }
+            delta_remove(m_inserted, to_uninsert);
+            delta_insert(m_deleted, to_delete);
+        }
+
+        static void normalize(std::vector<spo_triple> &triples)
+        {
+            std::sort(triples.begin(), triples.end());
+            triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+        }
+
+        // Finishes a compaction that is ready, or starts one if the changes are too many
+        void maintain()
+        {
+            if (m_compaction.valid())
+                finish_compaction(false);
+            else if (needs_compaction())
+                start_compaction();
+        }
+
+        void update(const bool insertion, std::vector<spo_triple> &triples)
+        {
+            normalize(triples);
+            {
+                update_scope su(*this, triples);
+                if (insertion)
+                    apply_insert(triples);
+                else
+                    apply_remove(triples);
+            }
+            if (m_compaction.valid())
+            {
+                for (const spo_triple &t : triples)
+                    m_pending.emplace_back(insertion, t);
+            }
+            maintain();
+        }
+
+    public:
+        hybrid_ring() = default;
+
+        /**
+         * @param base          Static ring with the initial triples
+         * @param max_changes   The changes that start a compaction, as a fraction of the base
+         */
+        explicit hybrid_ring(base_ring_type &&base, const double max_changes = 0.01)
+            : m_base(std::make_shared<base_ring_type>(std::move(base))), m_max_changes(max_changes) {}
+
+        /**
+         * Builds the base with the triples of D, as the constructors of ring.
+         *
+         * @param D         Triples, they are sorted and the repeated ones removed
+         * @param n_threads Threads used to build the base, and the later ones
+         */
+        explicit hybrid_ring(std::vector<spo_triple> &D, const size_type n_threads = 1)
+            : m_threads(std::max<size_type>(n_threads, 1))
+        {
+            normalize(D);
+            if (D.empty())
+                return;
+            if (m_threads > 1)
+                m_base = std::make_shared<base_ring_type>(D, m_threads);
+            else
+                m_base = std::make_shared<base_ring_type>(D);
+        }
+
+        //! Copy constructor, the base is shared
+        hybrid_ring(const hybrid_ring &o)
+        {
+            copy(o);
+        }
+
+        //! Move constructor
+        hybrid_ring(hybrid_ring &&o)
+        {
+            *this = std::move(o);
+        }
+
+        //! Copy Operator=
+        hybrid_ring &operator=(const hybrid_ring &o)
+        {
+            if (this != &o)
+            {
+                copy(o);
+            }
+            return *this;
+        }
+
+        //! Move Operator=
+        hybrid_ring &operator=(hybrid_ring &&o)
+        {
+            if (this != &o)
+            {
+                m_base = std::move(o.m_base);
+                m_inserted = std::move(o.m_inserted);
+                m_deleted = std::move(o.m_deleted);
+                m_stats = std::move(o.m_stats);
+                m_epoch = o.m_epoch;
+                m_predicate_epoch = std::move(o.m_predicate_epoch);
+                m_max_changes = o.m_max_changes;
+                m_threads = o.m_threads;
+                m_compaction = std::move(o.m_compaction);
+                m_pending = std::move(o.m_pending);
+            }
+            return *this;
+        }
+
+        ~hybrid_ring()
+        {
+            if (m_compaction.valid())
+                m_compaction.wait();
+        }
+
+        //! Parts of the ring, for its iterators. They are null when they have no triples
+        base_ring_type *base() { return m_base.get(); }
+        delta_ring_type *inserted() { return m_inserted.get(); }
+        delta_ring_type *deleted() { return m_deleted.get(); }
+
+        size_type n_triples() const
+        {
+            return (m_base ? m_base->n_triples() : 0) + size(m_inserted) - size(m_deleted);
+        }
+
+        //! Number of inserted and deleted triples not merged into the base yet
+        size_type n_changes() const
+        {
+            return size(m_inserted) + size(m_deleted);
+        }
+
+        void insert(spo_triple triple)
+        {
+            std::vector<spo_triple> triples{triple};
+            update(true, triples);
+        }
+
+        void insert_batch(std::vector<spo_triple> &triples)
+        {
+            update(true, triples);
+        }
+
+        void remove_edge(spo_triple triple)
+        {
+            std::vector<spo_triple> triples{triple};
+            update(false, triples);
+        }
+
+        void remove_batch(std::vector<spo_triple> &triples)
+        {
+            update(false, triples);
+        }
+
+        bool contains(spo_triple triple)
+        {
+            if (delta_contains(m_inserted, triple))
+                return true;
+            return base_contains(triple) && !delta_contains(m_deleted, triple);
+        }
+
+        //! Current triples, sorted
+        void triples(std::vector<spo_triple> &D)
+        {
+            D.clear();
+            triple_pattern tp;
+            tp.var_s(0);
+            tp.var_p(1);
+            tp.var_o(2);
+            hybrid_ltj_iterator<hybrid_ring, uint8_t, uint64_t> iter(&tp, this);
+            if (iter.is_empty)
+                return;
+            for (uint64_t s = iter.leap(0); s != 0; s = iter.leap(0, s + 1))
+            {
+                iter.down(0, s);
+                for (uint64_t p = iter.leap(1); p != 0; p = iter.leap(1, p + 1))
+                {
+                    iter.down(1, p);
+                    for (uint64_t o = iter.leap(2); o != 0; o = iter.leap(2, o + 1))
+                        D.emplace_back(s, p, o);
+                    iter.up(1);
+                }
+                iter.up(0);
+            }
+        }
+
+        /**
+         * @param max_changes   The changes that start a compaction, as a fraction of the base. 0 disables them
+         * @param n_threads     Threads used to build the new bases
+         */
+        void set_compaction(const double max_changes, const size_type n_threads = 1)
+        {
+            m_max_changes = max_changes;
+            m_threads = std::max<size_type>(n_threads, 1);
+        }
+
+        bool needs_compaction() const
+        {
+            if (m_max_changes <= 0 || n_changes() == 0)
+                return false;
+            return n_changes() >= m_max_changes * (m_base ? m_base->n_triples() : 0);
+        }
+
+        //! True while a new base is being built
+        bool compacting() const
+        {
+            return m_compaction.valid();
+        }
+
+        /**
+         * Starts building a new base with the current triples in a background thread.
+         * Only the changes are copied here (the base is shared), the triples are
+         * collected and the new base built in the background.
+         *
+         * @return  False if there is already a compaction in progress
+         */
+        bool start_compaction()
+        {
+            if (m_compaction.valid())
+                return false;
+            auto parts = std::make_shared<hybrid_ring>();
+            parts->m_base = m_base;
+            parts->m_inserted.reset(m_inserted ? new delta_ring_type(*m_inserted) : nullptr);
+            parts->m_deleted.reset(m_deleted ? new delta_ring_type(*m_deleted) : nullptr);
+            const size_type n_threads = m_threads;
+            m_pending.clear();
+            m_compaction = std::async(std::launch::async, [parts, n_threads]() mutable {
+                std::vector<spo_triple> D;
+                parts->triples(D);
+                parts.reset();
+                if (D.empty())
+                    return std::shared_ptr<base_ring_type>();
+                if (n_threads > 1)
+                    return std::make_shared<base_ring_type>(D, n_threads);
+                return std::make_shared<base_ring_type>(D);
+            });
+            return true;
+        }
+
+        /**
+         * Installs the base built by start_compaction and applies again the updates
+         * received meanwhile. The triples of the ring do not change.
+         *
+         * @param wait  Waits for the base if it is not ready
+         * @return      True if the new base was installed
+         */
+        bool finish_compaction(const bool wait = true)
+        {
+            if (!m_compaction.valid())
+                return false;
+            if (!wait && m_compaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+            m_base = m_compaction.get();
+            m_inserted.reset();
+            m_deleted.reset();
+            std::vector<spo_triple> batch(1);
+            for (const update_type &u : m_pending)
+            {
+                batch[0] = u.second;
+                if (u.first)
+                    apply_insert(batch);
+                else
+                    apply_remove(batch);
+            }
+            m_pending.clear();
+            return true;
+        }
+
+        //! Builds a new base now with the current triples
+        void compact()
+        {
+            finish_compaction();
+            if (n_changes() == 0)
+                return;
+            start_compaction();
+            finish_compaction();
+        }
+
+        /**
+         * Statistics of the triples for the GAO (see stats_catalog), kept up to date
+         * by the updates like those of ring.
+         */
+        stats_catalog &stats()
+        {
+            return m_stats;
+        }
+
+        const stats_catalog &stats() const
+        {
+            return m_stats;
+        }
+
+        //! Number of updates applied since the ring was built
+        size_type epoch() const
+        {
+            return m_epoch;
+        }
+
+        //! Last update (see epoch) that inserted or removed triples with predicate p, 0 if none
+        size_type predicate_epoch(const uint64_t p) const
+        {
+            return p < m_predicate_epoch.size() ? m_predicate_epoch[p] : 0;
+        }
+
+        //! Predicates of the subject s with the number of triples of each one
+        void subject_profile(uint64_t s, stats_catalog::profile_type &profile)
+        {
+            stats_catalog::profile_type b, i, d;
+            if (m_base)
+                m_base->subject_profile(s, b);
+            if (m_inserted)
+                m_inserted->subject_profile(s, i);
+            if (m_deleted)
+                m_deleted->subject_profile(s, d);
+            // The deleted triples are a subset of the base
+            for (uint64_t k = 0, l = 0; k < b.size(); k++)
+            {
+                while (l < d.size() && d[l].first < b[k].first)
+                    l++;
+                if (l < d.size() && d[l].first == b[k].first)
+                    b[k].second -= d[l].second;
+            }
+            profile.clear();
+            uint64_t k = 0, l = 0;
+            while (k < b.size() || l < i.size())
+            {
+                if (l == i.size() || (k < b.size() && b[k].first < i[l].first))
+                {
+                    if (b[k].second > 0)
+                        profile.push_back(b[k]);
+                    k++;
+                }
+                else if (k == b.size() || i[l].first < b[k].first)
+                {
+                    profile.push_back(i[l++]);
+                }
+                else
+                {
+                    profile.emplace_back(b[k].first, b[k].second + i[l].second);
+                    k++;
+                    l++;
+                }
+            }
+        }
+
+        //! Number of triples with predicate p and object o
+        uint64_t count_PO(uint64_t p, uint64_t o)
+        {
+            uint64_t n = m_base ? m_base->count_PO(p, o) : 0;
+            if (m_deleted)
+                n -= m_deleted->count_PO(p, o);
+            if (m_inserted)
+                n += m_inserted->count_PO(p, o);
+            return n;
+        }
+
+        //! Number of triples with subject s and predicate p
+        uint64_t count_SP(uint64_t s, uint64_t p)
+        {
+            uint64_t n = m_base ? m_base->count_SP(s, p) : 0;
+            if (m_deleted)
+                n -= m_deleted->count_SP(s, p);
+            if (m_inserted)
+                n += m_inserted->count_SP(s, p);
+            return n;
+        }
+
+        //! Serializes the base and the changes. A compaction in progress is not waited for
+        size_type serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name = "")
+        {
+            sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+            size_type written_bytes = 0;
+            uint8_t parts = (m_base ? 1 : 0) | (m_inserted ? 2 : 0) | (m_deleted ? 4 : 0);
+            written_bytes += sdsl::write_member(parts, out, child, "parts");
+            if (m_base)
+                written_bytes += m_base->serialize(out, child, "base");
+            if (m_inserted)
+                written_bytes += m_inserted->serialize(out, child, "inserted");
+            if (m_deleted)
+                written_bytes += m_deleted->serialize(out, child, "deleted");
+            written_bytes += sdsl::write_member(m_max_changes, out, child, "max_changes");
+            sdsl::structure_tree::add_size(child, written_bytes);
+            return written_bytes;
+        }
+
+        void load(std::istream &in)
+        {
+            if (m_compaction.valid())
+                m_compaction.wait();
+            m_compaction = std::future<std::shared_ptr<base_ring_type>>();
+            m_pending.clear();
+            uint8_t parts;
+            sdsl::read_member(parts, in);
+            m_base.reset();
+            m_inserted.reset();
+            m_deleted.reset();
+            if (parts & 1)
+            {
+                m_base = std::make_shared<base_ring_type>();
+                m_base->load(in);
+            }
+            if (parts & 2)
+            {
+                m_inserted.reset(new delta_ring_type());
+                m_inserted->load(in);
+            }
+            if (parts & 4)
+            {
+                m_deleted.reset(new delta_ring_type());
+                m_deleted->load(in);
+            }
+            sdsl::read_member(m_max_changes, in);
+        }
+
+        uint64_t bit_size()
+        {
+            uint64_t bits = m_base ? m_base->bit_size() : 0;
+            if (m_inserted)
+                bits += m_inserted->bit_size();
+            if (m_deleted)
+                bits += m_deleted->bit_size();
+            return bits;
+        }
+    };
+
+    template <class base_ring_t, class delta_ring_t, class var_t, class cons_t>
+    struct ltj_iterator_of<hybrid_ring<base_ring_t, delta_ring_t>, var_t, cons_t>
+    {
+        typedef hybrid_ltj_iterator<hybrid_ring<base_ring_t, delta_ring_t>, var_t, cons_t> type;
+    };
+
+    typedef hybrid_ring<ring<>, ring_dyn> ring_hybrid; // static base with dynamic changes
+}
+
+#endif
@@ -27,6 +27,12 @@
 #include <ring.hpp>
 #include <ltj_iterator.hpp>
 #include <gao.hpp>
+#include <ws_deque.hpp>
+#include <query_arena.hpp>
+#include <continuation.hpp>
+#include <thread>
+#include <atomic>
+#include <array>
 
 namespace ring {
 
@@ -39,18 +45,43 @@ namespace ring {
         typedef var_t var_type;
         typedef ring_t ring_type;
         typedef cons_t const_type;
-        typedef ltj_iterator<ring_type, var_type, const_type> ltj_iter_type;
-        typedef std::unordered_map<var_type, std::vector<ltj_iter_type*>> var_to_iterators_type;
+        typedef typename ltj_iterator_of<ring_type, var_type, const_type>::type ltj_iter_type;
+        typedef std::vector<ltj_iter_type, arena_allocator<ltj_iter_type>> iterators_type;
+        typedef std::vector<var_type, arena_allocator<var_type>> gao_type;
+        static constexpr size_type max_vars = 256; //var_type has one byte
+        static_assert(sizeof(var_type) == 1, "The iterators of the variables are indexed by var_type");
+
+        //! Iterators of a variable, a view of a range of pointers
+        class var_iterators {
+            ltj_iter_type* const* m_first;
+            ltj_iter_type* const* m_last;
+        public:
+            var_iterators(ltj_iter_type* const* first, ltj_iter_type* const* last) : m_first(first), m_last(last) {}
+            inline size_type size() const { return m_last - m_first; }
+            inline ltj_iter_type* operator[](const size_type i) const { return m_first[i]; }
+            inline ltj_iter_type* const* begin() const { return m_first; }
+            inline ltj_iter_type* const* end() const { return m_last; }
+        };
         typedef std::vector<std::pair<var_type, value_type>> tuple_type;
         typedef std::chrono::high_resolution_clock::time_point time_point_type;
+        typedef struct {
+            value_type values[2];
+            size_type depth;
+        } prefix_type; //Bindings of the first (or the first two) variables of the GAO
+        typedef util::ws_deque<prefix_type> deque_type;
+        typedef gao::gao_adaptive<ring_type, var_type, const_type> gao_adaptive_type;
 
     private:
         const std::vector<triple_pattern>* m_ptr_triple_patterns;
-        std::vector<var_type> m_gao; //TODO: should be a class
+        gao_type m_gao; //TODO: should be a class
         ring_type* m_ptr_ring;
-        std::vector<ltj_iter_type> m_iterators;
-        var_to_iterators_type m_var_to_iterators;
+        iterators_type m_iterators;
+        //Iterators of each variable, grouped by variable: those of x are in
+        //m_var_iterators[m_var_begin[x], m_var_begin[x+1])
+        std::vector<ltj_iter_type*, arena_allocator<ltj_iter_type*>> m_var_iterators;
+        std::array<size_type, max_vars + 1> m_var_begin{};
         bool m_is_empty = false;
+        std::vector<range_values, arena_allocator<range_values>> m_values; //Values of the lonely variable of each depth
 
 
         void copy(const ltj_algorithm &o) {
@@ -58,55 +89,91 @@ namespace ring {
             m_gao = o.m_gao;
             m_ptr_ring = o.m_ptr_ring;
             m_iterators = o.m_iterators;
-            m_var_to_iterators = o.m_var_to_iterators;
             m_is_empty = o.m_is_empty;
+            //The buffers are not shared, only their number is copied
+            m_values.clear();
+            m_values.resize(o.m_values.size());
+            for(auto &values : m_values) values.with_counts = false;
+            //The pointers have to point to our own iterators
+            m_var_begin = o.m_var_begin;
+            m_var_iterators.clear();
+            m_var_iterators.reserve(o.m_var_iterators.size());
+            for(ltj_iter_type* ptr : o.m_var_iterators){
+                m_var_iterators.push_back(&m_iterators[ptr - o.m_iterators.data()]);
+            }
         }
 
-
-        inline void add_var_to_iterator(const var_type var, ltj_iter_type* ptr_iterator){
-            auto it =  m_var_to_iterators.find(var);
-            if(it != m_var_to_iterators.end()){
-                it->second.push_back(ptr_iterator);
-            }else{
-                std::vector<ltj_iter_type*> vec = {ptr_iterator};
-                m_var_to_iterators.insert({var, vec});
+        //Calls f(var, iterator) for each variable of each triple pattern
+        template<class func_t>
+        void for_each_var(func_t f){
+            size_type i = 0;
+            for(const auto& triple : *m_ptr_triple_patterns){
+                if(triple.o_is_variable()){
+                    f((var_type) triple.term_o.value, &(m_iterators[i]));
+                }
+                if(triple.p_is_variable()){
+                    f((var_type) triple.term_p.value, &(m_iterators[i]));
+                }
+                if(triple.s_is_variable()){
+                    f((var_type) triple.term_s.value, &(m_iterators[i]));
+                }
+                ++i;
             }
         }
 
+        inline var_iterators iterators(const var_type var) const {
+            return var_iterators(m_var_iterators.data() + m_var_begin[var],
+                                 m_var_iterators.data() + m_var_begin[var + 1]);
+        }
+
     public:
 
 
         ltj_algorithm() = default;
 
-        ltj_algorithm(const std::vector<triple_pattern>* triple_patterns, ring_type* ring){
+        /**
+         * @param triple_patterns   Triple patterns of the query
+         * @param ring              Ring
+         * @param arena             Arena for the structures of the query. It has to outlive the
+         *                          ltj_algorithm, and if it is null they are allocated in the heap.
+         */
+        ltj_algorithm(const std::vector<triple_pattern>* triple_patterns, ring_type* ring,
+                      query_arena* arena = nullptr)
+                : m_gao(arena_allocator<var_type>(arena)),
+                  m_iterators(arena_allocator<ltj_iter_type>(arena)),
+                  m_var_iterators(arena_allocator<ltj_iter_type*>(arena)),
+                  m_values(arena_allocator<range_values>(arena)) {
 
             m_ptr_triple_patterns = triple_patterns;
             m_ptr_ring = ring;
 
-            size_type i = 0;
-            m_iterators.resize(m_ptr_triple_patterns->size());
+            //Building iterators
+            m_iterators.reserve(m_ptr_triple_patterns->size());
             for(const auto& triple : *m_ptr_triple_patterns){
-                //Building iterators
-                m_iterators[i] = ltj_iter_type(&triple, m_ptr_ring);
-                if(m_iterators[i].is_empty){
+                m_iterators.emplace_back(&triple, m_ptr_ring);
+                if(m_iterators.back().is_empty){
                     m_is_empty = true;
                     return;
                 }
+            }
 
-                //For each variable we add the pointers to its iterators
-                if(triple.o_is_variable()){
-                    add_var_to_iterator(triple.term_o.value, &(m_iterators[i]));
-                }
-                if(triple.p_is_variable()){
-                    add_var_to_iterator(triple.term_p.value, &(m_iterators[i]));
-                }
-                if(triple.s_is_variable()){
-                    add_var_to_iterator(triple.term_s.value, &(m_iterators[i]));
-                }
-                ++i;
+            //For each variable we add the pointers to its iterators
+            for_each_var([this](const var_type var, ltj_iter_type* iter){
+                ++m_var_begin[var + 1];
+            });
+            for(size_type x = 0; x < max_vars; ++x){
+                m_var_begin[x + 1] += m_var_begin[x];
             }
+            m_var_iterators.resize(m_var_begin[max_vars]);
+            std::array<size_type, max_vars> next;
+            std::copy(m_var_begin.begin(), m_var_begin.begin() + max_vars, next.begin());
+            for_each_var([this, &next](const var_type var, ltj_iter_type* iter){
+                m_var_iterators[next[var]++] = iter;
+            });
 
-            gao::gao_size<ring_type> gao_sv2(m_ptr_triple_patterns, &m_iterators, m_ptr_ring, m_gao);
+            gao::gao_size<ring_type> gao_sv2(m_ptr_triple_patterns, &m_iterators, m_ptr_ring, m_gao, arena);
+            m_values.resize(m_gao.size());
+            for(auto &values : m_values) values.with_counts = false;
 
         }
 
@@ -135,8 +202,10 @@ namespace ring {
                 m_gao = std::move(o.m_gao);
                 m_ptr_ring = std::move(o.m_ptr_ring);
                 m_iterators = std::move(o.m_iterators);
-                m_var_to_iterators = std::move(o.m_var_to_iterators);
+                m_var_iterators = std::move(o.m_var_iterators);
+                m_var_begin = o.m_var_begin;
                 m_is_empty = o.m_is_empty;
+                m_values = std::move(o.m_values);
             }
             return *this;
         }
@@ -146,8 +215,10 @@ namespace ring {
             std::swap(m_gao, o.m_gao);
             std::swap(m_ptr_ring, o.m_ptr_ring);
             std::swap(m_iterators, o.m_iterators);
-            std::swap(m_var_to_iterators, o.m_var_to_iterators);
+            std::swap(m_var_iterators, o.m_var_iterators);
+            std::swap(m_var_begin, o.m_var_begin);
             std::swap(m_is_empty, o.m_is_empty);
+            std::swap(m_values, o.m_values);
         }
 
 
@@ -159,23 +230,581 @@ namespace ring {
         */
         void join(std::vector<tuple_type> &res,
                   const size_type limit_results = 0, const size_type timeout_seconds = 0){
-            if(m_is_empty) return;
+            join([&res](const tuple_type &t){
+                res.emplace_back(t);
+                return true;
+            }, limit_results, timeout_seconds);
+        };
+
+        /**
+        * Streaming version of join. Each solution is given to report as a view of the
+        * tuple used during the search, so it is only valid during the call. Nothing is
+        * materialised, report has to copy what it needs.
+        *
+        * @param report            Callable bool(const tuple_type&). Returning false stops the join
+        * @param limit_results     Limit of results
+        * @param timeout_seconds   Timeout in seconds
+        * @return                  Number of reported results
+        */
+        template<class report_t>
+        size_type join(report_t &&report,
+                       const size_type limit_results = 0, const size_type timeout_seconds = 0){
+            if(m_is_empty) return 0;
             time_point_type start = std::chrono::high_resolution_clock::now();
             tuple_type t(m_gao.size());
-            search(0, t, res, start, limit_results, timeout_seconds);
+            size_type n_results = 0;
+            search(0, t, report, n_results, start, limit_results, timeout_seconds);
+            return n_results;
+        };
+
+        /**
+        * Join with the adaptive GAO: the next variable is chosen after each binding
+        * according to the current intervals of the iterators (see gao::gao_adaptive).
+        * The results are the same as in join, but the variables of each tuple may
+        * appear in a different order.
+        *
+        * @param res               Results
+        * @param limit_results     Limit of results
+        * @param timeout_seconds   Timeout in seconds
+        */
+        void join_adaptive(std::vector<tuple_type> &res,
+                           const size_type limit_results = 0, const size_type timeout_seconds = 0){
+            join_adaptive([&res](const tuple_type &t){
+                res.emplace_back(t);
+                return true;
+            }, limit_results, timeout_seconds);
+        };
+
+        /**
+        * Streaming version of join_adaptive.
+        *
+        * @param report            Callable bool(const tuple_type&). Returning false stops the join
+        * @param limit_results     Limit of results
+        * @param timeout_seconds   Timeout in seconds
+        * @return                  Number of reported results
+        */
+        template<class report_t>
+        size_type join_adaptive(report_t &&report,
+                                const size_type limit_results = 0, const size_type timeout_seconds = 0){
+            if(m_is_empty) return 0;
+            time_point_type start = std::chrono::high_resolution_clock::now();
+            gao_adaptive_type gao(m_ptr_triple_patterns, &m_iterators, m_gao, m_iterators.get_allocator().arena);
+            tuple_type t(m_gao.size());
+            size_type n_results = 0;
+            search_adaptive(0, gao, t, report, n_results, start, limit_results, timeout_seconds);
+            return n_results;
+        };
+
+
+        /**
+         * Pull-style enumeration of the results of an ltj_algorithm. It runs the same
+         * search as join but with an explicit stack, so the results are produced one
+         * by one when next is called. It moves the iterators of the algorithm, so there
+         * can only be one open cursor per ltj_algorithm.
+         *
+         * Its state can be saved in a continuation and a new cursor, even on another
+         * ltj_algorithm of the same query, can resume the enumeration from it.
+         */
+        class cursor {
+
+        private:
+            typedef struct {
+                bool started;
+                bool lonely;
+                value_type c;
+                size_type idx;
+                range_values values;
+            } level_type;
+
+            ltj_algorithm* m_ptr_ltj;
+            tuple_type m_tuple;
+            std::vector<level_type> m_levels;
+            size_type m_depth = 0;
+            size_type m_n_results = 0;
+            size_type m_limit_results = 0;
+            size_type m_timeout_seconds = 0;
+            time_point_type m_start;
+            bool m_finished = false;
+            bool m_exhausted = false; //there are no more results, not only a limit or a timeout
+            bool m_pending = false; //resumed on a result that was not reported yet
+            std::vector<value_type> m_last; //bindings of the last reported result
+
+            //Binds the next value of the j-th variable, returns false if there are no more values
+            bool step(const size_type j){
+                var_type x_j = m_ptr_ltj->m_gao[j];
+                var_iterators itrs = m_ptr_ltj->iterators(x_j);
+                level_type &level = m_levels[j];
+                if(level.started){
+                    for (ltj_iter_type* iter : itrs) {
+                        iter->up(x_j);
+                    }
+                }else{
+                    level.lonely = itrs.size() == 1 && itrs[0]->in_last_level();
+                }
+                if(level.lonely){
+                    if(level.started){
+                        ++level.idx;
+                    }else{
+                        itrs[0]->seek_all(x_j, level.values);
+                        level.idx = 0;
+                    }
+                    level.started = true;
+                    if(level.idx == level.values.size()) return false;
+                    level.c = level.values[level.idx];
+                }else{
+                    level.c = level.started ? m_ptr_ltj->seek(x_j, level.c + 1) : m_ptr_ltj->seek(x_j);
+                    level.started = true;
+                    if(level.c == 0) return false;
+                }
+                m_tuple[j] = {x_j, level.c};
+                for (ltj_iter_type* iter : itrs) {
+                    iter->down(x_j, level.c);
+                }
+                return true;
+            }
+
+            bool timeout(){
+                if(m_timeout_seconds == 0) return false;
+                time_point_type stop = std::chrono::high_resolution_clock::now();
+                auto sec = std::chrono::duration_cast<std::chrono::seconds>(stop-m_start).count();
+                return sec > m_timeout_seconds;
+            }
+
+            void reported(){
+                ++m_n_results;
+                for(size_type j = 0; j < m_tuple.size(); ++j){
+                    m_last[j] = m_tuple[j].second;
+                }
+            }
+
+            //Leaps to the bindings of the last result of k, next goes on with the results after them
+            void resume(const continuation &k){
+                m_n_results = k.n_results;
+                if(k.finished){
+                    m_finished = m_exhausted = true;
+                    return;
+                }
+                const size_type n = m_levels.size();
+                if(k.values.empty() || n == 0) return; //Nothing reported yet
+                m_last.assign(k.values.begin(), k.values.end());
+                size_type j = 0;
+                for(; j < n; ++j){
+                    var_type x_j = m_ptr_ltj->m_gao[j];
+                    var_iterators itrs = m_ptr_ltj->iterators(x_j);
+                    level_type &level = m_levels[j];
+                    level.lonely = itrs.size() == 1 && itrs[0]->in_last_level();
+                    level.started = true;
+                    const value_type v = k.values[j];
+                    if(level.lonely){
+                        itrs[0]->seek_all(x_j, level.values);
+                        level.idx = std::lower_bound(level.values.begin(), level.values.end(), v)
+                                    - level.values.begin();
+                        if(level.idx == level.values.size()) break;
+                        level.c = level.values[level.idx];
+                    }else{
+                        level.c = m_ptr_ltj->seek(x_j, v);
+                        if(level.c == 0) break;
+                    }
+                    m_tuple[j] = {x_j, level.c};
+                    for (ltj_iter_type* iter : itrs) {
+                        iter->down(x_j, level.c);
+                    }
+                    if(level.c != v){
+                        //The bindings are gone (the ring was updated): we are already
+                        //past them, the search starts again below the new value
+                        m_depth = j + 1;
+                        m_pending = m_depth == n;
+                        if(!m_pending) m_levels[m_depth].started = false;
+                        return;
+                    }
+                }
+                if(j == n){ //Same state as after reporting the result
+                    m_depth = n;
+                    return;
+                }
+                //No values left from k.values[j], next goes on with the previous variable
+                m_levels[j].started = false;
+                if(j == 0){
+                    m_finished = m_exhausted = true;
+                    return;
+                }
+                m_depth = j - 1;
+            }
+
+        public:
+
+            cursor(ltj_algorithm* ltj, const size_type limit_results = 0, const size_type timeout_seconds = 0){
+                m_ptr_ltj = ltj;
+                m_limit_results = limit_results;
+                m_timeout_seconds = timeout_seconds;
+                m_start = std::chrono::high_resolution_clock::now();
+                m_finished = m_exhausted = ltj->m_is_empty;
+                m_tuple.resize(ltj->m_gao.size());
+                m_last.resize(ltj->m_gao.size());
+                m_levels.resize(ltj->m_gao.size());
+                for(auto &level : m_levels){
+                    level.started = false;
+                    level.values.with_counts = false;
+                }
+            }
+
+            /**
+             * Resumes the enumeration saved in a continuation. The ltj_algorithm takes
+             * the GAO of the continuation, and the limit counts the results reported
+             * before it too.
+             *
+             * @param ltj               An ltj_algorithm of the query of the continuation, without other cursors
+             * @param k                 Continuation given by save
+             * @param limit_results     Limit of results
+             * @param timeout_seconds   Timeout in seconds
+             */
+            cursor(ltj_algorithm* ltj, const continuation &k,
+                   const size_type limit_results = 0, const size_type timeout_seconds = 0)
+                   : cursor(ltj, limit_results, timeout_seconds){
+                if(m_exhausted) {
+                    m_n_results = k.n_results;
+                    return;
+                }
+                if(k.query != continuation::fingerprint(*ltj->m_ptr_triple_patterns) || !ltj->set_gao(k.gao)){
+                    throw std::invalid_argument("The continuation does not belong to the query");
+                }
+                resume(k);
+            }
+
+            //! Moves to the next result. Returns false when there are no more results
+            bool next(){
+                if(m_finished) return false;
+                if(m_limit_results > 0 && m_n_results == m_limit_results){
+                    m_finished = true;
+                    return false;
+                }
+                const size_type n = m_levels.size();
+                if(n == 0){ //Only constants, one empty result
+                    m_finished = m_exhausted = m_n_results > 0;
+                    if(!m_finished) ++m_n_results;
+                    return !m_finished;
+                }
+                if(m_pending){
+                    m_pending = false;
+                    reported();
+                    return true;
+                }
+                if(m_depth == n) --m_depth; //Last result is reported, next value of the last variable
+                while(true){
+                    if(timeout()){
+                        m_finished = true;
+                        return false;
+                    }
+                    if(step(m_depth)){
+                        ++m_depth;
+                        if(m_depth == n){
+                            reported();
+                            return true;
+                        }
+                        m_levels[m_depth].started = false;
+                    }else{
+                        m_levels[m_depth].started = false;
+                        if(m_depth == 0){
+                            m_finished = m_exhausted = true;
+                            return false;
+                        }
+                        --m_depth;
+                    }
+                }
+            }
+
+            //! Current result, valid until the next call to next
+            const tuple_type &tuple() const {
+                return m_tuple;
+            }
+
+            size_type n_results() const {
+                return m_n_results;
+            }
+
+            /**
+             * Skips the next k results, as k calls to next but without stepping
+             * through the values of a lonely last variable one by one.
+             *
+             * @param k     Number of results
+             * @return      Number of skipped results, less than k if there are no more
+             */
+            size_type skip(const size_type k){
+                size_type skipped = 0;
+                const size_type n = m_levels.size();
+                while(skipped < k){
+                    if(n > 0 && m_depth == n && !m_pending && !m_finished && m_levels[n-1].lonely){
+                        level_type &level = m_levels[n-1];
+                        size_type s = std::min(level.values.size() - level.idx - 1, k - skipped - 1);
+                        if(m_limit_results > 0) s = std::min(s, m_limit_results - m_n_results);
+                        if(s > 0){
+                            var_type x = m_ptr_ltj->m_gao[n-1];
+                            ltj_iter_type* iter = m_ptr_ltj->iterators(x)[0];
+                            iter->up(x);
+                            level.idx += s;
+                            level.c = level.values[level.idx];
+                            iter->down(x, level.c);
+                            m_tuple[n-1].second = m_last[n-1] = level.c;
+                            m_n_results += s;
+                            skipped += s;
+                        }
+                    }
+                    if(!next()) break;
+                    ++skipped;
+                }
+                return skipped;
+            }
+
+            //! State of the enumeration after the last reported result
+            continuation save() const {
+                continuation k;
+                k.query = continuation::fingerprint(*m_ptr_ltj->m_ptr_triple_patterns);
+                k.gao.assign(m_ptr_ltj->m_gao.begin(), m_ptr_ltj->m_gao.end());
+                if(m_n_results > 0) k.values = m_last;
+                k.n_results = m_n_results;
+                k.finished = m_exhausted;
+                return k;
+            }
+
+            //! True if the enumeration is over, not only stopped by a limit or a timeout
+            bool exhausted() const {
+                return m_exhausted;
+            }
+
+            //! Stops the enumeration and moves the iterators back to the root, so another cursor can be opened
+            void close(){
+                for(size_type j = std::min(m_depth + 1, m_levels.size()); j-- > 0; ){
+                    var_type x_j = m_ptr_ltj->m_gao[j];
+                    for (ltj_iter_type* iter : m_ptr_ltj->iterators(x_j)) {
+                        iter->up(x_j);
+                    }
+                    m_levels[j].started = false;
+                }
+                m_depth = 0;
+                m_pending = false;
+                m_finished = true;
+            }
         };
 
+        cursor open_cursor(const size_type limit_results = 0, const size_type timeout_seconds = 0){
+            return cursor(this, limit_results, timeout_seconds);
+        }
+
+        cursor open_cursor(const continuation &k, const size_type limit_results = 0,
+                           const size_type timeout_seconds = 0){
+            return cursor(this, k, limit_results, timeout_seconds);
+        }
+
+        /**
+        * Paginated version of join. It reports the results that follow those given
+        * by a continuation, and leaves in it the state after the new ones. Starting
+        * from an empty continuation, the pages together are the results of join.
+        *
+        * @param res               Results
+        * @param k                 Continuation, updated
+        * @param page_size         Maximum number of results of the page
+        * @param offset            Results skipped before the page
+        * @param timeout_seconds   Timeout in seconds, the continuation can be resumed after it
+        * @return                  Number of results of the page
+        */
+        size_type join_page(std::vector<tuple_type> &res, continuation &k, const size_type page_size,
+                            const size_type offset = 0, const size_type timeout_seconds = 0){
+            cursor c = (k.n_results == 0 && !k.finished)
+                       ? open_cursor(0, timeout_seconds) : open_cursor(k, 0, timeout_seconds);
+            size_type n = 0;
+            if(c.skip(offset) == offset){
+                while(n < page_size && c.next()){
+                    res.emplace_back(c.tuple());
+                    ++n;
+                }
+            }
+            k = c.save();
+            c.close();
+            return n;
+        }
+
+        /**
+        * Parallel version of join. The bindings of the first variable of the GAO
+        * (and of the second one when there are too few of them) are split into tasks
+        * that are distributed among the deques of the workers. Each worker runs on its
+        * own copy of the iterators and steals tasks from the others when its deque is empty.
+        * The order of the results is not the one given by join. When a worker reaches
+        * the limit or the timeout, the others stop at their next result.
+        * Note that the ring is read concurrently, so it only works with the static rings.
+        *
+        * @param res               Results
+        * @param n_threads         Number of threads
+        * @param limit_results     Limit of results
+        * @param timeout_seconds   Timeout in seconds
+        */
+        void join_parallel(std::vector<tuple_type> &res, const size_type n_threads,
+                           const size_type limit_results = 0, const size_type timeout_seconds = 0){
+            if(m_is_empty) return;
+            if(n_threads <= 1 || m_gao.empty()){
+                join(res, limit_results, timeout_seconds);
+                return;
+            }
+            time_point_type start = std::chrono::high_resolution_clock::now();
+
+            //1. Splitting the search space
+            std::vector<prefix_type> prefixes;
+            if(!split_prefixes(prefixes, n_threads, start, timeout_seconds)) return;
+            if(prefixes.empty()) return;
+
+            //2. Round-robin, consecutive bindings tend to have similar costs
+            std::vector<deque_type> deques(n_threads);
+            for(size_type i = 0; i < prefixes.size(); ++i){
+                deques[i % n_threads].push(prefixes[i]);
+            }
+
+            //3. Running the workers
+            std::atomic<size_type> n_results(0);
+            std::atomic<bool> stop(false);
+            std::vector<std::vector<tuple_type>> partial(n_threads);
+            std::vector<std::thread> workers;
+            workers.reserve(n_threads);
+            for(size_type w = 0; w < n_threads; ++w){
+                workers.emplace_back([&, w](){
+                    ltj_algorithm local(*this);
+                    local.run_worker(w, deques, partial[w], n_results, stop,
+                                     start, limit_results, timeout_seconds);
+                });
+            }
+            for(auto &worker : workers){
+                worker.join();
+            }
+
+            //4. Merging the results
+            for(auto &p : partial){
+                for(auto &t : p){
+                    if(limit_results > 0 && res.size() == limit_results) return;
+                    res.emplace_back(std::move(t));
+                }
+            }
+        };
+
+    private:
+
+        //Takes the GAO of a continuation, which has to be an order of the same variables
+        bool set_gao(const std::vector<uint8_t> &gao){
+            if(gao.size() != m_gao.size() || !std::is_permutation(gao.begin(), gao.end(), m_gao.begin())){
+                return false;
+            }
+            std::copy(gao.begin(), gao.end(), m_gao.begin());
+            return true;
+        }
+
+        static bool timed_out(const time_point_type start, const size_type timeout_seconds){
+            if(timeout_seconds == 0) return false;
+            time_point_type stop = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::seconds>(stop-start).count() > timeout_seconds;
+        }
+
+        //Returns false if the timeout expires while enumerating the bindings
+        bool split_prefixes(std::vector<prefix_type> &prefixes, const size_type n_threads,
+                            const time_point_type start, const size_type timeout_seconds){
+            var_type x_0 = m_gao[0];
+            value_type c = seek(x_0);
+            while (c != 0) {
+                if(timed_out(start, timeout_seconds)) return false;
+                prefixes.push_back({{c, 0}, 1});
+                c = seek(x_0, c + 1);
+            }
+            //Too few tasks for balancing the work, we also split the second variable
+            if(prefixes.size() >= 4 * n_threads || m_gao.size() == 1) return true;
+            var_type x_1 = m_gao[1];
+            var_iterators itrs = iterators(x_0);
+            std::vector<prefix_type> refined;
+            for(const auto &p : prefixes){
+                seek(x_0, p.values[0]);
+                for (ltj_iter_type* iter : itrs) {
+                    iter->down(x_0, p.values[0]);
+                }
+                c = seek(x_1);
+                while (c != 0) {
+                    if(timed_out(start, timeout_seconds)) return false;
+                    refined.push_back({{p.values[0], c}, 2});
+                    c = seek(x_1, c + 1);
+                }
+                for (ltj_iter_type* iter : itrs) {
+                    iter->up(x_0);
+                }
+            }
+            prefixes.swap(refined);
+            return true;
+        }
+
+        inline bool next_prefix(const size_type w, std::vector<deque_type> &deques, prefix_type &p){
+            if(deques[w].pop(p)) return true;
+            for(size_type i = 1; i < deques.size(); ++i){
+                if(deques[(w + i) % deques.size()].steal(p)) return true;
+            }
+            return false; //No new tasks are created, so all the deques are empty
+        }
+
+        void run_worker(const size_type w, std::vector<deque_type> &deques, std::vector<tuple_type> &res,
+                        std::atomic<size_type> &n_results, std::atomic<bool> &stop,
+                        const time_point_type start,
+                        const size_type limit_results, const size_type timeout_seconds){
+            tuple_type tuple(m_gao.size());
+            prefix_type p;
+            size_type n_local = 0;
+            //Checks the flag at each result, so a long task does not keep running after
+            //another worker stops. The limit is counted among all the workers
+            auto report = [&](const tuple_type &t){
+                if(stop.load(std::memory_order_relaxed)) return false;
+                res.emplace_back(t);
+                if(limit_results > 0 && n_results.fetch_add(1, std::memory_order_relaxed) + 1 >= limit_results){
+                    stop.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+                return true;
+            };
+            while(!stop.load(std::memory_order_relaxed) && next_prefix(w, deques, p)){
+                if(!search_prefix(p, tuple, report, n_local, start, limit_results, timeout_seconds)){
+                    stop.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        template<class report_t>
+        bool search_prefix(const prefix_type &p, tuple_type &tuple, report_t &report, size_type &n_results,
+                           const time_point_type start,
+                           const size_type limit_results, const size_type timeout_seconds){
+            for(size_type k = 0; k < p.depth; ++k){
+                var_type x_k = m_gao[k];
+                //Leaping to the value restores the state stored in the intervals
+                seek(x_k, p.values[k]);
+                tuple[k] = {x_k, p.values[k]};
+                for (ltj_iter_type* iter : iterators(x_k)) {
+                    iter->down(x_k, p.values[k]);
+                }
+            }
+            bool ok = search(p.depth, tuple, report, n_results, start, limit_results, timeout_seconds);
+            if(!ok) return false;
+            for(size_type k = p.depth; k-- > 0; ){
+                var_type x_k = m_gao[k];
+                for (ltj_iter_type* iter : iterators(x_k)) {
+                    iter->up(x_k);
+                }
+            }
+            return true;
+        }
+
+    public:
 
         /**
          *
          * @param j                 Index of the variable
          * @param tuple             Tuple of the current search
-         * @param res               Results
+         * @param report            Callable bool(const tuple_type&) receiving the results
+         * @param n_results         Number of reported results
          * @param start             Initial time to check timeout
          * @param limit_results     Limit of results
          * @param timeout_seconds   Timeout in seconds
          */
-        bool search(const size_type j, tuple_type &tuple, std::vector<tuple_type> &res,
+        template<class report_t>
+        bool search(const size_type j, tuple_type &tuple, report_t &report, size_type &n_results,
                     const time_point_type start,
                     const size_type limit_results = 0, const size_type timeout_seconds = 0){
 
@@ -187,25 +816,27 @@ namespace ring {
             }
 
             //(Optional) Check limit
-            if(limit_results > 0 && res.size() == limit_results) return false;
+            if(limit_results > 0 && n_results == limit_results) return false;
 
 
             if(j == m_gao.size()){
                 //Report results
-                res.emplace_back(tuple);
+                ++n_results;
+                if(!report(tuple)) return false;
             }else{
                 var_type x_j = m_gao[j];
-                std::vector<ltj_iter_type*>& itrs = m_var_to_iterators[x_j];
+                var_iterators itrs = iterators(x_j);
                 bool ok;
                 if(itrs.size() == 1 && itrs[0]->in_last_level()) {//Lonely variables
-                    auto results = itrs[0]->seek_all(x_j);
+                    range_values &results = m_values[j];
+                    itrs[0]->seek_all(x_j, results);
                     for (const auto &c : results) {
                         //1. Adding result to tuple
                         tuple[j] = {x_j, c};
                         //2. Going down in the trie by setting x_j = c (\mu(t_i) in paper)
                         itrs[0]->down(x_j, c);
                         //2. Search with the next variable x_{j+1}
-                        ok = search(j + 1, tuple, res, start, limit_results, timeout_seconds);
+                        ok = search(j + 1, tuple, report, n_results, start, limit_results, timeout_seconds);
                         if(!ok) return false;
                         //4. Going up in the trie by removing x_j = c
                         itrs[0]->up(x_j);
@@ -221,7 +852,7 @@ namespace ring {
                             iter->down(x_j, c);
                         }
                         //3. Search with the next variable x_{j+1}
-                        ok = search(j + 1, tuple, res, start, limit_results, timeout_seconds);
+                        ok = search(j + 1, tuple, report, n_results, start, limit_results, timeout_seconds);
                         if(!ok) return false;
                         //4. Going up in the tries by removing x_j = c
                         for (ltj_iter_type *iter : itrs) {
@@ -236,6 +867,67 @@ namespace ring {
             return true;
         };
 
+        /**
+         * Same as search, but the j-th variable is chosen by the adaptive GAO.
+         *
+         * @param j                 Number of bound variables
+         * @param gao               Adaptive GAO
+         * @param tuple             Tuple of the current search
+         * @param report            Callable bool(const tuple_type&) receiving the results
+         * @param n_results         Number of reported results
+         * @param start             Initial time to check timeout
+         * @param limit_results     Limit of results
+         * @param timeout_seconds   Timeout in seconds
+         */
+        template<class report_t>
+        bool search_adaptive(const size_type j, gao_adaptive_type &gao, tuple_type &tuple, report_t &report,
+                             size_type &n_results, const time_point_type start,
+                             const size_type limit_results = 0, const size_type timeout_seconds = 0){
+
+            //(Optional) Check timeout
+            if(timeout_seconds > 0){
+                time_point_type stop = std::chrono::high_resolution_clock::now();
+                auto sec = std::chrono::duration_cast<std::chrono::seconds>(stop-start).count();
+                if(sec > timeout_seconds) return false;
+            }
+
+            //(Optional) Check limit
+            if(limit_results > 0 && n_results == limit_results) return false;
+
+            if(j == gao.size()){
+                //Report results
+                ++n_results;
+                if(!report(tuple)) return false;
+            }else{
+                size_type v = gao.choose(j);
+                var_type x_j = gao.var(v).name;
+                var_iterators itrs = iterators(x_j);
+                bool ok;
+                if(itrs.size() == 1 && itrs[0]->in_last_level()) {//Lonely variables
+                    range_values &results = m_values[j];
+                    itrs[0]->seek_all(x_j, results);
+                    for (const auto &c : results) {
+                        tuple[j] = {x_j, c};
+                        gao.bind(v, j, c, true);
+                        ok = search_adaptive(j + 1, gao, tuple, report, n_results, start, limit_results, timeout_seconds);
+                        if(!ok) return false;
+                        gao.unbind(v, j);
+                    }
+                }else {
+                    value_type c = seek(x_j);
+                    while (c != 0) { //If empty c=0
+                        tuple[j] = {x_j, c};
+                        gao.bind(v, j, c);
+                        ok = search_adaptive(j + 1, gao, tuple, report, n_results, start, limit_results, timeout_seconds);
+                        if(!ok) return false;
+                        gao.unbind(v, j);
+                        c = seek(x_j, c + 1);
+                    }
+                }
+            }
+            return true;
+        };
+
 
         /**
          *
@@ -247,7 +939,7 @@ namespace ring {
 
         value_type seek(const var_type x_j, value_type c=-1){
             value_type c_i, c_min = UINT64_MAX, c_max = 0;
-            std::vector<ltj_iter_type*>& itrs = m_var_to_iterators[x_j];
+            var_iterators itrs = iterators(x_j);
             while (true){
                 //Compute leap for each triple that contains x_j
                 for(ltj_iter_type* iter : itrs){
@@ -591,6 +591,25 @@ namespace ring {
             }
             return std::vector<uint64_t>();
         }
+
+        //Same as seek_all, the values are written into res
+        void seek_all(var_type var, range_values &res){
+            if (is_variable_subject(var)){
+                m_ptr_ring->all_S_in_range(m_i_s, res);
+            }else if (is_variable_predicate(var)){
+                m_ptr_ring->all_P_in_range(m_i_p, res);
+            }else if (is_variable_object(var)){
+                m_ptr_ring->all_O_in_range(m_i_o, res);
+            }else{
+                res.clear();
+            }
+        }
+    };
+
+    //! Iterator of the triple patterns on a ring. The rings with their own iterator specialize it
+    template<class ring_t, class var_t, class cons_t>
+    struct ltj_iterator_of {
+        typedef ltj_iterator<ring_t, var_t, cons_t> type;
     };
 
 }
@@ -0,0 +1,152 @@
+/*
+ * mapped_file.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_MAPPED_FILE_HPP
+#define RING_MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <istream>
+#include <streambuf>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ring {
+
+    /**
+     * Read-only streambuf over a memory region. The structures that know it
+     * (e.g. bwt_mapped) take a pointer to the current position instead of
+     * copying their data, the rest of the members are read as usual.
+     */
+    class mapped_streambuf : public std::streambuf {
+
+    public:
+        mapped_streambuf(const char *data, uint64_t size) {
+            char *p = const_cast<char *>(data);
+            setg(p, p, p + size);
+        }
+
+        inline const char *current() const {
+            return gptr();
+        }
+
+        inline uint64_t remaining() const {
+            return egptr() - gptr();
+        }
+
+        //! Skips bytes that have been used in place
+        inline void advance(uint64_t bytes) {
+            setg(eback(), gptr() + bytes, egptr());
+        }
+
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            char *base = (dir == std::ios_base::beg) ? eback() : (dir == std::ios_base::cur) ? gptr() : egptr();
+            if (off < eback() - base || off > egptr() - base) return pos_type(off_type(-1));
+            setg(eback(), base + off, egptr());
+            return pos_type(gptr() - eback());
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    /**
+     * Read-only shared mapping of an index file. The pages are shared with the
+     * page cache, so several processes querying the same file use one copy of
+     * the index. The mapping has to outlive the structures loaded from it.
+     */
+    class mapped_file {
+
+    private:
+        int m_fd = -1;
+        char *m_data = nullptr;
+        uint64_t m_size = 0;
+
+    public:
+
+        mapped_file() = default;
+
+        explicit mapped_file(const std::string &file) {
+            open(file);
+        }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        ~mapped_file() {
+            close();
+        }
+
+        void open(const std::string &file) {
+            close();
+            m_fd = ::open(file.c_str(), O_RDONLY);
+            if (m_fd < 0) throw std::runtime_error("Cannot open " + file);
+            struct stat st;
+            if (fstat(m_fd, &st) < 0) {
+                close();
+                throw std::runtime_error("Cannot stat " + file);
+            }
+            m_size = st.st_size;
+            void *p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+            if (p == MAP_FAILED) {
+                m_size = 0;
+                close();
+                throw std::runtime_error("Cannot map " + file);
+            }
+            m_data = (char *) p;
+            //Queries access the index at random
+            madvise(m_data, m_size, MADV_RANDOM);
+        }
+
+        void close() {
+            if (m_data != nullptr) munmap(m_data, m_size);
+            if (m_fd >= 0) ::close(m_fd);
+            m_data = nullptr;
+            m_fd = -1;
+            m_size = 0;
+        }
+
+        inline bool is_open() const {
+            return m_data != nullptr;
+        }
+
+        inline const char *data() const {
+            return m_data;
+        }
+
+        inline uint64_t size() const {
+            return m_size;
+        }
+
+        //! Loads obj from the beginning of the mapping
+        template<class t>
+        void load(t &obj) const {
+            mapped_streambuf buf(m_data, m_size);
+            std::istream in(&buf);
+            obj.load(in);
+        }
+    };
+}
+
+#endif //RING_MAPPED_FILE_HPP
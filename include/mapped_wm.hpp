@@ -0,0 +1,411 @@
+/*
+ * mapped_wm.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_MAPPED_WM_HPP
+#define RING_MAPPED_WM_HPP
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include "range_values.hpp"
+
+namespace ring {
+
+    /**
+     * Read-only bitvector with rank and select stored in a flat array of words,
+     * so it can be used directly from a mapped file.
+     * Layout: [n, n_words, n_blocks, n_s1, n_s0 | bits | ranks | samples1 | samples0]
+     * ranks[b] is the number of ones before the block b (of 512 bits), samples1[j] is
+     * the block of the (j*4096+1)-th one and samples0 the same for the zeros.
+     */
+    class mapped_bv {
+
+    public:
+        typedef uint64_t size_type;
+        static constexpr uint64_t block_words = 8;
+        static constexpr uint64_t block_bits = block_words * 64;
+        static constexpr uint64_t sample_rate = 4096;
+        static constexpr uint64_t header_words = 5;
+
+    private:
+        const uint64_t *m_bits = nullptr;
+        const uint64_t *m_ranks = nullptr;
+        const uint64_t *m_s1 = nullptr;
+        const uint64_t *m_s0 = nullptr;
+        uint64_t m_n = 0;
+        uint64_t m_n_words = 0;
+        uint64_t m_n_blocks = 0;
+        uint64_t m_n_s1 = 0;
+        uint64_t m_n_s0 = 0;
+
+        static inline uint64_t select_in_word(uint64_t x, uint64_t k) {
+            for (uint64_t i = 1; i < k; ++i) x &= x - 1;
+            return __builtin_ctzll(x);
+        }
+
+        inline uint64_t ones_before_block(uint64_t b, bool bit) const {
+            return bit ? m_ranks[b] : b * block_bits - m_ranks[b];
+        }
+
+        uint64_t select(uint64_t k, bool bit) const {
+            const uint64_t *samples = bit ? m_s1 : m_s0;
+            uint64_t j = (k - 1) / sample_rate;
+            uint64_t lo = samples[j], hi = samples[j + 1];
+            //Last block in [lo, hi] with less than k bits before it
+            while (lo < hi) {
+                uint64_t mid = (lo + hi + 1) / 2;
+                if (ones_before_block(mid, bit) < k) lo = mid;
+                else hi = mid - 1;
+            }
+            uint64_t rem = k - ones_before_block(lo, bit);
+            for (uint64_t w = lo * block_words; w < m_n_words; ++w) {
+                uint64_t word = bit ? m_bits[w] : ~m_bits[w];
+                uint64_t c = __builtin_popcountll(word);
+                if (c >= rem) return w * 64 + select_in_word(word, rem);
+                rem -= c;
+            }
+            return m_n;
+        }
+
+        static void add_samples(const std::vector<uint64_t> &ranks, uint64_t n_blocks, uint64_t total,
+                                bool bit, std::vector<uint64_t> &out) {
+            uint64_t b = 0;
+            for (uint64_t k = 1; k <= total; k += sample_rate) {
+                while (b + 1 < n_blocks && (bit ? ranks[b + 1] : (b + 1) * block_bits - ranks[b + 1]) < k) ++b;
+                out.push_back(b);
+            }
+            out.push_back(n_blocks ? n_blocks - 1 : 0);
+        }
+
+    public:
+
+        mapped_bv() = default;
+
+        //! View of the bitvector stored at ptr
+        explicit mapped_bv(const uint64_t *ptr) {
+            m_n = ptr[0];
+            m_n_words = ptr[1];
+            m_n_blocks = ptr[2];
+            m_n_s1 = ptr[3];
+            m_n_s0 = ptr[4];
+            m_bits = ptr + header_words;
+            m_ranks = m_bits + m_n_words;
+            m_s1 = m_ranks + m_n_blocks + 1;
+            m_s0 = m_s1 + m_n_s1;
+        }
+
+        //! Appends to out the layout of the bitvector of n bits stored in bits
+        static void build(const std::vector<uint64_t> &bits, const uint64_t n, std::vector<uint64_t> &out) {
+            uint64_t n_words = (n + 63) / 64;
+            uint64_t n_blocks = (n + block_bits - 1) / block_bits;
+            std::vector<uint64_t> ranks(n_blocks + 1, 0);
+            for (uint64_t w = 0; w < n_words; ++w) {
+                ranks[w / block_words + 1] += __builtin_popcountll(bits[w]);
+            }
+            for (uint64_t b = 1; b <= n_blocks; ++b) ranks[b] += ranks[b - 1];
+            uint64_t ones = ranks[n_blocks];
+
+            std::vector<uint64_t> s1, s0;
+            add_samples(ranks, n_blocks, ones, true, s1);
+            add_samples(ranks, n_blocks, n - ones, false, s0);
+
+            out.push_back(n);
+            out.push_back(n_words);
+            out.push_back(n_blocks);
+            out.push_back(s1.size());
+            out.push_back(s0.size());
+            out.insert(out.end(), bits.begin(), bits.begin() + n_words);
+            out.insert(out.end(), ranks.begin(), ranks.end());
+            out.insert(out.end(), s1.begin(), s1.end());
+            out.insert(out.end(), s0.begin(), s0.end());
+        }
+
+        //! Number of words used by the layout
+        inline uint64_t words() const {
+            return header_words + m_n_words + m_n_blocks + 1 + m_n_s1 + m_n_s0;
+        }
+
+        inline uint64_t size() const {
+            return m_n;
+        }
+
+        inline uint64_t ones() const {
+            return m_ranks[m_n_blocks];
+        }
+
+        inline bool operator[](uint64_t i) const {
+            return (m_bits[i / 64] >> (i % 64)) & 1ULL;
+        }
+
+        //! Number of ones in [0, i)
+        inline uint64_t rank1(uint64_t i) const {
+            uint64_t b = i / block_bits;
+            uint64_t r = m_ranks[b];
+            uint64_t w = b * block_words;
+            for (; w < i / 64; ++w) r += __builtin_popcountll(m_bits[w]);
+            if (i % 64) r += __builtin_popcountll(m_bits[w] & ((1ULL << (i % 64)) - 1));
+            return r;
+        }
+
+        inline uint64_t rank0(uint64_t i) const {
+            return i - rank1(i);
+        }
+
+        //! Position of the k-th one (k >= 1)
+        inline uint64_t select1(uint64_t k) const {
+            return select(k, true);
+        }
+
+        //! Position of the k-th zero (k >= 1)
+        inline uint64_t select0(uint64_t k) const {
+            return select(k, false);
+        }
+    };
+
+    /**
+     * Read-only wavelet matrix over mapped_bv levels.
+     * Layout: [n, levels, Z[0..levels) | level 0 | ... | level levels-1]
+     */
+    class mapped_wm {
+
+    public:
+        typedef uint64_t size_type;
+        typedef uint64_t value_type;
+
+    private:
+        uint64_t m_n = 0;
+        uint64_t m_levels = 0;
+        uint64_t m_words = 0;
+        const uint64_t *m_Z = nullptr;
+        std::vector<mapped_bv> m_bv;
+
+        inline uint64_t bit_of(uint64_t v, uint64_t l) const {
+            return (v >> (m_levels - 1 - l)) & 1ULL;
+        }
+
+        // Smallest value >= x in [lo, hi) of the level l. If free, any value in the range is valid
+        bool next_value(uint64_t l, uint64_t lo, uint64_t hi, uint64_t val, uint64_t x, bool free,
+                        uint64_t &res) const {
+            if (lo >= hi) return false;
+            if (l == m_levels) {
+                res = val;
+                return true;
+            }
+            const mapped_bv &bv = m_bv[l];
+            uint64_t lo0 = bv.rank0(lo), hi0 = bv.rank0(hi);
+            uint64_t lo1 = m_Z[l] + lo - lo0, hi1 = m_Z[l] + hi - hi0;
+            uint64_t one = 1ULL << (m_levels - 1 - l);
+            if (free) {
+                if (hi0 > lo0) return next_value(l + 1, lo0, hi0, val, x, true, res);
+                return next_value(l + 1, lo1, hi1, val | one, x, true, res);
+            }
+            if (bit_of(x, l) == 0) {
+                if (next_value(l + 1, lo0, hi0, val, x, false, res)) return true;
+                return next_value(l + 1, lo1, hi1, val | one, x, true, res);
+            }
+            return next_value(l + 1, lo1, hi1, val | one, x, false, res);
+        }
+
+        void all_values(uint64_t l, uint64_t lo, uint64_t hi, uint64_t val, std::vector<uint64_t> &res) const {
+            if (lo >= hi) return;
+            if (l == m_levels) {
+                res.push_back(val);
+                return;
+            }
+            const mapped_bv &bv = m_bv[l];
+            uint64_t lo0 = bv.rank0(lo), hi0 = bv.rank0(hi);
+            all_values(l + 1, lo0, hi0, val, res);
+            all_values(l + 1, m_Z[l] + lo - lo0, m_Z[l] + hi - hi0, val | (1ULL << (m_levels - 1 - l)), res);
+        }
+
+        void all_values(uint64_t l, uint64_t lo, uint64_t hi, uint64_t val, range_values &res) const {
+            if (lo >= hi) return;
+            if (l == m_levels) {
+                if (res.size() == res.values.size()) res.reserve(2 * res.size() + 1);
+                res.push_back(val, hi - lo);
+                return;
+            }
+            const mapped_bv &bv = m_bv[l];
+            uint64_t lo0 = bv.rank0(lo), hi0 = bv.rank0(hi);
+            all_values(l + 1, lo0, hi0, val, res);
+            all_values(l + 1, m_Z[l] + lo - lo0, m_Z[l] + hi - hi0, val | (1ULL << (m_levels - 1 - l)), res);
+        }
+
+    public:
+
+        mapped_wm() = default;
+
+        //! View of the wavelet matrix stored at ptr
+        explicit mapped_wm(const uint64_t *ptr) {
+            m_n = ptr[0];
+            m_levels = ptr[1];
+            m_Z = ptr + 2;
+            m_words = 2 + m_levels;
+            m_bv.reserve(m_levels);
+            for (uint64_t l = 0; l < m_levels; ++l) {
+                m_bv.emplace_back(ptr + m_words);
+                m_words += m_bv.back().words();
+            }
+        }
+
+        //! Appends to out the layout of the wavelet matrix of L (any vector with size() and [])
+        template<class vector_t>
+        static void build(const vector_t &L, std::vector<uint64_t> &out) {
+            const uint64_t n = L.size();
+            std::vector<uint64_t> cur(n), next(n);
+            uint64_t max_value = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                cur[i] = L[i];
+                if (cur[i] > max_value) max_value = cur[i];
+            }
+            uint64_t levels = 1;
+            while (levels < 64 && (max_value >> levels)) ++levels;
+
+            out.push_back(n);
+            out.push_back(levels);
+            uint64_t z_pos = out.size();
+            out.resize(out.size() + levels, 0);
+            std::vector<uint64_t> bits((n + 63) / 64);
+            for (uint64_t l = 0; l < levels; ++l) {
+                uint64_t shift = levels - 1 - l;
+                std::fill(bits.begin(), bits.end(), 0);
+                uint64_t zeros = 0;
+                for (uint64_t i = 0; i < n; ++i) {
+                    if ((cur[i] >> shift) & 1ULL) bits[i / 64] |= 1ULL << (i % 64);
+                    else ++zeros;
+                }
+                out[z_pos + l] = zeros;
+                mapped_bv::build(bits, n, out);
+                //Stable partition, zeros first
+                uint64_t p0 = 0, p1 = zeros;
+                for (uint64_t i = 0; i < n; ++i) {
+                    if ((cur[i] >> shift) & 1ULL) next[p1++] = cur[i];
+                    else next[p0++] = cur[i];
+                }
+                cur.swap(next);
+            }
+        }
+
+        inline uint64_t words() const {
+            return m_words;
+        }
+
+        inline uint64_t size() const {
+            return m_n;
+        }
+
+        inline uint64_t levels() const {
+            return m_levels;
+        }
+
+        inline const mapped_bv &level(uint64_t l) const {
+            return m_bv[l];
+        }
+
+        uint64_t operator[](uint64_t i) const {
+            uint64_t v = 0;
+            for (uint64_t l = 0; l < m_levels; ++l) {
+                const mapped_bv &bv = m_bv[l];
+                if (bv[i]) {
+                    v = (v << 1) | 1ULL;
+                    i = m_Z[l] + bv.rank1(i);
+                } else {
+                    v <<= 1;
+                    i = bv.rank0(i);
+                }
+            }
+            return v;
+        }
+
+        //! Number of occurrences of c in [0, i)
+        uint64_t rank(uint64_t i, uint64_t c) const {
+            if (m_levels < 64 && (c >> m_levels)) return 0;
+            uint64_t s = 0;
+            for (uint64_t l = 0; l < m_levels; ++l) {
+                const mapped_bv &bv = m_bv[l];
+                if (bit_of(c, l)) {
+                    s = m_Z[l] + bv.rank1(s);
+                    i = m_Z[l] + bv.rank1(i);
+                } else {
+                    s = bv.rank0(s);
+                    i = bv.rank0(i);
+                }
+            }
+            return i - s;
+        }
+
+        //! Position of the k-th (k >= 1) occurrence of c
+        uint64_t select(uint64_t k, uint64_t c) const {
+            uint64_t s = 0;
+            for (uint64_t l = 0; l < m_levels; ++l) {
+                const mapped_bv &bv = m_bv[l];
+                s = bit_of(c, l) ? m_Z[l] + bv.rank1(s) : bv.rank0(s);
+            }
+            uint64_t p = s + k - 1;
+            for (uint64_t l = m_levels; l-- > 0;) {
+                const mapped_bv &bv = m_bv[l];
+                p = bit_of(c, l) ? bv.select1(p - m_Z[l] + 1) : bv.select0(p + 1);
+            }
+            return p;
+        }
+
+        //! Rank of L[i] in [0, i) and L[i]
+        std::pair<uint64_t, uint64_t> inverse_select(uint64_t i) const {
+            uint64_t c = (*this)[i];
+            return {rank(i, c), c};
+        }
+
+        //! Next occurrence of c from position i and its rank. {0, 0} if there are no more than n_elems
+        std::pair<uint64_t, uint64_t> select_next(uint64_t i, uint64_t c, uint64_t n_elems) const {
+            uint64_t r = rank(i, c);
+            if (r >= n_elems) return {0, 0};
+            return {select(r + 1, c), r};
+        }
+
+        //! Minimum value in [l, r]
+        uint64_t range_minimum_query(uint64_t l, uint64_t r) const {
+            uint64_t res = 0;
+            next_value(0, l, r + 1, 0, 0, true, res);
+            return res;
+        }
+
+        //! Smallest value >= x in [l, r], 0 if there is none
+        uint64_t range_next_value(uint64_t x, uint64_t l, uint64_t r) const {
+            if (m_levels < 64 && (x >> m_levels)) return 0;
+            uint64_t res = 0;
+            if (!next_value(0, l, r + 1, 0, x, false, res)) return 0;
+            return res;
+        }
+
+        //! Distinct values in [l, r] in increasing order
+        std::vector<uint64_t> all_values_in_range(uint64_t l, uint64_t r) const {
+            std::vector<uint64_t> res;
+            all_values(0, l, r + 1, 0, res);
+            return res;
+        }
+
+        //! Distinct values in [l, r] in increasing order with their number of occurrences
+        void all_values_in_range(uint64_t l, uint64_t r, range_values &res) const {
+            res.clear();
+            all_values(0, l, r + 1, 0, res);
+        }
+    };
+}
+
+#endif //RING_MAPPED_WM_HPP
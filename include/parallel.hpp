@@ -0,0 +1,135 @@
+/*
+ * parallel.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_PARALLEL_HPP
+#define RING_PARALLEL_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace ring {
+
+    namespace parallel {
+
+        static constexpr uint64_t radix_bits = 11;
+        static constexpr uint64_t radix_buckets = 1ULL << radix_bits;
+
+        /**
+         * Splits [0, n) into n_threads chunks and runs f(t, begin, end) on each one
+         * in its own thread.
+         */
+        template<class function_t>
+        void parallel_for(const uint64_t n, const uint64_t n_threads, function_t f){
+            std::vector<std::thread> threads;
+            threads.reserve(n_threads);
+            uint64_t chunk = (n + n_threads - 1) / n_threads;
+            for(uint64_t t = 0; t < n_threads; ++t){
+                uint64_t b = std::min(n, t * chunk);
+                uint64_t e = std::min(n, b + chunk);
+                threads.emplace_back(f, t, b, e);
+            }
+            for(auto &th : threads){
+                th.join();
+            }
+        }
+
+        /**
+         * Stable LSD radix sort of v by key(v[i]). Each pass counts the digits of its
+         * chunk in a per-thread histogram, the offsets are computed bucket by bucket
+         * and thread by thread, so the scatter keeps the order of equal keys.
+         *
+         * @param v         Vector to sort
+         * @param buffer    Auxiliary vector, it is resized to v.size()
+         * @param key       Callable returning the (32-bit) key of an element
+         * @param max_key   Maximum key, used to skip the passes of the empty digits
+         * @param n_threads Number of threads
+         */
+        template<class value_t, class key_t>
+        void radix_sort(std::vector<value_t> &v, std::vector<value_t> &buffer, key_t key,
+                        const uint64_t max_key, const uint64_t n_threads){
+            const uint64_t n = v.size();
+            buffer.resize(n);
+            uint64_t n_bits = 1;
+            while(n_bits < 64 && (max_key >> n_bits)) ++n_bits;
+
+            std::vector<std::vector<uint64_t>> hist(n_threads, std::vector<uint64_t>(radix_buckets));
+            for(uint64_t shift = 0; shift < n_bits; shift += radix_bits){
+                //1. Per-thread histograms
+                parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e){
+                    std::vector<uint64_t> &h = hist[t];
+                    std::fill(h.begin(), h.end(), 0);
+                    for(uint64_t i = b; i < e; ++i){
+                        ++h[(key(v[i]) >> shift) & (radix_buckets - 1)];
+                    }
+                });
+                //2. Offsets
+                uint64_t sum = 0;
+                for(uint64_t d = 0; d < radix_buckets; ++d){
+                    for(uint64_t t = 0; t < n_threads; ++t){
+                        uint64_t c = hist[t][d];
+                        hist[t][d] = sum;
+                        sum += c;
+                    }
+                }
+                //3. Scatter
+                parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e){
+                    std::vector<uint64_t> &h = hist[t];
+                    for(uint64_t i = b; i < e; ++i){
+                        buffer[h[(key(v[i]) >> shift) & (radix_buckets - 1)]++] = v[i];
+                    }
+                });
+                v.swap(buffer);
+            }
+        }
+
+        /**
+         * Computes the C array of a vector sorted by key, as done with the counters
+         * in the serial construction of the ring: C[0] = 0 (dummy), C[c] = 1 + number
+         * of keys in [1, c) and C[sigma+1] = n+1. Each thread fills the entries
+         * between the keys that change in its chunk, so there are no conflicts.
+         */
+        template<class value_t, class key_t>
+        std::vector<uint64_t> C_array(const std::vector<value_t> &v, key_t key,
+                                      const uint64_t sigma, const uint64_t n_threads){
+            const uint64_t n = v.size();
+            std::vector<uint64_t> C(sigma + 2, 0);
+            uint64_t zeros = 0; //Keys equal to 0 are not counted
+            while(zeros < n && key(v[zeros]) == 0) ++zeros;
+            parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e){
+                for(uint64_t i = b; i < e; ++i){
+                    uint64_t prev = (i == 0) ? 0 : key(v[i - 1]);
+                    uint64_t cur = key(v[i]);
+                    for(uint64_t c = prev + 1; c <= cur && c <= sigma; ++c){
+                        C[c] = 1 + i - zeros;
+                    }
+                }
+            });
+            uint64_t last = (n == 0) ? 0 : key(v[n - 1]);
+            for(uint64_t c = last + 1; c <= sigma; ++c){
+                C[c] = 1 + n - zeros;
+            }
+            C[sigma + 1] = n + 1;
+            return C;
+        }
+    }
+}
+
+#endif //RING_PARALLEL_HPP
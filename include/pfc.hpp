@@ -20,53 +20,54 @@
 #ifndef TREE_PFC_H
 #define TREE_PFC_H
 
+#include "bucket_map.hpp"
 #include "configuration.hpp"
+#include "query_arena.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace ring
 {
   class PFC;
 
-  /*
-  * Union type to represent a pointer to a PFC
-  * or the next ID that its free in the array.
-  */
-  struct EmptyOrPFC {
-    bool is_empty = true;
-    union {
-        PFC* pfc;
-        uint64_t next_empty;
-    };
-
-    EmptyOrPFC() : is_empty(true), next_empty(0) {}
-
-    EmptyOrPFC(PFC* ptr) : is_empty(false), pfc(ptr) {}
-
-    EmptyOrPFC(uint64_t next) : is_empty(true), next_empty(next) {}
-
-    void set_pfc(PFC* ptr) {
-        is_empty = false;
-        pfc = ptr;
-    }
-
-    void set_next_empty(uint64_t next) {
-        is_empty = true;
-        next_empty = next;
-    }
-
-    bool has_pfc() const { return !is_empty; }
-
-    bool is_slot_empty() const { return is_empty; }
-
-    PFC* get_pfc() const {
-        assert(!is_empty);
-        return pfc;
+  /**
+   * @brief Length of the longest common prefix of a[0, n) and b[0, n).
+   * Compares 16 bytes at a time when SSE2 is available
+   */
+  inline uint64_t common_prefix(const char *a, const char *b, uint64_t n)
+  {
+    uint64_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16)
+    {
+      __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+      __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+      uint32_t diff = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xffff;
+      if (diff)
+        return i + __builtin_ctz(diff);
     }
+#endif
+    while (i < n && a[i] == b[i])
+      i++;
+    return i;
+  }
 
-    uint64_t get_next_empty() const {
-        assert(is_empty);
-        return next_empty;
-    }
-  };
+  /**
+   * @brief Compares a[0, na) with b[0, nb) in the order of std::string::compare
+   *
+   * @return int Negative, zero or positive if a is smaller, equal or greater than b
+   */
+  inline int compare_bytes(const char *a, uint64_t na, const char *b, uint64_t nb)
+  {
+    uint64_t k = common_prefix(a, b, std::min(na, nb));
+    if (k < na && k < nb)
+      return (unsigned char)a[k] < (unsigned char)b[k] ? -1 : 1;
+    return na == nb ? 0 : (na < nb ? -1 : 1);
+  }
 
   /**
    * @brief Class implementing a Plain Front Coding bucket
@@ -83,6 +84,39 @@ namespace ring
 
     PFC(std::string initial_string, uint64_t initial_size) : text_string(initial_string), current_size(initial_size) {}
 
+    /**
+     * @brief Builds a PFC with the given words in a single pass
+     *
+     * @param begin Iterator to the first word. The words are sorted and without repetitions
+     * @param end Iterator past the last word
+     * @param first_id The ID of the first word, the next ones get consecutive IDs
+     */
+    template <class iterator_t>
+    PFC(iterator_t begin, iterator_t end, uint64_t first_id) : text_string(""), current_size(0)
+    {
+      iterator_t prev = begin;
+      for (iterator_t it = begin; it != end; ++it, ++first_id)
+      {
+        const std::string &s = *it;
+        if (it == begin)
+        {
+          text_string += encode_number(first_id);
+          text_string += s;
+        }
+        else
+        {
+          uint64_t lcp = longest_common_prefix(*prev, s, std::min(s.size(), prev->size()));
+          text_string += encode_number(first_id);
+          text_string += encode_number(lcp);
+          text_string.append(s, lcp, std::string::npos);
+        }
+        text_string += '\0';
+        prev = it;
+        current_size++;
+      }
+      text_string.shrink_to_fit();
+    }
+
     /**
      * @brief Function that serializes the data structure.
      *
@@ -121,9 +155,9 @@ namespace ring
      * stored in the data structure to itself
      *
      * @param in The in stream where the bytes are coming from
-     * @param id_map A vector of PFC pointers to map the IDs
+     * @param id_map The map from the IDs to their PFCs
      */
-    void load(std::istream &in, std::vector<EmptyOrPFC> &id_map)
+    void load(std::istream &in, bucket_map &id_map)
     {
       size_t string_size;
       in.read((char *)&current_size, sizeof(current_size));
@@ -137,7 +171,7 @@ namespace ring
       // Get first word
       curr_id = decode_number(index);
       index = text_string.find_first_of('\0', index) + 1;
-      id_map[curr_id - 1].set_pfc(this);
+      id_map.set_pfc(curr_id, this);
 
       // Go through the PFC loading the ID map
       while (index < text_string.size())
@@ -145,7 +179,7 @@ namespace ring
         curr_id = decode_number(index);
         decode_number(index);
         index = text_string.find_first_of('\0', index) + 1;
-        id_map[curr_id - 1].set_pfc(this);
+        id_map.set_pfc(curr_id, this);
       }
     }
 
@@ -298,32 +332,10 @@ namespace ring
      */
     uint64_t locate(const std::string &s)
     {
-      uint64_t index = 0;
-      std::string prev, curr;
-      uint64_t curr_id;
-
-      // Linear search
-      curr_id = decode_number(index);
-      read_string(index, curr);
-      prev = curr;
-      while (index < text_string.size())
-      {
-        if (curr == s)
-        {
-          return curr_id;
-        }
-        curr_id = decode_number(index);
-        uint64_t lcp = decode_number(index);
-        read_string(index, curr, prev, lcp);
-        prev = curr;
-      }
-
-      if (curr == s)
-      {
-        return curr_id;
-      }
-
-      throw std::invalid_argument(s + " not in Plain Front Coding");
+      std::pair<bool, uint64_t> res = locate_if_exists(s.data(), s.size());
+      if (!res.first)
+        throw std::invalid_argument(s + " not in Plain Front Coding");
+      return res.second;
     }
 
     /**
@@ -333,33 +345,60 @@ namespace ring
      * @param s The string bieng searched
      * @return std::pair<bool, uint64_t> True if the string exits and the ID of the string otherwise false and 0
      */
-    std::pair<bool, uint64_t> locate_if_exists(const std::string &s)
+    std::pair<bool, uint64_t> locate_if_exists(const std::string &s) const
+    {
+      return locate_if_exists(s.data(), s.size());
+    }
+
+    //! Search the string in the PFC without decoding the words (see locate_in)
+    std::pair<bool, uint64_t> locate_if_exists(const char *s, uint64_t n) const
+    {
+      return locate_in(text_string.data(), text_string.size(), s, n);
+    }
+
+    /**
+     * @brief Search the string in the PFC without decoding the words.
+     * The words are sorted, so a word is only compared with s when it shares
+     * with s as many characters as the previous word did: with more it is
+     * smaller than s and with less it is greater.
+     *
+     * @param text      The bytes of a PFC
+     * @param text_size The number of bytes
+     * @param s         The string being searched
+     * @param n         The length of s
+     * @return std::pair<bool, uint64_t> True if the string exits and the ID of the string otherwise false and 0
+     */
+    static std::pair<bool, uint64_t> locate_in(const char *text, uint64_t text_size, const char *s, uint64_t n)
     {
       uint64_t index = 0;
-      std::string prev, curr;
-      uint64_t curr_id;
+      uint64_t m = 0; // Common prefix of s and the previous word
 
-      // Linear search
-      curr_id = decode_number(index);
-      read_string(index, curr);
-      prev = curr;
-      while (index < text_string.size())
+      while (index < text_size)
       {
-        if (curr == s)
+        // The first word is stored whole
+        bool is_first = index == 0;
+        uint64_t curr_id = decode_number(text, index);
+        uint64_t lcp = is_first ? 0 : decode_number(text, index);
+        if (lcp == m)
         {
-          return {true, curr_id};
+          const char *suffix = text + index;
+          uint64_t k = common_prefix(suffix, s + m, std::min(n - m, text_size - index));
+          if (m + k == n)
+          {
+            // Equal, or s is a prefix of the word
+            return suffix[k] == '\0' ? std::make_pair(true, curr_id) : std::make_pair(false, (uint64_t)0);
+          }
+          if (suffix[k] != '\0' && (unsigned char)suffix[k] > (unsigned char)s[m + k])
+            return {false, 0};
+          m += k;
+          index += k;
         }
-        curr_id = decode_number(index);
-        uint64_t lcp = decode_number(index);
-        read_string(index, curr, prev, lcp);
-        prev = curr;
-      }
-
-      if (curr == s)
-      {
-        return {true, curr_id};
+        else if (lcp < m)
+        {
+          return {false, 0};
+        }
+        index = (const char *)std::memchr(text + index, '\0', text_size - index) - text + 1;
       }
-
       return {false, 0};
     }
 
@@ -571,6 +610,16 @@ namespace ring
      */
     void fuse(std::string &new_half, uint64_t new_words_counter)
     {
+      // Either of them can be empty after deleting by ID
+      if (new_half.empty())
+        return;
+      if (text_string.empty())
+      {
+        text_string = new_half;
+        current_size = new_words_counter;
+        return;
+      }
+
       uint64_t index = 0;
       std::string prev = "\0", curr = "\0";
 
@@ -619,6 +668,114 @@ namespace ring
       return ids;
     }
 
+    /**
+     * @brief Calls f(id, word) with every word of the PFC, decoding each one once
+     */
+    template <class function_t>
+    void for_each(function_t f) const
+    {
+      for_each_in(text_string.data(), text_string.size(), f);
+    }
+
+    //! As for_each over the bytes of a PFC
+    template <class function_t>
+    static void for_each_in(const char *text, uint64_t text_size, function_t f)
+    {
+      uint64_t index = 0;
+      std::string curr;
+      while (index < text_size)
+      {
+        bool is_first = index == 0;
+        uint64_t curr_id = decode_number(text, index);
+        uint64_t lcp = is_first ? 0 : decode_number(text, index);
+        uint64_t length = (const char *)std::memchr(text + index, '\0', text_size - index) - (text + index);
+        curr.resize(lcp);
+        curr.append(text + index, length);
+        index += length + 1;
+        f(curr_id, curr);
+      }
+    }
+
+    //! Extracts many strings decoding the PFC once (see extract_in)
+    template <class function_t>
+    uint64_t extract(const uint64_t *ids, uint64_t n, function_t f) const
+    {
+      return extract_in(text_string.data(), text_string.size(), ids, n, f);
+    }
+
+    /**
+     * @brief Extracts many strings decoding the PFC once, up to the last one found
+     *
+     * @param text      The bytes of a PFC
+     * @param text_size The number of bytes
+     * @param ids The IDs of the strings, sorted and without repetitions
+     * @param n   The number of IDs
+     * @param f   Called as f(i, word) with the string of ids[i]
+     * @return uint64_t The number of IDs found
+     */
+    template <class function_t>
+    static uint64_t extract_in(const char *text, uint64_t text_size, const uint64_t *ids, uint64_t n, function_t f)
+    {
+      uint64_t index = 0, found = 0;
+      std::string curr;
+      while (index < text_size && found < n)
+      {
+        bool is_first = index == 0;
+        uint64_t curr_id = decode_number(text, index);
+        uint64_t lcp = is_first ? 0 : decode_number(text, index);
+        uint64_t length = (const char *)std::memchr(text + index, '\0', text_size - index) - (text + index);
+        curr.resize(lcp);
+        curr.append(text + index, length);
+        index += length + 1;
+        const uint64_t *it = std::lower_bound(ids, ids + n, curr_id);
+        if (it != ids + n && *it == curr_id)
+        {
+          f(it - ids, curr);
+          found++;
+        }
+      }
+      return found;
+    }
+
+    //! Checks if the word with the given ID is s (see matches_in)
+    bool matches(uint64_t id, const char *s, uint64_t n) const
+    {
+      return matches_in(text_string.data(), text_string.size(), id, s, n);
+    }
+
+    /**
+     * @brief Checks if the word with the given ID is s, without decoding the words.
+     * It keeps the common prefix of s and the current word, which only changes
+     * when a word keeps no more of the previous one than that.
+     *
+     * @param text      The bytes of a PFC
+     * @param text_size The number of bytes
+     * @param id The ID of the word
+     * @param s  The string being compared
+     * @param n  The length of s
+     * @return bool True if the ID is in the PFC and its word is s
+     */
+    static bool matches_in(const char *text, uint64_t text_size, uint64_t id, const char *s, uint64_t n)
+    {
+      uint64_t index = 0;
+      uint64_t m = 0; // Common prefix of s and the current word
+
+      while (index < text_size)
+      {
+        bool is_first = index == 0;
+        uint64_t curr_id = decode_number(text, index);
+        uint64_t lcp = is_first ? 0 : decode_number(text, index);
+        const char *suffix = text + index;
+        uint64_t length = (const char *)std::memchr(suffix, '\0', text_size - index) - suffix;
+        if (lcp <= m)
+          m = lcp + common_prefix(suffix, s + lcp, std::min(n - std::min(n, lcp), length));
+        if (curr_id == id)
+          return m == n && lcp + length == n;
+        index += length + 1;
+      }
+      return false;
+    }
+
     std::string first_word()
     {
       uint64_t index = 0;
@@ -626,6 +783,28 @@ namespace ring
       return read_string(index);
     }
 
+    /**
+     * @brief Compares s with the first word, without decoding it
+     *
+     * @param s The string being compared
+     * @param n The length of s
+     * @return int As s.compare(first_word())
+     */
+    int compare_to_first_word(const char *s, uint64_t n) const
+    {
+      if (text_string.empty())
+        return n == 0 ? 0 : 1;
+      uint64_t index = 0;
+      decode_number(text_string, index);
+      const char *word = text_string.data() + index;
+      uint64_t k = common_prefix(s, word, std::min(n, (uint64_t)text_string.size() - index));
+      if (word[k] == '\0')
+        return k == n ? 0 : 1;
+      if (k == n)
+        return -1;
+      return (unsigned char)s[k] < (unsigned char)word[k] ? -1 : 1;
+    }
+
     uint64_t size()
     {
       return current_size;
@@ -641,6 +820,12 @@ namespace ring
       return text_string;
     }
 
+    //! The bytes of the PFC, valid until it is modified
+    std::string_view bytes() const
+    {
+      return text_string;
+    }
+
   private:
     uint64_t current_size;   // Amount of words stored in the PFC
     std::string text_string; // The actual bytes of the PFC
@@ -784,7 +969,13 @@ namespace ring
      * @param index pointer to the index being used
      * @return uint64_t the decoded number
      */
-    uint64_t decode_number(const std::string &s, uint64_t &index)
+    static uint64_t decode_number(const std::string &s, uint64_t &index)
+    {
+      return decode_number(s.data(), index);
+    }
+
+    //! As decode_number over the bytes of a PFC
+    static uint64_t decode_number(const char *s, uint64_t &index)
     {
       uint64_t n = 0;
       uint64_t shift = 0;
@@ -812,12 +1003,113 @@ namespace ring
      */
     uint64_t longest_common_prefix(const std::string &s1, const std::string &s2, size_t max_length)
     {
-      uint64_t index = 0;
-      while (index < max_length && (s1[index] == s2[index]))
-        index++;
-      return index;
+      return common_prefix(s1.data(), s2.data(), max_length);
     }
   };
+
+  /**
+   * @brief Builds the PFCs of a dictionary from its values in a single pass,
+   * for the bulk constructors of the dictionaries. The values are spread evenly
+   * over the fewest PFCs of at most max_size words, so every PFC has at least
+   * max_size / 2 words. The i-th value gets the ID i + 1.
+   *
+   * @param values The values, sorted and without repetitions
+   * @param max_size The maximum words of a PFC
+   * @param id_map Replaced by the PFC of every ID
+   * @return std::vector<PFC *> The PFCs in the order of their words
+   */
+  inline std::vector<PFC *> bulk_load_pfcs(const std::vector<std::string> &values, uint64_t max_size, bucket_map &id_map)
+  {
+    for (uint64_t i = 1; i < values.size(); i++)
+    {
+      if (values[i - 1].compare(values[i]) >= 0)
+        throw std::invalid_argument("The values of the dictionary are not sorted or have repetitions");
+    }
+
+    uint64_t n = values.size();
+    uint64_t n_pfcs = (n + max_size - 1) / max_size;
+    std::vector<PFC *> pfcs(n_pfcs);
+    id_map.assign(n, n_pfcs);
+    for (uint64_t b = 0; b < n_pfcs; b++)
+    {
+      uint64_t begin = n * b / n_pfcs, end = n * (b + 1) / n_pfcs;
+      pfcs[b] = new PFC(values.begin() + begin, values.begin() + end, begin + 1);
+      for (uint64_t i = begin; i < end; i++)
+        id_map.set_pfc(i + 1, pfcs[b]);
+    }
+    return pfcs;
+  }
+
+  /**
+   * @brief Extracts the strings of many IDs, decoding each PFC once. The IDs are
+   * grouped by their PFC and the repeated ones are extracted once.
+   *
+   * @param bucket_of Gives the bytes of the PFC of an ID, or no bytes if the ID is free
+   * @param ids       The IDs
+   * @param n         The number of IDs
+   * @param arena     Holds the strings, which are valid until it is reset
+   * @param values    The i-th value is the string of ids[i]
+   */
+  template <class bucket_of_t>
+  void extract_batch(bucket_of_t bucket_of, const uint64_t *ids, uint64_t n,
+                     query_arena &arena, std::vector<std::string_view> &values)
+  {
+    typedef std::pair<std::string_view, uint64_t> entry_type; // PFC and position in ids
+    std::vector<entry_type, arena_allocator<entry_type>> entries{arena_allocator<entry_type>(&arena)};
+    std::vector<uint64_t, arena_allocator<uint64_t>> group_ids{arena_allocator<uint64_t>(&arena)};
+    std::vector<uint64_t, arena_allocator<uint64_t>> starts{arena_allocator<uint64_t>(&arena)};
+
+    values.assign(n, std::string_view());
+    entries.reserve(n);
+    for (uint64_t i = 0; i < n; i++)
+    {
+      std::string_view bucket = bucket_of(ids[i]);
+      if (bucket.empty())
+        throw std::invalid_argument("ID is not asociated to any string in the mapping");
+      entries.emplace_back(bucket, i);
+    }
+    std::sort(entries.begin(), entries.end(), [&](const entry_type &a, const entry_type &b)
+              { return a.first.data() != b.first.data() ? std::less<const char *>()(a.first.data(), b.first.data()) : ids[a.second] < ids[b.second]; });
+
+    for (uint64_t b = 0; b < n;)
+    {
+      std::string_view bucket = entries[b].first;
+      group_ids.clear();
+      starts.clear();
+      uint64_t e = b;
+      for (; e < n && entries[e].first.data() == bucket.data(); e++)
+      {
+        if (group_ids.empty() || group_ids.back() != ids[entries[e].second])
+        {
+          group_ids.push_back(ids[entries[e].second]);
+          starts.push_back(e);
+        }
+      }
+      starts.push_back(e);
+
+      uint64_t found = PFC::extract_in(bucket.data(), bucket.size(), group_ids.data(), group_ids.size(), [&](uint64_t j, const std::string &word)
+                                       {
+                                         char *data = (char *)arena.allocate(word.size(), 1);
+                                         std::memcpy(data, word.data(), word.size());
+                                         for (uint64_t k = starts[j]; k < starts[j + 1]; k++)
+                                           values[entries[k].second] = std::string_view(data, word.size());
+                                       });
+      if (found < group_ids.size())
+        throw std::invalid_argument("ID is not asociated to any string in Plain Front Coding");
+      b = e;
+    }
+  }
+
+  //! extract_batch for the IDs of an id_map
+  inline void extract_batch(const bucket_map &id_map, const uint64_t *ids, uint64_t n,
+                            query_arena &arena, std::vector<std::string_view> &values)
+  {
+    extract_batch([&](uint64_t id)
+                  {
+                    PFC *pfc = id_map.get_pfc(id);
+                    return pfc ? pfc->bytes() : std::string_view(); },
+                  ids, n, arena, values);
+  }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+/*
+ * query_arena.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_QUERY_ARENA_HPP
+#define RING_QUERY_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ring {
+
+    /**
+     * Bump allocator for the structures of a query. Memory is never freed on its own:
+     * reset releases everything at once and keeps the blocks, so after the first
+     * queries the next ones do not allocate. It is meant to be reset between queries
+     * by its owner, once the objects that use it are destroyed.
+     */
+    class query_arena {
+
+    public:
+        typedef uint64_t size_type;
+        static constexpr size_type block_size = 64 * 1024;
+
+    private:
+        struct block_type {
+            std::unique_ptr<char[]> data;
+            size_type size;
+        };
+
+        std::vector<block_type> m_blocks;
+        size_type m_block = 0; // block in use
+        size_type m_used = 0;  // bytes used of m_blocks[m_block]
+
+    public:
+
+        query_arena() = default;
+
+        query_arena(const query_arena &) = delete;
+        query_arena &operator=(const query_arena &) = delete;
+
+        //! Move constructor, the memory given by o is still valid
+        query_arena(query_arena &&o) {
+            *this = std::move(o);
+        }
+
+        //! Move Operator=
+        query_arena &operator=(query_arena &&o) {
+            if (this != &o) {
+                m_blocks = std::move(o.m_blocks);
+                m_block = o.m_block;
+                m_used = o.m_used;
+                o.m_block = 0;
+                o.m_used = 0;
+            }
+            return *this;
+        }
+
+        void swap(query_arena &o) {
+            std::swap(m_blocks, o.m_blocks);
+            std::swap(m_block, o.m_block);
+            std::swap(m_used, o.m_used);
+        }
+
+        /**
+         * @param bytes     Number of bytes
+         * @param align     Alignment, a power of two
+         * @return          Memory valid until the next reset
+         */
+        void *allocate(const size_type bytes, const size_type align) {
+            while (m_block < m_blocks.size()) {
+                block_type &b = m_blocks[m_block];
+                size_type offset = (m_used + align - 1) & ~(align - 1);
+                if (offset + bytes <= b.size) {
+                    m_used = offset + bytes;
+                    return b.data.get() + offset;
+                }
+                ++m_block;
+                m_used = 0;
+            }
+            // new[] returns memory aligned for any fundamental type
+            size_type size = std::max(block_size, bytes);
+            m_blocks.push_back({std::unique_ptr<char[]>(new char[size]), size});
+            m_used = bytes;
+            return m_blocks.back().data.get();
+        }
+
+        //! Releases all the memory given by allocate, the blocks are kept
+        void reset() {
+            m_block = 0;
+            m_used = 0;
+        }
+
+        //! Bytes reserved by the arena
+        size_type capacity() const {
+            size_type bytes = 0;
+            for (const block_type &b : m_blocks) bytes += b.size;
+            return bytes;
+        }
+    };
+
+    /**
+     * Allocator of the standard containers over a query_arena. Deallocation does
+     * nothing, the memory goes back on reset. Without arena it uses the heap, which is
+     * also what copies of the containers get, so copies do not depend on the arena.
+     */
+    template<class T>
+    class arena_allocator {
+
+    public:
+        typedef T value_type;
+        typedef std::false_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        query_arena *arena = nullptr;
+
+        arena_allocator() = default;
+
+        explicit arena_allocator(query_arena *a) : arena(a) {}
+
+        template<class U>
+        arena_allocator(const arena_allocator<U> &o) : arena(o.arena) {}
+
+        T *allocate(const std::size_t n) {
+            if (arena == nullptr) return std::allocator<T>().allocate(n);
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *p, const std::size_t n) {
+            if (arena == nullptr) std::allocator<T>().deallocate(p, n);
+        }
+
+        arena_allocator select_on_container_copy_construction() const {
+            return arena_allocator();
+        }
+
+        template<class U>
+        bool operator==(const arena_allocator<U> &o) const {
+            return arena == o.arena;
+        }
+
+        template<class U>
+        bool operator!=(const arena_allocator<U> &o) const {
+            return arena != o.arena;
+        }
+    };
+}
+
+#endif //RING_QUERY_ARENA_HPP
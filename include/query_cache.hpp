@@ -0,0 +1,302 @@
+/*
+ * query_cache.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_QUERY_CACHE_HPP
+#define RING_QUERY_CACHE_HPP
+
+#include <triple_pattern.hpp>
+#include <algorithm>
+#include <array>
+#include <list>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ring {
+
+    /**
+     * LRU cache of the results of the queries on a ring. The queries are identified
+     * by a canonical form of their triple patterns: the patterns are sorted and the
+     * variables renamed by order of appearance, so the same query written with other
+     * variable names or in another order is found too.
+     *
+     * The entries remember the epoch of the ring (see ring::epoch) when they were
+     * computed. An entry is dropped when an update of the ring has touched one of the
+     * predicates of its query, or any predicate if the query has a variable predicate.
+     */
+    template<class ring_t, class var_t = uint8_t>
+    class query_cache {
+
+    public:
+        typedef uint64_t size_type;
+        typedef uint64_t value_type;
+        typedef var_t var_type;
+        typedef ring_t ring_type;
+        typedef std::vector<std::pair<var_type, value_type>> tuple_type;
+        typedef std::vector<uint64_t> key_type;
+        static_assert(sizeof(var_type) == 1, "The canonical positions are indexed by var_type");
+        static constexpr size_type max_orders = 720; //orders of the patterns tried by the canonical form
+
+    private:
+        struct key_hash {
+            size_type operator()(const key_type &key) const {
+                size_type h = 0xcbf29ce484222325ULL;
+                for (uint64_t x : key) {
+                    h ^= x;
+                    h *= 0x100000001b3ULL;
+                }
+                return h;
+            }
+        };
+
+        //Canonical form of a query and the names of its variables
+        struct canonical_type {
+            key_type key;
+            std::vector<var_type> vars; //variable of each canonical position
+            std::array<size_type, 256> position; //canonical position of each variable
+        };
+
+        typedef struct {
+            key_type key;
+            size_type n_vars;
+            size_type n_results;
+            std::vector<value_type> values; //n_vars values per result, by canonical position
+            bool complete; //all the results of the query, not only the first ones
+            size_type epoch;
+            std::vector<uint64_t> predicates; //constant predicates of the query
+            bool any_predicate; //the query has a variable predicate
+        } entry_type;
+
+        typedef std::list<entry_type> lru_type;
+
+        const ring_type* m_ptr_ring;
+        size_type m_max_entries;
+        size_type m_max_results;
+        lru_type m_lru; //most recently used first
+        std::unordered_map<key_type, typename lru_type::iterator, key_hash> m_entries;
+        size_type m_hits = 0;
+        size_type m_misses = 0;
+
+        static void encode(const term_pattern &term, const canonical_type &c, key_type &key) {
+            key.push_back(term.is_variable);
+            key.push_back(term.is_variable ? c.position[(var_type) term.value] : term.value);
+        }
+
+        //Renames the variables by order of appearance in the given order of the patterns,
+        //and sorts the patterns with the new names
+        static void canonical(const std::vector<triple_pattern> &query, const std::vector<size_type> &order,
+                              canonical_type &c) {
+            c.vars.clear();
+            std::fill(c.position.begin(), c.position.end(), (size_type) -1);
+            auto rename = [&c](const term_pattern &term) {
+                if (term.is_variable && c.position[(var_type) term.value] == (size_type) -1) {
+                    c.position[(var_type) term.value] = c.vars.size();
+                    c.vars.push_back((var_type) term.value);
+                }
+            };
+            for (size_type i : order) {
+                rename(query[i].term_s);
+                rename(query[i].term_p);
+                rename(query[i].term_o);
+            }
+            std::vector<key_type> patterns(query.size());
+            for (size_type i = 0; i < query.size(); ++i) {
+                encode(query[i].term_s, c, patterns[i]);
+                encode(query[i].term_p, c, patterns[i]);
+                encode(query[i].term_o, c, patterns[i]);
+            }
+            std::sort(patterns.begin(), patterns.end());
+            c.key.clear();
+            for (const key_type &p : patterns) c.key.insert(c.key.end(), p.begin(), p.end());
+        }
+
+        static void canonical(const std::vector<triple_pattern> &query, canonical_type &c) {
+            //1. The patterns are ordered by their constants, ignoring the names of the variables
+            std::vector<size_type> order(query.size());
+            for (size_type i = 0; i < order.size(); ++i) order[i] = i;
+            auto shape = [&query](const size_type i) {
+                const triple_pattern &t = query[i];
+                return std::make_tuple(t.s_is_variable(), t.s_is_variable() ? 0 : t.term_s.value,
+                                       t.p_is_variable(), t.p_is_variable() ? 0 : t.term_p.value,
+                                       t.o_is_variable(), t.o_is_variable() ? 0 : t.term_o.value);
+            };
+            std::sort(order.begin(), order.end(), [&shape](const size_type a, const size_type b) {
+                return shape(a) != shape(b) ? shape(a) < shape(b) : a < b;
+            });
+
+            //2. Patterns with the same constants can go in any order: the key is the smallest
+            //one over their orders, unless there are too many of them
+            std::vector<std::pair<size_type, size_type>> groups;
+            size_type n_orders = 1;
+            for (size_type first = 0, last; first < order.size(); first = last) {
+                for (last = first + 1; last < order.size() && shape(order[last]) == shape(order[first]); ++last) {
+                    n_orders *= last - first + 1;
+                    if (n_orders > max_orders) break;
+                }
+                if (last - first > 1) groups.emplace_back(first, last);
+                if (n_orders > max_orders) break;
+            }
+            canonical(query, order, c);
+            if (n_orders > max_orders) return;
+            canonical_type candidate;
+            while (true) {
+                size_type g = groups.size();
+                while (g > 0 && !std::next_permutation(order.begin() + groups[g - 1].first,
+                                                       order.begin() + groups[g - 1].second)) {
+                    --g;
+                }
+                if (g == 0) break; //every group is back to its first order
+                canonical(query, order, candidate);
+                if (candidate.key < c.key) std::swap(c, candidate);
+            }
+        }
+
+        bool is_valid(const entry_type &e) const {
+            if (e.any_predicate) return m_ptr_ring->epoch() <= e.epoch;
+            for (uint64_t p : e.predicates) {
+                if (m_ptr_ring->predicate_epoch(p) > e.epoch) return false;
+            }
+            return true;
+        }
+
+    public:
+
+        /**
+         * @param r             Ring of the queries
+         * @param max_entries   Maximum number of cached queries
+         * @param max_results   Maximum number of results of a cached query, larger results are not kept
+         */
+        explicit query_cache(const ring_type* r, const size_type max_entries = 1024,
+                             const size_type max_results = 10000)
+                : m_ptr_ring(r), m_max_entries(max_entries), m_max_results(max_results) {}
+
+        query_cache(const query_cache &) = delete;
+        query_cache &operator=(const query_cache &) = delete;
+
+        /**
+         * Looks for the results of a query.
+         *
+         * @param query             Triple patterns
+         * @param res               Results, in the same form as those of ltj_algorithm::join
+         * @param limit_results     Limit of results, 0 if there is no limit
+         * @return                  True if the cache had them
+         */
+        bool lookup(const std::vector<triple_pattern> &query, std::vector<tuple_type> &res,
+                    const size_type limit_results = 0) {
+            canonical_type c;
+            canonical(query, c);
+            auto it = m_entries.find(c.key);
+            if (it == m_entries.end()) {
+                ++m_misses;
+                return false;
+            }
+            const entry_type &e = *it->second;
+            if (!is_valid(e)) {
+                m_lru.erase(it->second);
+                m_entries.erase(it);
+                ++m_misses;
+                return false;
+            }
+            size_type n = e.n_results;
+            //The first results of a query only answer smaller limits
+            if (!e.complete && (limit_results == 0 || limit_results > n)) {
+                ++m_misses;
+                return false;
+            }
+            if (limit_results > 0 && limit_results < n) n = limit_results;
+            res.clear();
+            res.reserve(n);
+            for (size_type i = 0; i < n; ++i) {
+                tuple_type t(e.n_vars);
+                for (size_type k = 0; k < e.n_vars; ++k) {
+                    t[k] = {c.vars[k], e.values[i * e.n_vars + k]};
+                }
+                res.emplace_back(std::move(t));
+            }
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            ++m_hits;
+            return true;
+        }
+
+        /**
+         * Keeps the results of a query given by ltj_algorithm::join. The results of a
+         * join stopped by a timeout must not be inserted.
+         *
+         * @param query             Triple patterns
+         * @param res               Results
+         * @param limit_results     Limit of results of the join, 0 if there was no limit
+         */
+        void insert(const std::vector<triple_pattern> &query, const std::vector<tuple_type> &res,
+                    const size_type limit_results = 0) {
+            if (m_max_entries == 0 || res.size() > m_max_results) return;
+            entry_type e;
+            canonical_type c;
+            canonical(query, c);
+            e.key = c.key;
+            e.n_vars = c.vars.size();
+            e.n_results = res.size();
+            e.complete = limit_results == 0 || res.size() < limit_results;
+            e.epoch = m_ptr_ring->epoch();
+            e.any_predicate = false;
+            for (const triple_pattern &t : query) {
+                if (t.p_is_variable()) e.any_predicate = true;
+                else e.predicates.push_back(t.term_p.value);
+            }
+            e.values.resize(res.size() * e.n_vars);
+            for (size_type i = 0; i < res.size(); ++i) {
+                for (const auto &b : res[i]) {
+                    e.values[i * e.n_vars + c.position[b.first]] = b.second;
+                }
+            }
+
+            auto it = m_entries.find(e.key);
+            if (it != m_entries.end()) {
+                m_lru.erase(it->second);
+                m_entries.erase(it);
+            }
+            m_lru.push_front(std::move(e));
+            m_entries.insert({m_lru.front().key, m_lru.begin()});
+            while (m_entries.size() > m_max_entries) {
+                m_entries.erase(m_lru.back().key);
+                m_lru.pop_back();
+            }
+        }
+
+        //! Drops all the entries
+        void clear() {
+            m_lru.clear();
+            m_entries.clear();
+        }
+
+        inline size_type size() const {
+            return m_entries.size();
+        }
+
+        inline size_type hits() const {
+            return m_hits;
+        }
+
+        inline size_type misses() const {
+            return m_misses;
+        }
+    };
+}
+
+#endif //RING_QUERY_CACHE_HPP
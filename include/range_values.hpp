@@ -0,0 +1,94 @@
+/*
+ * range_values.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_RANGE_VALUES_HPP
+#define RING_RANGE_VALUES_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ring {
+
+    /**
+     * Distinct values of a range of a BWT in increasing order, with their number of
+     * occurrences, as reported by values_in_range. Only the first size() entries are
+     * valid: the vectors are never shrunk, so the buffer does not allocate once it
+     * has grown to the largest range it has seen.
+     */
+    struct range_values {
+        typedef uint64_t size_type;
+
+        std::vector<uint64_t> values;
+        std::vector<uint64_t> counts;
+        std::vector<uint64_t> ranks; // scratch of the kernels
+        size_type n = 0;
+        bool with_counts = true; // false if the caller only needs the values
+
+        inline size_type size() const {
+            return n;
+        }
+
+        inline bool empty() const {
+            return n == 0;
+        }
+
+        //! Makes room for k values, keeping the current ones
+        inline void reserve(const size_type k) {
+            if (values.size() < k) {
+                values.resize(k);
+                counts.resize(k);
+                ranks.resize(k);
+            }
+        }
+
+        inline void clear() {
+            n = 0;
+        }
+
+        //! Appends a value, there has to be room for it (see reserve)
+        inline void push_back(const uint64_t v, const uint64_t c) {
+            values[n] = v;
+            counts[n] = c;
+            ++n;
+        }
+
+        inline uint64_t operator[](const size_type i) const {
+            return values[i];
+        }
+
+        inline const uint64_t *begin() const {
+            return values.data();
+        }
+
+        inline const uint64_t *end() const {
+            return values.data() + n;
+        }
+
+        void swap(range_values &o) {
+            std::swap(values, o.values);
+            std::swap(counts, o.counts);
+            std::swap(ranks, o.ranks);
+            std::swap(n, o.n);
+            std::swap(with_counts, o.with_counts);
+        }
+    };
+}
+
+#endif //RING_RANGE_VALUES_HPP
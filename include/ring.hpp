@@ -23,7 +23,10 @@
 #include <cstdint>
 #include "bwt.hpp"
 #include "bwt_dyn.hpp"
+#include "bwt_mapped.hpp"
 #include "bwt_interval.hpp"
+#include "parallel.hpp"
+#include "stats_catalog.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,10 +49,102 @@ namespace ring
         bwt_p_type m_bwt_p;  // OSP
         bwt_so_type m_bwt_o; // SPO
 
-        size_type m_max_s;
-        size_type m_max_p;
-        size_type m_max_o;
-        size_type m_n_triples; // number of triples
+        size_type m_max_s = 0;
+        size_type m_max_p = 0;
+        size_type m_max_o = 0;
+        size_type m_n_triples = 0; // number of triples
+        stats_catalog m_stats; // not serialized with the ring, see stats()
+        size_type m_epoch = 0; // number of updates, see epoch()
+        std::vector<size_type> m_predicate_epoch; // last update of each predicate
+
+        // A triple and its positions in the three orders, used by the batch updates
+        struct batch_item
+        {
+            uint64_t s, p, o;
+            uint64_t pos_spo, pos_osp, pos_pos; // in L_O, L_P and L_S
+        };
+
+        // Adds a zero at the end of the block of each key of C (keys with repetitions)
+        template <class bwt_t>
+        static void insert_C_batch(bwt_t &bwt, std::vector<uint64_t> &keys)
+        {
+            sort(keys.begin(), keys.end());
+            for (uint64_t i = 0, j; i < keys.size(); i = j)
+            {
+                for (j = i; j < keys.size() && keys[j] == keys[i]; j++);
+                bwt.increment_C(keys[i], j - i);
+            }
+        }
+
+        // Removes a zero from the end of the block of each key of C (keys with repetitions)
+        template <class bwt_t>
+        static void remove_C_batch(bwt_t &bwt, std::vector<uint64_t> &keys)
+        {
+            sort(keys.begin(), keys.end());
+            for (uint64_t i = 0, j; i < keys.size(); i = j)
+            {
+                for (j = i; j < keys.size() && keys[j] == keys[i]; j++);
+                bwt.decrement_C(keys[i], j - i);
+            }
+        }
+
+        void remove_items(std::vector<batch_item> &items);
+
+        void node_items(uint64_t x, std::vector<batch_item> &items);
+
+        // Hooks of the updates: counts the update and records the predicates it touches,
+        // and keeps the statistics up to date, saving the state of the triples being
+        // updated when it is created and applying the differences when it is destroyed
+        struct update_scope
+        {
+            ring &r;
+            stats_catalog::update_type u;
+            bool active;
+
+            update_scope(ring &_r, const spo_triple &triple) : r(_r), active(_r.m_stats.enabled())
+            {
+                ++r.m_epoch;
+                r.touch_predicate(std::get<1>(triple));
+                if (active)
+                    r.m_stats.begin_update(r, std::vector<spo_triple>{triple}, u);
+            }
+
+            update_scope(ring &_r, const std::vector<spo_triple> &triples) : r(_r), active(_r.m_stats.enabled())
+            {
+                ++r.m_epoch;
+                for (const spo_triple &t : triples)
+                    r.touch_predicate(std::get<1>(t));
+                if (active)
+                    r.m_stats.begin_update(r, triples, u);
+            }
+
+            update_scope(ring &_r, const std::vector<batch_item> &items) : r(_r), active(_r.m_stats.enabled())
+            {
+                ++r.m_epoch;
+                for (const batch_item &it : items)
+                    r.touch_predicate(it.p);
+                if (!active)
+                    return;
+                std::vector<spo_triple> triples;
+                triples.reserve(items.size());
+                for (const batch_item &it : items)
+                    triples.emplace_back(it.s, it.p, it.o);
+                r.m_stats.begin_update(r, triples, u);
+            }
+
+            ~update_scope()
+            {
+                if (active)
+                    r.m_stats.end_update(r, u);
+            }
+        };
+
+        void touch_predicate(const uint64_t p)
+        {
+            if (p >= m_predicate_epoch.size())
+                m_predicate_epoch.resize(p + 1, 0);
+            m_predicate_epoch[p] = m_epoch;
+        }
 
         void copy(const ring &o)
         {
@@ -60,6 +155,9 @@ namespace ring
             m_max_p = o.m_max_p;
             m_max_o = o.m_max_o;
             m_n_triples = o.m_n_triples;
+            m_stats = o.m_stats;
+            m_epoch = o.m_epoch;
+            m_predicate_epoch = o.m_predicate_epoch;
         }
 
     public:
@@ -206,6 +304,86 @@ namespace ring
             // cout << "-- Index constructed successfully" << endl; fflush(stdout);
         };
 
+        // Parallel construction, builds the same ring as ring(D).
+        // Sorts with a parallel radix sort, computes the C arrays from the sorted
+        // triples and builds the three BWTs concurrently.
+        // D ends sorted in POS order as in the serial construction.
+        ring(vector<spo_triple_type> &D, const uint64_t n_threads)
+        {
+            if (n_threads <= 1)
+            {
+                *this = ring(D);
+                return;
+            }
+            uint64_t n = m_n_triples = D.size();
+            uint64_t U = 0;
+
+            {
+                std::vector<uint64_t> max_p(n_threads, 0), max_so(n_threads, 0);
+                parallel::parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e)
+                                       {
+                    for (uint64_t i = b; i < e; i++)
+                    {
+                        max_p[t] = std::max<uint64_t>(max_p[t], std::get<1>(D[i]));
+                        max_so[t] = std::max<uint64_t>(max_so[t], std::get<0>(D[i]));
+                        max_so[t] = std::max<uint64_t>(max_so[t], std::get<2>(D[i]));
+                    } });
+                m_max_p = *std::max_element(max_p.begin(), max_p.end());
+                U = *std::max_element(max_so.begin(), max_so.end());
+            }
+            uint64_t alphabet_SO = U;
+            m_max_s = m_max_o = alphabet_SO;
+
+            auto key_s = [](const spo_triple_type &t) { return std::get<0>(t); };
+            auto key_p = [](const spo_triple_type &t) { return std::get<1>(t); };
+            auto key_o = [](const spo_triple_type &t) { return std::get<2>(t); };
+
+            vector<spo_triple_type> buffer;
+            int_vector<> new_O(n + 1), new_P(n + 1), new_S(n + 1);
+            new_O[0] = new_P[0] = new_S[0] = 0;
+
+            // Sorts the triples lexycographically, LSD so O, P and then S
+            parallel::radix_sort(D, buffer, key_o, alphabet_SO, n_threads);
+            parallel::radix_sort(D, buffer, key_p, m_max_p, n_threads);
+            parallel::radix_sort(D, buffer, key_s, alphabet_SO, n_threads);
+            vector<uint64_t> new_C_O = parallel::C_array(D, key_s, alphabet_SO, n_threads);
+            parallel::parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e)
+                                   {
+                for (uint64_t i = b; i < e; i++)
+                    new_O[i + 1] = std::get<2>(D[i]); });
+
+            // OSP, the sort is stable
+            parallel::radix_sort(D, buffer, key_o, alphabet_SO, n_threads);
+            vector<uint64_t> new_C_P = parallel::C_array(D, key_o, alphabet_SO, n_threads);
+            parallel::parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e)
+                                   {
+                for (uint64_t i = b; i < e; i++)
+                    new_P[i + 1] = std::get<1>(D[i]); });
+
+            // POS
+            parallel::radix_sort(D, buffer, key_p, m_max_p, n_threads);
+            vector<uint64_t> new_C_S = parallel::C_array(D, key_p, m_max_p, n_threads);
+            parallel::parallel_for(n, n_threads, [&](uint64_t t, uint64_t b, uint64_t e)
+                                   {
+                for (uint64_t i = b; i < e; i++)
+                    new_S[i + 1] = std::get<0>(D[i]); });
+            vector<spo_triple_type>().swap(buffer);
+
+            // Builds the three BWTs concurrently
+            std::thread th_o([&]()
+                             {
+                util::bit_compress(new_O);
+                m_bwt_o = bwt_so_type(new_O, new_C_O, alphabet_SO); });
+            std::thread th_p([&]()
+                             {
+                util::bit_compress(new_P);
+                m_bwt_p = bwt_p_type(new_P, new_C_P, m_max_p); });
+            util::bit_compress(new_S);
+            m_bwt_s = bwt_so_type(new_S, new_C_S, alphabet_SO);
+            th_o.join();
+            th_p.join();
+        };
+
         //! Copy constructor
         ring(const ring &o)
         {
@@ -240,6 +418,9 @@ namespace ring
                 m_max_p = o.m_max_p;
                 m_max_o = o.m_max_o;
                 m_n_triples = o.m_n_triples;
+                m_stats = std::move(o.m_stats);
+                m_epoch = o.m_epoch;
+                m_predicate_epoch = std::move(o.m_predicate_epoch);
             }
             return *this;
         }
@@ -254,6 +435,9 @@ namespace ring
             std::swap(m_max_p, o.m_max_p);
             std::swap(m_max_o, o.m_max_o);
             std::swap(m_n_triples, o.m_n_triples);
+            m_stats.swap(o.m_stats);
+            std::swap(m_epoch, o.m_epoch);
+            std::swap(m_predicate_epoch, o.m_predicate_epoch);
         }
 
         //! Serializes the data structure into the given ostream
@@ -450,6 +634,12 @@ namespace ring
             return m_bwt_o.values_in_range(I.left(), I.right());
         }
 
+        //! Same as all_O_in_range, into a reusable buffer and with the number of occurrences
+        void all_O_in_range(bwt_interval &I, range_values &res)
+        {
+            m_bwt_o.values_in_range(I.left(), I.right(), res);
+        }
+
         /**********************************/
         // Functions for OPS
         //
@@ -519,6 +709,12 @@ namespace ring
             return m_bwt_s.values_in_range(I.left(), I.right());
         }
 
+        //! Same as all_S_in_range, into a reusable buffer and with the number of occurrences
+        void all_S_in_range(bwt_interval &I, range_values &res)
+        {
+            m_bwt_s.values_in_range(I.left(), I.right(), res);
+        }
+
         /**********************************/
         // Function for SOP
         //
@@ -588,6 +784,12 @@ namespace ring
             return m_bwt_p.values_in_range(I.left(), I.right());
         }
 
+        //! Same as all_P_in_range, into a reusable buffer and with the number of occurrences
+        void all_P_in_range(bwt_interval &I, range_values &res)
+        {
+            m_bwt_p.values_in_range(I.left(), I.right(), res);
+        }
+
         /**********************************/
         // Functions for SPO
         //
@@ -812,6 +1014,12 @@ namespace ring
 
         void insert(spo_triple triple);
 
+        void insert_batch(std::vector<spo_triple> &triples);
+
+        uint64_t remove_batch(std::vector<spo_triple> &triples);
+
+        bool contains(spo_triple triple);
+
         spo_valid_triple remove_edge_and_check(spo_triple triple);
 
         void remove_edge(spo_triple triple);
@@ -822,6 +1030,47 @@ namespace ring
 
         uint64_t bit_size();
 
+        /**
+         * Statistics of the triples for the GAO (see stats_catalog). They are stored
+         * apart from the ring, and once built or loaded the updates keep them up to date.
+         */
+        stats_catalog &stats()
+        {
+            return m_stats;
+        }
+
+        const stats_catalog &stats() const
+        {
+            return m_stats;
+        }
+
+        //! Number of triples
+        size_type n_triples() const
+        {
+            return m_n_triples;
+        }
+
+        //! Number of updates applied since the ring was built or loaded
+        size_type epoch() const
+        {
+            return m_epoch;
+        }
+
+        //! Last update (see epoch) that inserted or removed triples with predicate p, 0 if none
+        size_type predicate_epoch(const uint64_t p) const
+        {
+            return p < m_predicate_epoch.size() ? m_predicate_epoch[p] : 0;
+        }
+
+        //! Predicates of the subject s with the number of triples of each one
+        void subject_profile(uint64_t s, stats_catalog::profile_type &profile);
+
+        //! Number of triples with predicate p and object o
+        uint64_t count_PO(uint64_t p, uint64_t o);
+
+        //! Number of triples with subject s and predicate p
+        uint64_t count_SP(uint64_t s, uint64_t p);
+
         uint64_t min_P_in_OS(bwt_interval &I)
         {
             return I.begin(m_bwt_p);
@@ -1023,6 +1272,7 @@ namespace ring
         uint64_t o = get<2>(triple);
 
         uint64_t low = 0, high = 0;
+        update_scope su(*this, triple);
 
         // Update the alphabet size if the symbols are new
         if (s > m_bwt_s.alphabet_size())
@@ -1046,6 +1296,8 @@ namespace ring
             m_bwt_o.increment_alphabet();
             m_bwt_s.increment_alphabet();
         }
+        m_max_s = m_max_o = std::max(m_max_s, std::max(s, o));
+        m_max_p = std::max(m_max_p, p);
 
         // Insert in the wavelet trees
         low = m_bwt_s.get_C(p);
@@ -1057,13 +1309,13 @@ namespace ring
         {
             insert_index = low;
             m_bwt_s.insert_WT(insert_index, s);
-            m_bwt_o.insert_C(m_bwt_o.select_C(s + 1), 0);
+            m_bwt_o.increment_C(s);
             insert_index = m_bwt_o.get_C(s) + m_bwt_s.ranky(insert_index, s);
             m_bwt_o.insert_WT(insert_index, o);
-            m_bwt_p.insert_C(m_bwt_p.select_C(o + 1), 0);
+            m_bwt_p.increment_C(o);
             insert_index = m_bwt_p.get_C(o) + m_bwt_o.ranky(insert_index, o);
             m_bwt_p.insert_WT(insert_index, p);
-            m_bwt_s.insert_C(m_bwt_s.select_C(p + 1), 0);
+            m_bwt_s.increment_C(p);
             m_n_triples++;
 
             return;
@@ -1077,13 +1329,13 @@ namespace ring
         {
             insert_index = low;
             m_bwt_o.insert_WT(insert_index, o); // SPO
-            m_bwt_p.insert_C(m_bwt_p.select_C(o + 1), 0);
+            m_bwt_p.increment_C(o);
             insert_index = m_bwt_p.get_C(o) + m_bwt_o.ranky(insert_index, o);
             m_bwt_p.insert_WT(insert_index, p); // OSP
-            m_bwt_s.insert_C(m_bwt_s.select_C(p + 1), 0);
+            m_bwt_s.increment_C(p);
             insert_index = m_bwt_s.get_C(p) + m_bwt_p.ranky(insert_index, p);
             m_bwt_s.insert_WT(insert_index, s); // POS
-            m_bwt_o.insert_C(m_bwt_o.select_C(s + 1), 0);
+            m_bwt_o.increment_C(s);
             m_n_triples++;
 
             return;
@@ -1097,19 +1349,217 @@ namespace ring
         {
             insert_index = low;
             m_bwt_p.insert_WT(insert_index, p);
-            m_bwt_s.insert_C(m_bwt_s.select_C(p + 1), 0);
+            m_bwt_s.increment_C(p);
             insert_index = m_bwt_s.get_C(p) + m_bwt_p.ranky(insert_index, p);
             m_bwt_s.insert_WT(insert_index, s);
-            m_bwt_o.insert_C(m_bwt_o.select_C(s + 1), 0);
+            m_bwt_o.increment_C(s);
             insert_index = m_bwt_o.get_C(s) + m_bwt_s.ranky(insert_index, s);
             m_bwt_o.insert_WT(insert_index, o);
-            m_bwt_p.insert_C(m_bwt_p.select_C(o + 1), 0);
+            m_bwt_p.increment_C(o);
             m_n_triples++;
 
             return;
         }
     }
 
+    /**
+     * @brief Checks if a triple is in the ring
+     *
+     * @param triple The triple being searched
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    bool ring<bwt_so_t, bwt_p_t>::contains(spo_triple triple)
+    {
+        uint64_t s = get<0>(triple);
+        uint64_t p = get<1>(triple);
+        uint64_t o = get<2>(triple);
+
+        if (s > m_bwt_s.alphabet_size() || p > m_bwt_p.alphabet_size() || o > m_bwt_o.alphabet_size())
+            return false;
+
+        uint64_t low = m_bwt_s.get_C(p);
+        uint64_t high = m_bwt_s.get_C(p + 1) - 1;
+        if (low > high) return false;
+
+        uint64_t c = m_bwt_o.get_C(s);
+        uint64_t aux = c + m_bwt_s.ranky(low, s);
+        high = c - 1 + m_bwt_s.ranky(high + 1, s);
+        low = aux;
+        if (low > high) return false;
+
+        c = m_bwt_p.get_C(o);
+        aux = c + m_bwt_o.ranky(low, o);
+        high = c - 1 + m_bwt_o.ranky(high + 1, o);
+        return aux <= high;
+    }
+
+    /**
+     * @brief Insert a batch of triples in the ring. Keeps the sorting
+     *        and updates the bitvectors in the wavelet trees
+     * The positions of the new triples in the three orders are computed first on the
+     * ring before the insertion: the position of a triple in SPO order is the number of
+     * triples smaller than it (obtained by backward search) plus the number of new
+     * triples smaller than it. Then each BWT receives its symbols in increasing order
+     * of position, and its C bitvector one update per distinct symbol.
+     * The triples that already exist (or are repeated) are not inserted.
+     *
+     * @tparam
+     * @param triples The triples being inserted, they are sorted and deduplicated
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    void ring<bwt_so_t, bwt_p_t>::insert_batch(std::vector<spo_triple> &triples)
+    {
+        sort(triples.begin(), triples.end());
+        triples.erase(unique(triples.begin(), triples.end()), triples.end());
+        if (triples.empty()) return;
+
+        // Update the alphabet size if the symbols are new
+        uint64_t max_so = 0, max_p = 0;
+        for (const spo_triple &t : triples)
+        {
+            max_so = std::max(max_so, (uint64_t)std::max(get<0>(t), get<2>(t)));
+            max_p = std::max(max_p, (uint64_t)get<1>(t));
+        }
+        while (max_so > m_bwt_s.alphabet_size())
+        {
+            m_bwt_o.push_back_C(1);
+            m_bwt_p.push_back_C(1);
+            m_bwt_o.increment_alphabet();
+            m_bwt_s.increment_alphabet();
+        }
+        while (max_p > m_bwt_p.alphabet_size())
+        {
+            m_bwt_s.push_back_C(1);
+            m_bwt_p.increment_alphabet();
+        }
+        m_max_s = m_max_o = std::max(m_max_s, max_so);
+        m_max_p = std::max(m_max_p, max_p);
+
+        triples.erase(remove_if(triples.begin(), triples.end(), [this](const spo_triple &t)
+                                { return contains(t); }),
+                      triples.end());
+        if (triples.empty()) return;
+        update_scope su(*this, triples);
+
+        // Positions before the insertion
+        std::vector<batch_item> items;
+        items.reserve(triples.size());
+        for (const spo_triple &t : triples)
+        {
+            batch_item it{get<0>(t), get<1>(t), get<2>(t), 0, 0, 0};
+            uint64_t c_o = m_bwt_o.get_C(it.s);
+            uint64_t c_p = m_bwt_p.get_C(it.o);
+            uint64_t c_s = m_bwt_s.get_C(it.p);
+            it.pos_spo = c_o + m_bwt_s.ranky(c_s + m_bwt_p.ranky(c_p, it.p), it.s);
+            it.pos_osp = c_p + m_bwt_o.ranky(c_o + m_bwt_s.ranky(c_s, it.s), it.o);
+            it.pos_pos = c_s + m_bwt_p.ranky(c_p + m_bwt_o.ranky(c_o, it.o), it.p);
+            items.push_back(it);
+        }
+
+        // SPO: triples are already sorted
+        for (uint64_t j = 0; j < items.size(); j++)
+        {
+            m_bwt_o.insert_WT(items[j].pos_spo + j, items[j].o);
+        }
+        // OSP
+        stable_sort(items.begin(), items.end(), [](const batch_item &a, const batch_item &b)
+                    { return std::tie(a.o, a.s, a.p) < std::tie(b.o, b.s, b.p); });
+        for (uint64_t j = 0; j < items.size(); j++)
+        {
+            m_bwt_p.insert_WT(items[j].pos_osp + j, items[j].p);
+        }
+        // POS
+        stable_sort(items.begin(), items.end(), [](const batch_item &a, const batch_item &b)
+                    { return std::tie(a.p, a.o, a.s) < std::tie(b.p, b.o, b.s); });
+        for (uint64_t j = 0; j < items.size(); j++)
+        {
+            m_bwt_s.insert_WT(items[j].pos_pos + j, items[j].s);
+        }
+
+        // C bitvectors: the new zeros of each symbol go at the end of its block
+        std::vector<uint64_t> keys(items.size());
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].s;
+        insert_C_batch(m_bwt_o, keys);
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].p;
+        insert_C_batch(m_bwt_s, keys);
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].o;
+        insert_C_batch(m_bwt_p, keys);
+
+        m_n_triples += items.size();
+    }
+
+    /**
+     * @brief Removes a set of triples, given with their positions in the three orders.
+     *        Each BWT removes its positions in one descending sweep, so the positions
+     *        still to remove are not shifted, and each C bitvector is updated once per
+     *        distinct symbol.
+     *
+     * @param items The triples being removed with their positions
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    void ring<bwt_so_t, bwt_p_t>::remove_items(std::vector<batch_item> &items)
+    {
+        update_scope su(*this, items);
+        sort(items.begin(), items.end(), [](const batch_item &a, const batch_item &b)
+             { return a.pos_spo > b.pos_spo; });
+        for (const batch_item &it : items)
+            m_bwt_o.remove_WT(it.pos_spo);
+        sort(items.begin(), items.end(), [](const batch_item &a, const batch_item &b)
+             { return a.pos_osp > b.pos_osp; });
+        for (const batch_item &it : items)
+            m_bwt_p.remove_WT(it.pos_osp);
+        sort(items.begin(), items.end(), [](const batch_item &a, const batch_item &b)
+             { return a.pos_pos > b.pos_pos; });
+        for (const batch_item &it : items)
+            m_bwt_s.remove_WT(it.pos_pos);
+
+        std::vector<uint64_t> keys(items.size());
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].s;
+        remove_C_batch(m_bwt_o, keys);
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].p;
+        remove_C_batch(m_bwt_s, keys);
+        for (uint64_t j = 0; j < items.size(); j++) keys[j] = items[j].o;
+        remove_C_batch(m_bwt_p, keys);
+
+        m_n_triples -= items.size();
+    }
+
+    /**
+     * @brief Remove a batch of triples (edges) from the ring. Keeps the sorting
+     *        and updates the bitvectors in the wavelet trees
+     * The positions of all the triples in the three orders are computed before
+     * removing any of them, as in insert_batch.
+     * The triples that do not exist (or are repeated) are ignored.
+     *
+     * @tparam
+     * @param triples The triples being removed, they are sorted and deduplicated
+     *
+     * @return the amount of triples deleted
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    uint64_t ring<bwt_so_t, bwt_p_t>::remove_batch(std::vector<spo_triple> &triples)
+    {
+        sort(triples.begin(), triples.end());
+        triples.erase(unique(triples.begin(), triples.end()), triples.end());
+
+        std::vector<batch_item> items;
+        items.reserve(triples.size());
+        for (const spo_triple &t : triples)
+        {
+            if (!contains(t)) continue;
+            batch_item it{get<0>(t), get<1>(t), get<2>(t), 0, 0, 0};
+            uint64_t c_o = m_bwt_o.get_C(it.s);
+            uint64_t c_p = m_bwt_p.get_C(it.o);
+            uint64_t c_s = m_bwt_s.get_C(it.p);
+            it.pos_spo = c_o + m_bwt_s.ranky(c_s + m_bwt_p.ranky(c_p, it.p), it.s);
+            it.pos_osp = c_p + m_bwt_o.ranky(c_o + m_bwt_s.ranky(c_s, it.s), it.o);
+            it.pos_pos = c_s + m_bwt_p.ranky(c_p + m_bwt_o.ranky(c_o, it.o), it.p);
+            items.push_back(it);
+        }
+        remove_items(items);
+        return items.size();
+    }
+
     /**
      * @brief remove a triple (edge) from the ring. Keeps the sorting
      *        and updates the bitvectors in the wavelet trees
@@ -1128,6 +1578,7 @@ namespace ring
         uint64_t o = get<2>(triple);
 
         uint64_t low = 0, high = 0;
+        update_scope su(*this, triple);
 
         // Find triple
         // find triple with p
@@ -1153,9 +1604,9 @@ namespace ring
             m_bwt_o.remove_WT(o_remove_index);
 
             // Update the bitvectors
-            m_bwt_o.remove_C(m_bwt_o.select_C(s + 1) - 1);
-            m_bwt_s.remove_C(m_bwt_s.select_C(p + 1) - 1);
-            m_bwt_p.remove_C(m_bwt_p.select_C(o + 1) - 1);
+            m_bwt_o.decrement_C(s);
+            m_bwt_s.decrement_C(p);
+            m_bwt_p.decrement_C(o);
 
             // Check if the elements s,p,o are still in use
             bool s_is_used = m_bwt_o.nElems(s) || m_bwt_p.nElems(s);
@@ -1186,6 +1637,7 @@ namespace ring
         uint64_t o = get<2>(triple);
 
         uint64_t low = 0, high = 0;
+        update_scope su(*this, triple);
 
         // Find triple
         low = m_bwt_s.get_C(p);
@@ -1202,9 +1654,9 @@ namespace ring
             m_bwt_p.remove_WT(p_remove_index);
 
             // Update the bitvectors
-            m_bwt_o.remove_C(m_bwt_o.select_C(s + 1) - 1);
-            m_bwt_s.remove_C(m_bwt_s.select_C(p + 1) - 1);
-            m_bwt_p.remove_C(m_bwt_p.select_C(o + 1) - 1);
+            m_bwt_o.decrement_C(s);
+            m_bwt_s.decrement_C(p);
+            m_bwt_p.decrement_C(o);
 
             return ;
         }
@@ -1224,9 +1676,9 @@ namespace ring
             m_bwt_s.remove_WT(s_remove_index);
 
             // Update the bitvectors
-            m_bwt_o.remove_C(m_bwt_o.select_C(s + 1) - 1);
-            m_bwt_s.remove_C(m_bwt_s.select_C(p + 1) - 1);
-            m_bwt_p.remove_C(m_bwt_p.select_C(o + 1) - 1);
+            m_bwt_o.decrement_C(s);
+            m_bwt_s.decrement_C(p);
+            m_bwt_p.decrement_C(o);
 
             return;
         }
@@ -1246,9 +1698,9 @@ namespace ring
             m_bwt_o.remove_WT(o_remove_index);
 
             // Update the bitvectors
-            m_bwt_o.remove_C(m_bwt_o.select_C(s + 1) - 1);
-            m_bwt_s.remove_C(m_bwt_s.select_C(p + 1) - 1);
-            m_bwt_p.remove_C(m_bwt_p.select_C(o + 1) - 1);
+            m_bwt_o.decrement_C(s);
+            m_bwt_s.decrement_C(p);
+            m_bwt_p.decrement_C(o);
 
             return;
         }
@@ -1257,68 +1709,70 @@ namespace ring
     }
 
     /**
-     * @brief remove all the triples associated to node value x from the ring.
-     *        Keeps the sorting and updates the bitvectors in the wavelet trees
-     *
-     *
-     * @tparam
-     * @param x The value of the node being removed
+     * @brief Collects the triples with S=x or O=x and their positions in the three
+     *        orders, following the LF steps from their ranges in SPO and OSP
      *
-     * @return the amount of triples deleted
+     * @param x The value of the node
+     * @param items Vector where the triples are appended
      */
     template <class bwt_so_t, class bwt_p_t>
-    uint64_t ring<bwt_so_t, bwt_p_t>::remove_node(uint64_t x)
+    void ring<bwt_so_t, bwt_p_t>::node_items(uint64_t x, std::vector<batch_item> &items)
     {
-        tuple<uint64_t, uint64_t> restricted_range = {m_bwt_o.get_C(x), m_bwt_o.get_C(x + 1) - 1};
-        uint64_t low = get<0>(restricted_range), high = get<1>(restricted_range);
-        uint64_t ret_value = 0;
-        uint64_t new_index = 0;
-        uint64_t total_removed = high - low + 1;
+        std::pair<uint64_t, uint64_t> r;
+        uint64_t low = m_bwt_o.get_C(x), high = m_bwt_o.get_C(x + 1) - 1;
 
-        // Remove every triple with S=x
+        // Every triple with S=x
         for (uint64_t i = low; i <= high; i++)
         {
-            // Remove from SPO
-            ret_value = m_bwt_o.remove_node_and_return(low);
-            new_index = m_bwt_p.get_C(ret_value) + m_bwt_o.ranky(low, ret_value);
-            m_bwt_p.remove_C(m_bwt_p.select_C(ret_value + 1) - 1);
-
-            // Remove from OSP
-            ret_value = m_bwt_p.remove_node_and_return(new_index);
-            new_index = m_bwt_s.get_C(ret_value) + m_bwt_p.ranky(new_index, ret_value);
-            m_bwt_s.remove_C(m_bwt_s.select_C(ret_value + 1) - 1);
-
-            // Remove from POS
-            ret_value = m_bwt_s.remove_node_and_return(new_index);
-            new_index = m_bwt_o.get_C(ret_value) + m_bwt_s.ranky(new_index, ret_value);
-            m_bwt_o.remove_C(m_bwt_o.select_C(ret_value + 1) - 1);
+            batch_item it;
+            it.s = x;
+            it.pos_spo = i;
+            r = m_bwt_o.inverse_select(i);
+            it.o = r.second;
+            it.pos_osp = m_bwt_p.get_C(it.o) + r.first;
+            r = m_bwt_p.inverse_select(it.pos_osp);
+            it.p = r.second;
+            it.pos_pos = m_bwt_s.get_C(it.p) + r.first;
+            items.push_back(it);
         }
 
         low = m_bwt_p.get_C(x);
         high = m_bwt_p.get_C(x + 1) - 1;
-        total_removed += high - low + 1;
 
-        // Remove every triple with O=x
+        // Every triple with O=x, the ones with S=x are already collected
         for (uint64_t i = low; i <= high; i++)
         {
-            // Remove from OSP
-            ret_value = m_bwt_p.remove_node_and_return(low);
-            new_index = m_bwt_s.get_C(ret_value) + m_bwt_p.ranky(low, ret_value);
-            m_bwt_s.remove_C(m_bwt_s.select_C(ret_value + 1) - 1);
-
-            // Remove from POS
-            ret_value = m_bwt_s.remove_node_and_return(new_index);
-            new_index = m_bwt_o.get_C(ret_value) + m_bwt_s.ranky(new_index, ret_value);
-            m_bwt_o.remove_C(m_bwt_o.select_C(ret_value + 1) - 1);
-
-            // Remove from SPO
-            ret_value = m_bwt_o.remove_node_and_return(new_index);
-            new_index = m_bwt_p.get_C(ret_value) + m_bwt_o.ranky(new_index, ret_value);
-            m_bwt_p.remove_C(m_bwt_p.select_C(ret_value + 1) - 1);
+            batch_item it;
+            it.o = x;
+            it.pos_osp = i;
+            r = m_bwt_p.inverse_select(i);
+            it.p = r.second;
+            it.pos_pos = m_bwt_s.get_C(it.p) + r.first;
+            r = m_bwt_s.inverse_select(it.pos_pos);
+            it.s = r.second;
+            if (it.s == x) continue;
+            it.pos_spo = m_bwt_o.get_C(it.s) + r.first;
+            items.push_back(it);
         }
-        m_n_triples -= total_removed;
+    }
 
-        return total_removed;
+    /**
+     * @brief remove all the triples associated to node value x from the ring.
+     *        Keeps the sorting and updates the bitvectors in the wavelet trees
+     *
+     *
+     * @tparam
+     * @param x The value of the node being removed
+     *
+     * @return the amount of triples deleted
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    uint64_t ring<bwt_so_t, bwt_p_t>::remove_node(uint64_t x)
+    {
+        std::vector<batch_item> items;
+        node_items(x, items);
+        remove_items(items);
+        return items.size();
     }
 
     /**
@@ -1337,77 +1791,75 @@ namespace ring
     template <class bwt_so_t, class bwt_p_t>
     uint64_t ring<bwt_so_t, bwt_p_t>::remove_node_with_check(uint64_t x, std::vector<uint64_t> &so_removed, std::vector<uint64_t> &p_removed)
     {
-        tuple<uint64_t, uint64_t> restricted_range = {m_bwt_o.get_C(x), m_bwt_o.get_C(x + 1) - 1};
-        uint64_t low = get<0>(restricted_range), high = get<1>(restricted_range);
-        uint64_t ret_value = 0;
-        uint64_t new_index = 0;
-        uint64_t total_removed = 0;
+        std::vector<batch_item> items;
+        node_items(x, items);
+        remove_items(items);
 
-        if (high >= low)
+        // Values of the removed triples that are not used anymore (x is removed by the caller)
+        std::vector<uint64_t> so_values, p_values;
+        for (const batch_item &it : items)
         {
-            total_removed += high - low + 1;
-
-            // Remove every triple with S=x
-            for (uint64_t i = low; i <= high; i++)
-            {
-                // Remove from SPO
-                ret_value = m_bwt_o.remove_node_and_return(low);
-                new_index = m_bwt_p.get_C(ret_value) + m_bwt_o.ranky(low, ret_value);
-                m_bwt_p.remove_C(m_bwt_p.select_C(ret_value + 1) - 1);
-
-                if (m_bwt_o.nElems(ret_value) == 0 && m_bwt_p.nElems(ret_value) == 0)
-                    so_removed.emplace_back(ret_value);
-
-                // Remove from OSP
-                ret_value = m_bwt_p.remove_node_and_return(new_index);
-                new_index = m_bwt_s.get_C(ret_value) + m_bwt_p.ranky(new_index, ret_value);
-                m_bwt_s.remove_C(m_bwt_s.select_C(ret_value + 1) - 1);
-
-                if (m_bwt_s.nElems(ret_value) == 0)
-                    p_removed.emplace_back(ret_value);
-
-                // Remove from POS
-                ret_value = m_bwt_s.remove_node_and_return(new_index);
-                new_index = m_bwt_o.get_C(ret_value) + m_bwt_s.ranky(new_index, ret_value);
-                m_bwt_o.remove_C(m_bwt_o.select_C(ret_value + 1) - 1);
-            }
+            if (it.s != x) so_values.push_back(it.s);
+            if (it.o != x) so_values.push_back(it.o);
+            p_values.push_back(it.p);
         }
+        sort(so_values.begin(), so_values.end());
+        so_values.erase(unique(so_values.begin(), so_values.end()), so_values.end());
+        sort(p_values.begin(), p_values.end());
+        p_values.erase(unique(p_values.begin(), p_values.end()), p_values.end());
 
-        low = m_bwt_p.get_C(x);
-        high = m_bwt_p.get_C(x + 1) - 1;
-
-        if (high >= low)
+        for (uint64_t v : so_values)
+        {
+            if (m_bwt_o.nElems(v) == 0 && m_bwt_p.nElems(v) == 0)
+                so_removed.emplace_back(v);
+        }
+        for (uint64_t v : p_values)
         {
-            total_removed += high - low + 1;
+            if (m_bwt_s.nElems(v) == 0)
+                p_removed.emplace_back(v);
+        }
+        return items.size();
+    }
 
-            // Remove every triple with O=x
-            for (uint64_t i = low; i <= high; i++)
-            {
-                // Remove from OSP
-                ret_value = m_bwt_p.remove_node_and_return(low);
-                new_index = m_bwt_s.get_C(ret_value) + m_bwt_p.ranky(low, ret_value);
-                m_bwt_s.remove_C(m_bwt_s.select_C(ret_value + 1) - 1);
-
-                if (m_bwt_s.nElems(ret_value) == 0)
-                    p_removed.emplace_back(ret_value);
-
-                // Remove from POS
-                ret_value = m_bwt_s.remove_node_and_return(new_index);
-                new_index = m_bwt_o.get_C(ret_value) + m_bwt_s.ranky(new_index, ret_value);
-                m_bwt_o.remove_C(m_bwt_o.select_C(ret_value + 1) - 1);
-
-                if (m_bwt_p.nElems(ret_value) == 0 && m_bwt_o.nElems(ret_value) == 0)
-                    so_removed.emplace_back(ret_value);
-
-                // Remove from SPO
-                ret_value = m_bwt_o.remove_node_and_return(new_index);
-                new_index = m_bwt_p.get_C(ret_value) + m_bwt_o.ranky(new_index, ret_value);
-                m_bwt_p.remove_C(m_bwt_p.select_C(ret_value + 1) - 1);
-            }
+    /**
+     * @brief Predicates of a subject, following the ones of S in POS order as the
+     *        leaps of ltj_iterator do
+     *
+     * @param s The subject
+     * @param profile Predicates of s in increasing order with their number of triples
+     */
+    template <class bwt_so_t, class bwt_p_t>
+    void ring<bwt_so_t, bwt_p_t>::subject_profile(uint64_t s, stats_catalog::profile_type &profile)
+    {
+        profile.clear();
+        if (s == 0 || s > m_max_s || m_bwt_o.nElems(s) == 0)
+            return;
+        bwt_interval I = down_S(s);
+        uint64_t p = min_P_in_S(I, s);
+        while (p != 0)
+        {
+            profile.emplace_back(p, down_S_P(I, s, p).size());
+            p = next_P_in_S(I, s, p + 1);
         }
-        m_n_triples -= total_removed;
+    }
+
+    template <class bwt_so_t, class bwt_p_t>
+    uint64_t ring<bwt_so_t, bwt_p_t>::count_PO(uint64_t p, uint64_t o)
+    {
+        if (p == 0 || o == 0 || p > m_max_p || o > m_max_o)
+            return 0;
+        return m_bwt_p.ranky(m_bwt_p.get_C(o + 1), p) - m_bwt_p.ranky(m_bwt_p.get_C(o), p);
+    }
 
-        return total_removed;
+    template <class bwt_so_t, class bwt_p_t>
+    uint64_t ring<bwt_so_t, bwt_p_t>::count_SP(uint64_t s, uint64_t p)
+    {
+        if (s == 0 || p == 0 || s > m_max_s || m_bwt_o.nElems(s) == 0)
+            return 0;
+        bwt_interval I = down_S(s);
+        if (next_P_in_S(I, s, p) != p)
+            return 0;
+        return down_S_P(I, s, p).size();
     }
 
     template <class bwt_so_t, class bwt_p_t>
@@ -1426,6 +1878,7 @@ namespace ring
     typedef ring<bwt_dynamic, bwt_dynamic> ring_dyn; // dynamic
     typedef ring<big_bwt, big_bwt> medium_ring_dyn;  // dynamic
     typedef ring<bwt_dyn_amo, bwt_dyn_amo> ring_dyn_amo; // dynamic amortizado
+    typedef ring<bwt_mapped, bwt_mapped> ring_mapped;   // with select, used from a mapped file
 
 }
 
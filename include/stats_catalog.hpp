@@ -0,0 +1,487 @@
+/*
+ * stats_catalog.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_STATS_CATALOG_HPP
+#define RING_STATS_CATALOG_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "configuration.hpp"
+
+namespace ring {
+
+    /**
+     * Statistics of the graph for estimating the cost of the joins. For each predicate
+     * it keeps the number of triples and of distinct subjects and objects, and for the
+     * subjects their characteristic sets (the set of predicates of a subject) with the
+     * number of subjects and of triples of each predicate.
+     *
+     * It is built from the triples of the index (build) and stored as a sidecar file.
+     * The dynamic rings keep it up to date: begin_update saves the predicates of the
+     * subjects touched by an update and the counts of their (p,o) pairs, and end_update
+     * applies the differences once the update is done, counting again only the (s,p)
+     * and (p,o) pairs of the updated triples.
+     */
+    class stats_catalog
+    {
+    public:
+        typedef uint64_t size_type;
+        typedef std::vector<uint64_t> cset_type;                          // sorted predicates
+        typedef std::vector<std::pair<uint64_t, uint64_t>> profile_type; // predicates of a subject and their triples
+
+        struct predicate_stats
+        {
+            size_type triples = 0;
+            size_type distinct_s = 0;
+            size_type distinct_o = 0;
+
+            //! Average number of objects of a subject
+            double fan_out() const
+            {
+                return distinct_s ? (double)triples / distinct_s : 0.0;
+            }
+
+            //! Average number of subjects of an object
+            double fan_in() const
+            {
+                return distinct_o ? (double)triples / distinct_o : 0.0;
+            }
+        };
+
+        struct cset_stats
+        {
+            size_type subjects = 0;
+            std::vector<size_type> occurrences; // triples of each predicate of the set
+        };
+
+        // State of the subjects and (p,o) pairs before an update
+        struct update_type
+        {
+            std::vector<uint64_t> subjects;
+            std::vector<profile_type> profiles;
+            std::vector<std::pair<uint64_t, uint64_t>> sp;
+            std::vector<std::pair<uint64_t, uint64_t>> po;
+            std::vector<size_type> po_counts;
+        };
+
+    private:
+        bool m_enabled = false;
+        std::vector<predicate_stats> m_predicates;
+        std::map<cset_type, cset_stats> m_csets;
+        std::vector<std::set<const cset_type *>> m_csets_of_predicate; // sets containing each predicate
+
+        void copy(const stats_catalog &o)
+        {
+            m_enabled = o.m_enabled;
+            m_predicates = o.m_predicates;
+            m_csets = o.m_csets;
+            index_csets();
+        }
+
+        // The sets of each predicate point to the keys of m_csets
+        void index_csets()
+        {
+            m_csets_of_predicate.clear();
+            m_csets_of_predicate.resize(m_predicates.size());
+            for (const auto &e : m_csets)
+            {
+                for (uint64_t p : e.first)
+                    m_csets_of_predicate[p].insert(&e.first);
+            }
+        }
+
+        inline predicate_stats &predicate_ref(uint64_t p)
+        {
+            if (p >= m_predicates.size())
+            {
+                m_predicates.resize(p + 1);
+                m_csets_of_predicate.resize(p + 1);
+            }
+            return m_predicates[p];
+        }
+
+        // Adds (or removes) a subject with the given predicates
+        void add_profile(const profile_type &profile, const bool add)
+        {
+            if (profile.empty())
+                return;
+            cset_type key(profile.size());
+            for (uint64_t i = 0; i < profile.size(); i++)
+                key[i] = profile[i].first;
+
+            auto it = m_csets.find(key);
+            if (it == m_csets.end())
+            {
+                if (!add)
+                    return;
+                it = m_csets.emplace(std::move(key), cset_stats()).first;
+                it->second.occurrences.assign(profile.size(), 0);
+                for (uint64_t p : it->first)
+                {
+                    predicate_ref(p);
+                    m_csets_of_predicate[p].insert(&it->first);
+                }
+            }
+            cset_stats &cs = it->second;
+            for (uint64_t i = 0; i < profile.size(); i++)
+            {
+                predicate_stats &ps = predicate_ref(profile[i].first);
+                if (add)
+                {
+                    cs.occurrences[i] += profile[i].second;
+                    ps.triples += profile[i].second;
+                    ps.distinct_s++;
+                }
+                else
+                {
+                    cs.occurrences[i] -= profile[i].second;
+                    ps.triples -= profile[i].second;
+                    ps.distinct_s--;
+                }
+            }
+            if (add)
+            {
+                cs.subjects++;
+            }
+            else if (--cs.subjects == 0)
+            {
+                for (uint64_t p : it->first)
+                    m_csets_of_predicate[p].erase(&it->first);
+                m_csets.erase(it);
+            }
+        }
+
+        template <class t_value>
+        static void write_value(std::ostream &out, const t_value &v)
+        {
+            out.write((const char *)&v, sizeof(v));
+        }
+
+        template <class t_value>
+        static void read_value(std::istream &in, t_value &v)
+        {
+            in.read((char *)&v, sizeof(v));
+        }
+
+    public:
+        stats_catalog() = default;
+
+        //! Copy constructor
+        stats_catalog(const stats_catalog &o)
+        {
+            copy(o);
+        }
+
+        //! Move constructor
+        stats_catalog(stats_catalog &&o)
+        {
+            *this = std::move(o);
+        }
+
+        //! Copy Operator=
+        stats_catalog &operator=(const stats_catalog &o)
+        {
+            if (this != &o)
+            {
+                copy(o);
+            }
+            return *this;
+        }
+
+        //! Move Operator=
+        stats_catalog &operator=(stats_catalog &&o)
+        {
+            if (this != &o)
+            {
+                // the nodes of the map are moved, so the pointers stay valid
+                m_enabled = o.m_enabled;
+                m_predicates = std::move(o.m_predicates);
+                m_csets = std::move(o.m_csets);
+                m_csets_of_predicate = std::move(o.m_csets_of_predicate);
+            }
+            return *this;
+        }
+
+        void swap(stats_catalog &o)
+        {
+            std::swap(m_enabled, o.m_enabled);
+            std::swap(m_predicates, o.m_predicates);
+            std::swap(m_csets, o.m_csets);
+            std::swap(m_csets_of_predicate, o.m_csets_of_predicate);
+        }
+
+        //! False until it is built or loaded, then the rings maintain it
+        bool enabled() const
+        {
+            return m_enabled;
+        }
+
+        /**
+         * Computes the statistics of a set of triples.
+         *
+         * @param D     Triples without repetitions, they are sorted
+         */
+        void build(std::vector<spo_triple> &D)
+        {
+            m_predicates.clear();
+            m_csets.clear();
+            m_enabled = true;
+
+            // SPO: characteristic sets, triples and distinct subjects
+            std::sort(D.begin(), D.end());
+            profile_type profile;
+            for (uint64_t i = 0, j; i < D.size(); i = j)
+            {
+                profile.clear();
+                for (j = i; j < D.size() && std::get<0>(D[j]) == std::get<0>(D[i]); j++)
+                {
+                    uint64_t p = std::get<1>(D[j]);
+                    if (profile.empty() || profile.back().first != p)
+                        profile.emplace_back(p, 0);
+                    profile.back().second++;
+                }
+                add_profile(profile, true);
+            }
+
+            // POS: distinct objects
+            std::sort(D.begin(), D.end(), [](const spo_triple &a, const spo_triple &b)
+                      { return std::tie(std::get<1>(a), std::get<2>(a), std::get<0>(a)) <
+                               std::tie(std::get<1>(b), std::get<2>(b), std::get<0>(b)); });
+            for (uint64_t i = 0; i < D.size(); i++)
+            {
+                if (i == 0 || std::get<1>(D[i]) != std::get<1>(D[i - 1]) || std::get<2>(D[i]) != std::get<2>(D[i - 1]))
+                    predicate_ref(std::get<1>(D[i])).distinct_o++;
+            }
+        }
+
+        predicate_stats predicate(uint64_t p) const
+        {
+            if (p >= m_predicates.size())
+                return predicate_stats();
+            return m_predicates[p];
+        }
+
+        size_type n_csets() const
+        {
+            return m_csets.size();
+        }
+
+        /**
+         * Number of subjects that have all the given predicates, that is, the sum of
+         * the subjects of the characteristic sets that contain them.
+         *
+         * @param first     First of the sorted predicates
+         * @param last      End of the sorted predicates
+         */
+        template <class iterator_t>
+        size_type subjects_with(iterator_t first, iterator_t last) const
+        {
+            if (first == last)
+                return 0;
+            // The sets of the rarest predicate
+            uint64_t rarest = *first;
+            for (iterator_t it = first; it != last; ++it)
+            {
+                uint64_t p = *it;
+                if (p >= m_csets_of_predicate.size())
+                    return 0;
+                if (m_csets_of_predicate[p].size() < m_csets_of_predicate[rarest].size())
+                    rarest = p;
+            }
+            size_type subjects = 0;
+            for (const cset_type *key : m_csets_of_predicate[rarest])
+            {
+                if (std::includes(key->begin(), key->end(), first, last))
+                    subjects += m_csets.find(*key)->second.subjects;
+            }
+            return subjects;
+        }
+
+        //! Same as above for a vector of sorted predicates
+        size_type subjects_with(const cset_type &predicates) const
+        {
+            return subjects_with(predicates.begin(), predicates.end());
+        }
+
+        /**
+         * Saves the subjects of the triples being updated, with their predicates, and
+         * the number of triples of their (p,o) pairs. Called before the update.
+         *
+         * @param r         Ring, before the update
+         * @param triples   Triples being inserted or removed, they may not be in the ring
+         * @param u         State before the update
+         */
+        template <class ring_t>
+        void begin_update(ring_t &r, const std::vector<spo_triple> &triples, update_type &u) const
+        {
+            u.subjects.clear();
+            u.sp.clear();
+            u.po.clear();
+            for (const spo_triple &t : triples)
+            {
+                u.sp.emplace_back(std::get<0>(t), std::get<1>(t));
+                u.po.emplace_back(std::get<1>(t), std::get<2>(t));
+            }
+            std::sort(u.sp.begin(), u.sp.end());
+            u.sp.erase(std::unique(u.sp.begin(), u.sp.end()), u.sp.end());
+            for (const auto &sp : u.sp)
+            {
+                if (u.subjects.empty() || u.subjects.back() != sp.first)
+                    u.subjects.push_back(sp.first);
+            }
+            std::sort(u.po.begin(), u.po.end());
+            u.po.erase(std::unique(u.po.begin(), u.po.end()), u.po.end());
+
+            u.profiles.resize(u.subjects.size());
+            for (uint64_t i = 0; i < u.subjects.size(); i++)
+                r.subject_profile(u.subjects[i], u.profiles[i]);
+            u.po_counts.resize(u.po.size());
+            for (uint64_t i = 0; i < u.po.size(); i++)
+                u.po_counts[i] = r.count_PO(u.po[i].first, u.po[i].second);
+        }
+
+        /**
+         * Applies the differences between the state saved by begin_update and the
+         * current one. Called after the update. Only the predicates of the updated
+         * triples can have changed in the profile of a subject, so just those are
+         * counted again.
+         *
+         * @param r     Ring, after the update
+         * @param u     State before the update
+         */
+        template <class ring_t>
+        void end_update(ring_t &r, update_type &u)
+        {
+            profile_type profile;
+            for (uint64_t i = 0, j = 0; i < u.subjects.size(); i++)
+            {
+                profile = u.profiles[i];
+                bool changed = false;
+                for (; j < u.sp.size() && u.sp[j].first == u.subjects[i]; j++)
+                {
+                    uint64_t p = u.sp[j].second;
+                    size_type count = r.count_SP(u.subjects[i], p);
+                    auto it = std::lower_bound(profile.begin(), profile.end(), std::make_pair(p, (uint64_t)0));
+                    if (it != profile.end() && it->first == p)
+                    {
+                        if (it->second == count)
+                            continue;
+                        if (count == 0)
+                            profile.erase(it);
+                        else
+                            it->second = count;
+                        changed = true;
+                    }
+                    else if (count > 0)
+                    {
+                        profile.insert(it, std::make_pair(p, count));
+                        changed = true;
+                    }
+                }
+                if (!changed)
+                    continue;
+                add_profile(u.profiles[i], false);
+                add_profile(profile, true);
+            }
+            for (uint64_t i = 0; i < u.po.size(); i++)
+            {
+                size_type count = r.count_PO(u.po[i].first, u.po[i].second);
+                if (u.po_counts[i] == 0 && count > 0)
+                    predicate_ref(u.po[i].first).distinct_o++;
+                else if (u.po_counts[i] > 0 && count == 0)
+                    predicate_ref(u.po[i].first).distinct_o--;
+            }
+        }
+
+        //! Serializes the catalog into the given ostream
+        size_type serialize(std::ostream &out) const
+        {
+            size_type written_bytes = 0;
+            uint64_t n = m_predicates.size();
+            write_value(out, n);
+            for (const predicate_stats &ps : m_predicates)
+            {
+                write_value(out, ps.triples);
+                write_value(out, ps.distinct_s);
+                write_value(out, ps.distinct_o);
+            }
+            written_bytes += sizeof(uint64_t) * (1 + 3 * n);
+            n = m_csets.size();
+            write_value(out, n);
+            written_bytes += sizeof(uint64_t);
+            for (const auto &e : m_csets)
+            {
+                uint64_t k = e.first.size();
+                write_value(out, k);
+                write_value(out, e.second.subjects);
+                out.write((const char *)e.first.data(), k * sizeof(uint64_t));
+                out.write((const char *)e.second.occurrences.data(), k * sizeof(size_type));
+                written_bytes += sizeof(uint64_t) * (2 + 2 * k);
+            }
+            return written_bytes;
+        }
+
+        void load(std::istream &in)
+        {
+            uint64_t n;
+            read_value(in, n);
+            m_predicates.resize(n);
+            for (predicate_stats &ps : m_predicates)
+            {
+                read_value(in, ps.triples);
+                read_value(in, ps.distinct_s);
+                read_value(in, ps.distinct_o);
+            }
+            m_csets.clear();
+            read_value(in, n);
+            for (uint64_t i = 0; i < n; i++)
+            {
+                uint64_t k;
+                cset_type key;
+                cset_stats cs;
+                read_value(in, k);
+                read_value(in, cs.subjects);
+                key.resize(k);
+                cs.occurrences.resize(k);
+                in.read((char *)key.data(), k * sizeof(uint64_t));
+                in.read((char *)cs.occurrences.data(), k * sizeof(size_type));
+                m_csets.emplace_hint(m_csets.end(), std::move(key), std::move(cs));
+            }
+            index_csets();
+            m_enabled = true;
+        }
+
+        uint64_t bit_size() const
+        {
+            uint64_t bytes = sizeof(predicate_stats) * m_predicates.size();
+            for (const auto &e : m_csets)
+                bytes += 2 * sizeof(uint64_t) * e.first.size() + sizeof(cset_stats) + sizeof(cset_type);
+            return bytes * 8;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * update_log.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_UPDATE_LOG_HPP
+#define RING_UPDATE_LOG_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "configuration.hpp"
+
+namespace ring {
+
+    /**
+     * Append-only log of the updates of a dynamic ring and of its dictionaries.
+     * Each record gets a log sequence number (lsn), consecutive from 1.
+     *
+     * The records are buffered by append() and written by commit(), which also
+     * syncs the file. Concurrent commits are grouped: one of them writes and
+     * syncs the records of all, the rest wait for it.
+     *
+     * The log is split in segments "<dir>/wal-<lsn of the first record>.log".
+     * rotate() starts a new segment (at each checkpoint) and remove_upto()
+     * deletes the segments whose records are all covered by a checkpoint.
+     *
+     * A record is [payload size u32 | checksum u32 | lsn u64 | kind u8 | payload].
+     * A torn record at the end of the last segment (a crash while writing) fails
+     * the checksum, and is cut when the log is opened again.
+     *
+     * A failed write is cut from the segment and its records stay buffered, so
+     * a later commit retries them. A failed sync leaves the segment in an
+     * unknown state: the log fails, and every later append or commit throws
+     * until it is opened again.
+     */
+    class update_log
+    {
+    public:
+        enum kind_type : uint8_t
+        {
+            insert_triples = 1,
+            remove_triples = 2,
+            remove_node = 3,
+            so_insert = 4,
+            so_eliminate = 5,
+            p_insert = 6,
+            p_eliminate = 7
+        };
+
+        struct record
+        {
+            uint64_t lsn;
+            kind_type kind;
+            std::vector<spo_triple> triples; // insert_triples, remove_triples
+            uint64_t value;                  // remove_node
+            std::string str;                 // dictionary records
+        };
+
+    private:
+        static constexpr uint64_t header_size = 2 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t);
+
+        std::string m_dir;
+        int m_fd = -1;
+        uint64_t m_size = 0;              // bytes of the open segment, only the flusher writes it
+        std::vector<uint64_t> m_segments; // first lsn of each segment, the last one is open
+        std::string m_buffer;             // records appended and not written yet
+        uint64_t m_last_lsn = 0;          // last appended
+        uint64_t m_durable_lsn = 0;       // last written and synced
+        bool m_flushing = false;
+        bool m_failed = false;            // a sync failed, nothing is durable after m_durable_lsn
+        std::mutex m_mutex;
+        std::condition_variable m_flushed;
+
+        static uint32_t checksum(const char *data, uint64_t n)
+        {
+            uint32_t h = 2166136261u; // FNV-1a
+            for (uint64_t i = 0; i < n; ++i)
+                h = (h ^ (uint8_t)data[i]) * 16777619u;
+            return h;
+        }
+
+        std::string segment_name(uint64_t first_lsn) const
+        {
+            std::string n = std::to_string(first_lsn);
+            return m_dir + "/wal-" + std::string(20 - n.size(), '0') + n + ".log";
+        }
+
+        void open_segment(uint64_t first_lsn)
+        {
+            m_fd = ::open(segment_name(first_lsn).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (m_fd < 0)
+                throw std::system_error(errno, std::generic_category(), "update_log: cannot open " + segment_name(first_lsn));
+            off_t size = ::lseek(m_fd, 0, SEEK_END);
+            m_size = size < 0 ? 0 : size;
+            m_segments.push_back(first_lsn);
+            sync_dir(m_dir);
+        }
+
+        enum flush_status
+        {
+            flushed,
+            not_written, // nothing of buf is in the segment
+            not_synced   // the segment is in an unknown state
+        };
+
+        /**
+         * Writes buf at the end of the open segment and syncs it. Runs without
+         * m_mutex, only the flushing thread calls it. A partial write is cut
+         * from the segment.
+         */
+        flush_status write_and_sync(const std::string &buf, int &err)
+        {
+            const char *data = buf.data();
+            uint64_t n = buf.size();
+            while (n > 0)
+            {
+                ssize_t w = ::write(m_fd, data, n);
+                if (w < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    err = errno;
+                    return ::ftruncate(m_fd, m_size) == 0 ? not_written : not_synced;
+                }
+                data += w;
+                n -= w;
+            }
+            m_size += buf.size();
+            if (::fdatasync(m_fd) != 0)
+            {
+                err = errno;
+                return not_synced;
+            }
+            return flushed;
+        }
+
+        /**
+         * Records the outcome of write_and_sync(buf), m_mutex must be held. The
+         * records of a failed write go back in front of m_buffer.
+         */
+        void finish_flush_locked(flush_status status, int err, std::string &buf, uint64_t upto)
+        {
+            if (status == flushed)
+            {
+                m_durable_lsn = upto;
+                return;
+            }
+            if (status == not_written)
+            {
+                buf += m_buffer;
+                m_buffer.swap(buf);
+                throw std::system_error(err, std::generic_category(), "update_log: write failed");
+            }
+            m_failed = true;
+            throw std::system_error(err, std::generic_category(), "update_log: fdatasync failed");
+        }
+
+        void check_failed_locked() const
+        {
+            if (m_failed)
+                throw std::runtime_error("update_log: a previous sync failed, the log must be opened again");
+        }
+
+        // writes and syncs the buffer, m_mutex must be held and nobody flushing
+        void flush_locked()
+        {
+            check_failed_locked();
+            std::string buffer;
+            buffer.swap(m_buffer);
+            int err = 0;
+            flush_status status = write_and_sync(buffer, err);
+            finish_flush_locked(status, err, buffer, m_last_lsn);
+        }
+
+        template <class t>
+        static void put(std::string &buf, const t &x)
+        {
+            buf.append((const char *)&x, sizeof(t));
+        }
+
+        template <class t>
+        static t get(const char *&p)
+        {
+            t x;
+            memcpy(&x, p, sizeof(t));
+            p += sizeof(t);
+            return x;
+        }
+
+        uint64_t append(kind_type kind, const std::string &payload)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            check_failed_locked();
+            uint64_t lsn = ++m_last_lsn;
+            std::string body;
+            put(body, lsn);
+            put(body, (uint8_t)kind);
+            body += payload;
+            put(m_buffer, (uint32_t)payload.size());
+            put(m_buffer, checksum(body.data(), body.size()));
+            m_buffer += body;
+            return lsn;
+        }
+
+        /**
+         * Reads the valid records of a segment. Returns the size of the valid
+         * prefix of the file.
+         */
+        static uint64_t read_segment(const std::string &file, const std::function<void(const record &)> &f)
+        {
+            std::ifstream in(file, std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            uint64_t pos = 0;
+            while (pos + header_size <= data.size())
+            {
+                const char *p = data.data() + pos;
+                uint32_t size = get<uint32_t>(p);
+                uint32_t sum = get<uint32_t>(p);
+                if (pos + header_size + size > data.size() || checksum(p, header_size - 2 * sizeof(uint32_t) + size) != sum)
+                    break;
+                record r;
+                r.lsn = get<uint64_t>(p);
+                r.kind = (kind_type)get<uint8_t>(p);
+                r.value = 0;
+                const char *end = p + size;
+                if (r.kind == insert_triples || r.kind == remove_triples)
+                {
+                    uint64_t n = get<uint64_t>(p);
+                    r.triples.reserve(n);
+                    for (uint64_t i = 0; i < n; ++i)
+                    {
+                        uint32_t s = get<uint32_t>(p), pr = get<uint32_t>(p), o = get<uint32_t>(p);
+                        r.triples.emplace_back(s, pr, o);
+                    }
+                }
+                else if (r.kind == remove_node)
+                {
+                    r.value = get<uint64_t>(p);
+                }
+                else
+                {
+                    r.str.assign(p, end);
+                }
+                f(r);
+                pos += header_size + size;
+            }
+            return pos;
+        }
+
+    public:
+        update_log() = default;
+
+        update_log(const update_log &) = delete;
+        update_log &operator=(const update_log &) = delete;
+
+        ~update_log()
+        {
+            if (m_fd >= 0)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                try
+                {
+                    if (!m_failed)
+                        flush_locked();
+                }
+                catch (...)
+                {
+                    // the records after m_durable_lsn are lost, as in a crash
+                }
+                ::close(m_fd);
+            }
+        }
+
+        static void sync_dir(const std::string &dir)
+        {
+            int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+
+        /**
+         * Opens (or creates) the log of dir and calls f for each record after
+         * from_lsn, in order. A torn record at the end is cut. The next records
+         * go to a new segment.
+         *
+         * @param dir       Directory of the log
+         * @param from_lsn  Records up to this lsn are skipped (covered by a checkpoint)
+         * @param f         Called with each record to replay
+         */
+        void open(const std::string &dir, uint64_t from_lsn, const std::function<void(const record &)> &f)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_fd >= 0)
+            {
+                ::close(m_fd); // opened again after a failure, the buffered records are dropped
+                m_fd = -1;
+            }
+            m_segments.clear();
+            m_buffer.clear();
+            m_dir = dir;
+            std::filesystem::create_directories(dir);
+            std::vector<std::pair<uint64_t, std::string>> files;
+            for (auto &e : std::filesystem::directory_iterator(dir))
+            {
+                std::string name = e.path().filename().string();
+                if (name.size() == 28 && name.compare(0, 4, "wal-") == 0 && name.compare(24, 4, ".log") == 0)
+                    files.emplace_back(std::stoull(name.substr(4, 20)), e.path().string());
+            }
+            std::sort(files.begin(), files.end());
+            m_last_lsn = from_lsn;
+            for (uint64_t i = 0; i < files.size(); ++i)
+            {
+                uint64_t valid = read_segment(files[i].second, [&](const record &r) {
+                    if (r.lsn <= m_last_lsn)
+                        return;
+                    if (r.lsn != m_last_lsn + 1)
+                        throw std::runtime_error("update_log: missing records before lsn " + std::to_string(r.lsn));
+                    m_last_lsn = r.lsn;
+                    f(r);
+                });
+                if (valid < std::filesystem::file_size(files[i].second))
+                {
+                    if (i + 1 < files.size())
+                        throw std::runtime_error("update_log: corrupted segment " + files[i].second);
+                    std::filesystem::resize_file(files[i].second, valid); // torn tail
+                }
+                m_segments.push_back(files[i].first);
+            }
+            m_durable_lsn = m_last_lsn;
+            m_failed = false;
+            if (!m_segments.empty() && m_segments.back() == m_last_lsn + 1)
+                m_segments.pop_back(); // empty, it is opened again
+            open_segment(m_last_lsn + 1);
+        }
+
+        uint64_t append_insert(const std::vector<spo_triple> &triples)
+        {
+            return append(insert_triples, encode(triples));
+        }
+
+        uint64_t append_remove(const std::vector<spo_triple> &triples)
+        {
+            return append(remove_triples, encode(triples));
+        }
+
+        uint64_t append_remove_node(uint64_t v)
+        {
+            std::string payload;
+            put(payload, v);
+            return append(remove_node, payload);
+        }
+
+        uint64_t append_string(kind_type kind, const std::string &str)
+        {
+            return append(kind, str);
+        }
+
+        static std::string encode(const std::vector<spo_triple> &triples)
+        {
+            std::string payload;
+            payload.reserve(sizeof(uint64_t) + triples.size() * 3 * sizeof(uint32_t));
+            put(payload, (uint64_t)triples.size());
+            for (auto &t : triples)
+            {
+                put(payload, std::get<0>(t));
+                put(payload, std::get<1>(t));
+                put(payload, std::get<2>(t));
+            }
+            return payload;
+        }
+
+        /**
+         * Makes the records up to lsn durable. If another thread is already
+         * syncing, waits for it and then syncs what is left, so one fsync
+         * serves all the records appended meanwhile.
+         *
+         * Throws std::system_error if the records cannot be written or synced.
+         */
+        void commit(uint64_t lsn)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_durable_lsn < lsn)
+            {
+                check_failed_locked();
+                if (m_flushing)
+                {
+                    m_flushed.wait(lock);
+                    continue;
+                }
+                m_flushing = true;
+                std::string buffer;
+                buffer.swap(m_buffer);
+                uint64_t upto = m_last_lsn;
+                lock.unlock();
+                int err = 0;
+                flush_status status = write_and_sync(buffer, err);
+                lock.lock();
+                m_flushing = false;
+                m_flushed.notify_all();
+                finish_flush_locked(status, err, buffer, upto);
+            }
+        }
+
+        //! Makes all the appended records durable
+        void commit()
+        {
+            uint64_t lsn;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                lsn = m_last_lsn;
+            }
+            commit(lsn);
+        }
+
+        /**
+         * Flushes the current segment and starts a new one. Returns the last
+         * lsn of the closed segment.
+         */
+        uint64_t rotate()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_flushed.wait(lock, [this] { return !m_flushing; });
+            flush_locked();
+            if (m_segments.back() == m_last_lsn + 1)
+                return m_last_lsn; // still empty
+            ::close(m_fd);
+            open_segment(m_last_lsn + 1);
+            return m_last_lsn;
+        }
+
+        //! Deletes the segments that only have records up to lsn
+        void remove_upto(uint64_t lsn)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (m_segments.size() > 1 && m_segments[1] - 1 <= lsn)
+            {
+                std::filesystem::remove(segment_name(m_segments[0]));
+                m_segments.erase(m_segments.begin());
+            }
+            sync_dir(m_dir);
+        }
+
+        uint64_t last_lsn()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_last_lsn;
+        }
+
+        uint64_t durable_lsn()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_durable_lsn;
+        }
+    };
+
+}
+
+#endif
@@ -21,8 +21,11 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <set>
+#include <string>
 #include "ring.hpp"
 
 
@@ -50,6 +53,28 @@ namespace ring {
             }
             return 0;
         }
+
+        //! Loads the statistics written next to the index file (see stats_catalog), if any
+        template<class ring_type>
+        bool load_stats(ring_type &graph, const std::string &file) {
+            std::ifstream stats_in(file + ".stats", std::ios::binary);
+            if(!stats_in) return false;
+            graph.stats().load(stats_in);
+            return true;
+        }
+
+        //! Writes the statistics of the ring next to the index file, if it keeps them.
+        //! Otherwise removes those of a previous index, they do not match it
+        template<class ring_type>
+        bool store_stats(ring_type &graph, const std::string &file) {
+            if(!graph.stats().enabled()){
+                std::remove((file + ".stats").c_str());
+                return false;
+            }
+            std::ofstream stats_out(file + ".stats", std::ios::binary | std::ios::trunc);
+            graph.stats().serialize(stats_out);
+            return true;
+        }
     }
 
 }
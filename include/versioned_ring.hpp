@@ -0,0 +1,225 @@
+/*
+ * versioned_ring.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_VERSIONED_RING_HPP
+#define RING_VERSIONED_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ring.hpp"
+
+namespace ring {
+
+    /**
+     * Snapshot isolation for the dynamic rings. The readers take a snapshot (a
+     * version of the ring) and query it while the writers build the next version,
+     * which is published atomically. Readers never wait for the writers, and each
+     * version is freed when its last snapshot is released.
+     *
+     * Two versions are kept: the published one and the previous one (the standby).
+     * An update is applied to the standby after replaying the updates it missed,
+     * so it costs about twice the update. Only when the standby is still pinned by
+     * some reader, the new version is copied from the published one instead.
+     * Updates are serialized among them.
+     *
+     * The standby doubles the space of the ring. With set_keep_standby(false) the
+     * previous version is freed as soon as its readers release it, and every
+     * update copies the published version instead.
+     *
+     * Several threads can query the same snapshot of the static rings and of
+     * ring_dyn. For ring_dyn_amo the queries adjust the amortized bitvectors, so
+     * amo::setConcurrentReads(true) is needed first.
+     */
+    template <class ring_t>
+    class versioned_ring
+    {
+    public:
+        typedef ring_t ring_type;
+        typedef std::shared_ptr<ring_type> snapshot_type;
+        typedef std::function<void(ring_type &)> update_type;
+
+    private:
+        snapshot_type m_current;          // published version, only read
+        snapshot_type m_standby;          // previous version
+        std::vector<update_type> m_log;   // updates of m_current missing in m_standby
+        std::atomic<uint64_t> m_version;
+        bool m_keep_standby = true;
+        std::mutex m_write_mutex;
+
+    public:
+        versioned_ring() : m_current(std::make_shared<ring_type>()), m_version(0) {}
+
+        explicit versioned_ring(ring_type &&r) : m_current(std::make_shared<ring_type>(std::move(r))), m_version(0) {}
+
+        versioned_ring(const versioned_ring &) = delete;
+        versioned_ring &operator=(const versioned_ring &) = delete;
+
+        /**
+         * Returns the published version. It stays valid (and unchanged) while the
+         * snapshot is held, whatever the writers do.
+         */
+        snapshot_type snapshot() const
+        {
+            return std::atomic_load(&m_current);
+        }
+
+        //! Number of versions published so far
+        uint64_t version() const
+        {
+            return m_version.load();
+        }
+
+        /**
+         * Builds the next version applying f and publishes it. f must give the
+         * same result when applied again to the previous version, as it is
+         * replayed on the standby later, so it should capture by value.
+         *
+         * @param f     Update, it receives the ring to modify
+         */
+        void update(update_type f)
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            snapshot_type next;
+            if (m_standby && m_standby.use_count() == 1)
+            {
+                // only reachable from here, it can be brought up to date.
+                // use_count() is a relaxed load, the fence orders the updates
+                // after the last accesses of the readers that released it
+                std::atomic_thread_fence(std::memory_order_acquire);
+                next = std::move(m_standby);
+                for (auto &g : m_log)
+                    g(*next);
+            }
+            else
+            {
+                next = std::make_shared<ring_type>(*m_current);
+            }
+            f(*next);
+            m_log.clear();
+            if (m_keep_standby)
+            {
+                m_log.push_back(std::move(f));
+                m_standby = m_current;
+            }
+            std::atomic_store(&m_current, next);
+            m_version++;
+        }
+
+        void insert_batch(const std::vector<spo_triple> &triples)
+        {
+            update([triples](ring_type &r) {
+                std::vector<spo_triple> batch(triples);
+                r.insert_batch(batch);
+            });
+        }
+
+        void remove_batch(const std::vector<spo_triple> &triples)
+        {
+            update([triples](ring_type &r) {
+                std::vector<spo_triple> batch(triples);
+                r.remove_batch(batch);
+            });
+        }
+
+        void remove_node(uint64_t v)
+        {
+            update([v](ring_type &r) {
+                r.remove_node(v);
+            });
+        }
+
+        /**
+         * Returns a copy of snap that nobody else reaches, so it can be
+         * serialized (which adjusts the amortized bitvectors) while the queries
+         * and the updates go on. If snap is still the published version and
+         * the standby is free, the standby is brought up to date and handed
+         * out, so no third version is made. Otherwise snap is copied.
+         *
+         * @param snap  A snapshot taken from this ring
+         */
+        snapshot_type private_copy(const snapshot_type &snap)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_write_mutex);
+                if (snap == m_current && m_standby && m_standby.use_count() == 1)
+                {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    snapshot_type copy = std::move(m_standby);
+                    for (auto &g : m_log)
+                        g(*copy);
+                    m_log.clear();
+                    return copy;
+                }
+            }
+            return std::make_shared<ring_type>(*snap);
+        }
+
+        /**
+         * Takes back a copy returned by private_copy() as the standby, if the
+         * copied version is still the published one and there is no standby.
+         * Otherwise the copy is freed.
+         *
+         * @param copy      The private copy
+         * @param version   version() when the copied snapshot was taken
+         */
+        void restore_standby(snapshot_type copy, uint64_t version)
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            if (version == m_version && !m_standby)
+            {
+                m_standby = std::move(copy);
+                m_log.clear();
+            }
+        }
+
+        /**
+         * Whether the previous version is kept as the standby after each update
+         * (the default). Without it the ring takes half the space, but every
+         * update copies the published version.
+         */
+        void set_keep_standby(const bool keep)
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            m_keep_standby = keep;
+            if (!keep)
+            {
+                m_standby.reset();
+                m_log.clear();
+            }
+        }
+
+        /**
+         * Frees the standby version, halving the space until the next update
+         * (which then copies the published version).
+         */
+        void release_standby()
+        {
+            std::lock_guard<std::mutex> lock(m_write_mutex);
+            m_standby.reset();
+            m_log.clear();
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * ws_deque.hpp
+ * Copyright (C) 2020 Author removed for double-blind evaluation
+ *
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_WS_DEQUE_HPP
+#define RING_WS_DEQUE_HPP
+
+#include <deque>
+#include <mutex>
+
+namespace ring {
+
+    namespace util {
+
+        /**
+         * Task deque of one worker. The owner takes tasks from the back and
+         * the other workers steal from the front, so the owner and the thieves
+         * only compete for the lock when the deque is almost empty.
+         */
+        template<class task_t>
+        class ws_deque {
+
+        public:
+            typedef task_t task_type;
+            typedef uint64_t size_type;
+
+        private:
+            std::deque<task_type> m_tasks;
+            std::mutex m_mutex;
+
+        public:
+
+            ws_deque() = default;
+
+            void push(const task_type &t){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push_back(t);
+            }
+
+            //! Takes the last task (owner side)
+            bool pop(task_type &t){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_tasks.empty()) return false;
+                t = m_tasks.back();
+                m_tasks.pop_back();
+                return true;
+            }
+
+            //! Takes the first task (thief side)
+            bool steal(task_type &t){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_tasks.empty()) return false;
+                t = m_tasks.front();
+                m_tasks.pop_front();
+                return true;
+            }
+
+            size_type size(){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_tasks.size();
+            }
+        };
+    }
+}
+
+#endif //RING_WS_DEQUE_HPP
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+if [ $# -ne 5 ]
+then
+    echo "Not enough arguments. Usage: bash run-adaptive-queries <index> <SO mapping> <P mapping> <queries_folder> <results_folder>"
+    exit 1
+fi
+
+if [ ! -f "$1" ]; then echo "Index file doesn't exist."; exit 1; fi
+if [ ! -f "$2" ]; then echo "SO mapping file doesn't exist."; exit 1; fi
+if [ ! -f "$3" ]; then echo "P mapping file doesn't exist."; exit 1; fi
+if [ ! -d "$4" ]; then echo "Queries folder doesn't exist."; exit 1; fi
+if [ ! -d "$5" ]; then echo "Results folder doesn't exist."; exit 1; fi
+
+# Runs each file of queries (e.g. Queries/bgps) with the static GAO and with --adaptive,
+# and writes in summary.csv the total time (ms) of each one and the number of queries
+# whose number of results differs (only possible with a timeout)
+summary="$5/summary.csv"
+echo "queries;static_ms;adaptive_ms;speedup;different_results" > "$summary"
+
+cd build
+
+for file in "$4"/*.txt
+do
+    queryName=$(basename "$file")
+    echo "testing $queryName"
+    ./query-index "$1" "$file" "$2" "$3" | grep -E '^[0-9]+(;[0-9]+){2,}$' > "$5/${queryName%%.txt}.static"
+    ./query-index "$1" "$file" "$2" "$3" --adaptive | grep -E '^[0-9]+(;[0-9]+){2,}$' > "$5/${queryName%%.txt}.adaptive"
+
+    static_ns=$(awk -F';' '{ s += $3 } END { print s + 0 }' "$5/${queryName%%.txt}.static")
+    adaptive_ns=$(awk -F';' '{ s += $3 } END { print s + 0 }' "$5/${queryName%%.txt}.adaptive")
+    different=$(awk -F';' 'NR == FNR { count[$1] = $2; next } count[$1] != $2 { n++ } END { print n + 0 }' \
+        "$5/${queryName%%.txt}.static" "$5/${queryName%%.txt}.adaptive")
+    awk -v q="${queryName%%.txt}" -v s="$static_ns" -v a="$adaptive_ns" -v d="$different" \
+        'BEGIN { printf "%s;%.1f;%.1f;%.2f;%d\n", q, s / 1e6, a / 1e6, (a > 0 ? s / a : 0), d }' >> "$summary"
+done
+
+cd ..
+
+cat "$summary"
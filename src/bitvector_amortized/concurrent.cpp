@@ -0,0 +1,117 @@
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "bitvector_amortized/concurrent.hpp"
+
+namespace amo {
+    namespace {
+        // max number of threads that can read at the same time
+        const uint MaxReaders = 256;
+
+        struct Retired {
+            uint64_t epoch;
+            std::function<void()> deleter;
+        };
+
+        bool concurrent = false;
+        std::atomic<uint64_t> globalEpoch(1);
+        // epoch pinned by each reader slot, 0 if not pinned
+        std::atomic<uint64_t> pinnedEpoch[MaxReaders];
+        std::atomic<bool> slotUsed[MaxReaders];
+
+        std::mutex retiredMutex;
+        std::vector<Retired> retired;
+        std::atomic<uint64_t> retiredCount(0);
+
+        // slot of the thread, released when the thread ends
+        struct ReaderSlot {
+            int slot = -1;
+            uint depth = 0; // guards can nest
+            ~ReaderSlot() {
+                if (slot >= 0) {
+                    pinnedEpoch[slot].store(0);
+                    slotUsed[slot].store(false);
+                }
+            }
+        };
+        thread_local ReaderSlot reader;
+
+        int claimSlot() {
+            for (uint i = 0; i < MaxReaders; i++) {
+                bool expected = false;
+                if (!slotUsed[i].load(std::memory_order_relaxed) &&
+                    slotUsed[i].compare_exchange_strong(expected, true)) {
+                    return i;
+                }
+            }
+            throw std::runtime_error("amo::EpochGuard: demasiados lectores concurrentes");
+        }
+    }
+
+    void setConcurrentReads(bool enabled) {
+        concurrent = enabled;
+    }
+
+    bool concurrentReads() {
+        return concurrent;
+    }
+
+    EpochGuard::EpochGuard() {
+        pinned = concurrent;
+        if (!pinned) return;
+        if (reader.depth++ > 0) return;
+        if (reader.slot < 0) reader.slot = claimSlot();
+        // the epoch must not move between reading and publishing it,
+        // otherwise a reclaimer could miss us
+        uint64_t epoch;
+        do {
+            epoch = globalEpoch.load();
+            pinnedEpoch[reader.slot].store(epoch);
+        } while (globalEpoch.load() != epoch);
+    }
+
+    EpochGuard::~EpochGuard() {
+        if (!pinned) return;
+        if (--reader.depth > 0) return;
+        pinnedEpoch[reader.slot].store(0);
+        if (retiredCount.load(std::memory_order_relaxed)) reclaim();
+    }
+
+    void retire(std::function<void()> deleter) {
+        // readers pinned after this point see the replacement already
+        // published, and cannot reach the retired object
+        uint64_t epoch = globalEpoch.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(retiredMutex);
+            retired.push_back({epoch, std::move(deleter)});
+            retiredCount.store(retired.size(), std::memory_order_relaxed);
+        }
+        reclaim();
+    }
+
+    void reclaim() {
+        std::vector<Retired> ready;
+        {
+            std::unique_lock<std::mutex> lock(retiredMutex, std::try_to_lock);
+            if (!lock.owns_lock()) return; // someone else is reclaiming
+            // oldest epoch still pinned
+            uint64_t oldest = UINT64_MAX;
+            for (uint i = 0; i < MaxReaders; i++) {
+                uint64_t epoch = pinnedEpoch[i].load();
+                if (epoch && epoch < oldest) oldest = epoch;
+            }
+            uint64_t k = 0;
+            for (auto& r : retired) {
+                if (r.epoch < oldest) {
+                    ready.push_back(std::move(r));
+                } else {
+                    retired[k++] = std::move(r);
+                }
+            }
+            retired.resize(k);
+            retiredCount.store(k, std::memory_order_relaxed);
+        }
+        for (auto& r : ready) r.deleter();
+    }
+}
@@ -2,6 +2,7 @@
 #include "bitvector_amortized/leaf.hpp"
 #include "bitvector_amortized/dynamic.hpp"
 #include "bitvector_amortized/hybrid.hpp"
+#include "bitvector_amortized/simd.hpp"
 
 namespace amo {
     // constructor por defecto
@@ -12,7 +13,7 @@ namespace amo {
         size = other.size;
         ones = other.ones;
         leaves = other.leaves;
-        accesses = other.accesses;
+        accesses = other.accesses.load();
 
         // Copia profunda de los hijos (usando el constructor por copia de HybridBV)
         left = new HybridBV(*other.left);
@@ -21,9 +22,10 @@ namespace amo {
 
     // Constructor por movimiento
     DynamicBV::DynamicBV(DynamicBV&& other) noexcept
-        : size(other.size), ones(other.ones), leaves(other.leaves), accesses(other.accesses),
-        left(other.left), right(other.right)
+        : size(other.size), ones(other.ones), leaves(other.leaves), accesses(other.accesses.load()),
+        left(other.left), right(other.right), flat(other.flat.load())
     {
+        other.flat = nullptr;
         other.left = nullptr;   // dejamos el objeto en estado válido (sin punteros)
         other.right = nullptr;
         other.size = 0;
@@ -41,11 +43,13 @@ namespace amo {
             size = other.size;
             ones = other.ones;
             leaves = other.leaves;
-            accesses = other.accesses;
+            accesses = other.accesses.load();
 
             left = other.left;   // transferimos propiedad
             right = other.right;
+            flat = other.flat.load();
 
+            other.flat = nullptr;
             other.left = nullptr;    // dejamos other limpio
             other.right = nullptr;
             other.size = 0;
@@ -80,7 +84,7 @@ namespace amo {
     // tells if it transfered something
     int DynamicBV::transferLeft () { 
         LeafBV *LB1,*LB2;
-        uint i,trf,ones,words;
+        uint trf,ones,words;
         uint64_t *segment;
 
         auto leftLeaf = std::get_if<LeafBV*>(&left->bv);
@@ -99,8 +103,7 @@ namespace amo {
         segment = new uint64_t[leafMaxSize()];
         copyBits(segment,0,LB2->data,trf,LB2->size);
         words = trf / w;
-        ones = 0;
-        for (i=0;i<words;i++) ones += popcount(LB2->data[i]);
+        ones = popcountWords(LB2->data, words);
         if (trf % w) ones += popcount(LB2->data[words] & 
                     (((uint64_t)1) << (trf % w)) - 1);
         LB1->ones += ones;
@@ -114,7 +117,7 @@ namespace amo {
     // tells if it transfered something
     int DynamicBV::transferRight () { 
         LeafBV *LB1,*LB2;
-        uint i,trf,ones,words;
+        uint trf,ones,words;
         uint64_t *segment;
 
         auto leftLeaf = std::get_if<LeafBV*>(&left->bv);
@@ -131,10 +134,7 @@ namespace amo {
         memcpy(segment,LB2->data,(LB2->size+7)/8);
         copyBits(LB2->data,0,LB1->data,LB1->size-trf,trf);
         words = trf / w;
-        ones = 0;
-        for (i=0;i<words;i++) {
-            ones += popcount(LB2->data[i]);
-        }
+        ones = popcountWords(LB2->data, words);
         if (trf % w) {
             ones += popcount(LB2->data[words] & (((uint64_t)1) << (trf % w)) - 1);
         }
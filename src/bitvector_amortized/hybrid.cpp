@@ -1,4 +1,5 @@
 #include <variant>
+#include "bitvector_amortized/concurrent.hpp"
 #include "bitvector_amortized/dynamic.hpp"
 #include "bitvector_amortized/hybrid.hpp"
 #include "bitvector_amortized/leaf.hpp"
@@ -20,10 +21,11 @@ namespace amo {
 
     // constructor por copia
     HybridBV::HybridBV(const HybridBV& other) {
+        EpochGuard guard; // other may be read (and flattened) concurrently
         bv = std::visit([](auto ptr) -> std::variant<StaticBV*, LeafBV*, DynamicBV*> {
             using T = std::decay_t<decltype(*ptr)>;
             return new T(*ptr);  // copia del objeto apuntado
-        }, other.bv);
+        }, other.resolved().bv);
     }
 
     // constructor por movimiento
@@ -38,23 +40,30 @@ namespace amo {
 
     void HybridBV::deleteBV() {
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
-            delete (*dyn)->left;
-            delete (*dyn)->right;
+            // once flattened aside, the children belong to the reclaimer
+            if (HybridBV* F = (*dyn)->flat.load()) {
+                delete F;
+            } else {
+                delete (*dyn)->left;
+                delete (*dyn)->right;
+            }
         }
 
         std::visit([](auto ptr) {
             delete ptr; 
         }, bv);
+        bv = static_cast<LeafBV*>(nullptr);
     }
 
     // operador de copia
     HybridBV& HybridBV::operator=(const HybridBV& other) {
         if (this != &other) {
+            EpochGuard guard;
             deleteBV();  // liberamos el contenido actual
             bv = std::visit([](auto ptr) -> std::variant<StaticBV*, LeafBV*, DynamicBV*> {
                 using T = std::decay_t<decltype(*ptr)>;
                 return new T(*ptr);
-            }, other.bv);
+            }, other.resolved().bv);
         }
         return *this;
     }
@@ -116,6 +125,10 @@ namespace amo {
             return; 
         }
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) { 
+            if (HybridBV* F = (*dyn)->flat.load(std::memory_order_acquire)) {
+                F->read(i,l,D,j);
+                return;
+            }
             lsize = (*dyn)->left->length();
             if (i+l < lsize) {
                 (*dyn)->left->read(i,l,D,j);
@@ -247,6 +260,7 @@ namespace amo {
         uint64_t w_bytes = 0;
         uint64_t n = size();
 
+        settle();
         w_bytes += myfwrite(&n,sizeof(uint64_t),1,out);
         w_bytes += serialize_(out, n);
 
@@ -294,8 +308,6 @@ namespace amo {
     void HybridBV::load(std::istream& in) {
         uint64_t n;
 
-        // Se elimina el anterior bitVector
-        deleteBV();
         // Se carga el nuevo bitVector
         myfread(&n,sizeof(uint64_t),1,in);
         load_(in, n);
@@ -304,6 +316,8 @@ namespace amo {
     void HybridBV::load_(std::istream &in, uint64_t n) {
         uint64_t size;
 
+        // Se elimina el anterior bitVector, tambien la hoja vacia de los hijos
+        deleteBV();
         myfread(&size,sizeof(uint64_t),1,in);
         if (size == n+1) {
             DynamicBV *DB = new DynamicBV();
@@ -317,22 +331,19 @@ namespace amo {
             DB->leaves = DB->left->leaves() + DB->right->leaves();
             bv = DB;
         } else if (size > leafNewSize()*w) {
-            if (auto leaf = std::get_if<LeafBV*>(&bv)) {
-                LeafBV* old_leaf = *leaf;
-                bv = StaticBV::load(in,size);
-                delete old_leaf;
-            }
+            bv = StaticBV::load(in,size);
         } else {
-            if (auto leaf = std::get_if<LeafBV*>(&bv)) {
-                LeafBV* old_leaf = *leaf;
-                bv = LeafBV::load(in,size);
-                delete old_leaf;
-            }
+            bv = LeafBV::load(in,size);
         }
     }
 
     // gives space of hybridBV in w-bit words
     uint64_t HybridBV::bit_size () const { 
+        if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
+            if (HybridBV* F = (*dyn)->flat.load(std::memory_order_acquire)) {
+                return sizeof(HybridBV) * 8 + sizeof(DynamicBV) * 8 + F->bit_size();
+            }
+        }
         return std::visit([](auto& obj) -> uint64_t {
             uint64_t s = sizeof(HybridBV) * 8;
             return s + obj->bit_size();
@@ -346,6 +357,9 @@ namespace amo {
         } else if (auto stat = std::get_if<StaticBV*>(&bv)) {
             return ((*stat)->length()+leafNewSize()*w-1) / (leafNewSize()*w);
         } else if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
+            if (HybridBV* F = (*dyn)->flat.load(std::memory_order_acquire)) {
+                return F->leaves();
+            }
             return (*dyn)->getLeaves();
         }
         throw std::runtime_error("HybridBV::leaves(): tipo inesperado, se esperaba StaticBV, LeafBV o DynamicBV");
@@ -512,6 +526,7 @@ namespace amo {
 
     void HybridBV::hybridInsert_(uint64_t i, uint v) { 
         uint recalc = 0;
+        settle();
         insert_(i,v,&recalc);
         // we went to the leaf now holding i
         if (recalc) {
@@ -608,6 +623,7 @@ namespace amo {
 
     int HybridBV::hybridRemove_(uint64_t i) { 
         uint recalc = 0;
+        settle();
         int dif = remove_(i,&recalc);
         // the node is now at i-1 or at i, hard to know
         if (recalc) {
@@ -634,25 +650,101 @@ namespace amo {
 
     bool HybridBV::mustFlatten(uint64_t n) {
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
-            return (((*dyn)->size <= Epsilon * n) && ((*dyn)->accesses >= Theta*(*dyn)->size));
+            return (((*dyn)->size <= Epsilon * n) && ((*dyn)->accesses.load(std::memory_order_relaxed) >= Theta*(*dyn)->size));
         }
         throw std::runtime_error("HybridBV::mustFlatten(): tipo inesperado, se esperaba DynamicBV");
     }
 
+    // counts a query on the dynamic node dyn of this and flattens it if it is time.
+    // returns the node where the query must continue, or NULL to go on with the children.
+    // flattens in place, or aside (publishing it) in the concurrent mode, where
+    // delta only tells that something was published
+    HybridBV* HybridBV::amortize(DynamicBV* dyn, int64_t* delta, uint64_t n) {
+        if (!concurrentReads()) {
+            dyn->countAccess();
+            if (!mustFlatten(n)) return NULL;
+            flatten(delta);
+            return this;
+        }
+        HybridBV* F = dyn->flat.load(std::memory_order_acquire);
+        if (F) return F;
+        dyn->countAccess();
+        if (!mustFlatten(n)) return NULL;
+        F = flattenAside();
+        if (F) *delta = 1;
+        return F;
+    }
+
+    // builds the flattened version of this dynamic node without touching it,
+    // publishes it for the readers and retires the children.
+    // returns NULL if another reader is already building it
+    HybridBV* HybridBV::flattenAside() {
+        DynamicBV* dyn = std::get<DynamicBV*>(bv);
+        bool expected = false;
+        if (!dyn->flattening.compare_exchange_strong(expected, true)) {
+            return dyn->flat.load(std::memory_order_acquire);
+        }
+        uint64_t len = length();
+        uint64_t* D = new uint64_t[(len + w - 1) / w]();
+        read(0,len,D,0);
+        HybridBV* F = new HybridBV(D,len); // a static or a leaf, as flatten
+        delete[] D;
+        dyn->flat.store(F, std::memory_order_release);
+        HybridBV* left = dyn->left;
+        HybridBV* right = dyn->right;
+        retire([left, right]() {
+            delete left;
+            delete right;
+        });
+        return F;
+    }
+
+    // puts the nodes flattened by concurrent readers in the place of their
+    // dynamic nodes and recomputes the leaves. Must run without readers
+    void HybridBV::settle() {
+        if (!pending.exchange(false, std::memory_order_acquire)) return;
+        fold();
+        reclaim();
+    }
+
+    void HybridBV::fold() {
+        auto dyn = std::get_if<DynamicBV*>(&bv);
+        if (!dyn) return;
+        if (HybridBV* F = (*dyn)->flat.load(std::memory_order_acquire)) {
+            // the children were already retired
+            DynamicBV* old_dynamic = *dyn;
+            bv = F->bv;
+            F->bv = static_cast<LeafBV*>(nullptr);
+            delete F;
+            delete old_dynamic;
+            return;
+        }
+        (*dyn)->left->fold();
+        (*dyn)->right->fold();
+        (*dyn)->leaves = (*dyn)->left->leaves() + (*dyn)->right->leaves();
+    }
+
+    const HybridBV& HybridBV::resolved() const {
+        if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
+            if (HybridBV* F = (*dyn)->flat.load(std::memory_order_acquire)) {
+                return *F;
+            }
+        }
+        return *this;
+    }
+
     // access B[i], assumes i is right
     uint HybridBV::access_ (uint64_t i, int64_t *delta, uint64_t n) { 
         uint64_t lsize;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) { 
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                flatten(delta);
-            } else { 
-                lsize = (*dyn)->left->length();
-                if (i < lsize) {
-                    return (*dyn)->left->access_(i,delta, n);
-                } else {
-                    return (*dyn)->right->access_(i-lsize,delta, n);
-                }
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->access_(i,delta,n);
+            }
+            lsize = (*dyn)->left->length();
+            if (i < lsize) {
+                return (*dyn)->left->access_(i,delta, n);
+            } else {
+                return (*dyn)->right->access_(i-lsize,delta, n);
             }
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
@@ -664,6 +756,7 @@ namespace amo {
     }
 
     uint HybridBV::hybridAccess_(uint64_t i) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
@@ -671,7 +764,8 @@ namespace amo {
         }
         uint answ = access_(i,&delta, n);
         if (delta) {
-            recompute(i,delta);
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(i,delta);
         }
         return answ;
     }
@@ -681,23 +775,23 @@ namespace amo {
         uint64_t lsize;
         int64_t delta;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) { 
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                delta = 0;
-                flatten(&delta); 
-                if (delta) *recomp = 1;
-            } else {
-                lsize = (*dyn)->left->length();
-                if (i+l < lsize) {
-                    (*dyn)->left->read(i,l,D,j,recomp, n);
-                } else if (i>=lsize) {
-                    (*dyn)->right->read(i-lsize,l,D,j,recomp, n);
-                } else { 
-                    (*dyn)->left->read(i,lsize-i,D,j,recomp, n);
-                    (*dyn)->right->read(0,l-(lsize-i),D,j+(lsize-i),recomp, n);
-                }
+            delta = 0;
+            HybridBV* F = amortize(*dyn,&delta,n);
+            if (delta) *recomp = 1;
+            if (F) {
+                F->read(i,l,D,j,recomp,n);
                 return;
             }
+            lsize = (*dyn)->left->length();
+            if (i+l < lsize) {
+                (*dyn)->left->read(i,l,D,j,recomp, n);
+            } else if (i>=lsize) {
+                (*dyn)->right->read(i-lsize,l,D,j,recomp, n);
+            } else { 
+                (*dyn)->left->read(i,lsize-i,D,j,recomp, n);
+                (*dyn)->right->read(0,l-(lsize-i),D,j+(lsize-i),recomp, n);
+            }
+            return;
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) { 
             (*leaf)->read(i,l,D,j);
@@ -708,6 +802,7 @@ namespace amo {
     }
 
     void HybridBV::hybridRead (uint64_t i, uint64_t l, uint64_t *D, uint64_t j) { 
+        EpochGuard guard;
         uint recomp = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
@@ -715,7 +810,8 @@ namespace amo {
         }
         read(i,l,D,j,&recomp, n);
         if (recomp) {
-            rrecompute(i,l);
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else rrecompute(i,l);
         }
     }
 
@@ -723,16 +819,14 @@ namespace amo {
     uint64_t HybridBV::rank_(uint64_t i, int64_t *delta, uint64_t n) {
         uint64_t lsize;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                flatten(delta); 
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->rank_(i,delta,n);
+            }
+            lsize = (*dyn)->left->length();
+            if (i < lsize) {
+                return (*dyn)->left->rank_(i,delta, n);
             } else {
-                lsize = (*dyn)->left->length();
-                if (i < lsize) {
-                    return (*dyn)->left->rank_(i,delta, n);
-                } else {
                 return (*dyn)->left->getOnes() + (*dyn)->right->rank_(i-lsize,delta, n);
-                }
             }
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
@@ -744,6 +838,7 @@ namespace amo {
     }
 
     uint64_t HybridBV::hybridRank_(uint64_t i) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
@@ -751,7 +846,8 @@ namespace amo {
         }
         uint64_t answ = rank_(i,&delta, n);
         if (delta) {
-            recompute(i,delta);
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(i,delta);
         }
         return answ;
     }
@@ -760,16 +856,14 @@ namespace amo {
     uint64_t HybridBV::select1_(uint64_t j, int64_t *delta, uint64_t n) {
         uint64_t lones;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                flatten(delta);
-            } else { 
-                lones = (*dyn)->left->getOnes();
-                if (j <= lones) {
-                    return (*dyn)->left->select1_(j,delta, n);
-                }
-                return (*dyn)->left->length() + (*dyn)->right->select1_(j-lones,delta, n);
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->select1_(j,delta,n);
             }
+            lones = (*dyn)->left->getOnes();
+            if (j <= lones) {
+                return (*dyn)->left->select1_(j,delta, n);
+            }
+            return (*dyn)->left->length() + (*dyn)->right->select1_(j-lones,delta, n);
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
             return (*leaf)->select1_(j);   
@@ -783,16 +877,14 @@ namespace amo {
     uint64_t HybridBV::select0_(uint64_t j, int64_t *delta, uint64_t n) { 
         uint64_t lzeros;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                flatten(delta); 
-            } else { 
-                lzeros = (*dyn)->left->length() - (*dyn)->left->getOnes();
-                if (j <= lzeros) {
-                    return (*dyn)->left->select0_(j,delta, n);
-                }
-                return (*dyn)->left->length() + (*dyn)->right->select0_(j-lzeros,delta, n);
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->select0_(j,delta,n);
+            }
+            lzeros = (*dyn)->left->length() - (*dyn)->left->getOnes();
+            if (j <= lzeros) {
+                return (*dyn)->left->select0_(j,delta, n);
             }
+            return (*dyn)->left->length() + (*dyn)->right->select0_(j-lzeros,delta, n);
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
             return (*leaf)->select0_(j);
@@ -809,20 +901,18 @@ namespace amo {
         int64_t next;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) { 
             if (getOnes() == 0) return -1; // not considered an access!
-            (*dyn)->accesses++;
-            if (mustFlatten(n)){
-                flatten(delta); 
-            } else { 
-                lsize =(*dyn)->left->length();
-                if (i < lsize) {
-                    next = (*dyn)->left->next1(i,delta,n);
-                    if (next != -1) return next;
-                    i = lsize;
-                }
-                next = (*dyn)->right->next1(i-lsize,delta,n);
-                if (next == -1) return -1;
-                return lsize + next;
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->next1(i,delta,n);
             }
+            lsize =(*dyn)->left->length();
+            if (i < lsize) {
+                next = (*dyn)->left->next1(i,delta,n);
+                if (next != -1) return next;
+                i = lsize;
+            }
+            next = (*dyn)->right->next1(i-lsize,delta,n);
+            if (next == -1) return -1;
+            return lsize + next;
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
             return (*leaf)->next1(i);
@@ -839,20 +929,18 @@ namespace amo {
         int64_t next;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) { 
             if (getOnes() == length()) return -1; // not an access
-            (*dyn)->accesses++;
-            if (mustFlatten(n)) {
-                flatten(delta);
-            } else { 
-                lsize = (*dyn)->left->length();
-                if (i < lsize) { 
-                    next = (*dyn)->left->next0(i,delta,n);
-                    if (next != -1) return next;
-                    i = lsize;
-                }
-                next = (*dyn)->right->next0(i-lsize,delta,n);
-                if (next == -1) return -1;
-                return lsize + next;
+            if (HybridBV* F = amortize(*dyn,delta,n)) {
+                return F->next0(i,delta,n);
+            }
+            lsize = (*dyn)->left->length();
+            if (i < lsize) { 
+                next = (*dyn)->left->next0(i,delta,n);
+                if (next != -1) return next;
+                i = lsize;
             }
+            next = (*dyn)->right->next0(i-lsize,delta,n);
+            if (next == -1) return -1;
+            return lsize + next;
         }
         if (auto leaf = std::get_if<LeafBV*>(&bv)) {
             return (*leaf)->next0(i);
@@ -863,28 +951,37 @@ namespace amo {
     }
 
     int64_t HybridBV::hybridNext1(uint64_t i) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
             n = (*dyn)->size;
         }
         int64_t answ = next1(i,&delta,n);
-        if (delta) recompute(i,delta);
+        if (delta) {
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(i,delta);
+        }
         return answ;
     }
 
     int64_t HybridBV::hybridNext0(uint64_t i) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
             n = (*dyn)->size;
         }
         int64_t answ = next0(i,&delta,n);
-        if (delta) recompute(i,delta);
+        if (delta) {
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(i,delta);
+        }
         return answ;
     }
 
     uint64_t HybridBV::hybridSelect1_(uint64_t j) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
@@ -892,12 +989,14 @@ namespace amo {
         }
         uint64_t answ = select1_(j,&delta, n);
         if (delta) {
-            recompute(answ,delta);
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(answ,delta);
         }
         return answ;
     }
 
     uint64_t HybridBV::hybridSelect0_(uint64_t j) { 
+        EpochGuard guard;
         int64_t delta = 0;
         uint64_t n = 0;
         if (auto dyn = std::get_if<DynamicBV*>(&bv)) {
@@ -905,7 +1004,8 @@ namespace amo {
         }
         uint64_t answ = select0_(j,&delta, n);
         if (delta) {
-            recompute(answ,delta);
+            if (concurrentReads()) pending.store(true, std::memory_order_release);
+            else recompute(answ,delta);
         }
         return answ;
     }
@@ -957,6 +1057,7 @@ namespace amo {
     }
 
     int HybridBV::set(uint64_t i, bool b) {
+        settle();
         return write_(i, b);
     }
 }
\ No newline at end of file
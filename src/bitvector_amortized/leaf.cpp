@@ -1,6 +1,7 @@
 #include "bitvector_amortized/leaf.hpp"
 #include "bitvector_amortized/dynamic.hpp"
 #include "bitvector_amortized/hybrid.hpp"
+#include "bitvector_amortized/simd.hpp"
 
 namespace amo {
     // Constructor hoja vacía
@@ -20,9 +21,7 @@ namespace amo {
         if (n % w) {
             data[nb - 1] &= (((uint64_t)1) << (n % w)) - 1;
         }
-        for (uint i = 0; i < nb; i++) {
-            ones += popcount(data[i]);
-        }
+        ones = popcountWords(data, nb);
     }
 
     // constructor por copia
@@ -125,7 +124,7 @@ namespace amo {
 
     // Insertar bit v en posición i
     void LeafBV::insert_(uint i, uint v) {
-        uint nb = ++size/w;
+        uint nb = size++/w; // last word in use after inserting
         uint ib = i/w;
         int b;
 
@@ -143,13 +142,14 @@ namespace amo {
 
     // Borrar bit en posición i, retorna diferencia en unos
     int LeafBV::remove_(uint i) {
-        uint nb = size--/w;
+        uint nb = (size-1)/w; // last word in use
         uint ib = i/w;
         int b;
         int v = (data[ib] >> (i%w)) & 1;
 
         data[ib] =   (data[ib] & ((((uint64_t)1) << (i%w)) - 1)) | ((data[ib] >> 1) & 
                         (~((uint64_t)0) << (i%w)));
+        size--;
         for (b=ib+1;b<=nb;b++) {
             data[b-1] |= data[b] << (w-1);
             data[b] >>= 1;
@@ -163,14 +163,15 @@ namespace amo {
         int p,ib;
         uint ones = 0;
         ib = i/w;
-        for (p=0;p<ib;p++) ones += popcount(data[p]);
+        ones = popcountWords(data, ib);
+        p = ib;
         if (i%w) ones += popcount(data[p] & ((((uint64_t)1)<<(i%w))-1));
         return ones;
     }
 
     // select1: posición del j-ésimo 1 (1-based)
     uint LeafBV::select1_(uint j) const {
-        uint p,i,pc;
+        uint p,pc;
         uint64_t word;
         uint ones = 0;
         p = 0;
@@ -181,18 +182,12 @@ namespace amo {
             ones += pc; 
             p++;
         }
-        i = p*w;
-        while (1) { 
-            ones += word & 1; 
-            if (ones == j) return i;
-            word >>= 1; 
-            i++; 
-        }
+        return p*w + selectWord(word, j - ones);
     }
 
     // select0: posición del j-ésimo 0 (0-based)
     uint LeafBV::select0_(uint j) const {
-        uint p,i,pc;
+        uint p,pc;
         uint64_t word;
         uint zeros = 0;
         p = 0;
@@ -203,22 +198,9 @@ namespace amo {
             zeros += pc; 
             p++;
         }
-        i = p*w;
-        while (1) { 
-            zeros += 1 - (word & 1);
-            if (zeros == j) return i;
-            word >>= 1; 
-            i++; 
-        }
+        return p*w + selectWord(~word, j - zeros);
     }
 
-    // trick for lowest 1 in a 64-bit word
-    static int decode[64] = {
-        0, 1,56, 2,57,49,28, 3,61,58,42,50,38,29,17, 4,
-        62,47,59,36,45,43,51,22,53,39,33,30,24,18,12, 5,
-        63,55,48,27,60,41,37,16,46,35,44,21,52,32,23,11,
-        54,26,40,15,34,20,31,10,25,14,19, 9,13, 8, 7, 6 };
-
     // computes next_1(B,i), zero-based and including i
     // returns -1 if no answer
     int LeafBV::next1(uint i) { 
@@ -235,7 +217,7 @@ namespace amo {
         if (!word) {
             return -1;
         }
-        return (p-1)*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+        return (p-1)*w + __builtin_ctzll(word);
     }
 
     // computes next_0(B,i), zero-based and including i
@@ -254,7 +236,7 @@ namespace amo {
         if (!word) {
             return -1;
         }
-        return (p-1)*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+        return (p-1)*w + __builtin_ctzll(word);
     }
 
     // Leer bits [i..i+l-1] en D a partir de D[j]
@@ -0,0 +1,199 @@
+#include "bitvector_amortized/simd.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define AMO_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace amo {
+
+    // portable versions
+
+    static uint64_t popcountWordsDefault(const uint64_t* data, uint64_t n) {
+        uint64_t ones = 0;
+        for (uint64_t i = 0; i < n; i++) ones += popcount(data[i]);
+        return ones;
+    }
+
+    static void popcountBlocksDefault(const uint64_t* data, uint64_t n, uint16_t* counts) {
+        for (uint64_t i = 0; i < n; i += K) {
+            counts[i/K] = static_cast<uint16_t>(popcountWordsDefault(data + i, std::min<uint64_t>(K, n - i)));
+        }
+    }
+
+    static uint selectWordDefault(uint64_t word, uint j) {
+        while (--j) word &= word - 1;
+        return __builtin_ctzll(word);
+    }
+
+#ifdef AMO_X86_KERNELS
+
+    // POPCNT
+
+    __attribute__((target("popcnt")))
+    static uint64_t popcountWordsPopcnt(const uint64_t* data, uint64_t n) {
+        uint64_t ones = 0;
+        for (uint64_t i = 0; i < n; i++) ones += _mm_popcnt_u64(data[i]);
+        return ones;
+    }
+
+    __attribute__((target("popcnt")))
+    static void popcountBlocksPopcnt(const uint64_t* data, uint64_t n, uint16_t* counts) {
+        for (uint64_t i = 0; i < n; i += K) {
+            uint64_t top = std::min<uint64_t>(i + K, n);
+            uint64_t ones = 0;
+            for (uint64_t p = i; p < top; p++) ones += _mm_popcnt_u64(data[p]);
+            counts[i/K] = static_cast<uint16_t>(ones);
+        }
+    }
+
+    // PDEP deposits a single 1 at the position of the j-th 1 of word
+    __attribute__((target("bmi,bmi2")))
+    static uint selectWordBmi2(uint64_t word, uint j) {
+        return _tzcnt_u64(_pdep_u64(((uint64_t)1) << (j - 1), word));
+    }
+
+    // AVX2: nibble lookup with vpshufb, bytes added with vpsadbw into 4 64-bit counters
+
+    __attribute__((target("avx2")))
+    static inline __m256i popcount256(__m256i v) {
+        const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                                0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const __m256i low = _mm256_set1_epi8(0x0f);
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+        __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+    }
+
+    __attribute__((target("avx2")))
+    static inline uint64_t sum256(__m256i v) {
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    static uint64_t popcountWordsAvx2(const uint64_t* data, uint64_t n) {
+        __m256i acc = _mm256_setzero_si256();
+        uint64_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc = _mm256_add_epi64(acc, popcount256(_mm256_loadu_si256((const __m256i*)(data + i))));
+        }
+        uint64_t ones = sum256(acc);
+        for (; i < n; i++) ones += _mm_popcnt_u64(data[i]);
+        return ones;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    static void popcountBlocksAvx2(const uint64_t* data, uint64_t n, uint16_t* counts) {
+        if (K != 4) {
+            popcountBlocksPopcnt(data, n, counts);
+            return;
+        }
+        uint64_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            counts[i/4] = static_cast<uint16_t>(sum256(popcount256(_mm256_loadu_si256((const __m256i*)(data + i)))));
+        }
+        if (i < n) {
+            uint64_t ones = 0;
+            for (; i < n; i++) ones += _mm_popcnt_u64(data[i]);
+            counts[(n-1)/4] = static_cast<uint16_t>(ones);
+        }
+    }
+
+    // AVX-512 VPOPCNTQ, the tails are handled with masked loads
+
+    // sum of the 64-bit lanes [lo, hi) of v. The reductions of immintrin.h start from
+    // undefined vectors, which gcc reports as uninitialized with -Wall
+    __attribute__((target("avx512f")))
+    static inline uint64_t sum512(__m512i v, uint lo = 0, uint hi = 8) {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, v);
+        uint64_t s = 0;
+        for (uint l = lo; l < hi; l++) s += lanes[l];
+        return s;
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static uint64_t popcountWordsAvx512(const uint64_t* data, uint64_t n) {
+        __m512i acc = _mm512_setzero_si512();
+        uint64_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(data + i)));
+        }
+        if (i < n) {
+            __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+            acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(mask, data + i)));
+        }
+        return sum512(acc);
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+    static void popcountBlocksAvx512(const uint64_t* data, uint64_t n, uint16_t* counts) {
+        if (K != 4) {
+            popcountBlocksPopcnt(data, n, counts);
+            return;
+        }
+        // two blocks per vector
+        uint64_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m512i c = _mm512_popcnt_epi64(_mm512_loadu_si512(data + i));
+            counts[i/4] = static_cast<uint16_t>(sum512(c, 0, 4));
+            counts[i/4+1] = static_cast<uint16_t>(sum512(c, 4, 8));
+        }
+        if (i < n) {
+            __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+            __m512i c = _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(mask, data + i));
+            counts[i/4] = static_cast<uint16_t>(sum512(c, 0, 4));
+            if (i + 4 < n) counts[i/4+1] = static_cast<uint16_t>(sum512(c, 4, 8));
+        }
+    }
+
+#endif
+
+    static const Kernels DefaultKernels = {"default", popcountWordsDefault, popcountBlocksDefault, selectWordDefault};
+
+    static bool supports(const char* name, Kernels& k) {
+        k = DefaultKernels;
+        if (!strcmp(name, "default")) return true;
+#ifdef AMO_X86_KERNELS
+        __builtin_cpu_init();
+        bool bmi2 = __builtin_cpu_supports("bmi2");
+        if (!strcmp(name, "popcnt") && __builtin_cpu_supports("popcnt")) {
+            k = {"popcnt", popcountWordsPopcnt, popcountBlocksPopcnt, selectWordDefault};
+        } else if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            k = {"avx2", popcountWordsAvx2, popcountBlocksAvx2, selectWordDefault};
+        } else if (!strcmp(name, "avx512") && __builtin_cpu_supports("avx512f")
+                   && __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("popcnt")) {
+            k = {"avx512", popcountWordsAvx512, popcountBlocksAvx512, selectWordDefault};
+        } else {
+            return false;
+        }
+        if (bmi2) k.selectWord = selectWordBmi2;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static Kernels& activeKernels() {
+        static Kernels active = [] {
+            Kernels k;
+            if (supports("avx512", k) || supports("avx2", k) || supports("popcnt", k)) return k;
+            supports("default", k);
+            return k;
+        }();
+        return active;
+    }
+
+    const Kernels& kernels() {
+        return activeKernels();
+    }
+
+    bool setKernels(const char* name) {
+        Kernels k;
+        if (!supports(name, k)) return false;
+        activeKernels() = k;
+        return true;
+    }
+}
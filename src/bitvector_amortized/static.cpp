@@ -2,6 +2,7 @@
 #include "bitvector_amortized/hybrid.hpp"
 #include "bitvector_amortized/leaf.hpp"
 #include "bitvector_amortized/static.hpp"
+#include "bitvector_amortized/simd.hpp"
 
 namespace amo {
     // constructor por defecto
@@ -103,25 +104,24 @@ namespace amo {
 
     // preprocesses for rank, with parameter K
     void StaticBV::staticPreprocess() { 
-        uint64_t i,n;
-        uint64_t sacc,acc;
+        uint64_t i,n,nb;
+        uint64_t sacc,acc,c;
         n = size;
         if (n == 0) return;
-        B = new uint16_t[(n + K*w - 1) / (K*w)];
+        nb = (n + K*w - 1) / (K*w);
+        B = new uint16_t[nb];
         S = new uint64_t[(n + (1 << w16) - 1) / (1 << w16)];
+        // counts of the blocks, then turned into ranks from the superblock start
+        kernels().popcountBlocks(data, (n+w-1)/w, B);
         sacc = acc = 0;
-        i = 0;
-        while (i<(n+w-1)/w) {
-            uint64_t top = std::min((n+w-1)/w,i+(1<<w16)/w);
-            sacc += acc; acc = 0;
-            S[(i*w) >> w16] = sacc;
-            while (i<top) { 
-                if (i%K == 0) {
-                    B[i/K] = static_cast<uint16_t>(acc);
-                }
-                acc += popcount(data[i]);
-                i++;
+        for (i=0;i<nb;i++) {
+            if ((i*K*w) % (1 << w16) == 0) {
+                sacc += acc; acc = 0;
+                S[(i*K*w) >> w16] = sacc;
             }
+            c = B[i];
+            B[i] = static_cast<uint16_t>(acc);
+            acc += c;
         }
         ones = sacc + acc;
     }
@@ -202,7 +202,7 @@ namespace amo {
     uint64_t StaticBV::select1_(uint64_t j) {
         int64_t i,d,b;
         uint p;
-        uint64_t word,s,m,n;
+        uint64_t s,m,n;
         n = size;
         s = (n+(1<<w16)-1)/(1<<w16);
         // interpolation: guess + exponential search
@@ -289,21 +289,14 @@ namespace amo {
             j -= p;
             i++;
         }
-        word = data[i];
-        i *= w;
-        while (1) {
-            j -= word & 1;
-            if (j == 0) return i;
-            word >>= 1;
-            i++;
-        }
+        return i*w + selectWord(data[i], j);
     };
 
     // computes select_1(j), zero-based, assumes j is right
     uint64_t StaticBV::select0_(uint64_t j) {
         int64_t i,d,b;
         uint p;
-        uint64_t word,s,m,n;
+        uint64_t s,m,n;
         n = size;
         s = (n+(1<<w16)-1)/(1<<w16);
         
@@ -408,23 +401,9 @@ namespace amo {
             j -= p;
             i++;
         }
-        word = data[i];
-        i *= w;
-        while (1) {
-            j -= 1 - (word & 1);
-            if (j == 0) return i;
-            word >>= 1;
-            i++;
-        }
+        return i*w + selectWord(~data[i], j);
     }
 
-    // trick for lowest 1 in a 64-bit word
-    static int decode[64] = {
-        0, 1,56, 2,57,49,28, 3,61,58,42,50,38,29,17, 4,
-        62,47,59,36,45,43,51,22,53,39,33,30,24,18,12, 5,
-        63,55,48,27,60,41,37,16,46,35,44,21,52,32,23,11,
-        54,26,40,15,34,20,31,10,25,14,19, 9,13, 8, 7, 6 };
-
     // computes next_1(B,i), zero-based and including i
     // returns -1 if no answer
     int64_t StaticBV::next1(uint64_t i) { 
@@ -438,7 +417,7 @@ namespace amo {
         }
         // a likely case, solve faster
         if (word) {
-            return p*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+            return p*w + __builtin_ctzll(word);
         }
         // search within block
         b = std::min((p/K+2)*K,1+(size-1)/w); // scan at least 2 blocks (a full one)
@@ -452,7 +431,7 @@ namespace amo {
                 word &= (((uint64_t)1) << (size % w)) - 1;
             }
             if (!word) return -1; // end of bitvector
-            return (p-1)*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+            return (p-1)*w + __builtin_ctzll(word);
         }
         else if (p == 1+(size-1)/w) return -1; // end of bitvector
         // reduce to select
@@ -472,7 +451,7 @@ namespace amo {
         word = ~data[p] & ((~(uint64_t)0)<<(i%w));
         // a likely case, solve faster
         if (word) {
-            return p*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+            return p*w + __builtin_ctzll(word);
         }
         // search within block
         b = std::min((p/K+2)*K,1+(size-1)/w); // scan at least 2 blocks (a full one)
@@ -486,7 +465,7 @@ namespace amo {
                 word &= (((uint64_t)1) << (size % w)) - 1;
             }
             if (!word) return -1; // end of bitvector
-            return (p-1)*w + decode[(0x03f79d71b4ca8b09 * (word & -word))>>58];
+            return (p-1)*w + __builtin_ctzll(word);
         }
         else if (p == 1+(size-1)/w) return -1; // end of bitvector
         // reduce to select
@@ -19,10 +19,13 @@
 
 #include <iostream>
 #include "ring.hpp"
+#include "hybrid_ring.hpp"
 #include "dict_map.hpp"
 #include "dict_map_avl.hpp"
+#include "dict_mapped.hpp"
+#include "dict_builder.hpp"
 #include <fstream>
-#include <regex>
+#include <memory>
 #include <sdsl/construct.hpp>
 #include <ltj_algorithm.hpp>
 
@@ -31,88 +34,118 @@ using namespace std;
 using namespace std::chrono;
 using timer = std::chrono::high_resolution_clock;
 
+// Builds the ring with the serial constructor on a copy of D,
+// returns the time in milliseconds
 template <class ring>
-void build_index(const std::string &dataset, const std::string &output)
+uint64_t serial_time(const vector<spo_triple> &D)
 {
-    vector<spo_triple> D, E;
-
-    std::ifstream ifs(dataset);
-    uint64_t s, p, o;
-    do
-    {
-        ifs >> s >> p >> o;
-        D.push_back(spo_triple(s, p, o));
-    } while (!ifs.eof());
+    vector<spo_triple> D_serial(D);
+    auto start = timer::now();
+    ring A(D_serial);
+    auto stop = timer::now();
+    return duration_cast<milliseconds>(stop - start).count();
+}
 
-    D.shrink_to_fit();
+// If compare is set, the ring is also built with the serial constructor
+// to report the speedup of the parallel one
+template <class ring>
+void construct(vector<spo_triple> &D, const std::string &output, const uint64_t n_threads, const bool compare)
+{
     cout << "--Indexing " << D.size() << " triples" << endl;
+    uint64_t serial_ms = 0;
+    if (compare)
+        serial_ms = serial_time<ring>(D);
+
     memory_monitor::start();
     auto start = timer::now();
-
-    ring A(D);
+    ring A(D, n_threads);
     auto stop = timer::now();
     memory_monitor::stop();
     cout << "  Index built  " << sdsl::size_in_bytes(A) << " bytes" << endl;
 
+    if (compare)
+    {
+        uint64_t parallel_ms = duration_cast<milliseconds>(stop - start).count();
+        cout << "  Serial construction " << serial_ms << " ms." << endl;
+        cout << "  Parallel construction (" << n_threads << " threads) " << parallel_ms << " ms." << endl;
+        cout << "  Speedup " << (double)serial_ms / std::max<uint64_t>(parallel_ms, 1) << endl;
+    }
+
     sdsl::store_to_file(A, output);
     cout << "Index saved" << endl;
     cout << duration_cast<seconds>(stop - start).count() << " seconds." << endl;
     cout << memory_monitor::peak() << " bytes." << endl;
+
+    // The statistics of the GAO are kept next to the index
+    A.stats().build(D);
+    std::ofstream stats_out(output + ".stats", std::ios::binary | std::ios::trunc);
+    A.stats().serialize(stats_out);
+    cout << "Statistics saved " << A.stats().bit_size() / 8 << " bytes" << endl;
 }
 
-template <class map>
-void build_mapping(const std::string &dataset, std::vector<spo_triple> &D, const std::string &output)
+template <class ring>
+void build_index(const std::string &dataset, const std::string &output, const uint64_t n_threads = 1, const bool compare = false)
 {
-    map so_mapping;
-    map p_mapping;
+    vector<spo_triple> D, E;
 
     std::ifstream ifs(dataset);
-    std::string line;
-    std::vector<std::string> user_input(3);
-    std::regex token_regex("(?:\".*\"|[^[:space:]])+");
-    std::sregex_iterator reg_it;
-    uint64_t i = 0;
+    uint64_t s, p, o;
+    do
+    {
+        ifs >> s >> p >> o;
+        D.push_back(spo_triple(s, p, o));
+    } while (!ifs.eof());
+
+    D.shrink_to_fit();
+    construct<ring>(D, output, n_threads, compare);
+}
+
+// The dictionaries are built in parallel (see dict_builder), the IDs of the
+// terms follow their lexicographic order
+template <class map>
+void build_mapping(const std::string &dataset, std::vector<spo_triple> &D, const std::string &output, const uint64_t n_threads = 1, const bool hash = false)
+{
+    std::unique_ptr<map> so_mapping, p_mapping;
+
     auto mapping_start = timer::now();
-    size_t count = 0;
-    while (ifs.good())
-    {
-        getline(ifs, line);
-        if (line.size() == 0)
-            break;
-        for (reg_it = sregex_iterator(line.begin(), line.end(), token_regex), i = 0; i < 3; i++, reg_it++)
-        {
-            user_input[i] = (*reg_it).str();
-        }
-        D.push_back(spo_triple(
-            so_mapping.get_or_insert(user_input[0]),
-            p_mapping.get_or_insert(user_input[1]),
-            so_mapping.get_or_insert(user_input[2])));
-        
-        if (++count%1000000 == 0) {
-            cout << "tripleta " << count << ": " << user_input[0] << " " << user_input[1] << " " << user_input[2] << endl;
-        }
-    }
+    ring::dict_builder::build(dataset, so_mapping, p_mapping, D, n_threads);
     auto mapping_stop = timer::now();
-    cout << "  Mapping built" << endl;
-    cout << "    SO mapping " << so_mapping.bit_size() / 8 << " bytes" << endl;
-    cout << "    P mapping " << p_mapping.bit_size() / 8 << " bytes" << endl;
+    cout << "  Mapping built (" << D.size() << " triples)" << endl;
+    cout << "    SO mapping " << so_mapping->bit_size() / 8 << " bytes" << endl;
+    cout << "    P mapping " << p_mapping->bit_size() / 8 << " bytes" << endl;
     cout << "  Mapping took " << duration_cast<seconds>(mapping_stop - mapping_start).count() << " seconds." << endl;
 
     osfstream so_out(output + ".so.mapping", std::ios::binary | std::ios::trunc | std::ios::out);
-    so_mapping.serialize(so_out);
+    so_mapping->serialize(so_out);
     cout << "SO Mapping saved" << endl;
 
     osfstream p_out(output + ".p.mapping", std::ios::binary | std::ios::trunc | std::ios::out);
-    p_mapping.serialize(p_out);
+    p_mapping->serialize(p_out);
     cout << "P Mapping saved" << endl;
+
+    // With --hash, hash indexes of the terms, used by the queries to locate their constants.
+    // Otherwise those of a previous build are removed, they do not match the new IDs
+    if (!hash)
+    {
+        std::remove((output + ".so.mapping.hash").c_str());
+        std::remove((output + ".p.mapping.hash").c_str());
+        return;
+    }
+    so_mapping->build_hash_index();
+    osfstream so_hash_out(output + ".so.mapping.hash", std::ios::binary | std::ios::trunc | std::ios::out);
+    so_mapping->serialize_hash_index(so_hash_out);
+    p_mapping->build_hash_index();
+    osfstream p_hash_out(output + ".p.mapping.hash", std::ios::binary | std::ios::trunc | std::ios::out);
+    p_mapping->serialize_hash_index(p_hash_out);
+    cout << "Hash indexes saved" << endl;
 }
 
 template <class ring, class map>
-void build_index_mapped(const std::string &dataset, const std::string &output)
+void build_index_mapped(const std::string &dataset, const std::string &output, const uint64_t n_threads = 1, const bool compare = false, const bool hash = false)
 {
     vector<spo_triple> D;
 
-    build_mapping<map>(dataset, D, output);
+    build_mapping<map>(dataset, D, output, n_threads, hash);
 
     std::sort(D.begin(), D.end());
     auto original_size = D.size();
@@ -123,95 +156,116 @@ void build_index_mapped(const std::string &dataset, const std::string &output)
     D.erase(new_end, D.end());
 
     D.shrink_to_fit();
-
-    cout << "--Indexing " << D.size() << " triples" << endl;
-    memory_monitor::start();
-    auto start = timer::now();
-    ring A(D);
-    auto stop = timer::now();
-    memory_monitor::stop();
-    cout << "  Index built  " << sdsl::size_in_bytes(A) << " bytes" << endl;
-    sdsl::store_to_file(A, output);
-    cout << "Index saved" << endl;
-    cout << duration_cast<seconds>(stop - start).count() << " seconds." << endl;
-    cout << memory_monitor::peak() << " bytes." << endl;
+    construct<ring>(D, output, n_threads, compare);
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 4)
+    // --hash also writes the hash indexes of the dictionaries (see ring::hash_index)
+    bool hash = false;
+    if (argc > 1 && std::string(argv[argc - 1]) == "--hash")
+    {
+        hash = true;
+        argc--;
+    }
+
+    if (argc < 4 || argc > 6)
     {
-        std::cout << "Usage: " << argv[0] << " <dataset> <type> <output>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <dataset> <type> <output> [<threads> [compare]] [--hash]" << std::endl;
         return 0;
     }
 
     std::string dataset = argv[1];
     std::string type = argv[2];
     std::string output = argv[3];
+    uint64_t n_threads = (argc >= 5) ? std::stoull(argv[4]) : 1;
+    bool compare = (argc == 6) && std::string(argv[5]) == "compare";
 
     if (type == "ring")
     {
         std::string index_name = output + "/ring.ring";
-        build_index<ring::ring<>>(dataset, index_name);
+        build_index<ring::ring<>>(dataset, index_name, n_threads, compare);
     }
     else if (type == "c-ring")
     {
         std::string index_name = output + "/c-ring.ring";
-        build_index<ring::c_ring>(dataset, index_name);
+        build_index<ring::c_ring>(dataset, index_name, n_threads, compare);
     }
     else if (type == "ring-sel")
     {
         std::string index_name = output + "/ring-sel.ring";
-        build_index<ring::ring_sel>(dataset, index_name);
+        build_index<ring::ring_sel>(dataset, index_name, n_threads, compare);
+    }
+    else if (type == "ring-mapped")
+    {
+        std::string index_name = output + "/ring-mapped.ring";
+        build_index<ring::ring_mapped>(dataset, index_name, n_threads, compare);
     }
     else if (type == "ring-dyn-basic")
     {
         std::string index_name = output + "/ring-dyn-basic.ring";
-        build_index<ring::ring_dyn>(dataset, index_name);
+        build_index<ring::ring_dyn>(dataset, index_name, n_threads, compare);
     }
     else if (type == "ring-dyn")
     {
         std::string index_name = output + "/ring-dyn.ring";
-        build_index<ring::medium_ring_dyn>(dataset, index_name);
+        build_index<ring::medium_ring_dyn>(dataset, index_name, n_threads, compare);
     }
     else if (type == "ring-dyn-amo")
     {
         std::string index_name = output + "/ring-dyn-amo.ring";
-        build_index<ring::ring_dyn_amo>(dataset, index_name);
+        build_index<ring::ring_dyn_amo>(dataset, index_name, n_threads, compare);
+    }
+    else if (type == "ring-hybrid")
+    {
+        std::string index_name = output + "/ring-hybrid.ring";
+        build_index<ring::ring_hybrid>(dataset, index_name, n_threads, compare);
     }
     else if (type == "ring-map") {
         std::string index_name = output + "/ring-map.ring";
-        build_index_mapped<ring::ring<>, ring::basic_map>(dataset, index_name);
+        build_index_mapped<ring::ring<>, ring::basic_map>(dataset, index_name, n_threads, compare, hash);
+    }
+    else if (type == "ring-mapped-map") {
+        std::string index_name = output + "/ring-mapped-map.ring";
+        build_index_mapped<ring::ring_mapped, ring::basic_map>(dataset, index_name, n_threads, compare, hash);
+    }
+    else if (type == "ring-mapped-dict") {
+        std::string index_name = output + "/ring-mapped-dict.ring";
+        build_index_mapped<ring::ring_mapped, ring::basic_map_mapped>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-dyn-map")
     {
         std::string index_name = output + "/ring-dyn-map.ring";
-        build_index_mapped<ring::medium_ring_dyn, ring::basic_map>(dataset, index_name);
+        build_index_mapped<ring::medium_ring_dyn, ring::basic_map>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-dyn-amo-map") {
         std::string index_name = output + "/ring-dyn-amo-map.ring";
-        build_index_mapped<ring::ring_dyn_amo, ring::basic_map>(dataset, index_name);
+        build_index_mapped<ring::ring_dyn_amo, ring::basic_map>(dataset, index_name, n_threads, compare, hash);
+    }
+    else if (type == "ring-hybrid-map") {
+        std::string index_name = output + "/ring-hybrid-map.ring";
+        build_index_mapped<ring::ring_hybrid, ring::basic_map>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-map-avl")
     {
         std::string index_name = output + "/ring-map-avl.ring";
-        build_index_mapped<ring::ring<>, ring::basic_map_avl>(dataset, index_name);
+        build_index_mapped<ring::ring<>, ring::basic_map_avl>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-map-avl") {
         std::string index_name = output + "/ring-map-avl.ring";
-        build_index_mapped<ring::ring<>, ring::basic_map_avl>(dataset, index_name);
+        build_index_mapped<ring::ring<>, ring::basic_map_avl>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-dyn-map-avl") {
         std::string index_name = output + "/ring-dyn-map-avl.ring";
-        build_index_mapped<ring::medium_ring_dyn, ring::basic_map_avl>(dataset, index_name);
+        build_index_mapped<ring::medium_ring_dyn, ring::basic_map_avl>(dataset, index_name, n_threads, compare, hash);
     }
     else if (type == "ring-dyn-amo-map-avl") {
         std::string index_name = output + "/ring-dyn-amo-map-avl.ring";
-        build_index_mapped<ring::ring_dyn_amo, ring::basic_map_avl>(dataset, index_name);
+        build_index_mapped<ring::ring_dyn_amo, ring::basic_map_avl>(dataset, index_name, n_threads, compare, hash);
     }
     else
     {
-        std::cout << "Usage: " << argv[0] << " <dataset> <type> <output>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <dataset> <type> <output> [<threads> [compare]] [--hash]" << std::endl;
     }
 
     return 0;
@@ -151,6 +151,9 @@ void delete_query(const std::string &file, const std::string &queries)
 
     cout << endl
          << " Index loaded " << sdsl::size_in_bytes(graph) << " bytes" << endl;
+    // Kept up to date by the updates, and stored with the modified ring
+    if (ring::util::load_stats(graph, file))
+        cout << " Statistics loaded " << graph.stats().bit_size() / 8 << " bytes" << endl;
 
     uint64_t nQ = 0;
 
@@ -178,6 +181,8 @@ void delete_query(const std::string &file, const std::string &queries)
     std::string outfile = get_file_without_type(file) + ".updated." + get_type(file);
     sdsl::store_to_file(graph, outfile);
     std::cout << "Modified Ring stored" << std::endl;
+    if (ring::util::store_stats(graph, outfile))
+        std::cout << "Modified statistics stored" << std::endl;
 }
 
 template <class ring_type, class map_type>
@@ -211,6 +216,9 @@ void mapped_delete_query(const std::string &file, const std::string &so_mapping_
 
     cout << endl
          << " Index loaded " << sdsl::size_in_bytes(graph) << " bytes" << endl;
+    // Kept up to date by the updates, and stored with the modified ring
+    if (ring::util::load_stats(graph, file))
+        cout << " Statistics loaded " << graph.stats().bit_size() / 8 << " bytes" << endl;
 
     std::ifstream ifs;
     uint64_t nQ = 0;
@@ -271,6 +279,8 @@ void mapped_delete_query(const std::string &file, const std::string &so_mapping_
         std::string outfile = get_file_without_type(file) + ".updated." + get_type(file);
         sdsl::store_to_file(graph, outfile);
         std::cout << "Modified Ring stored" << std::endl;
+        if (ring::util::store_stats(graph, outfile))
+            std::cout << "Modified statistics stored" << std::endl;
 
         std::string so_outfile = get_file_without_type(so_mapping_file) + ".updated.mapping";
         std::ofstream so_out(so_outfile, std::ios::binary | std::ios::trunc | std::ios::out);
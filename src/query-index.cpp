@@ -21,11 +21,15 @@
 #include <iostream>
 #include <utility>
 #include "ring.hpp"
+#include "hybrid_ring.hpp"
 #include "dict_map.hpp"
 #include "dict_map_avl.hpp"
+#include "dict_mapped.hpp"
 #include <chrono>
 #include <triple_pattern.hpp>
 #include <ltj_algorithm.hpp>
+#include <query_cache.hpp>
+#include "bitvector_amortized/concurrent.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -220,19 +224,83 @@ std::string get_type(const std::string& path) {
 }
 
 template <class ring_type>
-void query(const std::string &file, const std::string &queries)
+void load_index(ring_type &graph, ring::mapped_file &mapping, const std::string &file)
+{
+    sdsl::load_from_file(graph, file);
+}
+
+//The mapped ring is not copied into memory, the queries run on the mapped file
+template <>
+void load_index(ring::ring_mapped &graph, ring::mapped_file &mapping, const std::string &file)
+{
+    mapping.open(file);
+    mapping.load(graph);
+}
+
+template <class map_type>
+void load_mapping(map_type &mapping, ring::mapped_file &file_mapping, const std::string &file)
+{
+    std::ifstream infs(file, std::ios::binary | std::ios::in);
+    mapping.load(infs);
+}
+
+//The flat dictionary is not copied into memory, it is used from the mapped file
+template <>
+void load_mapping(ring::basic_map_mapped &mapping, ring::mapped_file &file_mapping, const std::string &file)
+{
+    file_mapping.open(file);
+    file_mapping.load(mapping);
+}
+
+// Loads the hash index of a dictionary written by build-index --hash, if any
+template <class map_type>
+void load_hash_index(map_type &mapping, ring::mapped_file &file_mapping, const std::string &file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::in);
+    if (in)
+        mapping.load_hash_index(in);
+}
+
+//The hash index of the flat dictionary is used from the mapped file too
+template <>
+void load_hash_index(ring::basic_map_mapped &mapping, ring::mapped_file &file_mapping, const std::string &file)
+{
+    if (!std::ifstream(file))
+        return;
+    file_mapping.open(file);
+    ring::mapped_streambuf buf(file_mapping.data(), file_mapping.size());
+    std::istream in(&buf);
+    mapping.load_hash_index(in);
+}
+
+// Loads the statistics written by build-index, if any, so that the GAO
+// can use them
+template <class ring_type>
+void load_stats(ring_type &graph, const std::string &file)
+{
+    if (!ring::util::load_stats(graph, file))
+        return;
+    cout << " Statistics loaded " << graph.stats().bit_size() / 8 << " bytes" << endl;
+}
+
+template <class ring_type>
+void query(const std::string &file, const std::string &queries, const uint64_t n_threads = 1, const bool adaptive = false, const bool cache = false)
 {
     vector<string> dummy_queries;
     bool result = get_file_content(queries, dummy_queries);
 
     ring_type graph;
+    ring::mapped_file mapping;
+    // The threads of the parallel join query the same amortized bitvectors (ring_dyn_amo)
+    amo::setConcurrentReads(n_threads > 1);
 
     cout << " Loading the index...";
     fflush(stdout);
-    sdsl::load_from_file(graph, file);
+    load_index(graph, mapping, file);
 
     cout << endl
          << " Index loaded " << sdsl::size_in_bytes(graph) << " bytes" << endl;
+    load_stats(graph, file);
 
     std::ifstream ifs;
     uint64_t nQ = 0;
@@ -241,6 +309,11 @@ void query(const std::string &file, const std::string &queries)
     double total_time = 0.0;
     duration<double> time_span;
 
+    // The structures of each query are taken from the arena, which is reused
+    ring::query_arena arena;
+    // With --cache the results of repeated queries are not computed again
+    ring::query_cache<ring_type> results_cache(&graph);
+
     if (result)
     {
         for (string &query_string : dummy_queries)
@@ -256,51 +329,92 @@ void query(const std::string &file, const std::string &queries)
 
             start = high_resolution_clock::now();
 
-            ring::ltj_algorithm<ring_type> ltj(&query, &graph);
             typedef std::vector<typename ring::ltj_algorithm<>::tuple_type> results_type;
+            uint64_t n_res = 0;
             results_type res;
-            
-            ltj.join(res, 1000, 600);
+
+            if (cache && results_cache.lookup(query, res, 1000))
+            {
+                n_res = res.size();
+            }
+            else
+            {
+                arena.reset();
+                ring::ltj_algorithm<ring_type> ltj(&query, &graph, &arena);
+                if (n_threads > 1)
+                {
+                    ltj.join_parallel(res, n_threads, 1000, 600);
+                    n_res = res.size();
+                }
+                else if (cache)
+                {
+                    // The results are stored for the cache
+                    if (adaptive)
+                        ltj.join_adaptive(res, 1000, 600);
+                    else
+                        ltj.join(res, 1000, 600);
+                    n_res = res.size();
+                }
+                else if (adaptive)
+                {
+                    n_res = ltj.join_adaptive([](const typename ring::ltj_algorithm<>::tuple_type &t)
+                                              { return true; }, 1000, 600);
+                }
+                else
+                {
+                    // Only the number of results is needed, so they are not stored
+                    n_res = ltj.join([](const typename ring::ltj_algorithm<>::tuple_type &t)
+                                     { return true; }, 1000, 600);
+                }
+                // The results of a join stopped by the timeout are not complete
+                if (cache && duration_cast<seconds>(high_resolution_clock::now() - start).count() < 600)
+                    results_cache.insert(query, res, 1000);
+            }
             stop = high_resolution_clock::now();
             time_span = duration_cast<microseconds>(stop - start);
             total_time = time_span.count();
 
-            cout << nQ << ";" << res.size() << ";" << (unsigned long long)(total_time * 1000000000ULL) << endl;
+            cout << nQ << ";" << n_res << ";" << (unsigned long long)(total_time * 1000000000ULL) << endl;
             nQ++;
         }
     }
 }
 
 template <class ring_type, class map_type>
-void mapped_query(const std::string &file, const std::string &so_mapping_file, const std::string &p_mapping_file, const std::string &queries)
+void mapped_query(const std::string &file, const std::string &so_mapping_file, const std::string &p_mapping_file, const std::string &queries, const uint64_t n_threads = 1, const bool adaptive = false, const bool cache = false)
 {
     vector<string> dummy_queries;
 
     bool result = get_file_content(queries, dummy_queries);
 
-    // Load Dictionary Mapping
+    // Load Dictionary Mapping, the mapped files have to outlive the dictionaries
+    ring::mapped_file so_file_mapping, p_file_mapping, so_hash_mapping, p_hash_mapping;
     map_type so_mapping;
-    std::ifstream so_infs(so_mapping_file, std::ios::binary | std::ios::in);
-    so_mapping.load(so_infs);
+    load_mapping(so_mapping, so_file_mapping, so_mapping_file);
+    load_hash_index(so_mapping, so_hash_mapping, so_mapping_file + ".hash");
 
     cout << endl
          << " SO Mapping loaded " << so_mapping.bit_size() / 8 << " bytes" << endl;
 
     map_type p_mapping;
-    std::ifstream p_infs(p_mapping_file, std::ios::binary | std::ios::in);
-    p_mapping.load(p_infs);
+    load_mapping(p_mapping, p_file_mapping, p_mapping_file);
+    load_hash_index(p_mapping, p_hash_mapping, p_mapping_file + ".hash");
 
     cout << endl
          << " P Mapping loaded " << p_mapping.bit_size() / 8 << " bytes" << endl;
 
     ring_type graph;
+    ring::mapped_file mapping;
+    // The threads of the parallel join query the same amortized bitvectors (ring_dyn_amo)
+    amo::setConcurrentReads(n_threads > 1);
 
     cout << " Loading the index...";
     fflush(stdout);
-    sdsl::load_from_file(graph, file);
+    load_index(graph, mapping, file);
 
     cout << endl
          << " Index loaded " << sdsl::size_in_bytes(graph) << " bytes" << endl;
+    load_stats(graph, file);
 
     std::ifstream ifs;
     uint64_t nQ = 0;
@@ -309,6 +423,15 @@ void mapped_query(const std::string &file, const std::string &so_mapping_file, c
     double total_time = 0.0, forward_trad = 0.0, backward_trad = 0.0;
     duration<double> time_span;
 
+    // The structures of each query are taken from the arena, which is reused
+    ring::query_arena arena;
+    // With --cache the results of repeated queries are not computed again
+    ring::query_cache<ring_type> results_cache(&graph);
+    // The values of the results are kept in values_arena until the next query
+    ring::query_arena values_arena;
+    std::vector<uint64_t> result_ids;
+    std::vector<std::string_view> result_values;
+
     if (result)
     {
         for (string &query_string : dummy_queries)
@@ -330,11 +453,22 @@ void mapped_query(const std::string &file, const std::string &so_mapping_file, c
 
             start = high_resolution_clock::now();
 
-            ring::ltj_algorithm<ring_type> ltj(&query, &graph);
-
             typedef std::vector<typename ring::ltj_algorithm<>::tuple_type> results_type;
             results_type res;
-            ltj.join(res, 1000, 600);
+            if (!cache || !results_cache.lookup(query, res, 1000))
+            {
+                arena.reset();
+                ring::ltj_algorithm<ring_type> ltj(&query, &graph, &arena);
+                if (n_threads > 1)
+                    ltj.join_parallel(res, n_threads, 1000, 600);
+                else if (adaptive)
+                    ltj.join_adaptive(res, 1000, 600);
+                else
+                    ltj.join(res, 1000, 600);
+                // The results of a join stopped by the timeout are not complete
+                if (cache && duration_cast<seconds>(high_resolution_clock::now() - start).count() < 600)
+                    results_cache.insert(query, res, 1000);
+            }
 
             stop = high_resolution_clock::now();
             time_span = duration_cast<microseconds>(stop - start);
@@ -342,16 +476,17 @@ void mapped_query(const std::string &file, const std::string &so_mapping_file, c
 
             start = high_resolution_clock::now();
 
-            if (res.size() > 0)
+            // The values of all the results are extracted at once, each PFC is decoded once
+            values_arena.reset();
+            result_ids.clear();
+            for (const auto &r : res)
             {
-                for (auto r : res)
+                for (const auto &x : r)
                 {
-                    for (auto x : r)
-                    {
-                        so_mapping.extract(get<1>(x));
-                    }
+                    result_ids.push_back(get<1>(x));
                 }
             }
+            so_mapping.extract_batch(result_ids.data(), result_ids.size(), values_arena, result_values);
 
             stop = high_resolution_clock::now();
             time_span = duration_cast<microseconds>(stop - start);
@@ -367,41 +502,70 @@ void mapped_query(const std::string &file, const std::string &so_mapping_file, c
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3 && argc != 5)
+    // --adaptive chooses the variable order during the join (gao::gao_adaptive)
+    // --cache keeps the results of the queries in a ring::query_cache
+    bool adaptive = false, cache = false;
+    while (argc > 1)
     {
-        std::cout << "Usage: " << argv[0] << " <index> <queries>" << std::endl;
+        std::string flag = argv[argc - 1];
+        if (flag == "--adaptive")
+            adaptive = true;
+        else if (flag == "--cache")
+            cache = true;
+        else
+            break;
+        argc--;
+    }
+
+    if (argc < 3 || argc > 6)
+    {
+        std::cout << "Usage: " << argv[0] << " <index> <queries> [<SO mapping> <P mapping>] [<threads>] [--adaptive] [--cache]" << std::endl;
         return 0;
     }
 
     std::string index = argv[1];
     std::string queries = argv[2];
     std::string type = get_type(index);
+    uint64_t n_threads = 1;
+    if (argc == 4 || argc == 6)
+    {
+        n_threads = std::stoull(argv[argc - 1]);
+        argc--;
+    }
 
     if (argc == 3)
     {
         if (type == "ring")
         {
-            query<ring::ring<>>(index, queries);
+            query<ring::ring<>>(index, queries, n_threads, adaptive, cache);
         }
         else if (type == "c-ring")
         {
-            query<ring::c_ring>(index, queries);
+            query<ring::c_ring>(index, queries, n_threads, adaptive, cache);
         }
         else if (type == "ring-sel")
         {
-            query<ring::ring_sel>(index, queries);
+            query<ring::ring_sel>(index, queries, n_threads, adaptive, cache);
+        }
+        else if (type == "ring-mapped")
+        {
+            query<ring::ring_mapped>(index, queries, n_threads, adaptive, cache);
         }
         else if (type == "ring-dyn-basic")
         {
-            query<ring::ring_dyn>(index, queries);
+            query<ring::ring_dyn>(index, queries, 1, adaptive, cache);
         }
         else if (type == "ring-dyn")
         {
-            query<ring::medium_ring_dyn>(index, queries);
+            query<ring::medium_ring_dyn>(index, queries, 1, adaptive, cache);
         }
         else if (type == "ring-dyn-amo")
         {
-            query<ring::ring_dyn_amo>(index, queries);
+            query<ring::ring_dyn_amo>(index, queries, n_threads, adaptive, cache);
+        }
+        else if (type == "ring-hybrid")
+        {
+            query<ring::ring_hybrid>(index, queries, n_threads, adaptive, cache);
         }
         else
         {
@@ -415,31 +579,43 @@ int main(int argc, char *argv[])
         std::string p_mapping = argv[4];
         if (type == "ring-map")
         {
-            mapped_query<ring::ring<>, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::ring<>, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
         } 
         else if (type == "ring-map-avl")
         {
-            mapped_query<ring::ring<>, ring::basic_map_avl>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::ring<>, ring::basic_map_avl>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
         }
         else if (type == "c-ring")
         {
-            mapped_query<ring::c_ring, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::c_ring, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
         }
         else if (type == "ring-sel")
         {
-            mapped_query<ring::ring_sel, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::ring_sel, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
+        }
+        else if (type == "ring-mapped-map")
+        {
+            mapped_query<ring::ring_mapped, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
+        }
+        else if (type == "ring-mapped-dict")
+        {
+            mapped_query<ring::ring_mapped, ring::basic_map_mapped>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
         }
         else if (type == "ring-dyn-basic")
         {
-            mapped_query<ring::ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, 1, adaptive, cache);
         }
         else if (type == "ring-dyn-map")
         {
-            mapped_query<ring::medium_ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::medium_ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, 1, adaptive, cache);
         }
         else if (type == "ring-dyn-amo-map")
         {
-            mapped_query<ring::ring_dyn_amo, ring::basic_map>(index, so_mapping, p_mapping, queries);
+            mapped_query<ring::ring_dyn_amo, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
+        }
+        else if (type == "ring-hybrid-map")
+        {
+            mapped_query<ring::ring_hybrid, ring::basic_map>(index, so_mapping, p_mapping, queries, n_threads, adaptive, cache);
         }
         else
         {
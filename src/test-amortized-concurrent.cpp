@@ -0,0 +1,105 @@
+#include "bitvector_amortized/hybrid.hpp"
+#include "bitvector_amortized/concurrent.hpp"
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Varios lectores consultan la version publicada de un HybridBV (y la aplanan
+// a la vez) mientras un escritor la copia, actualiza la copia y la publica,
+// como hace ring::versioned_ring. Cada version lleva los bits esperados.
+struct Version {
+    amo::HybridBV bv;
+    std::vector<bool> bits;
+    std::vector<uint64_t> ones; // unos antes de cada posicion
+    std::vector<uint64_t> pos1; // posicion de cada uno
+
+    void index() {
+        ones.assign(bits.size() + 1, 0);
+        pos1.clear();
+        for (uint64_t i = 0; i < bits.size(); i++) {
+            ones[i + 1] = ones[i] + bits[i];
+            if (bits[i]) pos1.push_back(i);
+        }
+    }
+};
+
+int main() {
+    const uint64_t n = 30000;
+    const uint readers = 4;
+    const uint versions = 40;
+    amo::setConcurrentReads(true);
+
+    std::mt19937_64 gen(17);
+    auto first = std::make_shared<Version>();
+    // inserciones en posiciones al azar, para que el arbol tenga nodos dinamicos
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t p = gen() % (first->bits.size() + 1);
+        uint v = gen() % 2;
+        first->bv.insert(p, v);
+        first->bits.insert(first->bits.begin() + p, v);
+    }
+    first->index();
+    std::shared_ptr<Version> current = first;
+    first.reset();
+
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> errors(0), queries(0);
+    std::vector<std::thread> threads;
+    for (uint r = 0; r < readers; r++) {
+        threads.emplace_back([&, r]() {
+            std::mt19937_64 g(100 + r);
+            while (!done.load()) {
+                std::shared_ptr<Version> v = std::atomic_load(&current);
+                uint64_t m = v->bits.size();
+                for (uint k = 0; k < 2000; k++) {
+                    uint64_t i = g() % m;
+                    if (v->bv.at(i) != v->bits[i]) errors++;
+                    if (v->bv.rank(i) != v->ones[i]) errors++;
+                    if (!v->pos1.empty()) {
+                        uint64_t j = g() % v->pos1.size();
+                        if (v->bv.select1(j) != v->pos1[j]) errors++;
+                    }
+                }
+                queries += 2000;
+            }
+        });
+    }
+
+    std::mt19937_64 g(99);
+    for (uint k = 0; k < versions; k++) {
+        std::shared_ptr<Version> v = std::atomic_load(&current);
+        // la copia se hace mientras los lectores aplanan la version publicada
+        auto next = std::make_shared<Version>(*v);
+        v.reset();
+        for (uint u = 0; u < 500; u++) {
+            if (g() % 2) {
+                uint64_t p = g() % (next->bits.size() + 1);
+                uint b = g() % 2;
+                next->bv.insert(p, b);
+                next->bits.insert(next->bits.begin() + p, b);
+            } else {
+                uint64_t p = g() % next->bits.size();
+                next->bv.remove(p);
+                next->bits.erase(next->bits.begin() + p);
+            }
+        }
+        next->index();
+        std::atomic_store(&current, next);
+    }
+    done = true;
+    for (auto &t : threads) t.join();
+
+    // la ultima version, ya sin lectores
+    std::shared_ptr<Version> v = current;
+    for (uint64_t i = 0; i < v->bits.size(); i++) {
+        if (v->bv.at(i) != v->bits[i]) errors++;
+    }
+
+    std::cout << "Versiones publicadas: " << versions << std::endl;
+    std::cout << "Consultas concurrentes: " << queries.load() << std::endl;
+    std::cout << "Errores (0): " << errors.load() << std::endl;
+    amo::setConcurrentReads(false);
+    return errors.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include "bitvector_amortized/hybrid.hpp"
+#include "bitvector_amortized/simd.hpp"
+#include <random>
+#include <vector>
+
+// Compara los kernels que soporta la CPU con las versiones escalares, con
+// palabras al azar, longitudes y desplazamientos al azar, y un HybridBV
+// construido y consultado con cada uno de ellos.
+
+static uint64_t unosEscalar(const uint64_t* data, uint64_t n) {
+    uint64_t unos = 0;
+    for (uint64_t i = 0; i < n; i++) unos += __builtin_popcountll(data[i]);
+    return unos;
+}
+
+static uint selectEscalar(uint64_t word, uint j) {
+    for (uint p = 0; p < 64; p++) {
+        if ((word >> p) & 1) {
+            if (--j == 0) return p;
+        }
+    }
+    return 64;
+}
+
+// palabras con densidades distintas: al azar, casi vacias y casi llenas
+static uint64_t palabra(std::mt19937_64& gen) {
+    switch (gen() % 3) {
+        case 0: return gen();
+        case 1: return gen() & gen() & gen();
+        default: return gen() | gen() | gen();
+    }
+}
+
+static uint64_t probarKernels(std::mt19937_64& gen) {
+    uint64_t errores = 0;
+    std::vector<uint64_t> data(256 + 16);
+    std::vector<uint16_t> counts(data.size() / amo::K + 2);
+    for (uint k = 0; k < 2000; k++) {
+        for (auto& w : data) w = palabra(gen);
+        uint64_t off = gen() % 16, n = gen() % 257;
+        const uint64_t* p = data.data() + off;
+        if (amo::kernels().popcountWords(p, n) != unosEscalar(p, n)) errores++;
+
+        std::fill(counts.begin(), counts.end(), 0xffff);
+        amo::kernels().popcountBlocks(p, n, counts.data());
+        for (uint64_t i = 0; i < n; i += amo::K) {
+            if (counts[i/amo::K] != unosEscalar(p + i, std::min<uint64_t>(amo::K, n - i))) errores++;
+        }
+        // no escribe despues del ultimo bloque
+        if (counts[(n + amo::K - 1) / amo::K] != 0xffff) errores++;
+
+        uint64_t w = palabra(gen);
+        uint unos = __builtin_popcountll(w);
+        for (uint j = 1; j <= unos; j++) {
+            if (amo::kernels().selectWord(w, j) != selectEscalar(w, j)) errores++;
+        }
+    }
+    return errores;
+}
+
+static uint64_t probarBitvector(std::mt19937_64& gen) {
+    uint64_t errores = 0;
+    amo::HybridBV bv;
+    std::vector<bool> bits;
+    for (uint64_t i = 0; i < 20000; i++) {
+        uint64_t p = gen() % (bits.size() + 1);
+        uint v = (gen() % 4) != 0;
+        bv.insert(p, v);
+        bits.insert(bits.begin() + p, v);
+    }
+    std::vector<uint64_t> pos1;
+    uint64_t unos = 0;
+    for (uint64_t i = 0; i < bits.size(); i++) {
+        if (bv.rank(i) != unos) errores++;
+        if (bits[i]) {
+            pos1.push_back(i);
+            unos++;
+        }
+    }
+    for (uint64_t j = 0; j < pos1.size(); j++) {
+        if (bv.select1(j) != pos1[j]) errores++;
+    }
+    return errores;
+}
+
+int main() {
+    const char* nombres[] = {"default", "popcnt", "avx2", "avx512"};
+    std::mt19937_64 gen(23);
+    uint64_t total = 0;
+    for (const char* nombre : nombres) {
+        if (!amo::setKernels(nombre)) {
+            std::cout << "Kernels " << nombre << ": no soportados por la CPU" << std::endl;
+            continue;
+        }
+        uint64_t errores = probarKernels(gen) + probarBitvector(gen);
+        std::cout << "Kernels " << amo::kernels().name << ", errores (0): " << errores << std::endl;
+        total += errores;
+    }
+    return total == 0 ? 0 : 1;
+}
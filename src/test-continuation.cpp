@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ring.hpp"
+#include <continuation.hpp>
+#include "test-helpers.hpp"
+
+const uint64_t n_so = 60, n_p = 6;
+
+static std::vector<std::vector<ring::triple_pattern>> make_queries()
+{
+    std::vector<std::vector<ring::triple_pattern>> queries;
+    for (int p = 1; p <= 3; ++p)
+    {
+        queries.push_back({pattern(-1, p, -2), pattern(-2, p + 1, -3)});
+        queries.push_back({pattern(-1, p, -2), pattern(-1, p + 2, -3), pattern(-3, p + 1, -2)});
+        queries.push_back({pattern(p, -1, -2)});
+        queries.push_back({pattern(-1, -2, p + 10)});
+    }
+    queries.push_back({pattern(-1, -2, -3)});
+    queries.push_back({pattern(-1, 1, -2), pattern(-2, 2, -3), pattern(-3, 3, -1)});
+    // without results
+    queries.push_back({pattern(-1, n_p + 1, -2)});
+    return queries;
+}
+
+// The pages of the query, each one computed by a new ltj_algorithm from the token
+// left by the previous one, and the offset skipped before the first page
+template <class ring_type>
+static results_type paged(std::vector<ring::triple_pattern> &query, ring_type &r, uint64_t page_size,
+                          uint64_t offset, bool &ok)
+{
+    results_type res;
+    std::string token = ring::continuation().encode();
+    for (uint64_t i = 0; ; ++i)
+    {
+        ring::continuation k;
+        ok &= k.decode(token);
+        if (k.finished)
+            break;
+        ring::ltj_algorithm<ring_type> ltj(&query, &r);
+        uint64_t n = ltj.join_page(res, k, page_size, i == 0 ? offset : 0);
+        ok &= n <= page_size && (n == page_size || k.finished);
+        token = k.encode();
+    }
+    return res;
+}
+
+template <class ring_type>
+static bool test_pages(ring_type &r, const std::string &name)
+{
+    bool ok = true;
+    uint64_t n_queries = 0, wrong = 0, n_results = 0;
+    auto queries = make_queries();
+    for (auto &q : queries)
+    {
+        results_type expected;
+        ring::ltj_algorithm<ring_type> ltj(&q, &r);
+        ltj.join(expected);
+        n_results += expected.size();
+        for (uint64_t page_size : {1, 3, 50, 1000000})
+        {
+            bool valid = true;
+            if (paged(q, r, page_size, 0, valid) != expected || !valid)
+                ++wrong;
+            // skipping some results before the first page
+            uint64_t offset = std::min<uint64_t>(page_size + 2, expected.size());
+            results_type rest(expected.begin() + offset, expected.end());
+            if (paged(q, r, page_size, offset, valid) != rest || !valid)
+                ++wrong;
+        }
+        ++n_queries;
+    }
+    ok &= wrong == 0;
+    std::cout << name << ": " << n_queries << " queries (" << n_results << " results), " << wrong
+              << " wrong paginations -> " << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+// encode and decode give back the same continuation, with integers of any size
+static bool test_encoding()
+{
+    ring::continuation k;
+    k.query = std::numeric_limits<uint64_t>::max();
+    k.n_results = 128;
+    k.finished = false;
+    k.gao = {2, 0, 255, 1};
+    k.values = {0, 127, 16384, std::numeric_limits<uint64_t>::max()};
+    ring::continuation d;
+    bool ok = d.decode(k.encode()) && d.query == k.query && d.n_results == k.n_results &&
+              d.finished == k.finished && d.gao == k.gao && d.values == k.values;
+
+    ring::continuation empty;
+    ok &= d.decode(empty.encode()) && d.n_results == 0 && !d.finished && d.gao.empty() && d.values.empty();
+    std::cout << "Token round trip -> " << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+// truncated and corrupt tokens are rejected
+static bool test_invalid_tokens()
+{
+    ring::continuation k;
+    k.query = 12345678901234ULL;
+    k.n_results = 300;
+    k.gao = {1, 0, 2};
+    k.values = {70000, 3, 129};
+    const std::string token = k.encode();
+    ring::continuation d;
+    bool ok = true;
+    for (uint64_t n = 0; n < token.size(); ++n)
+        ok &= !d.decode(token.substr(0, n));
+    ok &= !d.decode(token + '\0');
+
+    // the last byte says that the integer goes on
+    std::string corrupt = token;
+    corrupt.back() |= 0x80;
+    ok &= !d.decode(corrupt);
+    // an integer longer than 64 bits
+    ok &= !d.decode(std::string(11, (char) 0xff) + '\1');
+
+    // a value of finished that is not a bool
+    ring::continuation bad = k;
+    bad.finished = false;
+    corrupt = bad.encode();
+    uint64_t pos = 0;
+    while (corrupt[pos] & 0x80)
+        ++pos; // end of the query
+    ++pos;
+    while (corrupt[pos] & 0x80)
+        ++pos; // end of the results
+    corrupt[pos + 1] = 2;
+    ok &= !d.decode(corrupt);
+
+    // as many values as variables of the GAO
+    bad.values.pop_back();
+    ok &= !d.decode(bad.encode());
+    std::cout << "Invalid tokens rejected -> " << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+// a continuation of another query cannot be resumed
+template <class ring_type>
+static bool test_other_query(ring_type &r)
+{
+    std::vector<ring::triple_pattern> a = {pattern(-1, 1, -2), pattern(-2, 2, -3)};
+    std::vector<ring::triple_pattern> b = {pattern(-1, 2, -2), pattern(-2, 1, -3)};
+    results_type res;
+    ring::continuation k;
+    ring::ltj_algorithm<ring_type> ltj_a(&a, &r);
+    ltj_a.join_page(res, k, 2);
+    bool ok = false;
+    try
+    {
+        ring::ltj_algorithm<ring_type> ltj_b(&b, &r);
+        ltj_b.join_page(res, k, 2);
+    }
+    catch (const std::invalid_argument &)
+    {
+        ok = true;
+    }
+    std::cout << "Continuation of another query rejected -> " << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+int main()
+{
+    std::mt19937 gen(19);
+    std::vector<spo_triple> D = random_triples(gen, 3000, n_so, n_p);
+    std::sort(D.begin(), D.end());
+    D.erase(std::unique(D.begin(), D.end()), D.end());
+    std::vector<spo_triple> E(D);
+    ring::ring<> r(D);
+    ring::ring_dyn r_dyn(E);
+
+    bool ok = test_encoding();
+    ok &= test_invalid_tokens();
+    ok &= test_pages(r, "ring");
+    ok &= test_pages(r_dyn, "ring_dyn");
+    ok &= test_other_query(r);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
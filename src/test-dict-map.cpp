@@ -0,0 +1,284 @@
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bucket_map.hpp"
+#include "dict_map.hpp"
+#include "dict_map_avl.hpp"
+#include "dict_mapped.hpp"
+#include "mapped_file.hpp"
+
+typedef std::map<std::string, uint64_t> reference_type;
+
+static std::string random_word(std::mt19937 &gen)
+{
+    // shared prefixes, so the PFCs compress them
+    static const char *prefixes[] = {"http://example.org/", "http://example.org/resource/", "\"", "_:b"};
+    return prefixes[gen() % 4] + std::to_string(gen() % 20000);
+}
+
+// every word of expected is found with its ID and extracted, alone and in a batch,
+// and absent words are not found
+template <class dict_type>
+static bool check(dict_type &dict, const reference_type &expected, std::mt19937 &gen, const std::string &step)
+{
+    uint64_t wrong = 0;
+    for (auto &w : expected)
+    {
+        std::pair<bool, uint64_t> found = dict.locate(w.first);
+        if (!found.first || found.second != w.second || dict.extract(w.second) != w.first)
+            ++wrong;
+    }
+    for (uint64_t i = 0; i < 200; ++i)
+    {
+        std::string w = random_word(gen);
+        if (expected.count(w) == 0 && dict.locate(w).first)
+            ++wrong;
+    }
+
+    // the IDs in random order and some of them repeated
+    std::vector<const std::pair<const std::string, uint64_t> *> entries;
+    for (auto &w : expected)
+        entries.push_back(&w);
+    std::vector<const std::pair<const std::string, uint64_t> *> batch;
+    std::vector<uint64_t> ids;
+    for (uint64_t i = 0; !entries.empty() && i < entries.size() + 100; ++i)
+    {
+        batch.push_back(entries[gen() % entries.size()]);
+        ids.push_back(batch.back()->second);
+    }
+    ring::query_arena arena;
+    std::vector<std::string_view> values;
+    dict.extract_batch(ids.data(), ids.size(), arena, values);
+    for (uint64_t i = 0; i < ids.size(); ++i)
+        if (values[i] != batch[i]->first)
+            ++wrong;
+    std::cout << step << ": " << expected.size() << " words, " << wrong << " wrong -> " << (wrong == 0 ? "OK" : "ERROR")
+              << std::endl;
+    return wrong == 0;
+}
+
+// many readers locate the words at the same time, right after an update, so
+// one of them builds the index of the PFCs while the others search the tree
+template <class dict_type>
+static bool check_concurrent(dict_type &dict, const reference_type &expected, const std::string &step)
+{
+    std::atomic<uint64_t> wrong(0);
+    std::vector<std::thread> readers;
+    for (uint64_t r = 0; r < 4; ++r)
+        readers.emplace_back([&]() {
+            for (auto &w : expected)
+            {
+                std::pair<bool, uint64_t> found = dict.locate(w.first);
+                if (!found.first || found.second != w.second)
+                    ++wrong;
+            }
+        });
+    for (auto &t : readers)
+        t.join();
+    std::cout << step << ": " << expected.size() << " words, " << wrong.load() << " wrong -> "
+              << (wrong.load() == 0 ? "OK" : "ERROR") << std::endl;
+    return wrong.load() == 0;
+}
+
+// n random insertions and deletions, with the given percentage of deletions
+template <class dict_type>
+static bool update(dict_type &dict, reference_type &expected, std::mt19937 &gen, uint64_t n, uint64_t deletions,
+                   const std::string &step)
+{
+    bool ok = true;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        bool remove = !expected.empty() && gen() % 100 < deletions;
+        if (remove)
+        {
+            auto it = std::next(expected.begin(), gen() % expected.size());
+            if (gen() % 4 != 0)
+                ok &= dict.eliminate(it->first) == it->second;
+            else
+                dict.eliminate(it->second);
+            expected.erase(it);
+        }
+        else
+        {
+            std::string w = random_word(gen);
+            auto it = expected.find(w);
+            if (it != expected.end())
+                ok &= dict.get_or_insert(w) == it->second;
+            else if (gen() % 2 == 0)
+                expected[w] = dict.insert(w);
+            else
+                expected[w] = dict.get_or_insert(w);
+        }
+    }
+    // the IDs in use are distinct
+    std::map<uint64_t, std::string> ids;
+    for (auto &w : expected)
+        ok &= ids.emplace(w.second, w.first).second;
+    if (!ok)
+        std::cout << step << ": wrong IDs -> ERROR" << std::endl;
+    return check(dict, expected, gen, step) && ok;
+}
+
+// n random words, with the IDs they get from a bulk build of values
+static reference_type bulk_words(std::mt19937 &gen, uint64_t n, std::vector<std::string> &values)
+{
+    reference_type words;
+    while (words.size() < n)
+        words.emplace(random_word(gen), 0);
+    values.clear();
+    for (auto &w : words)
+    {
+        values.push_back(w.first);
+        w.second = values.size();
+    }
+    return words;
+}
+
+template <class dict_type>
+static bool test(const std::string &name, std::mt19937 &gen)
+{
+    bool ok = true;
+    {
+        reference_type expected;
+        dict_type dict;
+        ok &= update(dict, expected, gen, 20000, 30, name + ", built by insertions");
+
+        // the updates keep the hash index consistent
+        dict.build_hash_index();
+        ok &= update(dict, expected, gen, 5000, 50, name + ", with the hash index");
+
+        // serialize and load, with the hash index stored apart
+        std::stringstream ss, hs;
+        dict.serialize(ss);
+        dict.serialize_hash_index(hs);
+        dict_type loaded;
+        loaded.load(ss);
+        loaded.load_hash_index(hs);
+        ok &= loaded.has_hash_index();
+        ok &= check(loaded, expected, gen, name + ", loaded");
+        ok &= update(loaded, expected, gen, 5000, 50, name + ", updated after loading");
+    }
+
+    // bulk built, so the tree is balanced before the updates
+    for (bool ascending : {true, false})
+    {
+        std::string order = ascending ? "ascending" : "descending";
+        std::vector<std::string> values;
+        reference_type expected = bulk_words(gen, 8000, values);
+        dict_type dict(values);
+        ok &= check(dict, expected, gen, name + ", bulk built");
+
+        // deleting the words in order empties the leaves one after the other
+        for (uint64_t i = 0; i < 7000; ++i)
+        {
+            auto it = ascending ? expected.begin() : std::prev(expected.end());
+            ok &= dict.eliminate(it->first) == it->second;
+            expected.erase(it);
+        }
+        ok &= check(dict, expected, gen, name + ", deleted in " + order + " order");
+        ok &= update(dict, expected, gen, 20000, 30, name + ", grown again");
+        for (uint64_t i = 0; i < 10; ++i)
+        {
+            std::string w = random_word(gen);
+            if (expected.count(w) == 0)
+                expected[w] = dict.insert(w);
+        }
+        ok &= check_concurrent(dict, expected, name + ", concurrent readers after an update");
+        ok &= update(dict, expected, gen, 20000, 80, name + ", mostly deleted");
+    }
+    return ok;
+}
+
+// the flat layout, read into memory and mapped, until the updates make it mutable
+template <class dict_type>
+static bool test_mapped(const std::string &name, std::mt19937 &gen)
+{
+    typedef ring::dict_mapped<dict_type> mapped_type;
+    bool ok = true;
+    std::vector<std::string> values;
+    reference_type expected = bulk_words(gen, 8000, values);
+    std::string file = (std::filesystem::temp_directory_path() / "test-dict-map.dict").string();
+    {
+        mapped_type built(values);
+        ok &= check(built, expected, gen, name + ", flat layout");
+        sdsl::store_to_file(built, file);
+    }
+    {
+        ring::mapped_file mapping(file);
+        mapped_type mapped;
+        mapping.load(mapped);
+        ok &= mapped.is_mapped();
+        ok &= check(mapped, expected, gen, name + ", mapped");
+        mapped.build_hash_index();
+        ok &= check(mapped, expected, gen, name + ", mapped with the hash index");
+
+        // the first update builds the mutable dictionary from the mapped buckets
+        ok &= update(mapped, expected, gen, 10000, 50, name + ", mapped and updated");
+        ok &= mapped.is_mutable() && mapped.has_hash_index();
+
+        // it is flattened again into the same layout
+        std::stringstream ss;
+        mapped.serialize(ss);
+        mapped_type loaded;
+        loaded.load(ss);
+        ok &= !loaded.is_mapped() && !loaded.is_mutable();
+        ok &= check(loaded, expected, gen, name + ", flat layout after the updates");
+    }
+    std::filesystem::remove(file);
+    return ok;
+}
+
+// random PFCs for the IDs, from more and more PFCs so that the array is widened
+static bool test_bucket_map(std::mt19937 &gen)
+{
+    std::vector<ring::PFC> pfcs(1000);
+    std::vector<ring::PFC *> expected(100, nullptr); // The PFC of the ID i + 1
+    ring::bucket_map map;
+    map.assign(expected.size(), 2);
+    const uint64_t n = 50000;
+    uint64_t wrong = 0;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint64_t n_pfcs = 1 + i * pfcs.size() / n;
+        ring::PFC *pfc = gen() % 5 == 0 ? nullptr : &pfcs[gen() % n_pfcs];
+        if (gen() % 10 == 0)
+        {
+            map.push_back(pfc);
+            expected.push_back(pfc);
+        }
+        else
+        {
+            uint64_t id = 1 + gen() % expected.size();
+            map.set_pfc(id, pfc);
+            expected[id - 1] = pfc;
+        }
+        if (i % 1000 == 0 || i == n - 1)
+        {
+            for (uint64_t id = 1; id <= expected.size(); ++id)
+                if (map.get_pfc(id) != expected[id - 1] || map.has_pfc(id) != (expected[id - 1] != nullptr))
+                    ++wrong;
+        }
+    }
+    bool ok = wrong == 0 && map.size() == expected.size() && !map.has_pfc(0) && !map.has_pfc(expected.size() + 1);
+    std::cout << "bucket_map: " << map.size() << " IDs, " << wrong << " wrong -> " << (ok ? "OK" : "ERROR")
+              << std::endl;
+    return ok;
+}
+
+int main()
+{
+    std::mt19937 gen(17);
+    bool ok = test_bucket_map(gen);
+    ok &= test<ring::basic_map>("basic_map", gen);
+    ok &= test<ring::basic_map_avl>("basic_map_avl", gen);
+    ok &= test_mapped<ring::basic_map>("basic_map_mapped", gen);
+    ok &= test_mapped<ring::basic_map_avl>("basic_map_avl_mapped", gen);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ring.hpp"
+#include "dict_map.hpp"
+#include "durable_ring.hpp"
+#include "test-helpers.hpp"
+
+typedef ring::durable_ring<ring::ring_dyn, ring::basic_map> durable_type;
+
+static std::string name(const std::string &prefix, uint64_t i)
+{
+    std::string n = std::to_string(i);
+    return prefix + std::string(6 - n.size(), '0') + n;
+}
+
+static std::vector<std::string> names(const std::string &prefix, uint64_t n)
+{
+    std::vector<std::string> v;
+    for (uint64_t i = 1; i <= n; ++i)
+        v.push_back(name(prefix, i));
+    return v;
+}
+
+static std::string last_segment(const std::string &dir)
+{
+    std::string last;
+    for (auto &e : std::filesystem::directory_iterator(dir))
+    {
+        std::string n = e.path().filename().string();
+        if (n.compare(0, 4, "wal-") == 0 && e.path().string() > last)
+            last = e.path().string();
+    }
+    return last;
+}
+
+int main()
+{
+    const uint64_t n_so = 60, n_p = 6;
+    std::string base = (std::filesystem::temp_directory_path() / "test-durable-ring").string();
+    std::string dir = base + "/store";
+    std::filesystem::remove_all(base);
+    std::filesystem::create_directories(base);
+    std::mt19937 gen(7);
+    bool ok = true;
+
+    // the index as written by build-index
+    auto initial = random_triples(gen, 300, n_so, n_p);
+    std::sort(initial.begin(), initial.end());
+    initial.erase(std::unique(initial.begin(), initial.end()), initial.end());
+    std::set<spo_triple> expected(initial.begin(), initial.end());
+    {
+        std::vector<spo_triple> D(initial);
+        ring::ring_dyn r(D);
+        sdsl::store_to_file(r, base + "/index.ring");
+        ring::basic_map so(names("so", n_so)), p(names("p", n_p));
+        std::ofstream so_out(base + "/index.so", std::ios::binary), p_out(base + "/index.p", std::ios::binary);
+        so.serialize(so_out);
+        p.serialize(p_out);
+    }
+    durable_type::create(dir, base + "/index.ring", base + "/index.so", base + "/index.p");
+
+    std::vector<spo_triple> torn;
+    {
+        durable_type d(dir);
+        ok &= check(*d.snapshot(), expected, "Opened");
+
+        auto batch = random_triples(gen, 100, n_so, n_p);
+        d.insert_batch(batch);
+        expected.insert(batch.begin(), batch.end());
+        d.checkpoint();
+
+        std::vector<spo_triple> removed(expected.begin(), std::next(expected.begin(), 40));
+        d.remove_batch(removed);
+        for (auto &t : removed)
+            expected.erase(t);
+        d.so_get_or_insert("so-new");
+        ok &= check(*d.snapshot(), expected, "Updated");
+
+        // the last record, torn below
+        torn = random_triples(gen, 50, n_so, n_p);
+        d.insert_batch(torn);
+    }
+
+    // a crash while writing the last record: its tail never reached the file
+    std::string segment = last_segment(dir);
+    std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 5);
+    // and a crash between a checkpoint and the removal of the previous one
+    std::filesystem::create_directories(dir + "/checkpoint-999.tmp");
+    std::filesystem::create_directories(dir + "/checkpoint-0");
+
+    {
+        durable_type d(dir);
+        ok &= check(*d.snapshot(), expected, "Recovered without the torn record");
+        bool so_new = d.so_locate("so-new").first;
+        bool stale = std::filesystem::exists(dir + "/checkpoint-999.tmp") || std::filesystem::exists(dir + "/checkpoint-0");
+        std::cout << "Dictionary update recovered -> " << (so_new ? "OK" : "ERROR") << std::endl;
+        std::cout << "Stale checkpoints removed -> " << (!stale ? "OK" : "ERROR") << std::endl;
+        ok &= so_new && !stale && d.skipped_records() == 0;
+
+        // the log goes on after the cut
+        d.insert_batch(torn);
+        expected.insert(torn.begin(), torn.end());
+        d.checkpoint();
+        auto batch = random_triples(gen, 30, n_so, n_p);
+        d.insert_batch(batch);
+        expected.insert(batch.begin(), batch.end());
+
+        // a background checkpoint that cannot write CHECKPOINT fails, and the
+        // next update throws its error without being applied
+        std::filesystem::create_directories(dir + "/CHECKPOINT.tmp/busy");
+        d.start_checkpoints(std::chrono::milliseconds(5));
+        bool reported = false;
+        for (uint64_t i = 0; i < 400 && !reported; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            auto b = random_triples(gen, 5, n_so, n_p);
+            try
+            {
+                d.insert_batch(b);
+                expected.insert(b.begin(), b.end());
+            }
+            catch (const std::exception &)
+            {
+                reported = true;
+            }
+        }
+        d.stop_checkpoints();
+        std::filesystem::remove_all(dir + "/CHECKPOINT.tmp");
+        std::cout << "Failed checkpoint reported -> " << (reported ? "OK" : "ERROR") << std::endl;
+        ok &= reported;
+        ok &= check(*d.snapshot(), expected, "After a failed checkpoint");
+        d.checkpoint();
+    }
+    {
+        durable_type d(dir);
+        ok &= check(*d.snapshot(), expected, "Reopened");
+    }
+
+    std::filesystem::remove_all(base);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
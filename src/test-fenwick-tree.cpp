@@ -0,0 +1,186 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "fenwick_tree.hpp"
+#include "bwt_dyn.hpp"
+
+typedef std::vector<uint64_t> counts_type;
+
+// sum of the first m counts
+static uint64_t prefix(const counts_type &counts, uint64_t m)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < m; ++i)
+        sum += counts[i];
+    return sum;
+}
+
+// largest m such that the sum of the first m counts is <= x
+static uint64_t upper(const counts_type &counts, uint64_t x)
+{
+    uint64_t m = 0, sum = 0;
+    while (m < counts.size() && sum + counts[m] <= x)
+        sum += counts[m++];
+    return m;
+}
+
+// every prefix sum, and the search of sums around and between them
+static uint64_t wrong_sums(const ring::fenwick_tree &tree, const counts_type &counts, std::mt19937 &gen)
+{
+    uint64_t wrong = tree.size() != counts.size();
+    for (uint64_t m = 0; m <= counts.size(); ++m)
+    {
+        uint64_t sum = prefix(counts, m);
+        wrong += tree.prefix(m) != sum;
+        wrong += tree.upper(sum) != upper(counts, sum);
+        if (sum > 0)
+            wrong += tree.upper(sum - 1) != upper(counts, sum - 1);
+    }
+    uint64_t total = prefix(counts, counts.size());
+    for (uint64_t i = 0; i < 20; ++i)
+    {
+        uint64_t x = gen() % (total + 5);
+        wrong += tree.upper(x) != upper(counts, x);
+    }
+    return wrong;
+}
+
+// random counts, many of them zero, updated and appended
+static bool test_fenwick_tree(std::mt19937 &gen)
+{
+    uint64_t wrong = 0;
+    ring::fenwick_tree empty;
+    wrong += empty.size() != 0 || empty.prefix(0) != 0 || empty.upper(10) != 0;
+    for (uint64_t n : {1, 2, 7, 64, 100, 1000})
+    {
+        counts_type counts(n);
+        for (auto &c : counts)
+            c = gen() % 3 == 0 ? 0 : gen() % 50;
+        ring::fenwick_tree tree(counts);
+        wrong += wrong_sums(tree, counts, gen);
+        for (uint64_t i = 0; i < 500; ++i)
+        {
+            if (gen() % 5 == 0)
+            {
+                uint64_t c = gen() % 3 == 0 ? 0 : gen() % 50;
+                tree.push_back(c);
+                counts.push_back(c);
+            }
+            else
+            {
+                uint64_t j = gen() % counts.size();
+                int64_t delta = (int64_t)(gen() % 20) - (int64_t)std::min<uint64_t>(counts[j], 10);
+                tree.add(j, delta);
+                counts[j] += delta;
+            }
+            if (i % 50 == 0)
+                wrong += wrong_sums(tree, counts, gen);
+        }
+        wrong += wrong_sums(tree, counts, gen);
+    }
+    // built by appending the counts
+    ring::fenwick_tree appended;
+    counts_type counts;
+    for (uint64_t i = 0; i < 300; ++i)
+    {
+        counts.push_back(gen() % 4);
+        appended.push_back(counts.back());
+        wrong += appended.prefix(counts.size()) != prefix(counts, counts.size());
+    }
+    wrong += wrong_sums(appended, counts, gen);
+    std::cout << "fenwick_tree: " << wrong << " wrong -> " << (wrong == 0 ? "OK" : "ERROR") << std::endl;
+    return wrong == 0;
+}
+
+// get_C and bsearch_C of bwt are those of the counts: counts[v] occurrences of
+// the symbols before v start, and then the zeros after the last symbol. A copy
+// serialized and loaded rebuilds the sums from the bitvector of C
+template <class bwt_type>
+static uint64_t wrong_C(bwt_type &bwt, const counts_type &counts)
+{
+    uint64_t wrong = 0;
+    std::stringstream ss;
+    bwt.serialize(ss);
+    bwt_type loaded;
+    loaded.load(ss);
+    uint64_t total = prefix(counts, counts.size());
+    for (uint64_t v = 0; v + 1 < counts.size(); ++v)
+    {
+        uint64_t c = prefix(counts, v + 1);
+        wrong += bwt.get_C(v) != c || loaded.get_C(v) != c || bwt.select_C(v) != c + v;
+    }
+    for (uint64_t x = 0; x < total; ++x)
+        wrong += bwt.bsearch_C(x) != upper(counts, x) || loaded.bsearch_C(x) != upper(counts, x);
+    return wrong;
+}
+
+// symbols added and removed from C, as the updates of the ring do
+template <class bwt_type>
+static bool test_bwt(const std::string &name, std::mt19937 &gen)
+{
+    // C as built by ring: a dummy symbol 0, and the text has n + 1 symbols
+    const uint64_t sigma = 40, n = 500;
+    std::vector<uint64_t> C = {0, 1};
+    for (uint64_t c = 2; c <= sigma; ++c)
+        C.push_back(C.back() + (gen() % 4 == 0 ? 0 : gen() % 25));
+    C.push_back(n + 1);
+    sdsl::int_vector<> L(n + 1);
+    for (uint64_t i = 0; i < L.size(); ++i)
+        L[i] = gen() % (sigma + 1);
+    bwt_type bwt(L, C, sigma);
+    counts_type counts;
+    for (uint64_t i = 0; i < C.size(); ++i)
+        counts.push_back(C[i] - (i > 0 ? C[i - 1] : 0));
+    counts.push_back(0);
+    uint64_t wrong = wrong_C(bwt, counts);
+
+    for (uint64_t i = 0; i < 2000; ++i)
+    {
+        uint64_t op = gen() % 10;
+        if (op == 0)
+        {
+            // a new symbol at the end, and occurrences of it
+            bwt.push_back_C(true);
+            counts.push_back(0);
+        }
+        else if (op == 1)
+        {
+            bwt.push_back_C(false);
+            ++counts.back();
+        }
+        else
+        {
+            uint64_t v = gen() % (counts.size() - 1);
+            uint64_t k = 1 + gen() % 3;
+            if (op < 6)
+            {
+                bwt.increment_C(v, k);
+                counts[v + 1] += k;
+            }
+            else if (counts[v + 1] > 0)
+            {
+                k = std::min(k, counts[v + 1]);
+                bwt.decrement_C(v, k);
+                counts[v + 1] -= k;
+            }
+        }
+        if (i % 200 == 0)
+            wrong += wrong_C(bwt, counts);
+    }
+    wrong += wrong_C(bwt, counts);
+    std::cout << name << ": " << counts.size() - 1 << " symbols, " << prefix(counts, counts.size())
+              << " occurrences, " << wrong << " wrong -> " << (wrong == 0 ? "OK" : "ERROR") << std::endl;
+    return wrong == 0;
+}
+
+int main()
+{
+    std::mt19937 gen(29);
+    bool ok = test_fenwick_tree(gen);
+    ok &= test_bwt<ring::bwt_dynamic>("bwt_dynamic", gen);
+    ok &= test_bwt<ring::bwt_dyn_amo>("bwt_dyn_amo", gen);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#ifndef RING_TEST_HELPERS_HPP
+#define RING_TEST_HELPERS_HPP
+
+// Helpers shared by the tests of the rings
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "ring.hpp"
+#include <triple_pattern.hpp>
+#include <ltj_algorithm.hpp>
+
+typedef std::vector<typename ring::ltj_algorithm<>::tuple_type> results_type;
+
+static inline ring::triple_pattern pattern(int s, int p, int o)
+{
+    // negative values are variables, positive ones constants
+    ring::triple_pattern t;
+    if (s < 0)
+        t.var_s(-s - 1);
+    else
+        t.const_s(s);
+    if (p < 0)
+        t.var_p(-p - 1);
+    else
+        t.const_p(p);
+    if (o < 0)
+        t.var_o(-o - 1);
+    else
+        t.const_o(o);
+    return t;
+}
+
+// the results in a canonical order, to compare them
+static inline results_type sorted(results_type res)
+{
+    for (auto &t : res)
+        std::sort(t.begin(), t.end());
+    std::sort(res.begin(), res.end());
+    return res;
+}
+
+// the sorted results of the query on r
+template <class ring_type>
+static results_type run(std::vector<ring::triple_pattern> &query, ring_type &r)
+{
+    results_type res;
+    ring::ltj_algorithm<ring_type> ltj(&query, &r);
+    ltj.join(res);
+    return sorted(std::move(res));
+}
+
+static inline spo_triple random_triple(std::mt19937 &gen, uint64_t n_so, uint64_t n_p)
+{
+    return spo_triple(1 + gen() % n_so, 1 + gen() % n_p, 1 + gen() % n_so);
+}
+
+// n random triples, maybe repeated
+static inline std::vector<spo_triple> random_triples(std::mt19937 &gen, uint64_t n, uint64_t n_so, uint64_t n_p)
+{
+    std::vector<spo_triple> v;
+    for (uint64_t i = 0; i < n; ++i)
+        v.push_back(random_triple(gen, n_so, n_p));
+    return v;
+}
+
+// the ring has exactly the triples of expected
+template <class ring_type>
+static bool check(ring_type &r, const std::set<spo_triple> &expected, const std::string &step)
+{
+    uint64_t wrong = 0;
+    for (auto &t : expected)
+        if (!r.contains(t))
+            ++wrong;
+    bool ok = wrong == 0 && r.n_triples() == expected.size();
+    std::cout << step << ": " << r.n_triples() << " triples, expected " << expected.size()
+              << ", " << wrong << " missing -> " << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+#endif
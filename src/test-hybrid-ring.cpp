@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <vector>
+#include "ring.hpp"
+#include "hybrid_ring.hpp"
+#include "test-helpers.hpp"
+
+typedef ring::ring_hybrid hybrid_type;
+typedef ring::ring<> static_type;
+
+const uint64_t n_so = 80, n_p = 6;
+
+// ?x p ?y . ?y p' ?z for some predicates, and ?x ?p ?y
+static std::vector<std::vector<ring::triple_pattern>> make_queries()
+{
+    std::vector<std::vector<ring::triple_pattern>> queries;
+    for (int p = 1; p <= 3; ++p)
+        queries.push_back({pattern(-1, p, -2), pattern(-2, p + 1, -3)});
+    queries.push_back({pattern(-1, -2, -3)});
+    return queries;
+}
+
+// The hybrid ring has the triples of expected, lists them in order and answers
+// the queries as a static ring built with them
+static bool check_hybrid(hybrid_type &h, const std::set<spo_triple> &expected, const std::string &step)
+{
+    bool ok = check(h, expected, step + " (" + std::to_string(h.n_changes()) + " changes)");
+    std::vector<spo_triple> D;
+    h.triples(D);
+    std::vector<spo_triple> E(expected.begin(), expected.end());
+    bool same = D == E;
+    static_type s(E);
+    auto queries = make_queries();
+    for (auto &q : queries)
+        same &= run(q, h) == run(q, s);
+    if (!same)
+        std::cout << step << ": different triples or results -> ERROR" << std::endl;
+    return ok && same;
+}
+
+int main()
+{
+    std::mt19937 gen(11);
+    std::set<spo_triple> expected;
+    while (expected.size() < 1000)
+        expected.insert(random_triple(gen, n_so, n_p));
+    std::vector<spo_triple> D(expected.begin(), expected.end());
+    hybrid_type h(D);
+    h.set_compaction(0.05, 2);
+    bool ok = check_hybrid(h, expected, "Built");
+
+    // Random batches, some of them start compactions and are applied again on the new base
+    uint64_t compactions = 0;
+    for (uint64_t i = 0; i < 40; ++i)
+    {
+        std::vector<spo_triple> batch;
+        for (uint64_t j = 0; j < 20; ++j)
+        {
+            if (gen() % 3 == 0 && !expected.empty())
+                batch.push_back(*std::next(expected.begin(), gen() % expected.size()));
+            else
+                batch.push_back(random_triple(gen, n_so, n_p));
+        }
+        bool was_compacting = h.compacting();
+        if (gen() % 2)
+        {
+            expected.insert(batch.begin(), batch.end());
+            h.insert_batch(batch);
+        }
+        else
+        {
+            for (auto &t : batch)
+                expected.erase(t);
+            h.remove_batch(batch);
+        }
+        compactions += was_compacting && !h.compacting();
+        if (i % 10 == 9)
+            ok &= check_hybrid(h, expected, "Batch " + std::to_string(i + 1));
+    }
+
+    // Updates while a compaction is in progress
+    h.start_compaction();
+    for (uint64_t j = 0; j < 30; ++j)
+    {
+        spo_triple t = random_triple(gen, n_so, n_p);
+        if (j % 2)
+        {
+            expected.insert(t);
+            h.insert(t);
+        }
+        else
+        {
+            expected.erase(t);
+            h.remove_edge(t);
+        }
+    }
+    ok &= check_hybrid(h, expected, "During a compaction");
+    h.finish_compaction();
+    ++compactions;
+    ok &= check_hybrid(h, expected, "After the compaction");
+
+    std::stringstream buffer;
+    h.serialize(buffer);
+    hybrid_type loaded;
+    loaded.load(buffer);
+    ok &= check_hybrid(loaded, expected, "Loaded");
+
+    h.compact();
+    ok &= h.n_changes() == 0;
+    ok &= check_hybrid(h, expected, "Compacted");
+
+    std::cout << compactions << " compactions" << std::endl;
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
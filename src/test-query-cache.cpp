@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ring.hpp"
+#include <query_cache.hpp>
+#include "test-helpers.hpp"
+
+typedef ring::ring_dyn ring_type;
+
+const uint64_t n_so = 50, n_p = 6;
+
+// Looks for the query in the cache, and on a miss computes and stores its results.
+// Checks that it was a hit or a miss as expected, and that the results are right
+static bool check(ring::query_cache<ring_type> &cache, std::vector<ring::triple_pattern> &query, ring_type &r,
+                  const bool hit, const std::string &step)
+{
+    results_type res;
+    bool found = cache.lookup(query, res);
+    if (!found)
+    {
+        res = run(query, r);
+        cache.insert(query, res);
+    }
+    bool ok = found == hit && sorted(res) == sorted(run(query, r));
+    std::cout << step << ": " << (found ? "hit" : "miss") << ", " << res.size() << " results -> "
+              << (ok ? "OK" : "ERROR") << std::endl;
+    return ok;
+}
+
+int main()
+{
+    std::mt19937 gen(3);
+    std::vector<spo_triple> D;
+    for (uint64_t i = 0; i < 1500; ++i)
+        D.emplace_back(1 + gen() % n_so, 1 + gen() % n_p, 1 + gen() % n_so);
+    std::sort(D.begin(), D.end());
+    D.erase(std::unique(D.begin(), D.end()), D.end());
+    ring_type r(D);
+    ring::query_cache<ring_type> cache(&r);
+
+    std::vector<ring::triple_pattern> join = {pattern(-1, 1, -2), pattern(-2, 2, -3)};
+    // the same query, with other names and order
+    std::vector<ring::triple_pattern> renamed = {pattern(-5, 2, -2), pattern(-4, 1, -5)};
+    std::vector<ring::triple_pattern> other = {pattern(-1, 3, -2)};
+    std::vector<ring::triple_pattern> any = {pattern(7, -1, -2)};
+
+    bool ok = check(cache, join, r, false, "Join");
+    ok &= check(cache, join, r, true, "Join again");
+    ok &= check(cache, renamed, r, true, "Join renamed");
+    ok &= check(cache, other, r, false, "Predicate 3");
+    ok &= check(cache, any, r, false, "Any predicate");
+    ok &= check(cache, any, r, true, "Any predicate again");
+
+    // a triple with a predicate of the join
+    std::vector<spo_triple> batch = {spo_triple(7, 1, 49)};
+    for (uint64_t o = 1; o <= n_so && batch.size() < 5; ++o)
+        batch.emplace_back(49, 2, o);
+    r.insert_batch(batch);
+    ok &= check(cache, join, r, false, "Join after inserting with predicates 1 and 2");
+    ok &= check(cache, other, r, true, "Predicate 3 after inserting with predicates 1 and 2");
+    ok &= check(cache, any, r, false, "Any predicate after inserting");
+    ok &= check(cache, join, r, true, "Join recomputed");
+
+    // a removal with another predicate
+    std::vector<spo_triple> removed;
+    for (auto &t : D)
+        if (std::get<1>(t) == 3 && removed.size() < 3)
+            removed.push_back(t);
+    r.remove_batch(removed);
+    ok &= check(cache, other, r, false, "Predicate 3 after removing with predicate 3");
+    ok &= check(cache, join, r, true, "Join after removing with predicate 3");
+
+    // and a single insertion
+    r.insert(spo_triple(3, 4, 5));
+    ok &= check(cache, join, r, true, "Join after inserting with predicate 4");
+    ok &= check(cache, any, r, false, "Any predicate after inserting with predicate 4");
+
+    std::cout << cache.hits() << " hits, " << cache.misses() << " misses" << std::endl;
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
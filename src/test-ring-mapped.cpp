@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ring.hpp"
+#include "mapped_file.hpp"
+#include "test-helpers.hpp"
+
+const uint64_t n_so = 120, n_p = 8;
+
+static std::vector<std::vector<ring::triple_pattern>> make_queries()
+{
+    std::vector<std::vector<ring::triple_pattern>> queries;
+    for (int p = 1; p <= 4; ++p)
+    {
+        queries.push_back({pattern(-1, p, -2), pattern(-2, p + 1, -3)});
+        queries.push_back({pattern(-1, p, -2), pattern(-1, p + 2, -3), pattern(-3, p + 1, -2)});
+        queries.push_back({pattern(p, -1, -2)});
+        queries.push_back({pattern(-1, -2, p + 10)});
+        queries.push_back({pattern(p, -1, -2), pattern(-2, -3, -4)});
+    }
+    queries.push_back({pattern(-1, -2, -3)});
+    queries.push_back({pattern(-1, 1, -2), pattern(-2, 2, -3), pattern(-3, 3, -1)});
+    return queries;
+}
+
+int main()
+{
+    std::mt19937 gen(13);
+    std::vector<spo_triple> D;
+    for (uint64_t i = 0; i < 4000; ++i)
+        D.emplace_back(1 + gen() % n_so, 1 + gen() % n_p, 1 + gen() % n_so);
+    std::sort(D.begin(), D.end());
+    D.erase(std::unique(D.begin(), D.end()), D.end());
+
+    std::string file = (std::filesystem::temp_directory_path() / "test-ring-mapped.ring").string();
+    {
+        std::vector<spo_triple> E(D);
+        ring::ring_mapped built(E);
+        sdsl::store_to_file(built, file);
+    }
+    std::vector<spo_triple> E(D);
+    ring::ring<> expected(E);
+
+    // the same file loaded into memory and mapped
+    ring::ring_mapped heap;
+    sdsl::load_from_file(heap, file);
+    ring::ring_mapped mapped;
+    ring::mapped_file mapping(file);
+    mapping.load(mapped);
+
+    bool ok = heap.n_triples() == D.size() && mapped.n_triples() == D.size();
+    uint64_t n_queries = 0, wrong = 0, n_results = 0;
+    auto queries = make_queries();
+    for (auto &q : queries)
+    {
+        results_type r = run(q, expected);
+        results_type h = run(q, heap);
+        results_type m = run(q, mapped);
+        n_results += r.size();
+        if (h != r || m != r)
+        {
+            std::cout << "Query " << n_queries << ": " << r.size() << " results, " << h.size()
+                      << " in memory, " << m.size() << " mapped -> ERROR" << std::endl;
+            ++wrong;
+        }
+        ++n_queries;
+    }
+    ok &= wrong == 0;
+    std::cout << n_queries << " queries (" << n_results << " results), " << wrong << " different" << std::endl;
+
+    std::filesystem::remove(file);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ring.hpp"
+#include "hybrid_ring.hpp"
+#include "stats_catalog.hpp"
+#include "test-helpers.hpp"
+
+const uint64_t n_so = 45, n_p = 6;
+
+static std::string bytes(const ring::stats_catalog &stats)
+{
+    std::stringstream ss;
+    stats.serialize(ss);
+    return ss.str();
+}
+
+// the statistics are those built from scratch on the triples of expected
+static bool same_stats(const ring::stats_catalog &stats, const std::set<spo_triple> &expected)
+{
+    std::vector<spo_triple> D(expected.begin(), expected.end());
+    ring::stats_catalog built;
+    built.build(D);
+    return stats.enabled() && bytes(stats) == bytes(built);
+}
+
+// Random updates of every kind, each one compared with the statistics built from
+// scratch. Only absent triples are inserted and only present ones removed
+template <class ring_type>
+static bool update(ring_type &r, std::set<spo_triple> &expected, std::mt19937 &gen, uint64_t n,
+                   const std::string &step)
+{
+    uint64_t wrong = 0;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        switch (gen() % 4)
+        {
+        case 0:
+        {
+            spo_triple t = random_triple(gen, n_so, n_p);
+            if (expected.insert(t).second)
+                r.insert(t);
+            break;
+        }
+        case 1:
+        {
+            if (expected.empty())
+                break;
+            auto it = std::next(expected.begin(), gen() % expected.size());
+            r.remove_edge(*it);
+            expected.erase(it);
+            break;
+        }
+        case 2:
+        {
+            std::vector<spo_triple> batch;
+            for (uint64_t j = 0; j < 20; ++j)
+            {
+                spo_triple t = random_triple(gen, n_so, n_p);
+                if (expected.insert(t).second)
+                    batch.push_back(t);
+            }
+            r.insert_batch(batch);
+            break;
+        }
+        default:
+        {
+            std::vector<spo_triple> batch;
+            for (auto &t : expected)
+                if (gen() % 30 == 0)
+                    batch.push_back(t);
+            for (auto &t : batch)
+                expected.erase(t);
+            r.remove_batch(batch);
+            break;
+        }
+        }
+        if (!same_stats(r.stats(), expected))
+            ++wrong;
+    }
+    std::cout << step << ": " << expected.size() << " triples, " << n << " updates, " << wrong
+              << " with wrong statistics -> " << (wrong == 0 ? "OK" : "ERROR") << std::endl;
+    return wrong == 0;
+}
+
+template <class ring_type>
+static bool test(const std::string &name, std::mt19937 &gen)
+{
+    std::set<spo_triple> expected;
+    while (expected.size() < 800)
+        expected.insert(random_triple(gen, n_so, n_p));
+    std::vector<spo_triple> D(expected.begin(), expected.end());
+    ring_type r(D);
+    D.assign(expected.begin(), expected.end());
+    r.stats().build(D);
+    bool ok = same_stats(r.stats(), expected);
+    ok &= update(r, expected, gen, 300, name + ", updated");
+
+    // the statistics are stored apart from the ring
+    std::stringstream ring_out, stats_out;
+    r.serialize(ring_out);
+    r.stats().serialize(stats_out);
+    ring_type loaded;
+    loaded.load(ring_out);
+    ok &= !loaded.stats().enabled();
+    loaded.stats().load(stats_out);
+    ok &= same_stats(loaded.stats(), expected);
+    ok &= update(loaded, expected, gen, 300, name + ", updated after loading");
+    return ok;
+}
+
+int main()
+{
+    std::mt19937 gen(9);
+    bool ok = test<ring::ring_dyn>("ring_dyn", gen);
+    ok &= test<ring::ring_hybrid>("ring_hybrid", gen);
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ring.hpp"
+#include "versioned_ring.hpp"
+#include "test-helpers.hpp"
+
+typedef ring::ring_dyn ring_type;
+typedef ring::versioned_ring<ring_type> versioned_type;
+
+const uint64_t n_so = 60, n_p = 6;
+
+// batch k of the concurrent part: triples with subject n_so + k, not in the ring before
+static std::vector<spo_triple> new_batch(uint64_t k, uint64_t size)
+{
+    std::vector<spo_triple> batch;
+    for (uint64_t j = 0; j < size; ++j)
+        batch.emplace_back(n_so + 1 + k, 1 + j % n_p, 1 + j);
+    return batch;
+}
+
+int main()
+{
+    std::mt19937 gen(5);
+    std::set<spo_triple> expected;
+    while (expected.size() < 400)
+        expected.insert(random_triple(gen, n_so, n_p));
+    std::vector<spo_triple> D(expected.begin(), expected.end());
+    ring_type r(D);
+    versioned_type versioned(std::move(r));
+    bool ok = check(*versioned.snapshot(), expected, "Built");
+
+    // a reader holds a snapshot while the writer updates
+    auto old_snap = versioned.snapshot();
+    std::set<spo_triple> old_expected = expected;
+    for (uint64_t i = 0; i < 6; ++i)
+    {
+        std::vector<spo_triple> batch;
+        for (uint64_t j = 0; j < 25; ++j)
+            batch.push_back(random_triple(gen, n_so, n_p));
+        if (i % 2 == 0)
+        {
+            versioned.insert_batch(batch);
+            expected.insert(batch.begin(), batch.end());
+        }
+        else
+        {
+            std::vector<spo_triple> removed(expected.begin(), std::next(expected.begin(), 25));
+            versioned.remove_batch(removed);
+            for (auto &t : removed)
+                expected.erase(t);
+        }
+        // the new version, built on the standby once the held snapshot is not the standby anymore
+        ok &= check(*versioned.snapshot(), expected, "Version " + std::to_string(versioned.version()));
+    }
+    ok &= check(*old_snap, old_expected, "Held snapshot");
+    old_snap.reset();
+
+    // without the standby, every update copies the published version
+    versioned.set_keep_standby(false);
+    std::vector<spo_triple> batch;
+    for (uint64_t j = 0; j < 25; ++j)
+        batch.push_back(random_triple(gen, n_so, n_p));
+    auto held = versioned.snapshot();
+    old_expected = expected;
+    versioned.insert_batch(batch);
+    expected.insert(batch.begin(), batch.end());
+    ok &= check(*versioned.snapshot(), expected, "Without standby");
+    ok &= check(*held, old_expected, "Held snapshot without standby");
+    held.reset();
+    versioned.set_keep_standby(true);
+
+    // readers take snapshots while the writer publishes new batches: a snapshot
+    // has the first k batches whole and nothing of the next one
+    const uint64_t n_batches = 30, batch_size = 20, readers = 3;
+    const uint64_t base_triples = versioned.snapshot()->n_triples();
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> errors(0), snapshots(0);
+    std::vector<std::thread> threads;
+    for (uint64_t r = 0; r < readers; ++r)
+    {
+        threads.emplace_back([&]() {
+            while (!done.load())
+            {
+                auto snap = versioned.snapshot();
+                uint64_t n = snap->n_triples();
+                uint64_t k = (n - base_triples) / batch_size;
+                if (n < base_triples || (n - base_triples) % batch_size != 0 || k > n_batches)
+                {
+                    ++errors;
+                    continue;
+                }
+                if (k > 0)
+                    for (auto &t : new_batch(k - 1, batch_size))
+                        errors += !snap->contains(t);
+                if (k < n_batches)
+                    for (auto &t : new_batch(k, batch_size))
+                        errors += snap->contains(t);
+                ++snapshots;
+            }
+        });
+    }
+    for (uint64_t k = 0; k < n_batches; ++k)
+    {
+        auto b = new_batch(k, batch_size);
+        versioned.insert_batch(b);
+        expected.insert(b.begin(), b.end());
+    }
+    done = true;
+    for (auto &t : threads)
+        t.join();
+    std::cout << "Concurrent snapshots: " << snapshots.load() << ", " << errors.load() << " errors -> "
+              << (errors.load() == 0 ? "OK" : "ERROR") << std::endl;
+    ok &= errors.load() == 0;
+    ok &= check(*versioned.snapshot(), expected, "After the concurrent updates");
+
+    std::cout << (ok ? "All tests passed" : "Some tests failed") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -17,13 +17,19 @@
  * with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <utility>
 #include "ring.hpp"
 #include "dict_map.hpp"
+#include "versioned_ring.hpp"
 #include <chrono>
+#include <thread>
+#include <atomic>
 #include <triple_pattern.hpp>
 #include <ltj_algorithm.hpp>
+#include "bitvector_amortized/concurrent.hpp"
 #include "utils.hpp"
 #include <regex>
 
@@ -190,8 +196,98 @@ std::string get_type(const std::string &file)
     return file.substr(p + 1);
 }
 
+// Triples per batch, and at most max_inserted of them are inserted
+const uint64_t batch_size = 100, max_inserted = 4000;
+
+/**
+ * Calls f with the consecutive batches of at most size triples, the last
+ * one can be smaller, until limit triples are given
+ */
+template <class function_type>
+void for_each_batch(const vector<spo_triple> &triples, const uint64_t size, const uint64_t limit, function_type f)
+{
+    auto end = std::next(triples.begin(), std::min<uint64_t>(limit, triples.size()));
+    for (auto it = triples.begin(); it != end;)
+    {
+        auto batchEnd = std::next(it, std::min<uint64_t>(size, std::distance(it, end)));
+        std::vector<spo_triple> batch(it, batchEnd);
+        f(batch);
+        it = batchEnd;
+    }
+}
+
+/**
+ * Inserts the triples in batches through a versioned ring while n_readers threads
+ * run the query on the snapshots. Reports the time of each batch and, per reader,
+ * the number of queries answered and their mean time.
+ */
+template <class ring_type>
+void concurrent_insert(ring_type &graph, std::vector<ring::triple_pattern> &query, const vector<spo_triple> &triples,
+                       const uint64_t n_readers, uint64_t &nQ)
+{
+    typedef std::vector<typename ring::ltj_algorithm<>::tuple_type> results_type;
+    high_resolution_clock::time_point start, stop;
+    duration<double> time_span;
+
+    // readers and the writer copying the published version read the same ring
+    amo::setConcurrentReads(true);
+    ring::versioned_ring<ring_type> versioned(std::move(graph));
+    std::atomic<bool> done(false);
+    std::vector<uint64_t> n_queries(n_readers, 0);
+    std::vector<double> reader_time(n_readers, 0.0);
+    std::vector<std::thread> readers;
+    for (uint64_t r = 0; r < n_readers; ++r)
+    {
+        readers.emplace_back([&, r]() {
+            while (!done.load())
+            {
+                auto snap = versioned.snapshot();
+                auto t0 = high_resolution_clock::now();
+                ring::ltj_algorithm<ring_type> ltj(&query, snap.get());
+                results_type res;
+                ltj.join(res, 0, 600);
+                duration<double> elapsed = duration_cast<microseconds>(high_resolution_clock::now() - t0);
+                reader_time[r] += elapsed.count();
+                ++n_queries[r];
+            }
+        });
+    }
+
+    for_each_batch(triples, batch_size, max_inserted, [&](std::vector<spo_triple> &batch) {
+        start = high_resolution_clock::now();
+        versioned.insert_batch(batch);
+        stop = high_resolution_clock::now();
+        time_span = duration_cast<microseconds>(stop - start);
+        cout << nQ << ";" << (unsigned long long)(time_span.count() * 1000000000ULL) << endl;
+        nQ++;
+    });
+    done = true;
+    for (auto &t : readers)
+        t.join();
+
+    for (uint64_t r = 0; r < n_readers; ++r)
+    {
+        double mean = n_queries[r] ? reader_time[r] / n_queries[r] : 0.0;
+        cout << nQ << ";" << n_queries[r] << ";" << (unsigned long long)(mean * 1000000000ULL) << endl;
+        nQ++;
+    }
+
+    // the last version
+    auto snap = versioned.snapshot();
+    start = high_resolution_clock::now();
+    ring::ltj_algorithm<ring_type> ltj(&query, snap.get());
+    results_type res;
+    ltj.join(res, 0, 600);
+    stop = high_resolution_clock::now();
+    time_span = duration_cast<microseconds>(stop - start);
+    cout << nQ << ";" << res.size() << ";" << (unsigned long long)(time_span.count() * 1000000000ULL) << endl;
+    nQ++;
+    amo::setConcurrentReads(false);
+}
+
 template <class ring_type, class map_type>
-void mapped_delete_insert(const std::string &file, const std::string &so_mapping_file, const std::string &p_mapping_file, const std::string &queries, const std::string &triples_file)
+void mapped_delete_insert(const std::string &file, const std::string &so_mapping_file, const std::string &p_mapping_file, const std::string &queries, const std::string &triples_file,
+                          const uint64_t n_readers)
 {
     vector<string> dummy_queries, dummy_triples;
 
@@ -222,6 +318,9 @@ void mapped_delete_insert(const std::string &file, const std::string &so_mapping
 
     cout << endl
          << " Index loaded " << sdsl::size_in_bytes(graph) << " bytes" << endl;
+    // Kept up to date by the updates, the GAO of the queries uses them
+    if (ring::util::load_stats(graph, file))
+        cout << " Statistics loaded " << graph.stats().bit_size() / 8 << " bytes" << endl;
 
     std::ifstream ifs;
     uint64_t nQ = 0;
@@ -248,11 +347,9 @@ void mapped_delete_insert(const std::string &file, const std::string &so_mapping
         parse_triples<map_type>(dummy_triples, triples, so_mapping, p_mapping); // triples parse
 
         // DELETE the triples
+        std::vector<spo_triple> to_remove(triples);
         start = high_resolution_clock::now();
-        for (spo_triple &t : triples)
-        {
-            graph.remove_edge(t);
-        }
+        graph.remove_batch(to_remove);
         stop = high_resolution_clock::now();
         time_span = duration_cast<microseconds>(stop - start);
         delete_time = time_span.count();
@@ -276,26 +373,22 @@ void mapped_delete_insert(const std::string &file, const std::string &so_mapping
         cout << nQ << ";" << res.size() << ";" << (unsigned long long)(query_time * 1000000000ULL) << endl;
         nQ++;
 
-        uint8_t batch_size = 100;
-        uint64_t limit = 4000;
-
-        for (auto it = triples.begin(); it != triples.end(); std::advance(it, batch_size))
+        if (n_readers > 0)
         {
-            auto batchEnd = std::next(it, batch_size);
+            concurrent_insert<ring_type>(graph, query, triples, n_readers, nQ);
+            return;
+        }
+
+        for_each_batch(triples, batch_size, max_inserted, [&](std::vector<spo_triple> &batch) {
             // Insert 100 triples
             start = high_resolution_clock::now();
-            for (auto batchIt = it; batchIt != batchEnd; ++batchIt)
-            {
-                graph.insert(*batchIt);
-            }
+            graph.insert_batch(batch);
             stop = high_resolution_clock::now();
             time_span = duration_cast<microseconds>(stop - start);
             insert_time = time_span.count();
             cout << nQ << ";" << (unsigned long long)(insert_time * 1000000000ULL) << endl;
             nQ++;
 
-            limit -= batch_size;
-
             // Query again
             start = high_resolution_clock::now();
 
@@ -311,17 +404,15 @@ void mapped_delete_insert(const std::string &file, const std::string &so_mapping
 
             cout << nQ << ";" << res.size() << ";" << (unsigned long long)(query_time * 1000000000ULL) << endl;
             nQ++;
-
-            if (limit <= 0) break;
-        }
+        });
     }
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 6)
+    if (argc != 6 && argc != 7)
     {
-        std::cout << "Usage: " << argv[0] << " <index> <SO mapping> <P mapping> <query> <triples>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <index> <SO mapping> <P mapping> <query> <triples> [readers]" << std::endl;
         return 0;
     }
 
@@ -331,18 +422,20 @@ int main(int argc, char *argv[])
     std::string queries = argv[4];
     std::string triples = argv[5];
     std::string type = get_type(index);
+    // with readers, the query runs on snapshots of a versioned ring while the triples are inserted
+    uint64_t n_readers = argc == 7 ? std::stoull(argv[6]) : 0;
 
     if (type == "ring-dyn-basic")
     {
-        mapped_delete_insert<ring::ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, triples);
+        mapped_delete_insert<ring::ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, triples, n_readers);
     }
     else if (type == "ring-dyn")
     {
-        mapped_delete_insert<ring::medium_ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, triples);
+        mapped_delete_insert<ring::medium_ring_dyn, ring::basic_map>(index, so_mapping, p_mapping, queries, triples, n_readers);
     }
     else if (type == "ring-dyn-amo")
     {
-        mapped_delete_insert<ring::ring_dyn_amo, ring::basic_map>(index, so_mapping, p_mapping, queries, triples);
+        mapped_delete_insert<ring::ring_dyn_amo, ring::basic_map>(index, so_mapping, p_mapping, queries, triples, n_readers);
     }
     else
     {